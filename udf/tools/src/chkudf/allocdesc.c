@@ -0,0 +1,475 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (c) 2026 Steve Magnani. All rights reserved.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nsr.h"
+#include "chkudf.h"
+#include "protos.h"
+
+/*
+ * Allocation descriptor walking.
+ *
+ * ADIterInit() starts a walk at the descriptors recorded in an (Extended)
+ * File Entry; ADIterInitChain() starts one at the first Unallocated Space
+ * Entry of a space table. Each ADIterNext() returns one extent. Extents
+ * that continue the descriptors elsewhere (E_ALLOCEXTENT) are returned like
+ * any other, so the caller can account for their space, and are followed
+ * by the next call.
+ *
+ * A continuation that can't be read, isn't the expected descriptor, or
+ * loops back to a block the walk has already passed through ends the walk
+ * with Failed set, after the problem has been reported. Since no block is
+ * passed through twice, a chain is only as long as the blocks it has; the
+ * set of those passed through grows with it. A zero-length descriptor ends
+ * the walk with ZeroLength set; the extent passed to ADIterNext() then
+ * holds that descriptor. Once done with, a walk is released by ADIterFree().
+ *
+ * Entering a continuation block starts the read of the next one, so a long
+ * chain is read while the current block's extents are being used.
+ */
+
+#define VISITED_KEY(ptn, loc)  ((1ULL << 63) | ((uint64_t) (ptn) << 32) | (loc))
+
+static uint32_t ADSize(uint16_t adType)
+{
+  return   (adType == ADLONG)     ? sizeof(struct long_ad)
+         : (adType == ADEXTENDED) ? sizeof(struct ext_ad)
+         :                          sizeof(struct short_ad);
+}
+
+static uint32_t VisitedSlot(uint64_t key, uint32_t numSlots)
+{
+  return (uint32_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & (numSlots - 1);
+}
+
+/*
+ * Double the room for blocks passed through. Returns false if there's no
+ * memory for it.
+ */
+static bool GrowVisited(sADIter *iter)
+{
+  uint32_t newSlots = iter->VisitedSlots ? iter->VisitedSlots * 2 : AD_VISITED_INITIAL;
+  uint64_t *larger;
+  uint32_t i, slot;
+
+  larger = calloc(newSlots, sizeof(uint64_t));
+  if (!larger) {
+    return false;
+  }
+  for (i = 0; i < iter->VisitedSlots; i++) {
+    if (iter->Visited[i]) {
+      slot = VisitedSlot(iter->Visited[i], newSlots);
+      while (larger[slot]) {
+        slot = (slot + 1) & (newSlots - 1);
+      }
+      larger[slot] = iter->Visited[i];
+    }
+  }
+  free(iter->Visited);
+  iter->Visited = larger;
+  iter->VisitedSlots = newSlots;
+  return true;
+}
+
+/*
+ * Remember that the walk has passed through a block. Returns false if it
+ * already had. There must be a free slot.
+ */
+static bool MarkVisited(sADIter *iter, uint16_t ptn, uint32_t location)
+{
+  uint64_t key = VISITED_KEY(ptn, location);
+  uint32_t slot = VisitedSlot(key, iter->VisitedSlots);
+
+  while (iter->Visited[slot]) {
+    if (iter->Visited[slot] == key) {
+      return false;
+    }
+    slot = (slot + 1) & (iter->VisitedSlots - 1);
+  }
+  iter->Visited[slot] = key;
+  iter->NumBlocks++;
+  return true;
+}
+
+/*
+ * Start reading the block that the descriptors of a continuation block
+ * are continued in, if there is one.
+ */
+static void PrefetchChain(udf_volume *vol, const sADIter *iter, const uint8_t *ads)
+{
+  uint32_t adSize = ADSize(iter->ADType);
+  uint32_t offset;
+
+  for (offset = 0; (offset + adSize) <= iter->L_AD; offset += adSize) {
+    const struct short_ad *sad = (const struct short_ad *)(ads + offset);
+
+    if (!EXTENT_LENGTH(sad->ExtentLengthAndType)) {
+      break;
+    }
+    if (EXTENT_TYPE(sad->ExtentLengthAndType) == E_ALLOCEXTENT) {
+      if (iter->ADType == ADSHORT) {
+        PrefetchPBlock(vol, U_endian32(sad->Location), iter->Ptn);
+      } else if (iter->ADType == ADLONG) {
+        const struct long_ad *lad = (const struct long_ad *)sad;
+        PrefetchPBlock(vol, U_endian32(lad->Location_LBN), U_endian16(lad->Location_PartNo));
+      } else {
+        const struct ext_ad *ead = (const struct ext_ad *)sad;
+        PrefetchPBlock(vol, U_endian32(ead->Location_LBN), U_endian16(ead->Location_PartNo));
+      }
+      break;
+    }
+  }
+}
+
+/*
+ * Move the walk to the continuation block described by extent. Returns
+ * false, having reported why, if the walk can't go on.
+ */
+static bool FollowChain(udf_volume *vol, sADIter *iter, const sADExtent *extent)
+{
+  const uint8_t *block;
+  uint32_t L_AD, hdrSize;
+  int result;
+
+  if (((iter->NumBlocks + 1) * 2 > iter->VisitedSlots) && !GrowVisited(iter)) {
+    OperationalError(vol, "**Couldn't allocate memory to follow allocation descriptors.\n");
+    return false;
+  }
+  if (!MarkVisited(iter, extent->Ptn, extent->Location)) {
+    SetError(vol, ERR_AD_LOOP, iter->DescLoc, extent->Location, 0);
+    DumpError(vol);
+    return false;
+  }
+
+  block = CachePBlocks(vol, extent->Location, extent->Ptn, 1);
+  if (!block) {
+    SetError(vol, ERR_READ, extent->Location, 0, 0);
+    DumpError(vol);
+    return false;
+  }
+
+  if (iter->ChainTagID == TAGID_ALLOC_EXTENT) {
+    const struct AllocationExtentDesc *AED = (const struct AllocationExtentDesc *)block;
+
+    result = CheckTag(vol, (const struct tag *)AED, extent->Location, TAGID_ALLOC_EXTENT,
+                      8, vol->blocksize - 16);
+    if ((result < CHECKTAG_OK_LIMIT) && (CurrentError(vol)->Code == ERR_TAGLOC)
+        && (U_endian32(AED->sTag.uTagLoc) == 0xffffffff)) {
+      ClearError(vol);     // Location not recorded
+    }
+    hdrSize = sizeof(struct AllocationExtentDesc);
+    L_AD = U_endian32(AED->L_AD);
+  } else {
+    const struct UnallocSpEntry *USE = (const struct UnallocSpEntry *)block;
+
+    result = CheckTag(vol, (const struct tag *)USE, extent->Location, TAGID_UNALLOC_SP_ENTRY,
+                      0, MIN(extent->Length, vol->blocksize));
+    if (result < CHECKTAG_OK_LIMIT) {
+      DumpError(vol);
+      // UDF: "Only Short Allocation Descriptors shall be used."
+      if ((U_endian16(USE->sICBTag.Flags) & ADTYPEMASK) != iter->ADType) {
+        SetError(vol, ERR_PROHIBITED_AD_TYPE, extent->Location, iter->ADType,
+                 U_endian16(USE->sICBTag.Flags) & ADTYPEMASK);
+        result = CHECKTAG_WRONG_TAG;
+      }
+    }
+    hdrSize = sizeof(struct UnallocSpEntry);
+    L_AD = U_endian32(USE->L_AD);
+  }
+  DumpError(vol);
+  if (result >= CHECKTAG_OK_LIMIT) {
+    return false;
+  }
+
+  iter->ADs = NULL;
+  iter->L_AD = MIN(L_AD, vol->blocksize - hdrSize);
+  iter->Offset = 0;
+  iter->DescLoc = extent->Location;
+  iter->BlockLoc = extent->Location;
+  iter->BlockPtn = extent->Ptn;
+  iter->BlockHdrSize = hdrSize;
+  PrefetchChain(vol, iter, block + hdrSize);
+  return true;
+}
+
+/*
+ * Start a walk at the allocation descriptors of an (Extended) File Entry
+ * recorded in partition reference ptn. Embedded data (ADNONE) and invalid
+ * descriptor types yield no extents. Descriptors that run past the end of
+ * the block end the walk with Failed set.
+ */
+void ADIterInit(udf_volume *vol, sADIter *iter, const struct FE_or_EFE *xFE, uint16_t ptn)
+{
+  uint32_t L_EA, L_AD, hdrSize;
+
+  if (U_endian16(xFE->sTag.uTagID) == TAGID_EXT_FILE_ENTRY) {
+    hdrSize = sizeof(struct ExtFileEntry);
+    L_EA = U_endian32(xFE->EFE.L_EA);
+    L_AD = U_endian32(xFE->EFE.L_AD);
+  } else {
+    hdrSize = sizeof(struct FileEntry);
+    L_EA = U_endian32(xFE->FE.L_EA);
+    L_AD = U_endian32(xFE->FE.L_AD);
+  }
+
+  iter->ADType = U_endian16(xFE->sICBTag.Flags) & ADTYPEMASK;
+  iter->Ptn = ptn;
+  iter->ChainTagID = TAGID_ALLOC_EXTENT;
+  iter->ADs = (const uint8_t *)xFE + hdrSize + L_EA;
+  iter->L_AD = L_AD;
+  iter->Offset = 0;
+  iter->DescLoc = U_endian32(xFE->sTag.uTagLoc);
+  iter->Chain = false;
+  iter->ZeroLength = false;
+  iter->Failed = false;
+  iter->NumBlocks = 0;
+  iter->Visited = NULL;
+  iter->VisitedSlots = 0;
+
+  if ((iter->ADType != ADSHORT) && (iter->ADType != ADLONG) && (iter->ADType != ADEXTENDED)) {
+    iter->L_AD = 0;
+  } else if ((L_EA > vol->blocksize) || (L_AD > vol->blocksize)
+             || ((hdrSize + L_EA + L_AD) > vol->blocksize)) {
+    iter->L_AD = 0;
+    iter->Failed = true;
+  }
+}
+
+/*
+ * Start a walk at the Unallocated Space Entry of length bytes at location
+ * in partition reference ptn. Returns false, having reported why, if it
+ * can't be used; the walk is then already released.
+ */
+bool ADIterInitChain(udf_volume *vol, sADIter *iter, uint16_t ptn, uint32_t location,
+                     uint32_t length)
+{
+  sADExtent first;
+
+  memset(&first, 0, sizeof(first));
+  first.Location = location;
+  first.Length = length;
+  first.Ptn = ptn;
+  first.Type = E_ALLOCEXTENT;
+
+  iter->ADType = ADSHORT;
+  iter->Ptn = ptn;
+  iter->ChainTagID = TAGID_UNALLOC_SP_ENTRY;
+  iter->ADs = NULL;
+  iter->L_AD = 0;
+  iter->Offset = 0;
+  iter->DescLoc = location;
+  iter->Chain = false;
+  iter->ZeroLength = false;
+  iter->NumBlocks = 0;
+  iter->Visited = NULL;
+  iter->VisitedSlots = 0;
+  iter->Failed = !FollowChain(vol, iter, &first);
+  if (iter->Failed) {
+    ADIterFree(iter);
+  }
+
+  return !iter->Failed;
+}
+
+/*
+ * Take the next extent. Returns false when there are no more.
+ */
+bool ADIterNext(udf_volume *vol, sADIter *iter, sADExtent *extent)
+{
+  const uint8_t *ads;
+  const struct short_ad *sad;
+  uint32_t adSize = ADSize(iter->ADType);
+
+  if (iter->ZeroLength || iter->Failed) {
+    return false;
+  }
+  if (iter->Chain) {
+    iter->Chain = false;
+    if (!FollowChain(vol, iter, &iter->Next)) {
+      iter->Failed = true;
+      iter->L_AD = 0;
+      return false;
+    }
+  }
+
+  if ((iter->Offset + adSize) > iter->L_AD) {
+    return false;
+  }
+
+  ads = iter->ADs;
+  if (!ads) {
+    ads = CachePBlocks(vol, iter->BlockLoc, iter->BlockPtn, 1);
+    if (!ads) {
+      SetError(vol, ERR_READ, iter->BlockLoc, 0, 0);
+      DumpError(vol);
+      iter->Failed = true;
+      iter->L_AD = 0;
+      return false;
+    }
+    ads += iter->BlockHdrSize;
+  }
+
+  // Note, all three AD types start with the extent length and type
+  sad = (const struct short_ad *)(ads + iter->Offset);
+  extent->Length = EXTENT_LENGTH(sad->ExtentLengthAndType);
+  extent->Type = EXTENT_TYPE(sad->ExtentLengthAndType);
+  extent->InfoLength = extent->Length;
+  extent->RecordedLength = (extent->Type == E_RECORDED) ? extent->Length : 0;
+
+  if (iter->ADType == ADSHORT) {
+    extent->Location = U_endian32(sad->Location);
+    extent->Ptn = iter->Ptn;
+  } else if (iter->ADType == ADLONG) {
+    const struct long_ad *lad = (const struct long_ad *)sad;
+    extent->Location = U_endian32(lad->Location_LBN);
+    extent->Ptn = U_endian16(lad->Location_PartNo);
+  } else {
+    const struct ext_ad *ead = (const struct ext_ad *)sad;
+    extent->Location = U_endian32(ead->Location_LBN);
+    extent->Ptn = U_endian16(ead->Location_PartNo);
+    if (extent->Type != E_ALLOCEXTENT) {
+      // Space is allocated for the extent length, the file has the information length
+      extent->InfoLength = U_endian32(ead->InfoLength);
+      if (extent->Type == E_RECORDED) {
+        // The top two bits are reserved (ECMA-167 4/14.14.3)
+        extent->RecordedLength = U_endian32(ead->RecordedLength) & 0x3FFFFFFF;
+      }
+    }
+  }
+
+  extent->DescOffset = iter->Offset;
+  if (extent->Length == 0) {
+    // ECMA-167r3 sec. 4.12: zero extent length terminates allocation descriptors
+    iter->ZeroLength = true;
+    return false;
+  }
+  iter->Offset += adSize;
+
+  if (extent->Type == E_ALLOCEXTENT) {
+    iter->Chain = true;
+    iter->Next = *extent;
+  }
+
+  return true;
+}
+
+void ADIterFree(sADIter *iter)
+{
+  free(iter->Visited);
+  iter->Visited = NULL;
+  iter->VisitedSlots = 0;
+}
+
+static bool AddSummaryExtent(sADSummary *summary, const sADExtent *extent, uint64_t start)
+{
+  if (summary->NumExtents >= summary->Allocated) {
+    uint32_t newAlloc = summary->Allocated ? summary->Allocated * 2 : 16;
+    sADExtent *extents;
+    uint64_t *starts;
+
+    extents = realloc(summary->Extents, newAlloc * sizeof(sADExtent));
+    if (!extents) {
+      return false;
+    }
+    summary->Extents = extents;
+    starts = realloc(summary->Start, newAlloc * sizeof(uint64_t));
+    if (!starts) {
+      return false;
+    }
+    summary->Start = starts;
+    summary->Allocated = newAlloc;
+  }
+
+  summary->Extents[summary->NumExtents] = *extent;
+  summary->Start[summary->NumExtents] = start;
+  summary->NumExtents++;
+  return true;
+}
+
+static void WalkADs(udf_volume *vol, sADSummary *summary, const struct FE_or_EFE *xFE,
+                    uint16_t ptn)
+{
+  sADIter   iter;
+  sADExtent extent;
+  uint64_t  start = 0;
+
+  summary->NumExtents = 0;
+  ADIterInit(vol, &iter, xFE, ptn);
+  while (ADIterNext(vol, &iter, &extent)) {
+    if (!AddSummaryExtent(summary, &extent, start)) {
+      OperationalError(vol, "**Couldn't allocate memory for allocation descriptors.\n");
+      iter.Failed = true;
+      break;
+    }
+    if (extent.Type != E_ALLOCEXTENT) {
+      start += extent.InfoLength;
+    }
+  }
+  summary->NumBlocks = iter.NumBlocks;
+  summary->Failed = iter.Failed;
+  ADIterFree(&iter);
+}
+
+/*
+ * Summarize the extents of the file whose (Extended) File Entry, recorded
+ * at block icbLoc of partition reference ptn, is xFE. A file whose
+ * descriptors are continued in other blocks is only walked again once its
+ * summary has been replaced by those of AD_SUMMARY_SLOTS more recently used
+ * files. Problems found in the walk are reported when it is made.
+ *
+ * The summary is valid until the next call.
+ */
+const sADSummary *GetADSummary(udf_volume *vol, const struct FE_or_EFE *xFE, uint16_t ptn,
+                               uint32_t icbLoc)
+{
+  sADSummary *victim = &vol->ADSummaries[0];
+  sADSummary  swap;
+  uint32_t    i;
+
+  for (i = 0; i < AD_SUMMARY_SLOTS; i++) {
+    sADSummary *slot = &vol->ADSummaries[i];
+
+    if (slot->Kept && (slot->ICBLoc == icbLoc) && (slot->Ptn == ptn)) {
+      slot->LastUsed = ++vol->ADSummaryClock;
+      return slot;
+    }
+  }
+
+  WalkADs(vol, &vol->ADScratch, xFE, ptn);
+  if (!vol->ADScratch.NumBlocks) {
+    return &vol->ADScratch;
+  }
+
+  // Keep it in place of the least recently used
+  for (i = 1; i < AD_SUMMARY_SLOTS; i++) {
+    if (vol->ADSummaries[i].LastUsed < victim->LastUsed) {
+      victim = &vol->ADSummaries[i];
+    }
+  }
+  swap = *victim;
+  *victim = vol->ADScratch;
+  vol->ADScratch = swap;
+  vol->ADScratch.Kept = false;
+  victim->Kept = true;
+  victim->ICBLoc = icbLoc;
+  victim->Ptn = ptn;
+  victim->LastUsed = ++vol->ADSummaryClock;
+
+  return victim;
+}
+
+void FreeADSummaries(udf_volume *vol)
+{
+  uint32_t i;
+
+  for (i = 0; i < AD_SUMMARY_SLOTS; i++) {
+    free(vol->ADSummaries[i].Extents);
+    free(vol->ADSummaries[i].Start);
+  }
+  free(vol->ADScratch.Extents);
+  free(vol->ADScratch.Start);
+  memset(vol->ADSummaries, 0, sizeof(vol->ADSummaries));
+  memset(&vol->ADScratch, 0, sizeof(vol->ADScratch));
+}
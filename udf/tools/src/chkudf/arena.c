@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (c) 2026 Steve Magnani. All rights reserved.
+
+#include <stdlib.h>
+#include "chkudf.h"
+#include "protos.h"
+
+/*
+ * Bump allocator for data that lives until the check is finished.
+ *
+ * Memory is carved sequentially out of large slabs; nothing is ever freed
+ * individually or moved, so pointers stay valid until ArenaRelease()
+ * returns every slab at once.
+ */
+
+#define ARENA_ALIGN        16
+#define ARENA_ROUND(n)     (((n) + ARENA_ALIGN - 1) & ~(uint32_t)(ARENA_ALIGN - 1))
+#define ARENA_HDR_SIZE     ARENA_ROUND(sizeof(sArenaSlab))
+
+void *ArenaAlloc(sArena *arena, uint32_t numBytes)
+{
+  sArenaSlab *slab = arena->Slabs;
+  uint8_t *p;
+
+  numBytes = ARENA_ROUND(numBytes);
+
+  if (!slab || (slab->Size - slab->Used < numBytes)) {
+    uint32_t slabSize = MAX(numBytes, ARENA_SLAB_SIZE);
+    sArenaSlab *newSlab = malloc(ARENA_HDR_SIZE + slabSize);
+    if (!newSlab) {
+      return NULL;
+    }
+    newSlab->Size = slabSize;
+    newSlab->Used = 0;
+
+    if (slab && (numBytes > ARENA_SLAB_SIZE)) {
+      // Oversize request - keep filling the current slab afterwards
+      newSlab->Next = slab->Next;
+      slab->Next = newSlab;
+    } else {
+      newSlab->Next = slab;
+      arena->Slabs = newSlab;
+    }
+    slab = newSlab;
+  }
+
+  p = (uint8_t *)slab + ARENA_HDR_SIZE + slab->Used;
+  slab->Used += numBytes;
+  arena->Bytes += numBytes;
+
+  return p;
+}
+
+void ArenaRelease(sArena *arena)
+{
+  sArenaSlab *slab = arena->Slabs;
+
+  while (slab) {
+    sArenaSlab *next = slab->Next;
+    free(slab);
+    slab = next;
+  }
+  arena->Slabs = NULL;
+  arena->Bytes = 0;
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (c) 2026 Steve Magnani. All rights reserved.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "chkudf.h"
+#include "protos.h"
+
+/*
+ * Bad sector map.
+ *
+ * Every sector that could not be read, even after retrying, is recorded
+ * here in ascending order. All phases of the check consult the map before
+ * reading, so a bad sector costs its retries and timeouts only once no
+ * matter how many structures are found to reference it.
+ */
+
+/*
+ * Index of the first bad sector >= address.
+ */
+static uint32_t bad_lower_bound(udf_volume *vol, uint32_t address)
+{
+  uint32_t lo = 0;
+  uint32_t hi = vol->BadSectorsLen;
+
+  while (lo < hi) {
+    uint32_t mid = lo + ((hi - lo) >> 1);
+    if (vol->BadSectors[mid] < address) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/*
+ * Returns the offset within [address, address + Count) of the first known
+ * bad sector, or Count if there is none.
+ */
+uint32_t FirstBadSector(udf_volume *vol, uint32_t address, uint32_t Count)
+{
+  uint32_t i;
+
+  if (!vol->BadSectorsLen) {
+    return Count;
+  }
+
+  i = bad_lower_bound(vol, address);
+  if ((i < vol->BadSectorsLen) && (vol->BadSectors[i] - address < Count)) {
+    return vol->BadSectors[i] - address;
+  }
+  return Count;
+}
+
+void RecordBadSector(udf_volume *vol, uint32_t address)
+{
+  uint32_t i = bad_lower_bound(vol, address);
+
+  if ((i < vol->BadSectorsLen) && (vol->BadSectors[i] == address)) {
+    return;
+  }
+
+  if (vol->BadSectorsLen >= vol->BadSectorsAlloc) {
+    uint32_t newAlloc = vol->BadSectorsAlloc ? vol->BadSectorsAlloc * 2 : BAD_SECTOR_ALLOC;
+    uint32_t *largerMap = realloc(vol->BadSectors, newAlloc * sizeof(uint32_t));
+    if (!largerMap) {
+      OperationalError(vol, "**Couldn't allocate memory to record bad sector %u.\n", address);
+      return;
+    }
+    vol->BadSectors = largerMap;
+    vol->BadSectorsAlloc = newAlloc;
+  }
+
+  memmove(vol->BadSectors + i + 1, vol->BadSectors + i, (vol->BadSectorsLen - i) * sizeof(uint32_t));
+  vol->BadSectors[i] = address;
+  vol->BadSectorsLen++;
+}
+
+/*
+ * List the bad sectors, collapsing consecutive runs.
+ */
+void ReportBadSectors(udf_volume *vol)
+{
+  uint32_t i, runStart;
+
+  if (!vol->BadSectorsLen) {
+    return;
+  }
+
+  fprintf(vol->Out, "\n--Bad sector map.\n");
+  fprintf(vol->Out, "**%u sector%s could not be read:\n", vol->BadSectorsLen,
+          (vol->BadSectorsLen == 1) ? "" : "s");
+  runStart = 0;
+  for (i = 1; i <= vol->BadSectorsLen; i++) {
+    if ((i == vol->BadSectorsLen) || (vol->BadSectors[i] != vol->BadSectors[i - 1] + 1)) {
+      if (i - 1 == runStart) {
+        fprintf(vol->Out, "  %8u\n", vol->BadSectors[runStart]);
+      } else {
+        fprintf(vol->Out, "  %8u - %8u\n", vol->BadSectors[runStart], vol->BadSectors[i - 1]);
+      }
+      runStart = i;
+    }
+  }
+}
+
+void FreeBadSectors(udf_volume *vol)
+{
+  free(vol->BadSectors);
+  vol->BadSectors = NULL;
+  vol->BadSectorsLen = 0;
+  vol->BadSectorsAlloc = 0;
+}
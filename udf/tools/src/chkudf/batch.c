@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (c) 2026 Steve Magnani. All rights reserved.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chkudf.h"
+#include "protos.h"
+
+/*
+ * Batch mode - check many devices or images with a bounded pool of workers.
+ *
+ * Each worker thread takes the next unchecked name from the list and checks
+ * it with a volume context of its own, so the checks share nothing but the
+ * command line options. A check's report goes to an anonymous temporary
+ * file and is copied to stdout as a whole when the check finishes, so
+ * reports from concurrent checks are never interleaved.
+ */
+
+typedef struct _sBatch {
+    char          **Names;
+    uint32_t        Count;
+    uint32_t        Next;      // Index of the next name to check
+    uint8_t        *Status;    // Exit status of each check
+    pthread_mutex_t Lock;      // Guards Next and stdout
+} sBatch;
+
+static const char *BatchStatusText(uint8_t status)
+{
+  if (status & (EXIT_OPERATIONAL_ERROR | EXIT_USAGE)) {
+    return "could not be completed";
+  } else if (status & EXIT_UNCORRECTED_ERRORS) {
+    return "damaged";
+  } else if (status & EXIT_MINOR_UNCORRECTED_ERRORS) {
+    return "minor issues";
+  }
+  return "clean";
+}
+
+static void FinishBatchJob(FILE *output, char *devname)
+{
+  char buf[4096];
+  size_t len;
+
+  printf("\n==> %s <==\n", devname);
+  rewind(output);
+  while ((len = fread(buf, 1, sizeof(buf), output)) > 0) {
+    fwrite(buf, 1, len, stdout);
+  }
+  fflush(stdout);
+}
+
+static void *BatchWorker(void *arg)
+{
+  sBatch  *batch = arg;
+  uint32_t index;
+  FILE    *output;
+
+  for (;;) {
+    pthread_mutex_lock(&batch->Lock);
+    index = batch->Next++;
+    pthread_mutex_unlock(&batch->Lock);
+    if (index >= batch->Count) {
+      break;
+    }
+
+    output = tmpfile();
+    if (!output) {
+      fprintf(stderr, "**Couldn't create temporary file for %s (error %d)\n",
+              batch->Names[index], errno);
+      batch->Status[index] = EXIT_OPERATIONAL_ERROR;
+      continue;
+    }
+
+    batch->Status[index] = CheckDevice(batch->Names[index], output);
+
+    pthread_mutex_lock(&batch->Lock);
+    FinishBatchJob(output, batch->Names[index]);
+    pthread_mutex_unlock(&batch->Lock);
+    fclose(output);
+  }
+
+  return NULL;
+}
+
+/*
+ * Check each of the Count named devices or images, at most Jobs at a time.
+ * Returns the combination of the individual exit statuses.
+ */
+uint8_t CheckBatch(char **devnames, uint32_t Count, uint32_t Jobs)
+{
+  sBatch     batch;
+  pthread_t *workers;
+  uint8_t    batchStatus = 0;
+  uint32_t   numWorkers, numClean = 0, i;
+  int        error;
+
+  memset(&batch, 0, sizeof(batch));
+  batch.Names = devnames;
+  batch.Count = Count;
+  batch.Status = calloc(Count, sizeof(uint8_t));
+  workers = calloc(Jobs, sizeof(pthread_t));
+  if (!workers || !batch.Status) {
+    fprintf(stderr, "**Couldn't allocate memory for batch mode.\n");
+    free(workers);
+    free(batch.Status);
+    return EXIT_OPERATIONAL_ERROR;
+  }
+  pthread_mutex_init(&batch.Lock, NULL);
+
+  printf("--Checking %u volumes, up to %u at a time.\n", Count, Jobs);
+  fflush(stdout);
+
+  for (numWorkers = 0; (numWorkers < Jobs) && (numWorkers < Count); numWorkers++) {
+    error = pthread_create(&workers[numWorkers], NULL, BatchWorker, &batch);
+    if (error) {
+      fprintf(stderr, "**Couldn't start batch worker (error %d)\n", error);
+      break;
+    }
+  }
+
+  if (!numWorkers) {
+    BatchWorker(&batch);    // Check everything on this thread
+  }
+  for (i = 0; i < numWorkers; i++) {
+    pthread_join(workers[i], NULL);
+  }
+
+  printf("\n--Batch summary.\n");
+  for (i = 0; i < Count; i++) {
+    printf("  %s: %s\n", devnames[i], BatchStatusText(batch.Status[i]));
+    batchStatus |= batch.Status[i];
+    if (!batch.Status[i]) {
+      numClean++;
+    }
+  }
+  printf("  %u of %u volume%s clean.\n", numClean, Count, (Count == 1) ? "" : "s");
+
+  pthread_mutex_destroy(&batch.Lock);
+  free(workers);
+  free(batch.Status);
+  return batchStatus;
+}
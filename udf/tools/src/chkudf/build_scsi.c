@@ -57,3 +57,30 @@ uint8_t *scsi_read10(uint8_t *buffer, int LBA, int length, int sectorsize,
   return buffer;
 }
 
+
+/*
+ * The following routine builds a READ 12 CDB in the area pointed to by
+ * buffer.  READ 12 is needed for transfers of more than 65535 sectors.
+ */
+uint8_t *scsi_read12(uint8_t *buffer, int LBA, int length, int sectorsize,
+                     int DPO, int FUA, int RelAdr)
+{
+  int  *ip;
+
+  memset(buffer, 0, 12);
+  buffer[0] = 0xa8;
+  if (DPO) {
+    buffer[1] |= 0x10;
+  }
+  if (FUA) {
+    buffer[1] |= 0x08;
+  }
+  if (RelAdr) {
+    buffer[1] |= 0x01;
+  }
+  ip = (int *)(buffer + 2);
+  *ip = S_endian32(LBA);
+  ip = (int *)(buffer + 6);
+  *ip = S_endian32(length);
+  return buffer;
+}
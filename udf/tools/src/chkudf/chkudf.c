@@ -7,6 +7,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include "nsr.h"
@@ -16,22 +17,107 @@
 
 void die_usage(const char* myName)
 {
-    fprintf(stderr, "**Usage: %s [-n|-y] [-v|-d] [-V] device_or_file\n", myName);
+    fprintf(stderr, "**Usage: %s [-n|-y] [-v|-d] [-p] [-r retries] [-t seconds] [-V]\n"
+                    "         [-j jobs] [-f listfile] device_or_file...\n"
+                    "  -p  sweep each partition in physical order before the directory walk,\n"
+                    "      keeping up to %u MiB of descriptors for the walk to read from memory\n"
+                    "      and reporting File Entries the walk does not reach\n",
+            myName, SCAN_STORE_LIMIT >> 20);
     exit(EXIT_USAGE);
 }
 
-int main(int argc, char **argv)
+/*
+ * Read the names of devices or images to check, one per line. Blank lines
+ * and lines starting with '#' are skipped.
+ */
+static void read_name_list(const char *listName, char ***names, uint32_t *numNames,
+                           uint32_t *allocNames)
 {
-  char   *devname;
-  struct stat fileinfo;
-  int opt;
+  FILE   *list;
+  char   *line = NULL;
+  size_t  lineAlloc = 0;
+  ssize_t len;
+
+  list = strcmp(listName, "-") ? fopen(listName, "r") : stdin;
+  if (!list) {
+    fprintf(stderr, "**Can't open %s (error %d)\n", listName, errno);
+    exit(EXIT_USAGE);
+  }
+
+  while ((len = getline(&line, &lineAlloc, list)) >= 0) {
+    while ((len > 0) && ((line[len - 1] == '\n') || (line[len - 1] == '\r'))) {
+      line[--len] = '\0';
+    }
+    if (!len || (line[0] == '#')) {
+      continue;
+    }
+    if (*numNames >= *allocNames) {
+      *allocNames = *allocNames ? *allocNames * 2 : 64;
+      *names = realloc(*names, *allocNames * sizeof(char *));
+    }
+    if (!*names || !((*names)[*numNames] = strdup(line))) {
+      fprintf(stderr, "**Couldn't allocate memory for the list of volumes.\n");
+      exit(EXIT_OPERATIONAL_ERROR);
+    }
+    (*numNames)++;
+  }
+
+  free(line);
+  if (list != stdin) {
+    fclose(list);
+  }
+}
+
+static void WriteReport(void *Context, const char *Text, size_t Length)
+{
+  fwrite(Text, 1, Length, (FILE *)Context);
+}
 
 /*
- * Initialize cache management structures
+ * Check a single device or image, writing the report to out.
+ * Returns its exit status.
  */
-  initialize();
+uint8_t CheckDevice(const char *devname, FILE *out)
+{
+  chkudf_callbacks callbacks = { .Output = WriteReport, .Context = out };
+  chkudf_volume *vol;
+  uint8_t exitStatus;
+
+  vol = chkudf_open(devname, &callbacks);
+  if (!vol) {
+    fprintf(out, "**Couldn't allocate memory to check %s.\n", devname);
+    return EXIT_OPERATIONAL_ERROR;
+  }
+  vol->Interactive = (out == stdout);
+
+  exitStatus = chkudf_run(vol);
+
+  fprintf(vol->Out, "\n");
+
+  if (exitStatus & EXIT_OPERATIONAL_ERROR) {
+    fprintf(vol->Out, "\nAnalysis could not be completed.\n");
+  } else if (exitStatus & EXIT_UNCORRECTED_ERRORS) {
+    fprintf(vol->Out, "\nThe filesystem is damaged. Messages with '**' indicate errors.\n");
+    // @todo Summarize repairs needed
+  } else if (exitStatus & EXIT_MINOR_UNCORRECTED_ERRORS) {
+    fprintf(vol->Out, "\nMinor issues were detected.\n");
+  } else if (exitStatus == 0) {
+    fprintf(vol->Out, "\nThe filesystem is clean.\n");
+  }
+
+  chkudf_close(vol);
+  return exitStatus;
+}
 
-  while ((opt = getopt(argc, argv, "dnvVy")) != -1) {
+int main(int argc, char **argv)
+{
+  char    **devnames = NULL;
+  uint32_t  numNames = 0, allocNames = 0;
+  uint32_t  jobs = 0;
+  bool      batch = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "df:j:npr:t:vVy")) != -1) {
     switch (opt) {
       case 'n':
       case 'y':
@@ -49,6 +135,51 @@ int main(int argc, char **argv)
         g_bVerbose = true;
         break;
 
+      case 'f':
+        read_name_list(optarg, &devnames, &numNames, &allocNames);
+        batch = true;
+        break;
+
+      case 'j':
+        {
+          char *end;
+          unsigned long numJobs = strtoul(optarg, &end, 0);
+          if (!*optarg || *end || (numJobs == 0) || (numJobs > BATCH_MAX_JOBS)) {
+            fprintf(stderr, "**Invalid number of jobs '%s'.\n", optarg);
+            die_usage(argv[0]);
+          }
+          jobs = (uint32_t) numJobs;
+        }
+        break;
+
+      case 'p':
+        g_bPhysicalScan = true;
+        break;
+
+      case 'r':
+        {
+          char *end;
+          unsigned long retries = strtoul(optarg, &end, 0);
+          if (!*optarg || *end || (retries > 100)) {
+            fprintf(stderr, "**Invalid read retry count '%s'.\n", optarg);
+            die_usage(argv[0]);
+          }
+          g_readRetries = (uint32_t) retries;
+        }
+        break;
+
+      case 't':
+        {
+          char *end;
+          unsigned long timeout = strtoul(optarg, &end, 0);
+          if (!*optarg || *end || (timeout == 0) || (timeout > 86400)) {
+            fprintf(stderr, "**Invalid SCSI timeout '%s'.\n", optarg);
+            die_usage(argv[0]);
+          }
+          g_scsiTimeout = (uint32_t) timeout;
+        }
+        break;
+
       case 'V':
     	printf("chkudf " PACKAGE_VERSION " (" __DATE__ ")\n");
     	exit(0);
@@ -61,52 +192,34 @@ int main(int argc, char **argv)
    }
 
 /*
- * Find the name of the file or device we're talking to
+ * Find the name(s) of the files or devices we're talking to
  */
-  if (optind < argc) {
-    devname = argv[optind];
-  } else {
+  for (; optind < argc; optind++) {
+    if (numNames >= allocNames) {
+      allocNames = allocNames ? allocNames * 2 : 64;
+      devnames = realloc(devnames, allocNames * sizeof(char *));
+      if (!devnames) {
+        fprintf(stderr, "**Couldn't allocate memory for the list of volumes.\n");
+        exit(EXIT_OPERATIONAL_ERROR);
+      }
+    }
+    devnames[numNames++] = argv[optind];
+  }
+  if (!numNames) {
     die_usage(argv[0]);
   }
 
-  device = open(devname, O_RDONLY);
-
-  if (device > 0) {
-    Information("--Determining device/media parameters.\n");
-    SetSectorSize();
-    SetLastSector();
-    if (LastSector == -1) {
-      fstat(device, &fileinfo);
-      LastSector = (fileinfo.st_size >> sdivshift) - 1;
-    }
-    Information("  Last Sector = %u (0x%x) and is%s accurate\n", LastSector,
-                LastSector, LastSectorAccurate ? "" : " not");
-    if (!LastSectorAccurate) {
-      SetLastSectorAccurate();
-    }
-    if (isType5) {
-      SetFirstSector();
-    }
-    Check_UDF();
-    cleanup();
-    close(device);
-  } else {
-    OperationalError("**Can't open %s (error %d)\n", devname, errno);
-    g_exitStatus = EXIT_OPERATIONAL_ERROR;
+  if (!batch && (numNames == 1)) {
+    return CheckDevice(devnames[0], stdout);
   }
 
-  printf("\n");
-
-  if (g_exitStatus & EXIT_OPERATIONAL_ERROR) {
-    printf("\nAnalysis could not be completed.\n");
-  } else if (g_exitStatus & EXIT_UNCORRECTED_ERRORS) {
-    printf("\nThe filesystem is damaged. Messages with '**' indicate errors.\n");
-    // @todo Summarize repairs needed
-  } else if (g_exitStatus & EXIT_MINOR_UNCORRECTED_ERRORS) {
-    printf("\nMinor issues were detected.\n");
-  } else if (g_exitStatus == 0) {
-    printf("\nThe filesystem is clean.\n");
+  // Nobody can answer questions for concurrent checks
+  if (!g_defaultAnswer) {
+    g_defaultAnswer = 'n';
   }
-
-  return g_exitStatus;
+  if (!jobs) {
+    long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = (numCpus > 0) ? (uint32_t) MIN(numCpus, BATCH_MAX_JOBS) : 1;
+  }
+  return CheckBatch(devnames, numNames, jobs);
 }
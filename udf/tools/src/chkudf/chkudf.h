@@ -4,24 +4,72 @@
 
 /*
  * chkudf.h configuration parameters
- * NUM_PARTS - Maximum number of partition maps
  * MAX_DEPTH - Maximum depth for recursive directory listing
  * MAX_SECTOR_SIZE - bytes per sector
  * NUM_CACHE - number of cache segments
- * MAX_VOL_EXTS - maximum number of entries in the volume space table
  * ICB_Alloc - number of ICB tracking entries to allocate each time there's
  *             no more space.
+ * SCAN_CHUNK_SIZE - bytes per read during a physical-order partition scan
+ * SCAN_INDEX_ALLOC - number of scan index entries to allocate at a time
+ * SCAN_STORE_LIMIT - maximum bytes of descriptor blocks kept by the scan
+ * SCSI_DEFAULT_XFER - bytes per SCSI READ if the device doesn't report a limit
+ * SCSI_DEFAULT_TIMEOUT - seconds allowed for a SCSI command unless -t is given
+ * SCSI_SENSE_LEN - bytes of sense data collected on SCSI command failure
+ * IO_BUFFER_ALIGN - alignment of read buffers, allowing DMA straight into them
+ * SG_ASYNC_DEPTH - maximum number of READs queued at once on an sg device
+ * SG_READAHEAD_SIZE - bytes read ahead of small reads when commands are queued
+ * READ_DEFAULT_RETRIES - times a failing sector is reread unless -r is given
+ * BAD_SECTOR_ALLOC - initial number of entries in the bad sector map
+ * BATCH_LIO_MAX - maximum number of reads submitted in one lio_listio() call
+ * GEOM_MIN_SECTOR_SIZE - smallest sector size tried when guessing
+ * GEOM_GUESS_SIZES - number of sector sizes (powers of 2) tried when guessing
+ * BATCH_MAX_JOBS - maximum number of volumes checked at once in batch mode
+ * RESULT_ALLOC - initial number of results kept for a library caller
+ * ARENA_SLAB_SIZE - bytes obtained from the heap at a time by the arena
+ * LINKED_UID_SLAB_SHIFT - log2 of the number of linked unique ID chunks
+ *                         allocated together
+ * ERROR_LOG_CHUNK - number of error log records allocated together
+ * ERROR_LOG_CHUNKS - maximum number of error log chunks per volume
+ * META_COMPARE_SIZE - bytes of the Mirror File read at a time when comparing
+ *                     it with the Metadata File
+ * AD_SUMMARY_SLOTS - number of files whose chained allocation descriptors
+ *                    are kept after being walked
+ * VDS_READ_SIZE - bytes of a Volume Descriptor Sequence read at a time
+ * VDS_POINTER_MAX - maximum number of Volume Descriptor Pointers followed in
+ *                   one sequence
  */
 
 #ifndef __CHKUDF_H__
 #define __CHKUDF_H__
-#define NUM_PARTS             4
 #define MAX_DEPTH             16
 #define MAX_SECTOR_SIZE       65536
 #define NUM_CACHE             4
-#define MAX_VOL_EXTS          100
 #define ICB_Alloc             1000
 #define LINKED_UIDS_PER_CHUNK  4
+#define SCAN_CHUNK_SIZE       (1024 * 1024)
+#define SCAN_INDEX_ALLOC      4096
+#define SCAN_STORE_LIMIT      (256 * 1024 * 1024)
+#define SCSI_DEFAULT_XFER     65536
+#define SCSI_DEFAULT_TIMEOUT  30
+#define SCSI_SENSE_LEN        32
+#define IO_BUFFER_ALIGN       4096
+#define SG_ASYNC_DEPTH        8
+#define SG_READAHEAD_SIZE     (64 * 1024)
+#define READ_DEFAULT_RETRIES  2
+#define BAD_SECTOR_ALLOC      64
+#define BATCH_LIO_MAX         32
+#define GEOM_MIN_SECTOR_SIZE  512
+#define GEOM_GUESS_SIZES      8
+#define BATCH_MAX_JOBS        64
+#define RESULT_ALLOC          64
+#define ARENA_SLAB_SIZE       (1024 * 1024)
+#define LINKED_UID_SLAB_SHIFT 10
+#define ERROR_LOG_CHUNK       256
+#define ERROR_LOG_CHUNKS      256
+#define META_COMPARE_SIZE     (1024 * 1024)
+#define AD_SUMMARY_SLOTS      16
+#define VDS_READ_SIZE         (64 * 1024)
+#define VDS_POINTER_MAX       16
 
 /*
  * common inline functions
@@ -31,7 +79,11 @@
 #define MIN(a,b)  ((a)<(b)?(a):(b))
 #define BITMAP_NUM_BYTES(numBits)    (((numBits) + 7) >> 3)
 
+#include <stdatomic.h>
+#include <stdio.h>
+#include <scsi/sg.h>
 #include "nsr.h"
+#include "libchkudf.h"
 /*----------------------------------------------------------------------------
  * Read cache management - the checker makes no effort to be efficient, so 
  * some read caching is done.
@@ -42,15 +94,126 @@ typedef struct _sCacheData {
     uint32_t Address;
     uint32_t Count;
     uint32_t Allocated;
+    int      Pending;       // sg_async tag of a READ still filling Buffer, or 0
 } sCacheData;
 
 
+/*----------------------------------------------------------------------------
+ * Batched reads - independent ranges issued together by ReadBatch().
+ */
+
+typedef struct _sReadRequest {
+    uint64_t Offset;        // Byte offset on the device
+    uint32_t Length;        // Bytes to read
+    uint8_t *Buffer;
+    bool     OK;            // Set by ReadBatch() if all bytes were read
+} sReadRequest;
+
+/*
+ * A Volume Descriptor Sequence being read, VDS_READ_SIZE bytes at a time.
+ */
+typedef struct _sVDSReader {
+    const char *Name;           // "Main" or "Reserve", for display
+    uint32_t    Loc;            // First sector of the current extent
+    uint32_t    NumSectors;     // Sectors in the current extent
+    uint8_t    *Buffer;         // Sectors read from the current extent
+    uint32_t    First;          // Index in the extent of the first sector in Buffer
+    uint32_t    Count;          // Number of sectors in Buffer
+    bool        OK;             // Every sector in Buffer was read
+} sVDSReader;
+
+/*
+ * A descriptor read from a Volume Descriptor Sequence.
+ */
+typedef struct _sVDEntry {
+    uint16_t    TagID;
+    uint32_t    VDSN;           // Volume Descriptor Sequence Number
+    uint16_t    PartNum;        // Partition number of a PD, otherwise 0
+    uint32_t    Location;       // Sector it was read from
+    uint8_t    *Data;           // The descriptor, one sector
+} sVDEntry;
+
+/*
+ * The descriptors of a Volume Descriptor Sequence, with the prevailing
+ * ones picked out. Prevailing descriptors are entry numbers, -1 if there
+ * is none; there is one PD for each partition number found.
+ */
+typedef struct _sVDSIndex {
+    sVDEntry   *Entries;        // In the order they were read
+    uint32_t    NumEntries;
+    uint32_t    EntriesAlloc;
+    int32_t     PVD, LVD, IUVD, USD;
+    int32_t    *PDs;
+    uint32_t    NumPDs;
+} sVDSIndex;
+
+
+/*----------------------------------------------------------------------------
+ * Media geometry - raw results of the device queries made by
+ * DiscoverGeometry(), from which sector size and media extent are derived.
+ */
+
+typedef struct _sGeometry {
+    bool     Probed;
+    bool     WholeDisk;             // Full-disk block device
+    bool     SgDevice;              // SCSI generic node
+    uint64_t FileBytes;             // Size according to fstat()
+    bool     BlockBytesOK;
+    uint64_t BlockBytes;            // Size according to BLKGETSIZE64
+    bool     TocOK;
+    uint32_t TocLeadOut;            // Lead-out LBA according to the TOC
+    bool     InquiryOK;
+    uint8_t  Inquiry[44];
+    bool     ReadCapOK;
+    uint8_t  ReadCap[8];
+    bool     ModeSenseOK;
+    uint8_t  ModeSense[16];
+    bool     DiscInfoOK;
+    uint8_t  DiscInfo[32];          // READ DISC INFORMATION
+    bool     LastTrackOK;
+    uint8_t  LastTrack[36];         // READ TRACK INFORMATION, last recorded track
+    bool     FirstTrackOK;
+    uint8_t  FirstTrack[36];        // READ TRACK INFORMATION, start of last session
+    uint8_t  FirstTrackNo;          // Nonzero if found by skipping a blank session
+    uint8_t  BlankSession;          // Number of a blank last session, or 0
+    bool     HPTrack1OK;
+    uint8_t  HPTrack1[20];          // HP 4020/6020 Read Track Info, track 1
+    bool     HPLastTrackOK;
+    uint8_t  HPLastTrack[20];       // HP 4020/6020 Read Track Info, last track
+    bool     GuessProbed;
+    bool     GuessOK[GEOM_GUESS_SIZES];
+    uint8_t *Guess[GEOM_GUESS_SIZES];  // Sector 256 at each candidate size
+} sGeometry;
+
+
+/*----------------------------------------------------------------------------
+ * Arena allocation - for data that is kept until the check completes.
+ */
+
+typedef struct _sArenaSlab {
+    struct _sArenaSlab *Next;
+    uint32_t Size;             // Bytes available in this slab
+    uint32_t Used;             // Bytes handed out from this slab
+} sArenaSlab;
+
+typedef struct _sArena {
+    sArenaSlab *Slabs;         // Slab currently being filled is first
+    uint64_t    Bytes;         // Total bytes handed out
+} sArena;
+
+
 /*----------------------------------------------------------------------------
  * Error reporting
  *   Since some errors are reported and others not (e.g. a "wrong tag" when 
  *   asking for an ICB is different than a "wrong tag" when searching the 
  *   VDS), the error is recorded and the caller can decide to ignore or 
  *   report.
+ *
+ *   The recorded error belongs to the thread doing the checking (see
+ *   CurrentError()). Every error that is reported, or that is replaced by
+ *   another before it could be, is appended to the volume's error log.
+ *   Appending takes no lock, so any number of threads can record errors
+ *   for the same volume at once.
  */
 
 typedef struct _sError {
@@ -60,6 +223,18 @@ typedef struct _sError {
     long long Found;
 } sError;
 
+typedef struct _sErrorRecord {
+    sError       Error;
+    chkudf_phase Phase;
+    bool         Reported;      // By DumpError(), rather than superseded
+    atomic_bool  Ready;         // The record has been filled in
+} sErrorRecord;
+
+typedef struct _sErrorLog {
+    _Atomic(sErrorRecord *) Chunks[ERROR_LOG_CHUNKS];
+    atomic_uint  Count;         // Records claimed, including any beyond the last chunk
+} sErrorLog;
+
 /* From CheckTag */
 #define CHECKTAG_TAG_GOOD      0   /* The tag is good in every way */
 #define CHECKTAG_TAG_DAMAGED   1   /* The tag is probably the intended one, but wasn't right */
@@ -71,24 +246,34 @@ typedef struct _sError {
  * Partition management
  */
 
+/*
+ * Read Count blocks of a partition into the cache, returning NULL if they
+ * can't be read - see CachePBlocks().
+ */
+typedef const uint8_t *(*PartBlockReader)(struct _udf_volume *vol, uint32_t p_address,
+                                          uint16_t p_ref, uint32_t Count);
+
 typedef struct _sPart_Info {
-    int       type;             // One of PTN_TYP
-    uint16_t  Num;              // Physical partition number
-    uint32_t  Offs;             // Offset of physical partition
-    uint32_t  Len;              // Length (for error checking)
-    uint16_t  SpaceTag;         // Tag expected for space map
-    uint8_t   FinalMapByteMask; // Valid bits in final space map byte
-    uint32_t  Space;            // Address of space map/list
-    uint32_t  SpLen;            // Number of bytes in space map/list
-    uint32_t *Extra;            // Pointer to VAT or sparing table, or ??.
-    uint8_t  *SpMap;            // Space Allocation map
-    uint8_t  *MyMap;            // Space Allocation map generated by chkudf
+    int             type;             // One of PTN_TYP, set with SetPartType()
+    PartBlockReader CacheBlocks;      // Block reader for the type
+    bool            Contiguous;       // Consecutive blocks can be read together
+    uint16_t        Num;              // Physical partition number
+    uint32_t        Offs;             // Offset of physical partition
+    uint32_t        Len;              // Length (for error checking)
+    uint16_t        SpaceTag;         // Tag expected for space map
+    uint8_t         FinalMapByteMask; // Valid bits in final space map byte
+    uint32_t        Space;            // Address of space map/list
+    uint32_t        SpLen;            // Number of bytes in space map/list
+    uint32_t       *Extra;            // Pointer to VAT or sparing table, or ??.
+    uint8_t        *SpMap;            // Space Allocation map
+    uint8_t        *MyMap;            // Space Allocation map generated by chkudf
 } sPart_Info;
 
 #define PTN_TYP_NONE    0
 #define PTN_TYP_REAL    1
 #define PTN_TYP_VIRTUAL 2
 #define PTN_TYP_SPARE   3
+#define PTN_TYP_METADATA 4
 
 typedef struct _sMap_Entry {
     uint32_t  Original;
@@ -104,23 +289,146 @@ typedef struct _sST_desc {
     sMap_Entry *Map;       // A copy of one of the sparing tables
 } sST_desc;
 
+typedef struct _sMetaExtent {
+    uint32_t Location;      // First block, in the physical partition
+    uint32_t NumBlocks;
+    bool     Recorded;      // Unrecorded blocks read as zeros
+} sMetaExtent;
+
+typedef struct _sMeta_desc {
+    uint32_t  FileLoc;     // Metadata File ICB, in the physical partition
+    uint32_t  MirrorLoc;   // Metadata Mirror File ICB
+    uint32_t  BitmapLoc;   // Metadata Bitmap File ICB, or -1 if there is none
+    uint32_t  AllocUnit;   // Allocation unit size, in blocks
+    uint16_t  AlignUnit;   // Alignment unit size, in blocks
+    uint8_t   Flags;       // META_FLAG_
+    uint16_t  PhysRef;     // Partition reference of the physical partition
+    uint8_t  *Blocks;      // The Metadata File, read in full by GetMetadata
+    uint32_t  NumBlocks;   // Number of blocks in Blocks
+    sMetaExtent *Extents;  // Where Blocks are recorded in the physical partition
+    uint32_t  NumExtents;
+} sMeta_desc;
+
+#define META_FLAG_DUPLICATE  1   // The Mirror File is a separate copy
+
+
+/*----------------------------------------------------------------------------
+ * Allocation descriptor walking - see allocdesc.c
+ */
+
+typedef struct _sADExtent {
+    uint32_t  Location;        // First block, partition relative
+    uint32_t  Length;          // Bytes allocated to the extent
+    uint32_t  InfoLength;      // Bytes of the file in it (differs only for ext_ad)
+    uint32_t  RecordedLength;  // Bytes of those that are recorded, as given
+    uint32_t  DescOffset;      // Of the descriptor, among those in its block
+    uint16_t  Ptn;             // Partition reference
+    uint8_t   Type;            // E_RECORDED .. E_ALLOCEXTENT
+} sADExtent;
+
+// Open-addressed and kept at most half full, so doubled from this as needed
+#define AD_VISITED_INITIAL  64
+
+/*
+ * Walks the descriptors of an ICB or space table and the blocks they are
+ * continued in. Continuation blocks are not copied: the current one is
+ * fetched from the read cache each time a descriptor is taken from it.
+ * Blocks already passed through are remembered so a chain that loops back
+ * on itself is caught; ADIterFree() releases them.
+ */
+typedef struct _sADIter {
+    const uint8_t *ADs;        // Descriptors in the ICB, NULL once in a continuation block
+    uint32_t  L_AD;            // Bytes of descriptors where the walk is
+    uint32_t  Offset;          // Of the next descriptor among them
+    uint32_t  DescLoc;         // Block holding the descriptors
+    uint32_t  BlockLoc;        // Continuation block, when ADs is NULL
+    uint16_t  BlockPtn;        // ... and its partition reference
+    uint16_t  BlockHdrSize;    // ... and the bytes before its descriptors
+    uint16_t  ADType;          // ADSHORT, ADLONG or ADEXTENDED
+    uint16_t  Ptn;             // Partition reference of short_ad extents
+    uint16_t  ChainTagID;      // TAGID_ALLOC_EXTENT, or TAGID_UNALLOC_SP_ENTRY for a table
+    bool      Chain;           // The last descriptor returned continues the walk
+    bool      ZeroLength;      // The walk ended at a zero-length descriptor
+    bool      Failed;          // The walk ended at a block that couldn't be used
+    sADExtent Next;            // Continuation to follow, when Chain is set
+    uint32_t  NumBlocks;       // Continuation blocks followed
+    uint64_t *Visited;         // ... hashed, as VISITED_KEY(), 0 if free
+    uint32_t  VisitedSlots;    // Entries in Visited, a power of 2
+} sADIter;
+
+/*
+ * The extents of a file, as found by one walk of its descriptors. Files
+ * whose descriptors are continued in other blocks keep their summary in
+ * one of AD_SUMMARY_SLOTS, so later reads of the file don't walk the chain
+ * again.
+ */
+typedef struct _sADSummary {
+    uint32_t   ICBLoc;         // Block the ICB is recorded in
+    uint16_t   Ptn;            // ... and its partition reference
+    bool       Kept;           // Held in a slot for the ICB at Ptn:ICBLoc
+    uint32_t   LastUsed;       // For replacement
+    sADExtent *Extents;        // In recorded order, continuations included
+    uint64_t  *Start;          // File offset at which each extent begins
+    uint32_t   NumExtents;
+    uint32_t   Allocated;      // Entries in Extents and Start
+    uint32_t   NumBlocks;      // Continuation blocks followed
+    bool       Failed;         // The walk ended at a block that couldn't be used
+} sADSummary;
+
 
 /*----------------------------------------------------------------------------
  * File space and ICB management
  */
 
+/*
+ * ICB tracking is kept as parallel arrays (one element per tracked ICB,
+ * sorted by Ptn then LBN) so that passes over the list only touch the
+ * fields they need and no space is lost to structure padding.
+ */
 typedef struct _sICB_trk {
+    uint32_t *LBN;
+    uint16_t *Ptn;
+    uint16_t *Link;
+    uint16_t *LinkRec;
+    uint16_t *Characteristics;
+    uint64_t *UniqueID;
+    uint32_t *FE_LBN;
+    uint16_t *FE_Ptn;
+    uint32_t *LinkedUIDs;      // First sLinkedUIDChunk of hard link IDs, 0 if none
+} sICB_trk;
+
+/*
+ * Unique IDs of hard links to an ICB, chained in fixed-size chunks drawn
+ * from arena slabs shared by all ICBs. Chunks are referenced by a 32-bit
+ * handle (slab number and index within the slab). Handle 0 is never used,
+ * so it terminates a chain. Unused slots in a chunk are 0.
+ */
+typedef struct _sLinkedUIDChunk {
+    uint32_t UID[LINKED_UIDS_PER_CHUNK];
+    uint32_t Next;
+} sLinkedUIDChunk;
+
+/*
+ * One descriptor found by the physical-order partition scan. Entries are
+ * kept sorted by (Ptn, LBN).
+ */
+typedef struct _sScanEntry {
     uint32_t LBN;
     uint16_t Ptn;
-    uint16_t Link;
-    uint16_t LinkRec;
-    uint64_t UniqueID;
-    uint32_t FE_LBN;
-    uint16_t FE_Ptn;
-    uint16_t Characteristics;
-    uint32_t *LinkedUIDs;
-    uint32_t MaxLinkedUIDs;
-} sICB_trk;
+    uint16_t TagID;
+    uint8_t  *Data;          // Copy of the block, or NULL if not retained
+    bool     Referenced;     // Reached by the directory walk
+} sScanEntry;
+
+/*
+ * An ICB the checker reads itself rather than reaching it from the
+ * directory hierarchy, such as the File Entry of the VAT or the Metadata
+ * File. The location is in a partition that is recorded in place.
+ */
+typedef struct _sSystemICB {
+    uint32_t LBN;
+    uint16_t Ptn;
+} sSystemICB;
 
 // Pseudo-characteristic used with read_icb() to mean a (directory) ICB
 // has been referenced as a child, in contrast with PARENT_ATTR.
@@ -129,11 +437,132 @@ typedef struct _sICB_trk {
 /*----------------------------------------------------------------------------
  * Volume space management
  */
-struct extent_ad_name {
-    uint32_t Length;
-    uint32_t Location;
-    char * Name;
-};
+typedef struct _sVolSpaceNode {
+    struct _sVolSpaceNode *Left;
+    struct _sVolSpaceNode *Right;
+    uint32_t    Location;
+    uint32_t    Length;
+    uint64_t    MaxEnd;     // Largest Location + Length in this subtree
+    const char *Name;
+    int         Height;     // AVL subtree height
+} sVolSpaceNode;
+
+/*----------------------------------------------------------------------------
+ * Queued SCSI commands - one slot per command outstanding on an sg device.
+ */
+typedef struct _sSgSlot {
+    struct sg_io_hdr io;
+    uint8_t          cdb[12];
+    uint8_t          sense[SCSI_SENSE_LEN];
+    uint8_t         *Buffer;        // Where the device transfers to
+    uint32_t         Allocated;     // Bytes allocated at Buffer
+    void            *Dest;          // Where the data is copied when collected
+    bool             InUse;
+    bool             Done;
+    bool             OK;
+} sSgSlot;
+
+/*----------------------------------------------------------------------------
+ * Volume context - everything known about one device or image being
+ * checked. Every routine that reads the volume or records what was found
+ * on it is handed the context, so any number of volumes can be checked at
+ * once from the same process. Options given on the command line apply to
+ * every check and remain globals.
+ */
+typedef struct _udf_volume {
+    FILE          *Out;                 // Where the report is written
+    uint8_t        ExitStatus;          // EXIT_ flags for this volume
+
+    /* Library interface */
+    chkudf_callbacks Callbacks;
+    bool           Interactive;         // Questions may be answered on stdin
+    chkudf_phase   Phase;               // Phase being run
+    chkudf_phase   NextPhase;           // First phase not yet run
+    char          *Line;                // Report line being assembled
+    uint32_t       LineLen;
+    uint32_t       LineAlloc;
+    uint8_t        LineSeverity;        // EXIT_ flags raised by that line
+    chkudf_result *Results;             // Problems reported so far
+    uint32_t       NumResults;
+    uint32_t       ResultsAlloc;
+
+    /* Device operating parameters */
+    uint32_t       blocksize;           // bytes per block
+    uint_least8_t  bdivshift;           // log2(blocksize)
+    uint32_t       secsize;             // bytes per sector
+    uint_least8_t  sdivshift;           // log2(secsize)
+    uint_least8_t  s_per_b;             // blocksize/secsize
+    uint32_t       packet_size;         // blocking factor for read operations
+    bool           scsi;                // Boolean for command selection
+    uint32_t       scsi_max_xfer;       // Max sectors per SCSI READ command
+    bool           sg_async;            // READs can be queued (sg device)
+    sSgSlot        SgSlots[SG_ASYNC_DEPTH];
+    bool           SgStalled;           // A queued command never completed
+    sGeometry      Geometry;            // Results of device queries
+    int            device;              // Device/file handle for operations
+    uint32_t       LastSector;          // Location of the last readable sector
+    bool           LastSectorAccurate;  // Indication of confidence
+    uint32_t       lastSessionStartLBA; // Start of last session
+    bool           isType5;             // Is a CD or DVD drive
+    bool           isCDRW;
+    uint8_t        cdb[12];             // command buffer
+    uint8_t        sensedata[SCSI_SENSE_LEN];  // Sense data buffer
+    int            sensebufsize;        // Sense data buffer size
+
+    /* Reading and error recording */
+    sCacheData     Cache[NUM_CACHE];
+    uint_least8_t  bufno;
+    sArena         Arena;               // Storage released only by cleanup()
+    sErrorLog      ErrorLog;
+    uint32_t      *BadSectors;          // Unreadable sectors, ascending
+    uint32_t       BadSectorsLen;
+    uint32_t       BadSectorsAlloc;
+    sADSummary     ADSummaries[AD_SUMMARY_SLOTS];
+    sADSummary     ADScratch;           // Summary of a file kept in no slot
+    uint32_t       ADSummaryClock;
+
+    /* UDF basics */
+    uint16_t       UDF_Version;
+    bool           Version_OK;
+    uint16_t       Serial_No;
+    bool           Serial_OK;
+    bool           Fatal;
+
+    /* Volume information */
+    uint32_t       VDS_Loc, VDS_Len, RVDS_Loc, RVDS_Len;
+    sPart_Info    *Part_Info;           // PTN_no entries, indexed by partition reference
+    uint16_t       PTN_no;              // The number of partition maps in the volume
+    dstring        LogVolID[128];       // The logical volume ID
+    sVolSpaceNode *VolSpaceRoot;        // Volume space assignments, by location
+    uint32_t      *VAT;
+    uint32_t       VATLength;
+
+    /* File System information */
+    struct long_ad FSD;
+    struct long_ad RootDirICB;
+    struct long_ad StreamDirICB;
+    sICB_trk       ICBlist;
+    uint_least32_t ICBlist_len;
+    uint_least32_t ICBlist_alloc;
+    sLinkedUIDChunk **LinkedUIDSlabs;
+    uint32_t       LinkedUIDSlabs_alloc; // Entries in LinkedUIDSlabs
+    uint32_t       LinkedUIDChunks;      // Chunk handles in use (incl. unused handle 0)
+    sScanEntry    *ScanIndex;           // Descriptors found by the partition scan
+    uint32_t       ScanIndexLen;
+    uint32_t       ScanIndexAlloc;      // Number of entries allocated in ScanIndex
+    uint32_t       ScanStoreBytes;      // Bytes of block data retained by the index
+    sSystemICB    *SystemICBs;          // ICBs not reached by the directory walk
+    uint32_t       SystemICBsLen;
+    uint32_t       SystemICBsAlloc;
+    uint32_t       ID_Dirs;             // Number of dirs according to LVID
+    uint32_t       ID_Files;            // Number of files according to LVID
+    uint64_t       ID_UID;              // Next Unique ID according to LVID
+    unsigned int   Num_Dirs;            // Number of dirs by our count
+    unsigned int   Num_Files;           // Number of files by our count
+    bool           WalkingStreams;      // The directory walk is in a stream directory
+    unsigned int   Num_Type_Err;
+    unsigned int   FID_Loc_Wrong;
+} udf_volume;
 
 /* 
  * for errors.c ------------------------------------------------------------
@@ -180,13 +609,15 @@ typedef struct _ErrorSeverity {
 #define ERR_UNSORTED_EXTENTS       33
 #define ERR_NOVATCODE              34
 #define ERR_UNEXPECTED_ZERO_LEN    35
+#define ERR_AD_LOOP                36
+//#define ERR_AD_CHAIN_DEPTH         37
 
 /*
  * Exit codes   ------------------------------------------------------------
  */
-#define EXIT_UNCORRECTED_ERRORS         (1U << 2)  // 4
-#define EXIT_OPERATIONAL_ERROR          (1U << 3)  // 8
-#define EXIT_USAGE                      (1U << 4)  // 16
-#define EXIT_MINOR_UNCORRECTED_ERRORS   (1U << 6)  // 64
+#define EXIT_UNCORRECTED_ERRORS         CHKUDF_UNCORRECTED_ERRORS
+#define EXIT_OPERATIONAL_ERROR          CHKUDF_OPERATIONAL_ERROR
+#define EXIT_USAGE                      CHKUDF_USAGE
+#define EXIT_MINOR_UNCORRECTED_ERRORS   CHKUDF_MINOR_UNCORRECTED_ERRORS
 
 #endif
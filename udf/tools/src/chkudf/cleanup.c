@@ -6,24 +6,46 @@
 #include "chkudf.h"
 #include "protos.h"
 
-void cleanup(void)
+void cleanup(udf_volume *vol)
 {
   int i;
 
+  FlushCacheReads(vol);
+  sg_async_free(vol);
   for (i = 0; i < NUM_CACHE; i++) {
-    if (Cache[i].Buffer) {
-      free(Cache[i].Buffer);
+    if (vol->Cache[i].Buffer) {
+      free(vol->Cache[i].Buffer);
     }
   }
-  for (i = 0; i < PTN_no; i++) {
-    switch (Part_Info[i].type) {
+  FreeScanIndex(vol);
+  FreeADSummaries(vol);
+  FreeBadSectors(vol);
+  FreeGeometry(vol);
+  free_icb_list(vol);
+  FreeErrorLog(vol);
+  ArenaRelease(&vol->Arena);
+  vol->VolSpaceRoot = NULL;    // Nodes belonged to Arena
+  for (i = 0; i < vol->PTN_no; i++) {
+    free(vol->Part_Info[i].SpMap);
+    free(vol->Part_Info[i].MyMap);
+    switch (vol->Part_Info[i].type) {
       case PTN_TYP_VIRTUAL:
-        free(Part_Info[i].Extra);
+        free(vol->Part_Info[i].Extra);
         break;
 
       case PTN_TYP_SPARE:
-        free(((struct _sST_desc *)Part_Info[i].Extra)->Map);
-        free(Part_Info[i].Extra);
+        if (vol->Part_Info[i].Extra) {
+          free(((struct _sST_desc *)vol->Part_Info[i].Extra)->Map);
+        }
+        free(vol->Part_Info[i].Extra);
+        break;
+
+      case PTN_TYP_METADATA:
+        if (vol->Part_Info[i].Extra) {
+          free(((sMeta_desc *)vol->Part_Info[i].Extra)->Blocks);
+          free(((sMeta_desc *)vol->Part_Info[i].Extra)->Extents);
+        }
+        free(vol->Part_Info[i].Extra);
         break;
 
       case PTN_TYP_NONE:
@@ -35,4 +57,7 @@ void cleanup(void)
         break;
     }
   }
+  free(vol->Part_Info);
+  vol->Part_Info = NULL;
+  vol->PTN_no = 0;
 }
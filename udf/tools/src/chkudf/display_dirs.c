@@ -12,9 +12,14 @@
 #include "protos.h"
 
 struct dirLevel {
-  uint16_t     part;   // Partition for directory ICB
-  uint32_t     addr;   // Partition-relative block address of directory ICB
-  uint64_t     offs;   // Current offset within directory data
+  uint16_t     part;        // Partition for directory ICB
+  uint32_t     addr;        // Partition-relative block address of directory ICB
+  uint16_t     fePart;      // Where its (Extended) File Entry is recorded
+  uint32_t     feAddr;
+  uint64_t     offs;        // Current offset within directory data
+  uint16_t     parentPart;  // Where the parent FID should point
+  uint32_t     parentAddr;
+  bool         streams;     // A stream directory
 };
 
 // 4096 == page size on many systems.
@@ -26,40 +31,35 @@ struct dirLevel {
  *  Read the FSD and get the root directory ICB address
  */
 
-int GetRootDir(void)
+int GetRootDir(udf_volume *vol)
 {
 
   struct FileSetDesc *FSDPtr;
   int i, error, result;
 
   error = ERR_NO_FSD;
-  FSDPtr = (struct FileSetDesc *)malloc(blocksize);
+  FSDPtr = (struct FileSetDesc *)malloc(vol->blocksize);
   if (FSDPtr) {
-    track_filespace(U_endian16(FSD.Location_PartNo), U_endian32(FSD.Location_LBN),
-                    EXTENT_LENGTH(FSD.ExtentLengthAndType));
+    track_filespace(vol, U_endian16(vol->FSD.Location_PartNo), U_endian32(vol->FSD.Location_LBN),
+                    EXTENT_LENGTH(vol->FSD.ExtentLengthAndType));
 
-    for (i = 0; i < EXTENT_LENGTH(FSD.ExtentLengthAndType) >> bdivshift; i++) {
-      result = ReadLBlocks(FSDPtr, U_endian32(FSD.Location_LBN) + i, 
-                           U_endian16(FSD.Location_PartNo), 1);
+    for (i = 0; i < EXTENT_LENGTH(vol->FSD.ExtentLengthAndType) >> vol->bdivshift; i++) {
+      result = ReadLBlocks(vol, FSDPtr, U_endian32(vol->FSD.Location_LBN) + i, 
+                           U_endian16(vol->FSD.Location_PartNo), 1);
       if (!result) {
-        result = CheckTag((struct tag *)FSDPtr, U_endian32(FSD.Location_LBN) + i, 
+        result = CheckTag(vol, (struct tag *)FSDPtr, U_endian32(vol->FSD.Location_LBN) + i, 
                           TAGID_FSD, 496, 496);
-        DumpError();
+        DumpError(vol);
         if (result < CHECKTAG_OK_LIMIT) {
-          RootDirICB = FSDPtr->sRootDirICB;
-          StreamDirICB = FSDPtr->sStreamDirICB;
-          if ((UDF_Version == 3) && EXTENT_LENGTH(StreamDirICB.ExtentLengthAndType)) {
-            // @todo Real traversal of stream directory
-            // Code below is a hack to avoid reporting space table mismatch
-            // on filesystems having a stub stream directory
-            track_filespace(U_endian16(StreamDirICB.Location_PartNo),
-                            U_endian32(StreamDirICB.Location_LBN),
-                            EXTENT_LENGTH(StreamDirICB.ExtentLengthAndType));
+          vol->RootDirICB = FSDPtr->sRootDirICB;
+          if (vol->UDF_Version == 3) {
+            // Not defined before UDF 2.00
+            vol->StreamDirICB = FSDPtr->sStreamDirICB;
           }
           error = 0;
           if (EXTENT_LENGTH(FSDPtr->sNextExtent.ExtentLengthAndType)) {
-            printf("  Found another FSD extent.\n");
-            FSD = FSDPtr->sNextExtent;
+            fprintf(vol->Out, "  Found another FSD extent.\n");
+            vol->FSD = FSDPtr->sNextExtent;
             i = -1;
           }
         } else {  /* All zeros, terminator, anything but an FSD */
@@ -71,17 +71,81 @@ int GetRootDir(void)
     }
     free(FSDPtr);
   } else {
-    printf("**Couldn't allocate memory for loading FSD.\n");
+    fprintf(vol->Out, "**Couldn't allocate memory for loading FSD.\n");
     return ERR_NO_FSD;
   }
   return error;
 }
 
+/*
+ * Add a level to the directory walk, growing the array as needed. The
+ * directory's ICB must already have been read.
+ * Returns false if there's no room for it.
+ */
+static bool PushDirLevel(udf_volume *vol, struct dirLevel **level, size_t *maxLevel, int *depth,
+                         uint16_t part, uint32_t addr, uint16_t parentPart,
+                         uint32_t parentAddr, bool streams)
+{
+  if (*depth >= *maxLevel) {
+    // Time to grow the array
+    void *largerLevel = realloc(*level,
+                                sizeof(struct dirLevel) * ((*maxLevel+1) + LEVELS_PER_ALLOC));
+    if (largerLevel) {
+      *level = (struct dirLevel *) largerLevel;
+      memset(&(*level)[*maxLevel+1], 0, LEVELS_PER_ALLOC * sizeof(struct dirLevel));
+      *maxLevel += LEVELS_PER_ALLOC;
+    }
+  }
+  if (*depth >= *maxLevel) {
+    return false;
+  }
+
+  (*depth)++;
+  (*level)[*depth].offs = 0;
+  (*level)[*depth].addr = addr;
+  (*level)[*depth].part = part;
+  icb_entry_location(vol, part, addr, &(*level)[*depth].fePart, &(*level)[*depth].feAddr);
+  (*level)[*depth].parentAddr = parentAddr;
+  (*level)[*depth].parentPart = parentPart;
+  (*level)[*depth].streams = streams;
+  return true;
+}
+
+/*
+ * Walk the stream directory of a file (UDF 2.00 and later) next, while the
+ * file is at hand, rather than in a pass of its own. The stream directory
+ * ICB is read now; a stream directory reached again through a hard link
+ * isn't walked again.
+ */
+static void PushStreamDir(udf_volume *vol, struct FE_or_EFE *ICB, struct long_ad streamDirICB,
+                          struct dirLevel **level, size_t *maxLevel, int *depth,
+                          uint16_t ownerPart, uint32_t ownerAddr)
+{
+  bool firstVisit;
+  int  i;
+
+  for (i = 0; i < *depth; i++) fprintf(vol->Out, "   ");
+  fprintf(vol->Out, "=%04x:%08x: [streams]", U_endian16(streamDirICB.Location_PartNo),
+          U_endian32(streamDirICB.Location_LBN));
+  firstVisit = read_stream_dir_icb(vol, ICB, streamDirICB);
+  fprintf(vol->Out, "\n");
+  DumpError(vol);
+  if (!firstVisit) {
+    return;
+  }
+
+  if (!PushDirLevel(vol, level, maxLevel, depth, U_endian16(streamDirICB.Location_PartNo),
+                    U_endian32(streamDirICB.Location_LBN), ownerPart, ownerAddr, true)) {
+    for (i = 0; i <= *depth; i++) fprintf(vol->Out, "   ");
+    fprintf(vol->Out, " +more stream directories (not displayed)\n");
+  }
+}
+
 /*
  *  Display a directory hierarchy
  */ 
 
-int DisplayDirs(void)
+int DisplayDirs(udf_volume *vol)
 {
   int depth, i, error;
   struct FileIDDesc *File  = NULL;    // Directory entry for the current file
@@ -89,27 +153,27 @@ int DisplayDirs(void)
   struct dirLevel   *level = NULL;
   size_t maxLevel = 0;                // Max subscript that can be used with 'level'
 
-  printf("\n--File Space report:\n");
+  fprintf(vol->Out, "\n--File Space report:\n");
 
-  GetRootDir();
+  GetRootDir(vol);
 
   do {
-    uint32_t address = U_endian32(RootDirICB.Location_LBN);
-    uint16_t partition = U_endian16(RootDirICB.Location_PartNo);
+    uint32_t address = U_endian32(vol->RootDirICB.Location_LBN);
+    uint16_t partition = U_endian16(vol->RootDirICB.Location_PartNo);
 
-    if (!EXTENT_LENGTH(RootDirICB.ExtentLengthAndType)) {
-      printf("**No root directory.\n");
+    if (!EXTENT_LENGTH(vol->RootDirICB.ExtentLengthAndType)) {
+      fprintf(vol->Out, "**No root directory.\n");
       break;
     }
 
-    printf("\nDisplaying directory hierarchy:\n%04x:%08x: \\", partition, address);
+    fprintf(vol->Out, "\nDisplaying directory hierarchy:\n%04x:%08x: \\", partition, address);
 
     maxLevel = LEVELS_PER_ALLOC - 1;
     level = (struct dirLevel *)  calloc(LEVELS_PER_ALLOC, sizeof(struct dirLevel));
-    File  = (struct FileIDDesc *)malloc(blocksize);
-    ICB   = (struct FE_or_EFE *) malloc(blocksize);
+    File  = (struct FileIDDesc *)malloc(vol->blocksize);
+    ICB   = (struct FE_or_EFE *) malloc(vol->blocksize);
     if (!File || !ICB || !level) {
-      printf("**Couldn't allocate space for FID buffer.\n");
+      fprintf(vol->Out, "**Couldn't allocate space for FID buffer.\n");
       break;
     }
 
@@ -117,56 +181,70 @@ int DisplayDirs(void)
     level[depth].offs = 0;
     level[depth].addr = address;
     level[depth].part = partition;
-    error = read_icb(ICB, RootDirICB, NULL, NULL);
+    level[depth].parentAddr = address;
+    level[depth].parentPart = partition;
+    error = read_icb(vol, ICB, vol->RootDirICB, NULL, NULL);
     if (error)
       break;
+    icb_entry_location(vol, partition, address, &level[depth].fePart, &level[depth].feAddr);
 
-    Num_Dirs++;  // We have to count the root directory ourselves
+    vol->Num_Dirs++;  // We have to count the root directory ourselves
+
+    fprintf(vol->Out, "\n");
+
+    // The system stream directory belongs to the File Set; its parent is the root
+    if (EXTENT_LENGTH(vol->StreamDirICB.ExtentLengthAndType)) {
+      PushStreamDir(vol, ICB, vol->StreamDirICB, &level, &maxLevel, &depth, partition, address);
+    }
 
-    printf("\n");
     do {
       struct dirLevel *curLevel = &level[depth];
-      printf("ICB %x:%05x offset %4" PRIx64 "\n", curLevel->part,
-             curLevel->addr, curLevel->offs);
+      fprintf(vol->Out, "ICB %x:%05x offset %4" PRIx64 "\n", curLevel->part,
+              curLevel->addr, curLevel->offs);
       if (curLevel->offs >= U_endian64(ICB->InfoLength)) {
-        for (i = 1; i <= depth; i++) printf("   ");
-        printf("++End of directory\n");
+        for (i = 1; i <= depth; i++) fprintf(vol->Out, "   ");
+        fprintf(vol->Out, "++End of directory\n");
         depth--;
       } else {
         // @todo Consider warning if offs[depth] is less than sizeof(struct tag)
         //     from the end of a block. See UDF2.01 sec. 2.3.4.4.
         bool bCycle = false;
         bool bSkipAlreadyTraversedDir = false;
-        error = GetFID(File, ICB, curLevel->part, curLevel->offs);
+        struct long_ad streamDirICB;
+
+        memset(&streamDirICB, 0, sizeof(streamDirICB));
+        vol->WalkingStreams = curLevel->streams;
+        error = GetFID(vol, File, ICB, curLevel->fePart, curLevel->feAddr, curLevel->offs);
         if (!error) {
-          for (i = 0; i < depth; i++) printf("   ");
+          for (i = 0; i < depth; i++) fprintf(vol->Out, "   ");
           if (File->Characteristics & DIR_ATTR) {
-            printf("+");
+            fprintf(vol->Out, "+");
           } else {
-            printf("-");
+            fprintf(vol->Out, "-");
           }
           if (File->Characteristics & PARENT_ATTR) {
-            printf("%04x:%08x: [parent] ", U_endian16(File->ICB.Location_PartNo), 
-                                           U_endian32(File->ICB.Location_LBN));
+            fprintf(vol->Out, "%04x:%08x: [parent] ", U_endian16(File->ICB.Location_PartNo), 
+                                            U_endian32(File->ICB.Location_LBN));
             if (File->L_FI) {
-              printf("**ILLEGAL NAME ");
-              printDchars((uint8_t *)File + FILE_ID_DESC_CONSTANT_LEN + U_endian16(File->L_IU), File->L_FI);
+              fprintf(vol->Out, "**ILLEGAL NAME ");
+              printDchars(vol, (uint8_t *)File + FILE_ID_DESC_CONSTANT_LEN + U_endian16(File->L_IU), File->L_FI);
             } else {
-              printf("NAME OK");
+              fprintf(vol->Out, "NAME OK");
             }
             if (depth == 1 && ((U_endian16(File->ICB.Location_PartNo) != curLevel->part) ||
                                (U_endian32(File->ICB.Location_LBN)    != curLevel->addr))) {
-              printf("** BAD PARENT OF ROOT (should be %04x:%08x)", curLevel->part, curLevel->addr);
-            } else if (depth > 1 && ((U_endian16(File->ICB.Location_PartNo) != level[depth - 1].part) ||
-                      (U_endian32(File->ICB.Location_LBN)    != level[depth - 1].addr))) {
+              fprintf(vol->Out, "** BAD PARENT OF ROOT (should be %04x:%08x)", curLevel->part, curLevel->addr);
+            } else if (depth > 1 && ((U_endian16(File->ICB.Location_PartNo) != curLevel->parentPart) ||
+                      (U_endian32(File->ICB.Location_LBN)    != curLevel->parentAddr))) {
               // @todo Hard-linked directories can trigger this - remove it?
-              printf(" unexpected parent (expected %04x:%08x)", level[depth - 1].part, level[depth - 1].addr);
+              fprintf(vol->Out, " unexpected parent (expected %04x:%08x)", curLevel->parentPart, curLevel->parentAddr);
             } else {
-              printf(" parent location OK");
+              fprintf(vol->Out, " parent location OK");
             }
-            read_icb(ICB, File->ICB, File, NULL);
+            // The parent of a stream directory is its owner, which this isn't a link to
+            read_icb(vol, ICB, File->ICB, curLevel->streams ? NULL : File, NULL);
           } else {
-            printf("%04x:%08x: ", U_endian16(File->ICB.Location_PartNo), U_endian32(File->ICB.Location_LBN));
+            fprintf(vol->Out, "%04x:%08x: ", U_endian16(File->ICB.Location_PartNo), U_endian32(File->ICB.Location_LBN));
             /*
              * Note: the following makes the assumption that a deleted file is no
              * longer allocated.  THIS IS WRONG according to the spec, but most
@@ -174,26 +252,32 @@ int DisplayDirs(void)
              * an extent length of zero for the ICB.
              */
             if (File->Characteristics & DELETE_ATTR) {
-              printf("[DELETED] ");
-              printDchars((uint8_t *)File + FILE_ID_DESC_CONSTANT_LEN + U_endian16(File->L_IU), File->L_FI);
+              fprintf(vol->Out, "[DELETED] ");
+              printDchars(vol, (uint8_t *)File + FILE_ID_DESC_CONSTANT_LEN + U_endian16(File->L_IU), File->L_FI);
             } else {
               uint16_t filePartition = U_endian16(File->ICB.Location_PartNo);
               uint32_t fileLocation  = U_endian32(File->ICB.Location_LBN);
-              printDchars((uint8_t *)File + FILE_ID_DESC_CONSTANT_LEN + U_endian16(File->L_IU), File->L_FI);
+              printDchars(vol, (uint8_t *)File + FILE_ID_DESC_CONSTANT_LEN + U_endian16(File->L_IU), File->L_FI);
               if (File->Characteristics & DIR_ATTR) {
                 for (i=1; i<=depth; ++i) {
                   if (   (filePartition == level[i].part)
                       && (fileLocation  == level[i].addr)) {
-                    printf(" **Directory cycle: %04x:%08x link to %04x:%08x\n",
-                           curLevel->part, curLevel->addr, filePartition, fileLocation);
+                    fprintf(vol->Out, " **Directory cycle: %04x:%08x link to %04x:%08x\n",
+                            curLevel->part, curLevel->addr, filePartition, fileLocation);
                     bCycle = true;
                   }
                 }
               }
               if (!bCycle) {
                 uint16_t prevCharacteristics = 0;
-                read_icb(ICB, File->ICB, File, &prevCharacteristics);
-                checkICB(ICB, File->ICB, File->Characteristics & DIR_ATTR);
+                read_icb(vol, ICB, File->ICB, File, &prevCharacteristics);
+                checkICB(vol, ICB, File->ICB, File->Characteristics & DIR_ATTR);
+
+                // Named streams don't have streams of their own
+                if (   !curLevel->streams
+                    && (U_endian16(ICB->sTag.uTagID) == TAGID_EXT_FILE_ENTRY)) {
+                  streamDirICB = ICB->EFE.sStreamDirICB;
+                }
 
                 // If this is a directory that's already been traversed
                 // because of a hard link, skip decent into it
@@ -204,38 +288,30 @@ int DisplayDirs(void)
               }
             }
           }
-          printf("\n");
-          DumpError();
+          fprintf(vol->Out, "\n");
+          DumpError(vol);
           curLevel->offs += (FILE_ID_DESC_CONSTANT_LEN + File->L_FI + U_endian16(File->L_IU) + 3) & ~3;
           if ((File->Characteristics & DIR_ATTR) && 
               !bCycle && !bSkipAlreadyTraversedDir &&
               ! (File->Characteristics & PARENT_ATTR) &&
               ! (File->Characteristics & DELETE_ATTR)) {
-            if (depth >= maxLevel) {
-              // Time to grow the array
-              void *largerLevel = realloc(level,
-                                          sizeof(struct dirLevel) * ((maxLevel+1) + LEVELS_PER_ALLOC));
-              if (largerLevel) {
-                level = (struct dirLevel *) largerLevel;
-                memset(&level[maxLevel+1], 0, LEVELS_PER_ALLOC * sizeof(struct dirLevel));
-                maxLevel += LEVELS_PER_ALLOC;
-              }
-            }
-            if (depth < maxLevel) {
-              depth++;
-              level[depth].offs = 0;
-              level[depth].addr = U_endian32(File->ICB.Location_LBN);
-              level[depth].part = U_endian16(File->ICB.Location_PartNo);
-            } else {
-              for (i = 0; i <= depth; i++) printf("   ");
-              printf(" +more subdirectories (not displayed)\n");
+            if (!PushDirLevel(vol, &level, &maxLevel, &depth, U_endian16(File->ICB.Location_PartNo),
+                              U_endian32(File->ICB.Location_LBN), curLevel->part, curLevel->addr,
+                              false)) {
+              for (i = 0; i <= depth; i++) fprintf(vol->Out, "   ");
+              fprintf(vol->Out, " +more subdirectories (not displayed)\n");
               // Note, this kills any ability to regenerate the Logical Volume Integrity Descriptor
               // because we can't get accurate file & directory counts
             }
           }
+          // Its streams are walked before the contents of the directory (if it is one)
+          if (EXTENT_LENGTH(streamDirICB.ExtentLengthAndType)) {
+            PushStreamDir(vol, ICB, streamDirICB, &level, &maxLevel, &depth,
+                          U_endian16(File->ICB.Location_PartNo), U_endian32(File->ICB.Location_LBN));
+          }
         } else {
-          printf("**Error in directory\n");
-          DumpError();
+          fprintf(vol->Out, "**Error in directory\n");
+          DumpError(vol);
           depth--;
         }
       }
@@ -249,13 +325,14 @@ int DisplayDirs(void)
         memset(&icbAddr, 0, sizeof(icbAddr));
         icbAddr.Location_PartNo = U_endian16(level[depth].part);
         icbAddr.Location_LBN    = U_endian32(level[depth].addr);
-        icbAddr.ExtentLengthAndType = U_endian32(blocksize);
-        read_icb(ICB, icbAddr, NULL, NULL);
+        icbAddr.ExtentLengthAndType = U_endian32(vol->blocksize);
+        read_icb(vol, ICB, icbAddr, NULL, NULL);
       }
     } while (depth > 0);
 
   } while (0);
 
+  vol->WalkingStreams = false;
   free(File);
   free(ICB);
   free(level);
@@ -266,29 +343,31 @@ int DisplayDirs(void)
 /**
  * @param[out] FID       Where to put File Identifier descriptor
  * @param[in]  fe        ICB of the directory containing the FID of interest
- * @param[in]  part      Which partition the directory is part of
+ * @param[in]  part      Which partition the directory's (Extended) File Entry is in
+ * @param[in]  icbLoc    Block of that partition in which it is recorded
  * @param[in]  offset    Number of bytes into the directory data where FID of interest
  *                       begins
  */
-int GetFID(struct FileIDDesc *FID, const struct FE_or_EFE *fe, uint16_t part,
-           uint64_t offset)
+int GetFID(udf_volume *vol, struct FileIDDesc *FID, const struct FE_or_EFE *fe,
+           uint16_t part, uint32_t icbLoc, uint64_t offset)
 {
   unsigned int bytesRead;
   uint32_t location;
+  sError *error = CurrentError(vol);
   
-  bytesRead = ReadFileData(FID, fe, part, offset, blocksize, &location);
+  bytesRead = ReadFileData(vol, FID, fe, part, icbLoc, offset, vol->blocksize, &location);
   if (bytesRead > FILE_ID_DESC_CONSTANT_LEN) {
-    CheckTag((struct tag *)FID, location, TAGID_FILE_ID, 0, bytesRead - sizeof(struct tag));
-    if (Error.Code == ERR_TAGLOC) {
-      printf("** Wrong Tag Location. Expected %lld, Found %lld (%u)\n",
-             Error.Expected, Error.Found, location);
-      FID_Loc_Wrong++;
-      Error.Code = 0;
+    CheckTag(vol, (struct tag *)FID, location, TAGID_FILE_ID, 0, bytesRead - sizeof(struct tag));
+    if (error->Code == ERR_TAGLOC) {
+      fprintf(vol->Out, "** Wrong Tag Location. Expected %lld, Found %lld (%u)\n",
+              error->Expected, error->Found, location);
+      vol->FID_Loc_Wrong++;
+      ClearError(vol);
     }
-    if (Error.Code == ERR_CRC_LENGTH) {
-      DumpError();
+    if (error->Code == ERR_CRC_LENGTH) {
+      DumpError(vol);
     }
-    return Error.Code;
+    return error->Code;
   } else {
     return ERR_READ;
   }
@@ -10,55 +10,125 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <memory.h>
+#include <scsi/sg.h>
 #include "nsr.h"
 #include "chkudf.h"
 #include "protos.h"
 
+// Host status set by the kernel when a command times out (DID_TIME_OUT)
+#define HOST_TIMED_OUT  0x03
+
+/*
+ * Extract the sense key, additional sense code and qualifier from either
+ * fixed format (response code 70h/71h) or descriptor format (72h/73h)
+ * sense data.  Fields that aren't present are returned as zero.
+ */
+void decode_sense(const uint8_t *sense, int sense_len, uint8_t *key,
+                  uint8_t *asc, uint8_t *ascq)
+{
+  *key = *asc = *ascq = 0;
+
+  if (sense_len < 1) {
+    return;
+  }
+
+  switch (sense[0] & 0x7f) {
+    case 0x70:
+    case 0x71:
+      if (sense_len > 2)  *key  = sense[2] & 0x0f;
+      if (sense_len > 12) *asc  = sense[12];
+      if (sense_len > 13) *ascq = sense[13];
+      break;
+
+    case 0x72:
+    case 0x73:
+      if (sense_len > 1)  *key  = sense[1] & 0x0f;
+      if (sense_len > 2)  *asc  = sense[2];
+      if (sense_len > 3)  *ascq = sense[3];
+      break;
+
+    default:
+      break;
+  }
+}
+
 /*
  * Generic SCSI command processor.  The identification of the device is
- * done elsewhere, and assumed to be global.  In the case of the Linux
+ * done elsewhere, and kept in the volume context.  In the case of the Linux
  * implementation, the device identification is a file handle kept in 
- * the "device" global.
+ * vol->device.
+ *
+ * Commands are issued with SG_IO, which transfers straight to or from
+ * 'buffer' (DMA directly into it if it is suitably aligned).
+ * in_len is the number of bytes to be read from the device, out_len the
+ * number to be written to it.  At most one of them may be nonzero.
  */
-bool do_scsi(uint8_t *command, int cmd_len, void *buffer, uint32_t in_len,
-             uint32_t out_len, uint8_t *sense, int sense_len)
+static bool issue_scsi(udf_volume *vol, uint8_t *command, int cmd_len, void *buffer,
+                       uint32_t in_len, uint32_t out_len, uint8_t *sense, int sense_len,
+                       bool report)
 {
-  uint32_t   *ip;
-  uint32_t   buffer_needed;
+  struct sg_io_hdr io;
+  uint8_t key, asc, ascq;
   bool     fail = true;
-  int      result;
 
-  buffer_needed = MAX(in_len, out_len) + 8 + cmd_len;
-  if (buffer_needed > scsibufsize) {
-    scsibuf = realloc(scsibuf, buffer_needed);
+  memset(&io, 0, sizeof(io));
+  io.interface_id = 'S';
+  io.cmdp = command;
+  io.cmd_len = cmd_len;
+  io.sbp = sense;
+  io.mx_sb_len = sense_len;
+  io.timeout = g_scsiTimeout * 1000;
+  io.flags = SG_FLAG_DIRECT_IO;
+  io.dxferp = buffer;
+  if (in_len) {
+    io.dxfer_direction = SG_DXFER_FROM_DEV;
+    io.dxfer_len = in_len;
+  } else if (out_len) {
+    io.dxfer_direction = SG_DXFER_TO_DEV;
+    io.dxfer_len = out_len;
+  } else {
+    io.dxfer_direction = SG_DXFER_NONE;
   }
-  if (scsibuf) {
-    memset(scsibuf, 0, buffer_needed);
-    ip = (uint32_t *)scsibuf;
-    ip[0] = out_len;
-    ip[1] = in_len;
-    memcpy(scsibuf + 8, command, cmd_len);
-    memcpy(scsibuf + 8 + cmd_len, buffer, out_len);
-    result = ioctl(device, 1, scsibuf);
-    if (result == 0) {
-      memcpy(buffer, scsibuf + 8, in_len);
-      fail = false;
-    } else {
-      if (result == 0x28000000) {
-        memcpy(sense, scsibuf + 8, sense_len);
-        printf("**SCSI error %x/%02x/%02x**", sense[2] & 0xf, 
-               (unsigned int)sense[12], (unsigned int)sense[13]);
-      } else if (result == 0x25040000) {
-        printf("SCSI error - can't talk to drive.\n");
-      } else if (result < 0) {
-        if (result == -EPERM)
-          printf("  SCSI access not permitted.\n");
-        else
-          printf("ioctl error %d.\n", -result);
-      } else {
-        printf("Unknown ioctl error 0x%08x.\n", (unsigned int) result);
-      }
-    }
-  } //if scsibuf allocated
+
+  if (ioctl(vol->device, SG_IO, &io) < 0) {
+    if (!report)
+      ;
+    else if (errno == EPERM)
+      fprintf(vol->Out, "  SCSI access not permitted.\n");
+    else
+      fprintf(vol->Out, "SG_IO error %d.\n", errno);
+  } else if ((io.info & SG_INFO_OK_MASK) == SG_INFO_OK) {
+    fail = false;
+  } else if (!report) {
+    // Caller only wants to know whether the command worked
+  } else if ((io.host_status == HOST_TIMED_OUT) || (io.duration >= io.timeout)) {
+    // Checked first: a timeout also sets host_status
+    fprintf(vol->Out, "SCSI command timed out.\n");
+  } else if (io.sb_len_wr > 0) {
+    decode_sense(sense, io.sb_len_wr, &key, &asc, &ascq);
+    fprintf(vol->Out, "**SCSI error %x/%02x/%02x**", key, asc, ascq);
+  } else if (io.host_status || io.driver_status) {
+    fprintf(vol->Out, "SCSI error - can't talk to drive (host 0x%x, driver 0x%x).\n",
+            io.host_status, io.driver_status);
+  } else if (io.status) {
+    fprintf(vol->Out, "SCSI status 0x%02x.\n", io.status);
+  }
+
   return fail;
 }
+
+bool do_scsi(udf_volume *vol, uint8_t *command, int cmd_len, void *buffer, uint32_t in_len,
+             uint32_t out_len, uint8_t *sense, int sense_len)
+{
+  return issue_scsi(vol, command, cmd_len, buffer, in_len, out_len, sense, sense_len, true);
+}
+
+/*
+ * As do_scsi, but failures are not reported. Used for probing commands
+ * that many devices are expected to reject.
+ */
+bool do_scsi_quiet(udf_volume *vol, uint8_t *command, int cmd_len, void *buffer,
+                   uint32_t in_len, uint8_t *sense, int sense_len)
+{
+  return issue_scsi(vol, command, cmd_len, buffer, in_len, 0, sense, sense_len, false);
+}
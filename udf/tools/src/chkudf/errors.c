@@ -3,26 +3,152 @@
 // Copyright (c) 2019 Steve Magnani. All rights reserved.
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "chkudf.h"
 #include "nsr.h"
 #include "protos.h"
 
-void DumpError(void)
+/*
+ * Each thread has its own error record, so threads checking different
+ * volumes - or different parts of the same one - never disturb each other's
+ * errors. The record belongs to one volume at a time; it is retired with
+ * FlushError() at the end of each phase, so a thread can move on to
+ * another volume without anything being left behind.
+ */
+static __thread sError      ThreadError;
+static __thread udf_volume *ThreadErrorVol;
+
+sError *CurrentError(udf_volume *vol)
+{
+  if (ThreadErrorVol != vol) {
+    ThreadErrorVol = vol;
+    ThreadError.Code = ERR_NONE;
+  }
+  return &ThreadError;
+}
+
+/*
+ * Claim the next record in the volume's error log and fill it in. Records
+ * are claimed with an atomic increment and chunks are installed with a
+ * compare-and-swap, so no lock is needed. Errors beyond the capacity of
+ * the log are still counted.
+ */
+static void LogError(udf_volume *vol, const sError *error, bool reported)
+{
+  sErrorLog    *log = &vol->ErrorLog;
+  uint32_t      index = atomic_fetch_add(&log->Count, 1);
+  uint32_t      chunkNo = index / ERROR_LOG_CHUNK;
+  sErrorRecord *chunk, *expected = NULL;
+  sErrorRecord *record;
+
+  if (chunkNo >= ERROR_LOG_CHUNKS) {
+    return;
+  }
+
+  chunk = atomic_load(&log->Chunks[chunkNo]);
+  if (!chunk) {
+    chunk = calloc(ERROR_LOG_CHUNK, sizeof(sErrorRecord));
+    if (!chunk) {
+      return;
+    }
+    if (!atomic_compare_exchange_strong(&log->Chunks[chunkNo], &expected, chunk)) {
+      free(chunk);            // Another thread installed this chunk first
+      chunk = expected;
+    }
+  }
+
+  record = &chunk[index % ERROR_LOG_CHUNK];
+  record->Error = *error;
+  record->Phase = vol->Phase;
+  record->Reported = reported;
+  atomic_store_explicit(&record->Ready, true, memory_order_release);
+}
+
+void SetError(udf_volume *vol, int code, uint32_t sector, long long expected,
+              long long found)
 {
-  if (Error.Code > 0) {
-    printf("**[%08x] ", Error.Sector);
-    printf(Error_Msgs[Error.Code - 1].format, Error.Expected, Error.Found);
-    printf(".\n");
+  sError *error = CurrentError(vol);
 
-    g_exitStatus |= Error_Msgs[Error.Code - 1].exitCode;
+  if (error->Code) {
+    LogError(vol, error, false);    // Replaced before it was reported
   }
-  ClearError();
+  error->Code     = code;
+  error->Sector   = sector;
+  error->Expected = expected;
+  error->Found    = found;
 }
 
-void ClearError(void)
+void DumpError(udf_volume *vol)
 {
-  Error.Code     = ERR_NONE;
-  Error.Sector   = 0;
-  Error.Expected = 0;
-  Error.Found    = 0;
+  sError *error = CurrentError(vol);
+
+  if (error->Code > 0) {
+    vol->ExitStatus |= Error_Msgs[error->Code - 1].exitCode;
+    vol->LineSeverity |= Error_Msgs[error->Code - 1].exitCode;
+    LogError(vol, error, true);
+
+    fprintf(vol->Out, "**[%08x] ", error->Sector);
+    fprintf(vol->Out, Error_Msgs[error->Code - 1].format, error->Expected, error->Found);
+    fprintf(vol->Out, ".\n");
+  }
+  ClearError(vol);
+}
+
+/*
+ * Discard the recorded error - the caller has decided it doesn't matter.
+ */
+void ClearError(udf_volume *vol)
+{
+  sError *error = CurrentError(vol);
+
+  error->Code     = ERR_NONE;
+  error->Sector   = 0;
+  error->Expected = 0;
+  error->Found    = 0;
+}
+
+/*
+ * Retire an error nobody dumped or cleared, logging it as superseded.
+ */
+void FlushError(udf_volume *vol)
+{
+  sError *error = CurrentError(vol);
+
+  if (error->Code) {
+    LogError(vol, error, false);
+  }
+  ClearError(vol);
+}
+
+/*
+ * Count the logged errors of a phase that were (or weren't) reported.
+ */
+uint32_t CountErrors(udf_volume *vol, chkudf_phase phase, bool reported)
+{
+  uint32_t count = atomic_load(&vol->ErrorLog.Count);
+  uint32_t i, matches = 0;
+  sErrorRecord *chunk;
+
+  count = MIN(count, ERROR_LOG_CHUNK * ERROR_LOG_CHUNKS);
+  for (i = 0; i < count; i++) {
+    chunk = atomic_load(&vol->ErrorLog.Chunks[i / ERROR_LOG_CHUNK]);
+    if (chunk && atomic_load_explicit(&chunk[i % ERROR_LOG_CHUNK].Ready, memory_order_acquire) &&
+        (chunk[i % ERROR_LOG_CHUNK].Phase == phase) &&
+        (chunk[i % ERROR_LOG_CHUNK].Reported == reported)) {
+      matches++;
+    }
+  }
+  return matches;
+}
+
+void FreeErrorLog(udf_volume *vol)
+{
+  int i;
+
+  ClearError(vol);
+  for (i = 0; i < ERROR_LOG_CHUNKS; i++) {
+    free(atomic_exchange(&vol->ErrorLog.Chunks[i], NULL));
+  }
+  atomic_store(&vol->ErrorLog.Count, 0);
+  ThreadErrorVol = NULL;
 }
@@ -9,47 +9,37 @@
 
 int bitv[8] = {1, 2, 4, 8, 16, 32, 64, 128};
 
-int track_freespace(uint16_t ptn, uint32_t addr, uint32_t extentNumBytes)
+int track_freespace(udf_volume *vol, uint16_t ptn, uint32_t addr, uint32_t extentNumBytes)
 {
   // @todo Decide if Error.Sector should be block address of extent's container
   do {
-    uint32_t endAddr = addr + ((extentNumBytes + blocksize - 1) >> bdivshift);
-    if (ptn >= PTN_no) {
-      Error.Code = ERR_BAD_PTN;
-      Error.Sector = addr;
-      Error.Expected = PTN_no;
-      Error.Found = ptn;
+    uint32_t endAddr = addr + ((extentNumBytes + vol->blocksize - 1) >> vol->bdivshift);
+    if (ptn >= vol->PTN_no) {
+      SetError(vol, ERR_BAD_PTN, addr, vol->PTN_no, ptn);
       break;
     }
-    if (addr >= Part_Info[ptn].Len) {
-      Error.Code = ERR_BAD_LBN;
-      Error.Sector = addr;
-      Error.Expected = Part_Info[ptn].Len;
-      Error.Found = addr;
+    if (addr >= vol->Part_Info[ptn].Len) {
+      SetError(vol, ERR_BAD_LBN, addr, vol->Part_Info[ptn].Len, addr);
       break;
     }
-    if ((endAddr > Part_Info[ptn].Len) || (endAddr < addr)) {
-      Error.Code = ERR_BAD_LBN;
-      Error.Sector = addr;
-      Error.Expected = Part_Info[ptn].Len;
-      Error.Found = endAddr;
+    if ((endAddr > vol->Part_Info[ptn].Len) || (endAddr < addr)) {
+      SetError(vol, ERR_BAD_LBN, addr, vol->Part_Info[ptn].Len, endAddr);
       break;
     }
 
-    if (Part_Info[ptn].SpMap) {
+    if (vol->Part_Info[ptn].SpMap) {
       uint32_t extentNumBlocks = endAddr - addr;
       while (extentNumBlocks > 0) {
         uint32_t bytep, bitp;
         bytep = addr >> 3;
         bitp = addr & 7;
-        if (Part_Info[ptn].SpMap[bytep] & bitv[bitp]) {
+        if (vol->Part_Info[ptn].SpMap[bytep] & bitv[bitp]) {
           // Report only the first overlapping block as that is what limits the extent
-          if (!Error.Code) {
-            Error.Code = ERR_FILE_SPACE_OVERLAP;    // @todo Appropriate error?
-            Error.Sector = addr;
+          if (!CurrentError(vol)->Code) {
+            SetError(vol, ERR_FILE_SPACE_OVERLAP, addr, 0, 0);    // @todo Appropriate error?
           }
         } else {
-          Part_Info[ptn].SpMap[bytep] |= bitv[bitp];
+          vol->Part_Info[ptn].SpMap[bytep] |= bitv[bitp];
         }
         extentNumBlocks--;
         addr++;
@@ -57,53 +47,43 @@ int track_freespace(uint16_t ptn, uint32_t addr, uint32_t extentNumBytes)
     }
   } while (0);
 
-  if (Error.Code) {
-    DumpError();
+  if (CurrentError(vol)->Code) {
+    DumpError(vol);
   }
   return 0;
 }
 
-int track_filespace(uint16_t ptn, uint32_t addr, uint32_t extentNumBytes)
+int track_filespace(udf_volume *vol, uint16_t ptn, uint32_t addr, uint32_t extentNumBytes)
 {
   // @todo Decide if Error.Sector should be block address of extent's container
   do {
-    uint32_t endAddr = addr + ((extentNumBytes + blocksize - 1) >> bdivshift);
-    if (ptn >= PTN_no) {
-      Error.Code = ERR_BAD_PTN;
-      Error.Sector = addr;
-      Error.Expected = PTN_no;
-      Error.Found = ptn;
+    uint32_t endAddr = addr + ((extentNumBytes + vol->blocksize - 1) >> vol->bdivshift);
+    if (ptn >= vol->PTN_no) {
+      SetError(vol, ERR_BAD_PTN, addr, vol->PTN_no, ptn);
       break;
     }
-    if (addr >= Part_Info[ptn].Len) {
-      Error.Code = ERR_BAD_LBN;
-      Error.Sector = addr;
-      Error.Expected = Part_Info[ptn].Len;
-      Error.Found = addr;
+    if (addr >= vol->Part_Info[ptn].Len) {
+      SetError(vol, ERR_BAD_LBN, addr, vol->Part_Info[ptn].Len, addr);
       break;
     }
-    if ((endAddr > Part_Info[ptn].Len) || (endAddr < addr)) {
-      Error.Code = ERR_BAD_LBN;
-      Error.Sector = addr;
-      Error.Expected = Part_Info[ptn].Len;
-      Error.Found = endAddr;
+    if ((endAddr > vol->Part_Info[ptn].Len) || (endAddr < addr)) {
+      SetError(vol, ERR_BAD_LBN, addr, vol->Part_Info[ptn].Len, endAddr);
       break;
     }
 
-    if (Part_Info[ptn].MyMap) {
+    if (vol->Part_Info[ptn].MyMap) {
       uint32_t extentNumBlocks = endAddr - addr;
       while (extentNumBlocks > 0) {
         uint32_t bytep, bitp;
         bytep = addr >> 3;
         bitp = addr & 7;
-        if ((Part_Info[ptn].MyMap[bytep] & bitv[bitp]) == 0) {
+        if ((vol->Part_Info[ptn].MyMap[bytep] & bitv[bitp]) == 0) {
           // Report only the first overlapping block as that is what limits the extent
-          if (!Error.Code) {
-            Error.Code = ERR_FILE_SPACE_OVERLAP;
-            Error.Sector = addr;
+          if (!CurrentError(vol)->Code) {
+            SetError(vol, ERR_FILE_SPACE_OVERLAP, addr, 0, 0);
           }
         } else {
-          Part_Info[ptn].MyMap[bytep] &= ~bitv[bitp];
+          vol->Part_Info[ptn].MyMap[bytep] &= ~bitv[bitp];
         }
         extentNumBlocks--;
         addr++;
@@ -111,23 +91,23 @@ int track_filespace(uint16_t ptn, uint32_t addr, uint32_t extentNumBytes)
     }
   } while (0);
 
-  if (Error.Code) {
-    DumpError();
+  if (CurrentError(vol)->Code) {
+    DumpError(vol);
   }
   return 0;
 }
 
-int check_filespace(void)
+int check_filespace(udf_volume *vol)
 {
   unsigned int i, j;
   int pass;    // 1 == in-use blocks marked free, 2 == free blocks marked in-use
 
-  for (i = 0; i < PTN_no; i++) {
-    if (Part_Info[i].SpMap && Part_Info[i].MyMap) {
-      unsigned int numMapBytes = BITMAP_NUM_BYTES(Part_Info[i].Len);
+  for (i = 0; i < vol->PTN_no; i++) {
+    if (vol->Part_Info[i].SpMap && vol->Part_Info[i].MyMap) {
+      unsigned int numMapBytes = BITMAP_NUM_BYTES(vol->Part_Info[i].Len);
       unsigned int numMismarkedFree = 0;
       unsigned int numMismarkedInUse = 0;
-      Information("\n--Checking partition reference %u for space errors.\n", i);
+      Information(vol, "\n--Checking partition reference %u for space errors.\n", i);
       for (pass = 1; pass <= 2; ++pass) {
         int numSuppressed = 0;
         int numReported = 0;
@@ -135,19 +115,19 @@ int check_filespace(void)
         bool bSuppress = false;
 
         for (j = 0; j < numMapBytes; j++) {
-          if (Part_Info[i].SpMap[j] != Part_Info[i].MyMap[j]) {
+          if (vol->Part_Info[i].SpMap[j] != vol->Part_Info[i].MyMap[j]) {
             // See if the mismatch is for the current pass
-            uint8_t mismatchBits = Part_Info[i].SpMap[j] ^ Part_Info[i].MyMap[j];
+            uint8_t mismatchBits = vol->Part_Info[i].SpMap[j] ^ vol->Part_Info[i].MyMap[j];
             if (pass == 1) {
               // In-use, but marked free?
-              mismatchBits &= ~Part_Info[i].MyMap[j];
+              mismatchBits &= ~vol->Part_Info[i].MyMap[j];
               if (mismatchBits)
                 numMismarkedFree += countSetBits(mismatchBits);
               else
                 continue;  // No
             } else {
               // Free, but marked in-use?
-              mismatchBits &= Part_Info[i].MyMap[j];
+              mismatchBits &= vol->Part_Info[i].MyMap[j];
               if (mismatchBits)
                 numMismarkedInUse += countSetBits(mismatchBits);
               else
@@ -158,19 +138,19 @@ int check_filespace(void)
             } else {
               if (numReported == 0) {
                 if (pass == 1)
-                  UDFError("**In-use blocks marked free:\n");
+                  UDFError(vol, "**In-use blocks marked free:\n");
                 else
-                  MinorError("  Free blocks marked in-use:\n");
+                  MinorError(vol, "  Free blocks marked in-use:\n");
               }
               ++numReported;
-              printf("  **At byte %u, (sectors %u-%u), recorded mask is %02x, mapped is %02x (mismatch %02x)\n",
-                     j, j * 8, j* 8 + 7, Part_Info[i].SpMap[j], Part_Info[i].MyMap[j], mismatchBits);
+              fprintf(vol->Out, "  **At byte %u, (sectors %u-%u), recorded mask is %02x, mapped is %02x (mismatch %02x)\n",
+                      j, j * 8, j* 8 + 7, vol->Part_Info[i].SpMap[j], vol->Part_Info[i].MyMap[j], mismatchBits);
 
               if (askForMore && ((numReported % askForMore) == 0)) {
-                char ans = g_defaultAnswer;
-                if (!g_defaultAnswer) {
-                  printf("Print more? ");
-                  fflush(stdout);
+                char ans = g_defaultAnswer ? g_defaultAnswer : 'n';
+                if (!g_defaultAnswer && vol->Interactive) {
+                  fprintf(vol->Out, "Print more? ");
+                  fflush(vol->Out);
                   ans = getchar();
                 }
                 if ((ans == 'n') || (ans == 'N')) {
@@ -184,91 +164,92 @@ int check_filespace(void)
         }     // for each partition slot
 
         if (numSuppressed > 0) {
-          printf("**(%d additional mismatching bytes)\n", numSuppressed);
+          fprintf(vol->Out, "**(%d additional mismatching bytes)\n", numSuppressed);
         }
       }  // for each pass
 
-      printf("\n%s%u in-use blocks mismarked free.\n",
-             (numMismarkedFree > 0) ? "**" : "  ", numMismarkedFree);
-      printf("  %u free blocks mismarked in-use.\n", numMismarkedInUse);
+      fprintf(vol->Out, "\n%s%u in-use blocks mismarked free.\n",
+              (numMismarkedFree > 0) ? "**" : "  ", numMismarkedFree);
+      fprintf(vol->Out, "  %u free blocks mismarked in-use.\n", numMismarkedInUse);
     }  // if maps are available to compare
   }    // for each partition
 
-  Information("  There are %u directories and %u files.\n", Num_Dirs, Num_Files);
-  if (ID_UID && (Num_Dirs != ID_Dirs)) {
-    UDFError("**The integrity descriptor indicated %u directories.\n",
-             ID_Dirs);
+  Information(vol, "  There are %u directories and %u files.\n", vol->Num_Dirs, vol->Num_Files);
+  Information(vol, "  Tracked %u ICBs using %u bytes each, plus %u bytes of hard link unique IDs.\n",
+              (unsigned int) vol->ICBlist_len, icb_bytes_per_entry(vol),
+              (unsigned int) (vol->LinkedUIDChunks * sizeof(sLinkedUIDChunk)));
+  if (vol->ID_UID && (vol->Num_Dirs != vol->ID_Dirs)) {
+    UDFError(vol, "**The integrity descriptor indicated %u directories.\n",
+             vol->ID_Dirs);
   }
-  if (ID_UID && (Num_Files != ID_Files)) {
-    UDFError("**The integrity descriptor indicated %u files.\n",
-             ID_Files);
+  if (vol->ID_UID && (vol->Num_Files != vol->ID_Files)) {
+    UDFError(vol, "**The integrity descriptor indicated %u files.\n",
+             vol->ID_Files);
   }
-  if (Num_Type_Err) {
-    UDFError("**%u files had a bad File Type.\n", Num_Type_Err);
+  if (vol->Num_Type_Err) {
+    UDFError(vol, "**%u files had a bad File Type.\n", vol->Num_Type_Err);
   }
-  printf("\n");
-  if (FID_Loc_Wrong) {
-    UDFError("**%u FIDs had a wrong location value.\n", FID_Loc_Wrong);
+  fprintf(vol->Out, "\n");
+  if (vol->FID_Loc_Wrong) {
+    UDFError(vol, "**%u FIDs had a wrong location value.\n", vol->FID_Loc_Wrong);
   }
   return 0;
 }
 
-int check_uniqueid(void)
+int check_uniqueid(udf_volume *vol)
 {
   int i, j, ii, jj;
   uint64_t maxUID;
   uint64_t nextUID;
 
-  Information("\n--Checking Unique ID list.\n");
+  Information(vol, "\n--Checking Unique ID list.\n");
 
   // Determine the maximum unique ID we've encountered
   maxUID = 0;
-  for (i = 0; i < ICBlist_len; i++) {
-    uint32_t *linkedUIDs = ICBlist[i].LinkedUIDs;
-    if (ICBlist[i].UniqueID > maxUID) {
-      maxUID = ICBlist[i].UniqueID;
+  for (i = 0; i < vol->ICBlist_len; i++) {
+    uint64_t linkedUID;
+    if (vol->ICBlist.UniqueID[i] > maxUID) {
+      maxUID = vol->ICBlist.UniqueID[i];
     }
 
-    for (j = 0; j < ICBlist[i].MaxLinkedUIDs; j++) {
-      if (linkedUIDs[j] > maxUID) {
-        maxUID = linkedUIDs[j];
+    for (ii = 1; (linkedUID = icb_unique_id(vol, i, ii)); ii++) {
+      if (linkedUID > maxUID) {
+        maxUID = linkedUID;
       }
     }
   }
 
   // Scan for illegal values
-  for (i = 0; i < ICBlist_len; i++) {
-    uint32_t *linkedUIDs = ICBlist[i].LinkedUIDs;
-    if ((ICBlist[i].UniqueID > 0) && ((ICBlist[i].UniqueID & 0xFFFFFFF0) == 0)) {
-      UDFError("**ICB at %04x:%08x has illegal UID 0x%" PRIX64 "\n", ICBlist[i].Ptn,
-               ICBlist[i].LBN, ICBlist[i].UniqueID);
+  for (i = 0; i < vol->ICBlist_len; i++) {
+    uint64_t linkedUID;
+    if ((vol->ICBlist.UniqueID[i] > 0) && ((vol->ICBlist.UniqueID[i] & 0xFFFFFFF0) == 0)) {
+      UDFError(vol, "**ICB at %04x:%08x has illegal UID 0x%" PRIX64 "\n", vol->ICBlist.Ptn[i],
+               vol->ICBlist.LBN[i], vol->ICBlist.UniqueID[i]);
     }
 
-    for (j = 0; j < ICBlist[i].MaxLinkedUIDs; j++) {
-      if ((linkedUIDs[j] > 0) && ((linkedUIDs[j] & 0xFFFFFFF0) == 0)) {
-        UDFError("**ICB at %04x:%08x has illegal linked UID 0x%" PRIX64 "\n", ICBlist[i].Ptn,
-                 ICBlist[i].LBN, ICBlist[i].UniqueID);
+    for (ii = 1; (linkedUID = icb_unique_id(vol, i, ii)); ii++) {
+      if ((linkedUID & 0xFFFFFFF0) == 0) {
+        UDFError(vol, "**ICB at %04x:%08x has illegal linked UID 0x%" PRIX64 "\n", vol->ICBlist.Ptn[i],
+                 vol->ICBlist.LBN[i], linkedUID);
       }
     }
   }
 
-  for (i = 0; i < ICBlist_len; i++) {
+  for (i = 0; i < vol->ICBlist_len; i++) {
 
-    for (ii=0; ii <= ICBlist[i].MaxLinkedUIDs; ++ii) {
-      uint64_t iUniqueID = (ii == 0) ? ICBlist[i].UniqueID
-                                     : ICBlist[i].LinkedUIDs[ii-1];
+    for (ii = 0; ; ++ii) {
+      uint64_t iUniqueID = icb_unique_id(vol, i, ii);
       if ((ii > 0) && !iUniqueID)
         break;   // No more linked UIDs for [i]
 
       bool bDuplicate = false;
       bool bAlreadyReported = false;
-      for (j = 0; !bAlreadyReported && (j < ICBlist_len); j++) {
+      for (j = 0; !bAlreadyReported && (j < vol->ICBlist_len); j++) {
         if (j == i)
-          continue;  // @todo This skips over duplicate checking within ICBlist[i].LinkedUIDs
+          continue;  // @todo This skips over duplicate checking within the linked UIDs of [i]
 
-        for (jj=0; jj <= ICBlist[j].MaxLinkedUIDs; ++jj) {
-          uint64_t jUniqueID = (jj == 0) ? ICBlist[j].UniqueID
-                                         : ICBlist[j].LinkedUIDs[jj-1];
+        for (jj = 0; ; ++jj) {
+          uint64_t jUniqueID = icb_unique_id(vol, j, jj);
           if ((jj > 0) && !jUniqueID)
             break;   // No more linked UIDs for [j]
 
@@ -280,12 +261,12 @@ int check_uniqueid(void)
             }
 
             if (!bDuplicate) {
-              UDFError("**Multiple ICBs with unique ID %" PRIu64 ":\n", jUniqueID);
-              UDFError("**  %04x:%08x%s\n", ICBlist[i].Ptn, ICBlist[i].LBN,
+              UDFError(vol, "**Multiple ICBs with unique ID %" PRIu64 ":\n", jUniqueID);
+              UDFError(vol, "**  %04x:%08x%s\n", vol->ICBlist.Ptn[i], vol->ICBlist.LBN[i],
                        (ii > 0) ? " [link]" : "");
               bDuplicate = true;
             }
-            UDFError("**  %04x:%08x%s\n", ICBlist[j].Ptn, ICBlist[j].LBN,
+            UDFError(vol, "**  %04x:%08x%s\n", vol->ICBlist.Ptn[j], vol->ICBlist.LBN[j],
                      (jj > 0) ? " [link]" : "");
             break;   // stop processing [j], don't want to print it more than once
           }
@@ -299,15 +280,15 @@ int check_uniqueid(void)
   if (!(nextUID & 0xFFFFFFF0))
     nextUID = (nextUID | 0xF) + 1;
 
-  if (!ID_UID || (nextUID == ID_UID)) {
-    Verbose("  The next Unique ID is %" PRIu64 ".\n", nextUID);
+  if (!vol->ID_UID || (nextUID == vol->ID_UID)) {
+    Verbose(vol, "  The next Unique ID is %" PRIu64 ".\n", nextUID);
   } else {
-    if (ID_UID > nextUID) {
-      Verbose("  The next Unique ID is %" PRIu64 ".\n", nextUID);
-      Verbose("  The Integrity Descriptor indicated a next Unique ID of %" PRIu64 ".\n", ID_UID);
+    if (vol->ID_UID > nextUID) {
+      Verbose(vol, "  The next Unique ID is %" PRIu64 ".\n", nextUID);
+      Verbose(vol, "  The Integrity Descriptor indicated a next Unique ID of %" PRIu64 ".\n", vol->ID_UID);
     } else {
-      Information("  The next Unique ID is %" PRIu64 ".\n", nextUID);
-      UDFError("**The Integrity Descriptor indicated a next Unique ID of %" PRIu64 ".\n", ID_UID);
+      Information(vol, "  The next Unique ID is %" PRIu64 ".\n", nextUID);
+      UDFError(vol, "**The Integrity Descriptor indicated a next Unique ID of %" PRIu64 ".\n", vol->ID_UID);
     }
   }
 
@@ -0,0 +1,282 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (c) 2026 Steve Magnani. All rights reserved.
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>        // BLKGETSIZE64
+#include <linux/cdrom.h>
+#include <blkid/blkid.h>     // libblkid
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nsr.h"
+#include "chkudf.h"
+#include "protos.h"
+
+/*
+ * Media geometry discovery.
+ *
+ * Sector size, first and last sector and CD-RW status are all derived from
+ * the same handful of device queries. DiscoverGeometry() makes each of
+ * those queries once, issuing independent ones together, and keeps the
+ * raw results in Geometry. SetSectorSize(), SetLastSector() and
+ * SetFirstSector() then only interpret what was gathered here.
+ *
+ * SCSI queries that depend on an earlier answer (the track to ask about
+ * comes from READ DISC INFORMATION) are issued in a second round.
+ */
+
+typedef struct _sProbe {
+    uint8_t  Cdb[12];
+    int      CdbLen;
+    uint8_t *Buffer;
+    uint32_t Length;
+    bool    *OK;
+} sProbe;
+
+static void ProbeCdb(sProbe *probe, uint8_t opcode, int cdbLen, uint8_t *buffer,
+                     uint32_t length, bool *ok)
+{
+  memset(probe->Cdb, 0, sizeof(probe->Cdb));
+  probe->Cdb[0] = opcode;
+  probe->CdbLen = cdbLen;
+  probe->Buffer = buffer;
+  probe->Length = length;
+  probe->OK = ok;
+  memset(buffer, 0, length);
+  *ok = false;
+}
+
+/*
+ * Issue a set of independent queries: all queued at once on an sg device,
+ * otherwise back to back. Failures are expected (most devices reject the
+ * optical-only commands) and are not reported.
+ */
+static void RunProbes(udf_volume *vol, sProbe *probes, int numProbes)
+{
+  int tags[SG_ASYNC_DEPTH];
+  int i;
+
+  if (vol->Geometry.SgDevice && !vol->SgStalled && (numProbes <= SG_ASYNC_DEPTH)) {
+    for (i = 0; i < numProbes; i++) {
+      tags[i] = sg_async_submit_cdb(vol, probes[i].Cdb, probes[i].CdbLen,
+                                    probes[i].Buffer, probes[i].Length);
+    }
+    for (i = 0; i < numProbes; i++) {
+      *probes[i].OK = tags[i] && sg_async_wait(vol, tags[i]);
+    }
+  } else {
+    for (i = 0; i < numProbes; i++) {
+      *probes[i].OK = !do_scsi_quiet(vol, probes[i].Cdb, probes[i].CdbLen, probes[i].Buffer,
+                                     probes[i].Length, vol->sensedata, vol->sensebufsize);
+    }
+  }
+}
+
+static void ProbeTrackInfo(sProbe *probe, uint8_t track, uint8_t *buffer, bool *ok)
+{
+  ProbeCdb(probe, 0x52, 10, buffer, 36, ok);   // READ TRACK INFORMATION
+  probe->Cdb[1] = 1;                           // For a track number
+  probe->Cdb[5] = track;
+  probe->Cdb[8] = 36;
+}
+
+static void ProbeHPTrackInfo(sProbe *probe, uint8_t track, uint8_t *buffer, bool *ok)
+{
+  ProbeCdb(probe, 0xe5, 10, buffer, 20, ok);   // 4020/6020 Read Track Info
+  probe->Cdb[5] = track;
+  probe->Cdb[8] = 20;
+}
+
+/*
+ * Optical media: ask about the recorded tracks.
+ */
+static void ProbeTracks(udf_volume *vol)
+{
+  sProbe   probes[3];
+  uint8_t  lastTrack, firstTrackLastSession;
+  int      n = 0;
+
+  ProbeCdb(&probes[n], 0x51, 10, vol->Geometry.DiscInfo, 32, &vol->Geometry.DiscInfoOK);
+  probes[n++].Cdb[8] = 32;                       // READ DISC INFORMATION
+  ProbeHPTrackInfo(&probes[n++], 1, vol->Geometry.HPTrack1, &vol->Geometry.HPTrack1OK);
+  RunProbes(vol, probes, n);
+
+  n = 0;
+  if (vol->Geometry.DiscInfoOK) {
+    lastTrack = vol->Geometry.DiscInfo[6];
+    firstTrackLastSession = vol->Geometry.DiscInfo[5];
+    ProbeTrackInfo(&probes[n++], lastTrack, vol->Geometry.LastTrack, &vol->Geometry.LastTrackOK);
+    ProbeTrackInfo(&probes[n++], firstTrackLastSession, vol->Geometry.FirstTrack,
+                   &vol->Geometry.FirstTrackOK);
+  }
+  if (vol->Geometry.HPTrack1OK) {
+    // Byte 1 is really the number of tracks, not the last track number
+    ProbeHPTrackInfo(&probes[n++], vol->Geometry.HPTrack1[1], vol->Geometry.HPLastTrack,
+                     &vol->Geometry.HPLastTrackOK);
+  }
+  RunProbes(vol, probes, n);
+
+  // Blank last track - the one before it holds the data
+  if (vol->Geometry.LastTrackOK && (vol->Geometry.LastTrack[6] & 0x40)) {
+    ProbeTrackInfo(&probes[0], vol->Geometry.DiscInfo[6] - 1, vol->Geometry.LastTrack,
+                   &vol->Geometry.LastTrackOK);
+    RunProbes(vol, probes, 1);
+  }
+
+  // Blank last session - walk back to the first track of the previous one
+  if (vol->Geometry.FirstTrackOK && (vol->Geometry.FirstTrack[6] & 0x40)) {
+    uint8_t firstTrack = vol->Geometry.DiscInfo[3];
+    uint8_t track = vol->Geometry.DiscInfo[5];
+    uint8_t targetSession = vol->Geometry.FirstTrack[3] - 1;
+    uint8_t trackInfo[36];
+    bool    ok;
+
+    vol->Geometry.BlankSession = vol->Geometry.FirstTrack[3];
+    vol->Geometry.FirstTrackOK = false;
+    while ((targetSession > 0) && (track > firstTrack)) {
+      track--;
+      ProbeTrackInfo(&probes[0], track, trackInfo, &ok);
+      RunProbes(vol, probes, 1);
+      if (ok && (trackInfo[3] == targetSession)) {
+        memcpy(vol->Geometry.FirstTrack, trackInfo, sizeof(trackInfo));
+        vol->Geometry.FirstTrackOK = true;
+        vol->Geometry.FirstTrackNo = track;
+      } else if (ok && (trackInfo[3] < targetSession)) {
+        break;
+      }
+    }
+  }
+}
+
+/*
+ * Read what would be the anchor at sector 256 for each candidate sector
+ * size in one batch. Sector 512 at half the size is in the same place.
+ */
+static void ProbeAnchors(udf_volume *vol)
+{
+  sReadRequest requests[GEOM_GUESS_SIZES];
+  uint32_t size;
+  int i;
+
+  for (i = 0; i < GEOM_GUESS_SIZES; i++) {
+    size = GEOM_MIN_SECTOR_SIZE << i;
+    vol->Geometry.Guess[i] = malloc(size);
+    requests[i].Offset = 256 * (uint64_t) size;
+    requests[i].Length = size;
+    requests[i].Buffer = vol->Geometry.Guess[i];
+    if (!vol->Geometry.Guess[i]) {
+      requests[i].Length = 0;
+    }
+  }
+
+  ReadBatch(vol, requests, GEOM_GUESS_SIZES);
+
+  for (i = 0; i < GEOM_GUESS_SIZES; i++) {
+    vol->Geometry.GuessOK[i] = requests[i].OK && requests[i].Length;
+  }
+  vol->Geometry.GuessProbed = true;
+}
+
+void DiscoverGeometry(udf_volume *vol)
+{
+  struct stat fileinfo;
+  sProbe probes[3];
+  struct cdrom_tocentry toc;
+
+  if (vol->Geometry.Probed) {
+    return;
+  }
+  vol->Geometry.Probed = true;
+
+  if (fstat(vol->device, &fileinfo) == 0) {
+    vol->Geometry.FileBytes = fileinfo.st_size;
+    if (S_ISBLK(fileinfo.st_mode)) {
+      char diskname[32];
+      dev_t fullDiskDev = 0;
+      if (blkid_devno_to_wholedisk(fileinfo.st_rdev, diskname,
+                                   sizeof(diskname), &fullDiskDev) == 0) {
+        vol->Geometry.WholeDisk = (fileinfo.st_rdev == fullDiskDev);
+      }
+    } else if (S_ISCHR(fileinfo.st_mode)) {
+      // SCSI generic (/dev/sg*) node - everything must be done with commands
+      vol->Geometry.SgDevice = sg_async_available(vol);
+    }
+  }
+
+  vol->Geometry.BlockBytesOK = (ioctl(vol->device, BLKGETSIZE64, &vol->Geometry.BlockBytes) == 0);
+
+  memset(&toc, 0, sizeof(toc));
+  toc.cdte_format = CDROM_LBA;
+  toc.cdte_track = CDROM_LEADOUT;
+  if (ioctl(vol->device, CDROMREADTOCENTRY, &toc) == 0) {
+    vol->Geometry.TocOK = true;
+    vol->Geometry.TocLeadOut = toc.cdte_addr.lba;
+  }
+
+  if (vol->Geometry.WholeDisk || vol->Geometry.SgDevice) {
+    ProbeCdb(&probes[0], 0x12, 6, vol->Geometry.Inquiry, 44, &vol->Geometry.InquiryOK);
+    probes[0].Cdb[4] = 44;                         // INQUIRY
+    ProbeCdb(&probes[1], 0x25, 10, vol->Geometry.ReadCap, 8, &vol->Geometry.ReadCapOK);
+    ProbeCdb(&probes[2], 0x5a, 10, vol->Geometry.ModeSense, 16, &vol->Geometry.ModeSenseOK);
+    probes[2].Cdb[8] = 16;                         // MODE SENSE header + block descriptor
+    RunProbes(vol, probes, 3);
+
+    if (vol->Geometry.InquiryOK && ((vol->Geometry.Inquiry[0] & 0x1f) == 5)) {
+      ProbeTracks(vol);
+    }
+  }
+
+  // Block devices only need guessing if the SCSI queries didn't settle it
+  if (!vol->Geometry.InquiryOK && !vol->Geometry.SgDevice) {
+    ProbeAnchors(vol);
+  }
+}
+
+/*
+ * Guess the sector size from the anchor candidates. Returns 0 if no anchor
+ * was found at any size.
+ */
+uint32_t GuessSectorSize(udf_volume *vol)
+{
+  uint32_t size, savedSecsize;
+  int i;
+  bool found = false;
+
+  if (!vol->Geometry.GuessProbed) {
+    ProbeAnchors(vol);
+  }
+
+  // CheckTag() validates against the volume's secsize
+  savedSecsize = vol->secsize;
+  for (i = 0; (i < GEOM_GUESS_SIZES) && !found; i++) {
+    if (!vol->Geometry.GuessOK[i]) {
+      continue;
+    }
+    size = GEOM_MIN_SECTOR_SIZE << i;
+    vol->secsize = size;
+    found = !CheckTag(vol, (struct tag *)vol->Geometry.Guess[i], 256, 2, 0, MAX_SECTOR_SIZE);
+    ClearError(vol);
+    if (!found) {
+      found = !CheckTag(vol, (struct tag *)vol->Geometry.Guess[i], 512, 2, 0, MAX_SECTOR_SIZE);
+      ClearError(vol);
+      if (found) {
+        size >>= 1;
+      }
+    }
+  }
+  vol->secsize = savedSecsize;
+
+  return found ? size : 0;
+}
+
+void FreeGeometry(udf_volume *vol)
+{
+  int i;
+
+  for (i = 0; i < GEOM_GUESS_SIZES; i++) {
+    free(vol->Geometry.Guess[i]);
+  }
+  memset(&vol->Geometry, 0, sizeof(vol->Geometry));
+}
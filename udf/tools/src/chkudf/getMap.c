@@ -13,7 +13,7 @@
  * sparing table is in memory identified by the Part_Info[n].Extra pointer.
  */
 
-void GetMap(void)
+void GetMap(udf_volume *vol)
 {
   struct SparingTable *Spare;
   uint16_t  SP;
@@ -22,62 +22,70 @@ void GetMap(void)
 
   SP = 0;
   found = false;
-  for (i = 0; (i < PTN_no) && !found; i++) {
-    if (Part_Info[i].type == PTN_TYP_SPARE) {
+  for (i = 0; (i < vol->PTN_no) && !found; i++) {
+    if (vol->Part_Info[i].type == PTN_TYP_SPARE) {
       SP = i;
       found = true;
     }
   }
 
   if (found) {
-    PM_ST = (struct _sST_desc *)Part_Info[SP].Extra;
+    PM_ST = (struct _sST_desc *)vol->Part_Info[SP].Extra;
     if (PM_ST) {
       PM_ST->Map = NULL;
-      printf("\n--Partition Reference %u is sparable, reading sparing maps.\n", SP);
+      fprintf(vol->Out, "\n--Partition Reference %u is sparable, reading sparing maps.\n", SP);
 
-      Spare = (struct SparingTable *)malloc(PM_ST->Size + secsize);
+      Spare = (struct SparingTable *)malloc(PM_ST->Size + vol->secsize);
       if (Spare) {
-        uint32_t num_sectors = (PM_ST->Size + secsize - 1) >> sdivshift;
-        if (!ReadSectors(Spare, PM_ST->Location[0], num_sectors)) {
-          track_volspace(PM_ST->Location[0], num_sectors,
+        uint32_t num_sectors = (PM_ST->Size + vol->secsize - 1) >> vol->sdivshift;
+        if (!ReadSectors(vol, Spare, PM_ST->Location[0], num_sectors)) {
+          track_volspace(vol, PM_ST->Location[0], num_sectors,
                          "Sparing Table");
   
-          CheckTag((struct tag *)Spare, PM_ST->Location[0], TAGID_NONE, 0, 16384);
-          if (!Error.Code) {
-            printf("  Sparing table candidate found\n");
+          CheckTag(vol, (struct tag *)Spare, PM_ST->Location[0], TAGID_NONE, 0, 16384);
+          if (!CurrentError(vol)->Code) {
+            fprintf(vol->Out, "  Sparing table candidate found\n");
             if (!CheckRegid(&Spare->sEntityId, E_REGID_SPARE)) {
-              printf("  Structure is a sparing table.\n");
-              printf("  Sparing Table contains %u entries.\n", Spare->uRT_L);
-              printf("  Sparing sequence %u.\n", Spare->uSequence);
+              fprintf(vol->Out, "  Structure is a sparing table.\n");
+              fprintf(vol->Out, "  Sparing Table contains %u entries.\n", Spare->uRT_L);
+              fprintf(vol->Out, "  Sparing sequence %u.\n", Spare->uSequence);
               PM_ST->Map = (struct _sMap_Entry *)malloc(Spare->uRT_L * 8);
               if (PM_ST->Map) {
                 PM_ST->Size = Spare->uRT_L;
                 memcpy(PM_ST->Map, Spare + 1, PM_ST->Size * 8);
               } else {
-                printf("**No memory for Sparing Table. Future reads may be from the wrong place.\n");
-                Error.Code = ERR_NOMAPMEM;
-                Error.Sector = PM_ST->Location[0];
+                fprintf(vol->Out, "**No memory for Sparing Table. Future reads may be from the wrong place.\n");
+                SetError(vol, ERR_NOMAPMEM, PM_ST->Location[0], 0, 0);
               }
-              for (i = 0; i < PM_ST->Size; i++) {
-                track_volspace(PM_ST->Map[i].Mapped, PM_ST->Extent,
-                               "Set aside for sparing");
-                printf("  %08x -> %08x\n", PM_ST->Map[i].Original, PM_ST->Map[i].Mapped);
+              if (PM_ST->Map) {
+                uint32_t *mapped = malloc(PM_ST->Size * sizeof(uint32_t));
+                if (mapped) {
+                  for (i = 0; i < PM_ST->Size; i++) {
+                    mapped[i] = PM_ST->Map[i].Mapped;
+                  }
+                  track_volspace_bulk(vol, mapped, PM_ST->Size, PM_ST->Extent,
+                                      "Set aside for sparing");
+                  free(mapped);
+                } else {
+                  OperationalError(vol, "**Couldn't allocate memory to track sparing packets.\n");
+                }
+                for (i = 0; i < PM_ST->Size; i++) {
+                  Verbose(vol, "  %08x -> %08x\n", PM_ST->Map[i].Original, PM_ST->Map[i].Mapped);
+                }
               }
             } else {
-              printf("**Bad Sparing Table. Future reads may be from the wrong place.\n");
-              Error.Code = ERR_NO_MAP;
-              Error.Sector = PM_ST->Location[0];
+              fprintf(vol->Out, "**Bad Sparing Table. Future reads may be from the wrong place.\n");
+              SetError(vol, ERR_NO_MAP, PM_ST->Location[0], 0, 0);
             }
           }
         } else {
-          printf("**Couldn't read Sparing Table. Future reads may be from the wrong place.\n");
-          Error.Code = ERR_NO_MAP;
-          Error.Sector = PM_ST->Location[0];
+          fprintf(vol->Out, "**Couldn't read Sparing Table. Future reads may be from the wrong place.\n");
+          SetError(vol, ERR_NO_MAP, PM_ST->Location[0], 0, 0);
         }
         free(Spare);
       }
     } else {
-      printf("**Couldn't allocate memory for Sparing Partition Map Entry.\n");
+      fprintf(vol->Out, "**Couldn't allocate memory for Sparing Partition Map Entry.\n");
     }
   } 
 }
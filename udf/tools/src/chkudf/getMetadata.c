@@ -0,0 +1,527 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (c) 2026 Steve Magnani. All rights reserved.
+
+#include "nsr.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "chkudf.h"
+#include "protos.h"
+
+/*
+ * Metadata Partition support (UDF 2.50 and later).
+ *
+ * The blocks of a metadata partition are the blocks of the Metadata File,
+ * which lives in the physical partition. Since every ICB and directory of
+ * the file set is in there, the whole file is read into memory up front -
+ * one read per extent, all issued together - and the directory walk is
+ * then served from memory (see CachePBlocks).
+ *
+ * The Mirror File stands in for the Metadata File if that can't be read,
+ * and is otherwise compared against it as it is read.
+ */
+
+typedef struct _sMetaFile {
+    const char  *Name;
+    uint32_t     ICBLoc;
+    uint32_t     NumBlocks;     // From the information length
+    sMetaExtent *Extents;
+    uint32_t     NumExtents;
+    uint32_t     ExtentsAlloc;
+    uint8_t     *Data;          // NumBlocks blocks, once read
+} sMetaFile;
+
+static bool AddMetaExtent(sMetaFile *file, uint32_t location, uint32_t numBlocks, bool recorded)
+{
+  if (file->NumExtents >= file->ExtentsAlloc) {
+    uint32_t newAlloc = file->ExtentsAlloc ? file->ExtentsAlloc * 2 : 8;
+    sMetaExtent *larger = realloc(file->Extents, newAlloc * sizeof(sMetaExtent));
+    if (!larger) {
+      return false;
+    }
+    file->Extents = larger;
+    file->ExtentsAlloc = newAlloc;
+  }
+
+  file->Extents[file->NumExtents].Location = location;
+  file->Extents[file->NumExtents].NumBlocks = numBlocks;
+  file->Extents[file->NumExtents].Recorded = recorded;
+  file->NumExtents++;
+  return true;
+}
+
+static void FreeMetaFile(sMetaFile *file)
+{
+  free(file->Extents);
+  free(file->Data);
+  file->Extents = NULL;
+  file->Data = NULL;
+}
+
+/*
+ * Read the File Entry of a metadata file and collect its extents. The
+ * blocks of the File Entry and of any Allocation Extent Descriptors are
+ * tracked as in use; the extents themselves are not (see TrackMetaFile).
+ */
+static bool GetMetaFileExtents(udf_volume *vol, uint16_t physRef, uint8_t fileType,
+                               sMetaFile *file)
+{
+  struct FE_or_EFE *xFE;
+  sADIter   iter;
+  sADExtent extent;
+  uint64_t infoLength;
+  uint32_t L_EA, L_AD, extentBlocks = 0;
+  size_t   hdrSize;
+  bool     ok = false;
+
+  xFE = malloc(vol->blocksize);
+  if (!xFE) {
+    OperationalError(vol, "**Couldn't allocate memory for the %s ICB.\n", file->Name);
+    return false;
+  }
+
+  do {
+    if (ReadLBlocks(vol, xFE, file->ICBLoc, physRef, 1)) {
+      SetError(vol, ERR_READ, file->ICBLoc, 0, 0);
+      DumpError(vol);
+      break;
+    }
+    track_filespace(vol, physRef, file->ICBLoc, vol->blocksize);
+
+    if (CheckTag(vol, (struct tag *)xFE, file->ICBLoc, TAGID_EXT_FILE_ENTRY, 16, vol->blocksize)
+        < CHECKTAG_OK_LIMIT) {
+      hdrSize = sizeof(struct ExtFileEntry);
+      L_EA = U_endian32(xFE->EFE.L_EA);
+      L_AD = U_endian32(xFE->EFE.L_AD);
+    } else {
+      ClearError(vol);
+      if (CheckTag(vol, (struct tag *)xFE, file->ICBLoc, TAGID_FILE_ENTRY, 16, vol->blocksize)
+          >= CHECKTAG_OK_LIMIT) {
+        UDFError(vol, "**The %s ICB is not a File Entry.\n", file->Name);
+        DumpError(vol);
+        break;
+      }
+      hdrSize = sizeof(struct FileEntry);
+      L_EA = U_endian32(xFE->FE.L_EA);
+      L_AD = U_endian32(xFE->FE.L_AD);
+    }
+    DumpError(vol);
+    NoteSystemICB(vol, physRef, file->ICBLoc);   // No FID identifies it
+
+    if (xFE->sICBTag.FileType != fileType) {
+      UDFError(vol, "**The %s has file type %u, expected %u.\n", file->Name,
+               xFE->sICBTag.FileType, fileType);
+    }
+    if ((U_endian16(xFE->sICBTag.Flags) & ADTYPEMASK) != ADSHORT) {
+      UDFError(vol, "**The %s uses allocation descriptor type %u; only short_ad is allowed.\n",
+               file->Name, U_endian16(xFE->sICBTag.Flags) & ADTYPEMASK);
+      break;
+    }
+    if ((hdrSize + L_EA + L_AD) > vol->blocksize) {
+      UDFError(vol, "**The %s ICB has %u bytes of extended attributes and %u of "
+               "allocation descriptors.\n", file->Name, L_EA, L_AD);
+      break;
+    }
+
+    // The Bitmap File is as long as its descriptor; the others are whole blocks
+    infoLength = U_endian64(xFE->InfoLength);
+    if ((fileType != FILE_TYPE_METADATA_BITMAP) && (infoLength & (vol->blocksize - 1))) {
+      UDFError(vol, "**The %s is %llu bytes long, not a whole number of blocks.\n",
+               file->Name, (unsigned long long) infoLength);
+    }
+    infoLength = (infoLength + vol->blocksize - 1) >> vol->bdivshift;
+    if (infoLength > vol->Part_Info[physRef].Len) {
+      UDFError(vol, "**The %s is %llu blocks long, more than its partition holds.\n",
+               file->Name, (unsigned long long) infoLength);
+      break;
+    }
+    file->NumBlocks = (uint32_t) infoLength;
+
+    ok = true;
+    ADIterInit(vol, &iter, xFE, physRef);
+    while (ok && ADIterNext(vol, &iter, &extent)) {
+      uint32_t numBlocks = (extent.Length + vol->blocksize - 1) >> vol->bdivshift;
+
+      switch (extent.Type) {
+        case E_RECORDED:
+          ok = AddMetaExtent(file, extent.Location, numBlocks, true);
+          extentBlocks += numBlocks;
+          break;
+
+        case E_ALLOCATED:
+          ok = AddMetaExtent(file, extent.Location, numBlocks, false);
+          extentBlocks += numBlocks;
+          break;
+
+        case E_UNALLOCATED:
+          ok = AddMetaExtent(file, (uint32_t) -1, numBlocks, false);
+          extentBlocks += numBlocks;
+          break;
+
+        case E_ALLOCEXTENT:
+          track_filespace(vol, physRef, extent.Location, vol->blocksize);
+          break;
+
+        // No other cases, this is just to avoid a "missing default" warning
+        default:
+          break;
+      }
+    }
+    if (iter.Failed) {
+      ok = false;
+    }
+    ADIterFree(&iter);
+
+    if (ok && (extentBlocks < file->NumBlocks)) {
+      UDFError(vol, "**The %s is %u blocks long but its extents hold only %u.\n",
+               file->Name, file->NumBlocks, extentBlocks);
+      file->NumBlocks = extentBlocks;
+    }
+  } while (0);
+
+  free(xFE);
+  return ok;
+}
+
+/*
+ * Track the space used by the extents of a metadata file.
+ */
+static void TrackMetaFile(udf_volume *vol, uint16_t physRef, const sMetaFile *file)
+{
+  uint32_t i;
+
+  for (i = 0; i < file->NumExtents; i++) {
+    if (file->Extents[i].Location != (uint32_t) -1) {
+      track_filespace(vol, physRef, file->Extents[i].Location,
+                      file->Extents[i].NumBlocks << vol->bdivshift);
+    }
+  }
+}
+
+/*
+ * Read numBlocks blocks of a metadata file, starting at block firstBlock,
+ * into buffer. On a real partition each piece of an extent is a single
+ * request, and all are issued together; otherwise blocks may need
+ * remapping, so ReadLBlocks does it. Unrecorded blocks read as zeros.
+ * Returns the number of blocks that couldn't be read.
+ */
+static uint32_t ReadMetaBlocks(udf_volume *vol, uint16_t physRef, const sMetaFile *file,
+                               uint32_t firstBlock, uint32_t numBlocks, uint8_t *buffer)
+{
+  sPart_Info   *part = vol->Part_Info + physRef;
+  sReadRequest *requests;
+  uint32_t      numRequests = 0, numFailed = 0, extentStart = 0;
+  uint32_t      endBlock = firstBlock + numBlocks;
+  uint32_t      i;
+
+  requests = calloc(MAX(file->NumExtents, 1), sizeof(sReadRequest));
+  if (!requests) {
+    OperationalError(vol, "**Couldn't allocate memory to read the %s.\n", file->Name);
+    return numBlocks;
+  }
+
+  for (i = 0; (i < file->NumExtents) && (extentStart < endBlock); i++) {
+    const sMetaExtent *extent = file->Extents + i;
+    uint32_t extentEnd = extentStart + extent->NumBlocks;
+    uint32_t pieceStart = MAX(extentStart, firstBlock);
+    uint32_t pieceEnd = MIN(extentEnd, endBlock);
+    uint32_t location = extent->Location + (pieceStart - extentStart);
+    uint32_t pieceBlocks = pieceEnd - pieceStart;
+    uint8_t *pieceBuffer = buffer + ((size_t) (pieceStart - firstBlock) << vol->bdivshift);
+
+    extentStart = extentEnd;
+    if (pieceStart >= pieceEnd) {
+      continue;
+    }
+
+    if (!extent->Recorded) {
+      memset(pieceBuffer, 0, (size_t) pieceBlocks << vol->bdivshift);
+    } else if ((location >= part->Len) || (pieceBlocks > part->Len - location)) {
+      numFailed += pieceBlocks;
+    } else if (part->type == PTN_TYP_REAL) {
+      requests[numRequests].Offset =
+        (uint64_t) (part->Offs + location * vol->s_per_b) << vol->sdivshift;
+      requests[numRequests].Length = pieceBlocks << vol->bdivshift;
+      requests[numRequests].Buffer = pieceBuffer;
+      numRequests++;
+    } else if (ReadLBlocks(vol, pieceBuffer, location, physRef, pieceBlocks)) {
+      numFailed += pieceBlocks;
+    }
+  }
+
+  ReadBatch(vol, requests, numRequests);
+  for (i = 0; i < numRequests; i++) {
+    if (!requests[i].OK) {
+      numFailed += requests[i].Length >> vol->bdivshift;
+    }
+  }
+  free(requests);
+
+  return numFailed;
+}
+
+/*
+ * Read the whole of a metadata file into memory.
+ */
+static bool ReadMetaFile(udf_volume *vol, uint16_t physRef, sMetaFile *file)
+{
+  uint32_t numFailed;
+
+  file->Data = calloc(MAX(file->NumBlocks, 1), vol->blocksize);
+  if (!file->Data) {
+    OperationalError(vol, "**Couldn't allocate memory for the %u blocks of the %s.\n",
+                     file->NumBlocks, file->Name);
+    return false;
+  }
+
+  numFailed = ReadMetaBlocks(vol, physRef, file, 0, file->NumBlocks, file->Data);
+
+  Verbose(vol, "  Read the %s: %u blocks in %u extent(s).\n", file->Name, file->NumBlocks,
+          file->NumExtents);
+  if (numFailed) {
+    OperationalError(vol, "**Couldn't read %u of the %u blocks of the %s.\n", numFailed,
+                     file->NumBlocks, file->Name);
+    return false;
+  }
+  return true;
+}
+
+static bool SameMetaExtents(const sMetaFile *a, const sMetaFile *b)
+{
+  uint32_t i;
+
+  if (a->NumExtents != b->NumExtents) {
+    return false;
+  }
+  for (i = 0; i < a->NumExtents; i++) {
+    if (   (a->Extents[i].Location != b->Extents[i].Location)
+        || (a->Extents[i].NumBlocks != b->Extents[i].NumBlocks)
+        || (a->Extents[i].Recorded != b->Extents[i].Recorded)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Compare the Mirror File with the Metadata File, which is already in
+ * memory. The mirror is streamed through a buffer of META_COMPARE_SIZE
+ * bytes rather than held in full. Blocks are compared by digest; only
+ * when digests differ are the bytes compared, to find the first one that
+ * differs.
+ */
+static void CompareMetaFiles(udf_volume *vol, uint16_t physRef, const sMetaFile *metadata,
+                             const sMetaFile *mirror)
+{
+  uint32_t numBlocks = MIN(metadata->NumBlocks, mirror->NumBlocks);
+  uint32_t chunkBlocks = MAX(META_COMPARE_SIZE >> vol->bdivshift, 1);
+  uint32_t numDiffer = 0, numUnread = 0, firstDiffer = 0, firstOffset = 0;
+  uint32_t block, chunkFailed, i;
+  uint8_t *chunk;
+
+  if (metadata->NumBlocks != mirror->NumBlocks) {
+    UDFError(vol, "**The Metadata File is %u blocks long, the Mirror File %u.\n",
+             metadata->NumBlocks, mirror->NumBlocks);
+  }
+
+  chunkBlocks = MIN(chunkBlocks, MAX(numBlocks, 1));
+  chunk = malloc((size_t) chunkBlocks << vol->bdivshift);
+  if (!chunk) {
+    OperationalError(vol, "**Couldn't allocate memory to compare the Mirror File.\n");
+    return;
+  }
+
+  for (block = 0; block < numBlocks; block += chunkBlocks) {
+    uint32_t count = MIN(chunkBlocks, numBlocks - block);
+
+    chunkFailed = ReadMetaBlocks(vol, physRef, mirror, block, count, chunk);
+    if (chunkFailed) {
+      numUnread += chunkFailed;   // Which blocks isn't known, so compare none of them
+      continue;
+    }
+
+    for (i = 0; i < count; i++) {
+      const uint8_t *mirrorBlock = chunk + ((size_t) i << vol->bdivshift);
+      const uint8_t *metaBlock = metadata->Data + ((size_t) (block + i) << vol->bdivshift);
+      uint32_t offset;
+
+      if (BlockDigest(mirrorBlock, vol->blocksize) == BlockDigest(metaBlock, vol->blocksize)) {
+        continue;
+      }
+      for (offset = 0; (offset < vol->blocksize) && (mirrorBlock[offset] == metaBlock[offset]);
+           offset++) {
+      }
+      if (offset < vol->blocksize) {
+        if (!numDiffer++) {
+          firstDiffer = block + i;
+          firstOffset = offset;
+        }
+      }
+    }
+  }
+  free(chunk);
+
+  Verbose(vol, "  Compared the Mirror File: %u blocks in %u extent(s).\n", numBlocks,
+          mirror->NumExtents);
+  if (numUnread) {
+    OperationalError(vol, "**Couldn't read %u of the %u blocks of the %s.\n", numUnread,
+                     mirror->NumBlocks, mirror->Name);
+  }
+  if (numDiffer) {
+    UDFError(vol, "**The Mirror File differs from the Metadata File in %u block%s, "
+             "first at block %u byte %u.\n", numDiffer, (numDiffer == 1) ? "" : "s",
+             firstDiffer, firstOffset);
+  } else if (!numUnread) {
+    Verbose(vol, "  The Mirror File matches the Metadata File.\n");
+  }
+}
+
+/*
+ * Read the Metadata Bitmap File, which holds the space map of the metadata
+ * partition.
+ */
+static void GetMetaBitmap(udf_volume *vol, uint16_t metaRef, uint16_t physRef, uint32_t icbLoc)
+{
+  sPart_Info *part = vol->Part_Info + metaRef;
+  sMetaFile bitmap;
+  uint32_t mapBytes = BITMAP_NUM_BYTES(part->Len);
+
+  memset(&bitmap, 0, sizeof(bitmap));
+  bitmap.Name = "Bitmap File";
+  bitmap.ICBLoc = icbLoc;
+
+  if (GetMetaFileExtents(vol, physRef, FILE_TYPE_METADATA_BITMAP, &bitmap)) {
+    TrackMetaFile(vol, physRef, &bitmap);
+    if (!bitmap.NumExtents || !bitmap.NumBlocks || !bitmap.Extents[0].Recorded) {
+      UDFError(vol, "**The Bitmap File has no recorded data.\n");
+    } else if (ReadMetaFile(vol, physRef, &bitmap)) {
+      part->SpMap = malloc(mapBytes);
+      if (part->SpMap) {
+        // Fill in case of underread
+        memset(part->SpMap, 0xff, mapBytes - 1);
+        part->SpMap[mapBytes - 1] = part->FinalMapByteMask;
+        LoadSpaceBitmap(vol, metaRef, (struct SpaceBitmapHdr *)bitmap.Data,
+                        bitmap.Extents[0].Location, bitmap.NumBlocks << vol->bdivshift);
+      }
+    }
+  }
+  FreeMetaFile(&bitmap);
+}
+
+/*
+ * Read the Metadata File of each metadata partition.
+ */
+void GetMetadata(udf_volume *vol)
+{
+  sMetaFile  metadata, mirror;
+  sMetaFile *source;
+  sMeta_desc *PM_MD;
+  uint16_t   i, physRef;
+  bool       metadataOK, mirrorOK;
+
+  for (i = 0; i < vol->PTN_no; i++) {
+    if ((vol->Part_Info[i].type != PTN_TYP_METADATA) || !vol->Part_Info[i].Extra) {
+      continue;
+    }
+    PM_MD = (sMeta_desc *)vol->Part_Info[i].Extra;
+
+    physRef = FindPhysicalPartition(vol, vol->Part_Info[i].Num);
+    if (physRef >= vol->PTN_no) {
+      UDFError(vol, "**Partition reference %u has no physical partition %u to be part of.\n",
+               i, vol->Part_Info[i].Num);
+      vol->Fatal = true;
+      continue;
+    }
+    PM_MD->PhysRef = physRef;
+
+    fprintf(vol->Out, "\n--Partition Reference %u is a metadata partition, reading the Metadata File.\n", i);
+
+    memset(&metadata, 0, sizeof(metadata));
+    metadata.Name = "Metadata File";
+    metadata.ICBLoc = PM_MD->FileLoc;
+    memset(&mirror, 0, sizeof(mirror));
+    mirror.Name = "Mirror File";
+    mirror.ICBLoc = PM_MD->MirrorLoc;
+
+    metadataOK = GetMetaFileExtents(vol, physRef, FILE_TYPE_METADATA, &metadata);
+    if (metadataOK) {
+      TrackMetaFile(vol, physRef, &metadata);
+      metadataOK = ReadMetaFile(vol, physRef, &metadata);
+    }
+
+    mirrorOK = GetMetaFileExtents(vol, physRef, FILE_TYPE_METADATA_MIRROR, &mirror);
+    if (mirrorOK && metadata.NumExtents && SameMetaExtents(&metadata, &mirror)) {
+      if (PM_MD->Flags & META_FLAG_DUPLICATE) {
+        UDFError(vol, "**Metadata is marked as duplicated, but the Mirror File shares "
+                 "the Metadata File's blocks.\n");
+      }
+      mirrorOK = false;     // Nothing more to be learned from it
+    } else if (mirrorOK) {
+      TrackMetaFile(vol, physRef, &mirror);
+      if (metadataOK) {
+        CompareMetaFiles(vol, physRef, &metadata, &mirror);
+        mirrorOK = false;   // Not needed in memory
+      } else {
+        mirrorOK = ReadMetaFile(vol, physRef, &mirror);
+      }
+    }
+
+    source = &metadata;
+    if (mirrorOK) {
+      fprintf(vol->Out, "  Using the Mirror File in place of the Metadata File.\n");
+      source = &mirror;
+    } else if (!metadataOK) {
+      UDFError(vol, "**Neither the Metadata File nor its Mirror File could be read.\n");
+      vol->Fatal = true;
+    }
+
+    if (!vol->Fatal) {
+      sPart_Info *part = vol->Part_Info + i;
+      uint32_t mapBytes;
+
+      PM_MD->Blocks = source->Data;
+      PM_MD->NumBlocks = source->NumBlocks;
+      PM_MD->Extents = source->Extents;
+      PM_MD->NumExtents = source->NumExtents;
+      source->Data = NULL;
+      source->Extents = NULL;
+
+      part->Len = PM_MD->NumBlocks;
+      part->FinalMapByteMask = (part->Len & 7) ? (0xFF >> (8 - (part->Len & 7))) : 0xFF;
+      mapBytes = BITMAP_NUM_BYTES(part->Len);
+      if (mapBytes) {
+        part->MyMap = malloc(mapBytes);
+        if (part->MyMap) {
+          memset(part->MyMap, 0xff, mapBytes - 1);
+          part->MyMap[mapBytes - 1] = part->FinalMapByteMask;
+        }
+        if (PM_MD->BitmapLoc != (uint32_t) -1) {
+          GetMetaBitmap(vol, i, physRef, PM_MD->BitmapLoc);
+        }
+      }
+      fprintf(vol->Out, "  Metadata partition is %u blocks long.\n", part->Len);
+    }
+
+    FreeMetaFile(&metadata);
+    FreeMetaFile(&mirror);
+  }
+}
+
+/*
+ * Return where a block of a metadata partition is recorded in its physical
+ * partition, or -1 if it is not recorded.
+ */
+uint32_t MetaBlockLocation(const sMeta_desc *PM_MD, uint32_t block)
+{
+  uint32_t i;
+
+  for (i = 0; i < PM_MD->NumExtents; i++) {
+    const sMetaExtent *extent = PM_MD->Extents + i;
+
+    if (block < extent->NumBlocks) {
+      return extent->Recorded ? extent->Location + block : (uint32_t) -1;
+    }
+    block -= extent->NumBlocks;
+  }
+  return (uint32_t) -1;
+}
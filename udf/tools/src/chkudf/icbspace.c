@@ -10,8 +10,8 @@
 #include "protos.h"
 
 // Forward declarations
-static bool set_true_unique_id(sICB_trk *pICBinfo, uint64_t uniqueID);
-static bool link_icb(sICB_trk *pICBinfo, uint32_t uniqueID_L);
+static bool set_true_unique_id(udf_volume *vol, uint32_t icb, uint64_t uniqueID);
+static bool link_icb(udf_volume *vol, uint32_t icb, uint32_t uniqueID_L);
 
 /* 
  * returns 1 if address 1 is greater than address 2, -1 if less than, and
@@ -28,156 +28,98 @@ int compare_address(uint16_t ptn1, uint16_t ptn2, uint32_t addr1, uint32_t addr2
 }
 
 /*
- * The following routine takes a File Entry as input and tracks the space
- * used by the file data and by the Extended Attributes of that file.
+ * The following routine takes a File Entry, recorded at block icbLoc of
+ * partition reference ptn, as input and tracks the space used by the file
+ * data and by the Extended Attributes of that file.
  */
-int track_file_allocation(const struct FE_or_EFE *xFE, uint16_t ptn)
+int track_file_allocation(udf_volume *vol, const struct FE_or_EFE *xFE, uint16_t ptn,
+                          uint32_t icbLoc)
 {
   uint64_t file_length;
   uint64_t infoLength;
-  int    error, sizeAD;
-  struct long_ad *lad;
-  struct short_ad *sad;
-  struct AllocationExtentDesc *AED = NULL; 
-  uint16_t ADlength;
-  uint32_t Location_AEDP, ad_offset;
-  uint32_t L_EA, L_AD;
-  size_t   xfe_hdr_sz;
-  uint8_t *ad_start;
-  bool     isLAD;
-
-  ad_offset = 0;   //Offset into the allocation descriptors
+  int    error = 0;
+  uint16_t adtype;
+  uint32_t L_AD, i;
+  const sADSummary *summary;
 
   infoLength = U_endian64(xFE->InfoLength);
   if (U_endian16(xFE->sTag.uTagID) == TAGID_EXT_FILE_ENTRY) {
-    xfe_hdr_sz = sizeof(struct ExtFileEntry);
-    L_EA = U_endian32(xFE->EFE.L_EA);
     L_AD = U_endian32(xFE->EFE.L_AD);
   } else {
-    xfe_hdr_sz = sizeof(struct FileEntry);
-    L_EA = U_endian32(xFE->FE.L_EA);
     L_AD = U_endian32(xFE->FE.L_AD);
   }
 
-  ADlength = L_AD;
-  switch(U_endian16(xFE->sICBTag.Flags) & ADTYPEMASK) {
+  adtype = U_endian16(xFE->sICBTag.Flags) & ADTYPEMASK;
+  switch(adtype) {
     case ADSHORT:
     case ADLONG:
-      isLAD = (U_endian16(xFE->sICBTag.Flags) & ADTYPEMASK) == ADLONG;
-      sizeAD = isLAD ?  sizeof(struct long_ad) : sizeof(struct short_ad);
+    case ADEXTENDED:
       file_length = 0;
-      ad_start = ((uint8_t *) xFE) + xfe_hdr_sz + L_EA;
-      Debug("\n  [type=%s, ADlength=%u, info_length=%" PRIu64 "]  ",
-            isLAD ? "LONG" : "SHORT", ADlength, infoLength);
-      while (ad_offset < ADlength) {
-        uint32_t curExtentLength;
-        sad = (struct short_ad *)(ad_start + ad_offset);
-        lad = (struct long_ad *)(ad_start + ad_offset);
-
-        // Note, since long_ad is a superset of short_ad this is valid for both
-        curExtentLength = EXTENT_LENGTH(sad->ExtentLengthAndType);
-        if (isLAD) {
-          ptn = U_endian16(lad->Location_PartNo);
+      Debug(vol, "\n  [type=%s, ADlength=%u, info_length=%" PRIu64 "]  ",
+            (adtype == ADLONG) ? "LONG" : (adtype == ADEXTENDED) ? "EXTENDED" : "SHORT",
+            L_AD, infoLength);
+      summary = GetADSummary(vol, xFE, ptn, icbLoc);
+      for (i = 0; i < summary->NumExtents; i++) {
+        const sADExtent *extent = summary->Extents + i;
+
+        Debug(vol, "\n    [ad_offset=%u, atype=%d, loc=%u, len=%u, file_length=%" PRIu64 "]  ",
+               extent->DescOffset, extent->Type, extent->Location, extent->Length, file_length);
+        switch(extent->Type) {
+          case E_RECORDED:
+          case E_ALLOCATED:
+            if (extent->RecordedLength > extent->Length) {
+              UDFError(vol, " **(RECORDED LENGTH %u > EXTENT LENGTH)", extent->RecordedLength);
+            }
+            track_filespace(vol, extent->Ptn, extent->Location, extent->Length);
+            // @todo If extent is invalid (i.e. huge length) we may continue on
+            //       for quite a bit even though we've left the tracks
+            if (file_length >= infoLength) {
+              Debug(vol, " (Tail)");
+            } else {
+              file_length += extent->InfoLength;
+            }
+            break;
+
+          case E_UNALLOCATED:
+            if (file_length >= infoLength) {
+              UDFError(vol, " **(ILLEGAL TAIL)");
+            } else {
+              file_length += extent->InfoLength;
+            }
+            Debug(vol, " --Unallocated Extent--");
+            break;
+
+          case E_ALLOCEXTENT:
+            track_filespace(vol, extent->Ptn, extent->Location, extent->Length);
+            break;
+
+          // No other cases, this is just to avoid a "missing default" warning
+          default:
+            break;
         }
-        Debug("\n    [ad_offset=%u, atype=%d, loc=%u, len=%u, file_length=%" PRIu64 "]  ",
-               ad_offset,
-               EXTENT_TYPE(sad->ExtentLengthAndType),
-               U_endian32(sad->Location),
-               curExtentLength,
-               file_length);
-        if (curExtentLength == 0) {
-          // Zero-length extent - force loop exit
-          break;
-        } else {
-          switch(EXTENT_TYPE(sad->ExtentLengthAndType)) {
-            case E_RECORDED:
-            case E_ALLOCATED:
-              track_filespace(ptn, U_endian32(sad->Location), curExtentLength);
-              // @todo If extent is invalid (i.e. huge length) we may continue on
-              //       for quite a bit even though we've left the tracks
-              if (file_length >= infoLength) {
-                Debug(" (Tail)");
-              } else {
-                file_length += curExtentLength;
-              }
-              ad_offset += sizeAD;
-              break;
-
-            case E_UNALLOCATED:
-              if (file_length >= infoLength) {
-                UDFError(" **(ILLEGAL TAIL)");
-              } else {
-                file_length += curExtentLength;
-              }
-              ad_offset += sizeAD;
-              Debug(" --Unallocated Extent--");
-              break;
-
-            case E_ALLOCEXTENT:
-              track_filespace(ptn, U_endian32(sad->Location), curExtentLength);
-              if (!AED) {
-                AED = (struct AllocationExtentDesc *)malloc(blocksize);
-              }
-              if (AED) {
-                Location_AEDP = U_endian32(sad->Location);
-                error = ReadLBlocks(AED, Location_AEDP, ptn, 1);
-                if (!error) {
-                  error = CheckTag((struct tag *)AED, Location_AEDP, TAGID_ALLOC_EXTENT, 8, blocksize - 16);
-                }
-              } else {
-                error = 1;
-              }
-              if (error) {
-                Debug("Error=%d, Error.Code=%d\n", error, Error.Code);
-                DumpError();
-              }
-              if (error == 2) {
-                if (U_endian32(AED->sTag.uTagLoc) == 0xffffffff) {
-                  error = 0;
-                  Error.Code = 0;
-                } else {
-                  DumpError();
-                  error = 0;
-                }
-              }
-              if (!error) {
-                ad_start = (uint8_t *)(AED + 1);
-                ADlength = U_endian32(AED->L_AD);
-                ad_offset = 0;
-              } else {
-                ad_offset = ADlength;
-              }
-              Debug("\n      [NEW ADlength=%u]  ", ADlength);
-              break;
-
-            // No other cases, this is just to avoid a "missing default" warning
-            default:
-              break;
-          }
-        }  // curExtentLength != 0
-      }    // while (ad_offset < ADlength)
-      printf("  [file_length=%" PRIu64 "]  ", file_length);
+      }
+      if (summary->Failed) {
+        error = 1;
+      }
+      fprintf(vol->Out, "  [file_length=%" PRIu64 "]  ", file_length);
       if (file_length != infoLength) {
-        if (((infoLength + blocksize - 1) & ~(blocksize - 1)) == file_length) {
-          printf(" **ADs rounded up");
+        if (((infoLength + vol->blocksize - 1) & ~(vol->blocksize - 1)) == file_length) {
+          fprintf(vol->Out, " **ADs rounded up");
         } else {
-          Error.Code = ERR_BAD_AD;
-          Error.Sector = U_endian32(xFE->sTag.uTagLoc);
-          Error.Expected = infoLength;
-          Error.Found = file_length;
+          SetError(vol, ERR_BAD_AD, U_endian32(xFE->sTag.uTagLoc), infoLength, file_length);
         }
       }
-      free (AED);
       break;
 
     case ADNONE:
       if (U_endian64(xFE->InfoLength) != L_AD) {
-        Error.Code = ERR_BAD_AD;
-        Error.Sector = U_endian32(xFE->sTag.uTagLoc);
-        Error.Expected = infoLength;
-        Error.Found = L_AD;
+        SetError(vol, ERR_BAD_AD, U_endian32(xFE->sTag.uTagLoc), infoLength, L_AD);
       }
       break;
+
+    default:
+      UDFError(vol, " **(ILLEGAL AD TYPE %u)", adtype);
+      break;
   }
 
   return error;
@@ -192,54 +134,54 @@ int track_file_allocation(const struct FE_or_EFE *xFE, uint16_t ptn)
  * This means that on write once media, errors will be generated when more
  * than one File Entry in an ICB hierarchy identifies the same space.
  */
-int walk_icb_hierarchy(struct FE_or_EFE *xFE, uint16_t ptn, uint32_t Location,
-                       uint32_t Length, int ICB_offs)
+int walk_icb_hierarchy(udf_volume *vol, struct FE_or_EFE *xFE, uint16_t ptn,
+                       uint32_t Location, uint32_t Length, int ICB_offs)
 {
   int i, error;
 
   /*
    * Mark the ICB extent as allocated
    */
-  track_filespace(ptn, Location, Length);
+  track_filespace(vol, ptn, Location, Length);
 
   /*
    * Read each sector in turn (1 sector == 1 ICB)
    */
-  for (i = 0; i < (Length >> bdivshift); i++) {
-    error = ReadLBlocks(xFE, Location + i, ptn, 1);
+  for (i = 0; i < (Length >> vol->bdivshift); i++) {
+    error = ReadLBlocks(vol, xFE, Location + i, ptn, 1);
     if (!error) {
-      if (!CheckTag((struct tag *)xFE, Location + i, TAGID_FILE_ENTRY, 16, Length)) {
-        set_true_unique_id(ICBlist + ICB_offs, U_endian64(xFE->FE.UniqueId));
-        ICBlist[ICB_offs].LinkRec = U_endian16(xFE->LinkCount);
-        ICBlist[ICB_offs].FE_LBN = Location + i;
-        ICBlist[ICB_offs].FE_Ptn = ptn;
-        track_file_allocation(xFE, ptn);
+      MarkScannedICB(vol, ptn, Location + i);
+      if (!CheckTag(vol, (struct tag *)xFE, Location + i, TAGID_FILE_ENTRY, 16, Length)) {
+        set_true_unique_id(vol, ICB_offs, U_endian64(xFE->FE.UniqueId));
+        vol->ICBlist.LinkRec[ICB_offs] = U_endian16(xFE->LinkCount);
+        vol->ICBlist.FE_LBN[ICB_offs] = Location + i;
+        vol->ICBlist.FE_Ptn[ICB_offs] = ptn;
+        track_file_allocation(vol, xFE, ptn, Location + i);
       } else {
-        ClearError();
-        if (!CheckTag((struct tag *)xFE, Location + i, TAGID_EXT_FILE_ENTRY, 16, Length)) {
-          set_true_unique_id(ICBlist + ICB_offs, U_endian64(xFE->EFE.UniqueId));
-          ICBlist[ICB_offs].LinkRec = U_endian16(xFE->LinkCount);
-          ICBlist[ICB_offs].FE_LBN = Location + i;
-          ICBlist[ICB_offs].FE_Ptn = ptn;
-          track_file_allocation(xFE, ptn);
+        ClearError(vol);
+        if (!CheckTag(vol, (struct tag *)xFE, Location + i, TAGID_EXT_FILE_ENTRY, 16, Length)) {
+          set_true_unique_id(vol, ICB_offs, U_endian64(xFE->EFE.UniqueId));
+          vol->ICBlist.LinkRec[ICB_offs] = U_endian16(xFE->LinkCount);
+          vol->ICBlist.FE_LBN[ICB_offs] = Location + i;
+          vol->ICBlist.FE_Ptn[ICB_offs] = ptn;
+          track_file_allocation(vol, xFE, ptn, Location + i);
         } else {
           /*
            * A descriptor was found that wasn't a File Entry.
            */
-          ClearError();
-          if (!CheckTag((struct tag *)xFE, Location + i, TAGID_INDIRECT, 16, Length)) {
-            walk_icb_hierarchy(xFE, U_endian32(((struct IndirectEntry *)xFE)->sIndirectICB.Location_LBN),
+          ClearError(vol);
+          if (!CheckTag(vol, (struct tag *)xFE, Location + i, TAGID_INDIRECT, 16, Length)) {
+            walk_icb_hierarchy(vol, xFE, U_endian32(((struct IndirectEntry *)xFE)->sIndirectICB.Location_LBN),
                                U_endian16(((struct IndirectEntry *)xFE)->sIndirectICB.Location_PartNo),
                                EXTENT_LENGTH(((struct IndirectEntry *)xFE)->sIndirectICB.ExtentLengthAndType),
                                ICB_offs);
           } else {
-            DumpError();  // Wasn't a file entry, but should have been.
+            DumpError(vol);  // Wasn't a file entry, but should have been.
           }
         }
       }
     } else {
-      Error.Code = ERR_READ;
-      Error.Sector = Location;
+      SetError(vol, ERR_READ, Location, 0, 0);
       i = Length;
     }  /* Read/didn't read sector */
   }    /* Do each ICB in the extent */
@@ -247,6 +189,61 @@ int walk_icb_hierarchy(struct FE_or_EFE *xFE, uint16_t ptn, uint32_t Location,
 }
 
 
+/*
+ * Enlarge each of the ICB tracking arrays.
+ */
+static bool grow_icb_list(udf_volume *vol)
+{
+  uint_least32_t newAlloc = vol->ICBlist_alloc + MAX(ICB_Alloc, vol->ICBlist_alloc >> 1);
+  void *p;
+
+#define GROW_ICB_FIELD(field)                                             \
+  p = realloc(vol->ICBlist.field, newAlloc * sizeof(*vol->ICBlist.field)); \
+  if (!p) return false;                                                   \
+  vol->ICBlist.field = p;
+
+  GROW_ICB_FIELD(LBN);
+  GROW_ICB_FIELD(Ptn);
+  GROW_ICB_FIELD(Link);
+  GROW_ICB_FIELD(LinkRec);
+  GROW_ICB_FIELD(Characteristics);
+  GROW_ICB_FIELD(UniqueID);
+  GROW_ICB_FIELD(FE_LBN);
+  GROW_ICB_FIELD(FE_Ptn);
+  GROW_ICB_FIELD(LinkedUIDs);
+#undef GROW_ICB_FIELD
+
+  vol->ICBlist_alloc = newAlloc;
+  return true;
+}
+
+/*
+ * Open up a zeroed slot at ICBlist index 'offs'.
+ * The caller must have ensured that there is room for one more entry.
+ */
+static void insert_icb_entry(udf_volume *vol, uint32_t offs)
+{
+  uint32_t numToMove = vol->ICBlist_len - offs;
+
+#define INSERT_ICB_FIELD(field)                                           \
+  memmove(vol->ICBlist.field + offs + 1, vol->ICBlist.field + offs,       \
+          numToMove * sizeof(*vol->ICBlist.field));                       \
+  vol->ICBlist.field[offs] = 0;
+
+  INSERT_ICB_FIELD(LBN);
+  INSERT_ICB_FIELD(Ptn);
+  INSERT_ICB_FIELD(Link);
+  INSERT_ICB_FIELD(LinkRec);
+  INSERT_ICB_FIELD(Characteristics);
+  INSERT_ICB_FIELD(UniqueID);
+  INSERT_ICB_FIELD(FE_LBN);
+  INSERT_ICB_FIELD(FE_Ptn);
+  INSERT_ICB_FIELD(LinkedUIDs);
+#undef INSERT_ICB_FIELD
+
+  vol->ICBlist_len++;
+}
+
 /*
  * This routine takes a partition, location, and length of an ICB extent as
  * input, marks the appropriate space as allocated in the space map, 
@@ -261,7 +258,7 @@ int walk_icb_hierarchy(struct FE_or_EFE *xFE, uint16_t ptn, uint32_t Location,
  *   FID == 0, space is not tracked and link counts not incremented.
  *   FID == 1, space is tracked and link counts are incremented.
  */
-int read_icb(struct FE_or_EFE *xFE, struct long_ad icbExtent,
+int read_icb(udf_volume *vol, struct FE_or_EFE *xFE, struct long_ad icbExtent,
              struct FileIDDesc *FID, uint16_t* pPrevCharacteristics)
 {
   uint32_t interval;
@@ -282,12 +279,12 @@ int read_icb(struct FE_or_EFE *xFE, struct long_ad icbExtent,
 
   if (Length == 0) {
     // Nothing to track
-    memset(xFE, 0, blocksize);  // Make sure caller doesn't see garbage or stale data
+    memset(xFE, 0, vol->blocksize);  // Make sure caller doesn't see garbage or stale data
   } else {
     /*
      * Something to track...
      */
-    ICB_offs = ICBlist_len >> 1; // start halfway for binary search
+    ICB_offs = vol->ICBlist_len >> 1; // start halfway for binary search
     temp = ICB_offs;
     interval = 1;
     while (temp) {
@@ -303,9 +300,9 @@ int read_icb(struct FE_or_EFE *xFE, struct long_ad icbExtent,
                             * the end of the list)
                             */
                                 
-    while ((interval > 0) && ICBlist_len) {
+    while ((interval > 0) && vol->ICBlist_len) {
       interval >>= 1;
-      temp = compare_address(ICBlist[ICB_offs].Ptn, ptn, ICBlist[ICB_offs].LBN, Location);
+      temp = compare_address(vol->ICBlist.Ptn[ICB_offs], ptn, vol->ICBlist.LBN[ICB_offs], Location);
       if (temp == 0) {
         interval = 0;
         if (FID) {
@@ -314,29 +311,29 @@ int read_icb(struct FE_or_EFE *xFE, struct long_ad icbExtent,
            * Increment our link count to note the fact.
            */
           if (U_endian16(FID->sTag.uDescriptorVersion) > 2) {
-            link_icb(ICBlist + ICB_offs, U_endian32(FID->ICB.UdfUniqueId_L));
+            link_icb(vol, ICB_offs, U_endian32(FID->ICB.UdfUniqueId_L));
           } else {
             // Pre-UDF2.00: UdfUniqueId_L not available
-            ICBlist[ICB_offs].Link++;
+            vol->ICBlist.Link[ICB_offs]++;
           }
           if (pPrevCharacteristics) {
-            *pPrevCharacteristics = ICBlist[ICB_offs].Characteristics;
+            *pPrevCharacteristics = vol->ICBlist.Characteristics[ICB_offs];
           }
-          if (   !(ICBlist[ICB_offs].Characteristics & CHILD_ATTR)
+          if (   !(vol->ICBlist.Characteristics[ICB_offs] & CHILD_ATTR)
               && ((FID->Characteristics & (PARENT_ATTR | DIR_ATTR)) == DIR_ATTR)) {
             // First time this directory has been counted as a child
-            ICBlist[ICB_offs].Characteristics |= CHILD_ATTR;
-            Num_Dirs++;
+            vol->ICBlist.Characteristics[ICB_offs] |= CHILD_ATTR;
+            vol->Num_Dirs++;
           }
-          ICBlist[ICB_offs].Characteristics |= FID->Characteristics;
+          vol->ICBlist.Characteristics[ICB_offs] |= FID->Characteristics;
         }
-        ReadLBlocks(xFE, ICBlist[ICB_offs].FE_LBN, ICBlist[ICB_offs].FE_Ptn, 1);
+        ReadLBlocks(vol, xFE, vol->ICBlist.FE_LBN[ICB_offs], vol->ICBlist.FE_Ptn[ICB_offs], 1);
       } else if (temp == 1) {
         ICB_offs -= interval;
         if (ICB_offs < 0) ICB_offs = 0;
       } else {
         ICB_offs += interval;
-        if (ICB_offs >= ICBlist_len) ICB_offs = ICBlist_len - 1;
+        if (ICB_offs >= vol->ICBlist_len) ICB_offs = vol->ICBlist_len - 1;
       }
     }
     if (temp) {
@@ -346,55 +343,47 @@ int read_icb(struct FE_or_EFE *xFE, struct long_ad icbExtent,
        * The above code may have left the pointer to a point either
        * before or after the insertion point.
        */
-      while ((temp == -1)  && (ICB_offs < (ICBlist_len - 1))) {
+      while ((temp == -1)  && (ICB_offs < (vol->ICBlist_len - 1))) {
         ICB_offs++;
-        temp = compare_address(ICBlist[ICB_offs].Ptn, ptn, ICBlist[ICB_offs].LBN, Location);
+        temp = compare_address(vol->ICBlist.Ptn[ICB_offs], ptn, vol->ICBlist.LBN[ICB_offs], Location);
       }
   
       /*
        * ICB_offs now points to the first entry greater than the one we 
        * are inserting or the end of the list.
        */
-      ICBlist_len++;
-      if (ICBlist_len > ICBlist_alloc) {
-        ICBlist = realloc(ICBlist, (ICBlist_alloc + ICB_Alloc) * sizeof(struct _sICB_trk));
-        if (ICBlist) {
-          ICBlist_alloc += ICB_Alloc;
-        } else {
-          Error.Code = ERR_NO_ICB_MEM;
-        }
-      }
-      for (temp = ICBlist_len -1; temp > ICB_offs; temp--) {
-        ICBlist[temp] = ICBlist[temp - 1];
+      if ((vol->ICBlist_len >= vol->ICBlist_alloc) && !grow_icb_list(vol)) {
+        SetError(vol, ERR_NO_ICB_MEM, 0, 0, 0);
+        DumpError(vol);
+        return ERR_NO_ICB_MEM;
       }
-      if ((compare_address(ICBlist[ICB_offs].Ptn, ptn, ICBlist[ICB_offs].LBN, Location) < 0) &&
-         (ICB_offs < (ICBlist_len - 1))) {
+      if (vol->ICBlist_len &&
+          (compare_address(vol->ICBlist.Ptn[ICB_offs], ptn, vol->ICBlist.LBN[ICB_offs], Location) < 0)) {
         ICB_offs++;
       }
+      insert_icb_entry(vol, ICB_offs);
 
-      memset(ICBlist + ICB_offs, 0, sizeof(ICBlist[ICB_offs]));
-      ICBlist[ICB_offs].LBN = Location;
-      ICBlist[ICB_offs].Ptn = ptn;
+      vol->ICBlist.LBN[ICB_offs] = Location;
+      vol->ICBlist.Ptn[ICB_offs] = ptn;
       if (FID) {
-        ICBlist[ICB_offs].Link = 1;
-        ICBlist[ICB_offs].Characteristics = FID->Characteristics;
+        vol->ICBlist.Link[ICB_offs] = 1;
+        vol->ICBlist.Characteristics[ICB_offs] = FID->Characteristics;
         if (U_endian16(FID->sTag.uDescriptorVersion) > 2) {
-          ICBlist[ICB_offs].UniqueID = U_endian32(FID->ICB.UdfUniqueId_L);
+          vol->ICBlist.UniqueID[ICB_offs] = U_endian32(FID->ICB.UdfUniqueId_L);
         }
       }
-      walk_icb_hierarchy(xFE, ptn, Location, Length, ICB_offs);
+      walk_icb_hierarchy(vol, xFE, ptn, Location, Length, ICB_offs);
 
       // Accounting for cross-check of Logical Volume Integrity Descriptor
       // These are the clarified rules first specified in UDF 2.50.
       if (FID && !(FID->Characteristics & (PARENT_ATTR | DELETE_ATTR))) {
         if (FID->Characteristics & DIR_ATTR) {
           if (xFE->sICBTag.FileType != FILE_TYPE_STREAMDIR) {
-            ICBlist[ICB_offs].Characteristics |= CHILD_ATTR;
-            Num_Dirs++;
+            vol->ICBlist.Characteristics[ICB_offs] |= CHILD_ATTR;
+            vol->Num_Dirs++;
           }
-        } else {
-          // @todo Don't bump this when we're traversing a stream directory
-          Num_Files++;
+        } else if (!vol->WalkingStreams) {
+          vol->Num_Files++;   // Named streams aren't counted as files
         }
       }
       if (U_endian16(xFE->sTag.uTagID) == TAGID_EXT_FILE_ENTRY) {
@@ -404,14 +393,14 @@ int read_icb(struct FE_or_EFE *xFE, struct long_ad icbExtent,
       }
 
       if (EXTENT_LENGTH(sExtAttrICB->ExtentLengthAndType)) {
-        EA = (struct FE_or_EFE *)malloc(blocksize);
+        EA = (struct FE_or_EFE *)malloc(vol->blocksize);
         if (EA) {
-          if (U_endian16(sExtAttrICB->Location_PartNo) < PTN_no) {
-            printf(" EA: [%x:%08x]", U_endian16(sExtAttrICB->Location_PartNo),
-                   U_endian32(sExtAttrICB->Location_LBN));
-            read_icb(EA, *sExtAttrICB, NULL, NULL);
+          if (U_endian16(sExtAttrICB->Location_PartNo) < vol->PTN_no) {
+            fprintf(vol->Out, " EA: [%x:%08x]", U_endian16(sExtAttrICB->Location_PartNo),
+                    U_endian32(sExtAttrICB->Location_LBN));
+            read_icb(vol, EA, *sExtAttrICB, NULL, NULL);
           } else {
-            printf("\n**EA field contains illegal partition reference number.\n");
+            fprintf(vol->Out, "\n**EA field contains illegal partition reference number.\n");
           }
           free(EA);
         }
@@ -419,69 +408,177 @@ int read_icb(struct FE_or_EFE *xFE, struct long_ad icbExtent,
     }
   }        /* If something to track */      
   if (error) {
-    DumpError();
+    DumpError(vol);
   }
   return error;
 }
 
-static bool add_linked_uid(sICB_trk *pICBinfo, uint32_t uniqueID_L)
+/*
+ * Find a tracked ICB. Returns its index in the ICB list, or -1.
+ */
+static int32_t find_icb(udf_volume *vol, uint16_t ptn, uint32_t Location)
 {
-  bool bSuccess = false;
-  uint32_t i;
-
-  if (!pICBinfo->LinkedUIDs) {
-    pICBinfo->LinkedUIDs = calloc(LINKED_UIDS_PER_CHUNK, sizeof(uniqueID_L));
-    if (pICBinfo->LinkedUIDs) {
-      pICBinfo->MaxLinkedUIDs = LINKED_UIDS_PER_CHUNK;
+  uint32_t low = 0, high = vol->ICBlist_len;
+
+  while (low < high) {
+    uint32_t mid = low + ((high - low) >> 1);
+    int temp = compare_address(vol->ICBlist.Ptn[mid], ptn, vol->ICBlist.LBN[mid], Location);
+    if (temp == 0) {
+      return mid;
+    } else if (temp < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
     }
   }
+  return -1;
+}
 
-  for (i=0; i < pICBinfo->MaxLinkedUIDs; ++i) {
-    if (pICBinfo->LinkedUIDs[i] == 0) {
-      pICBinfo->LinkedUIDs[i] = uniqueID_L;
-      bSuccess = true;
-      break;
+/*
+ * Read and track the stream directory ICB of a file (or of the File Set),
+ * counting the reference to it from its owner as its one link.
+ *
+ * Returns false if the stream directory was already tracked - its owner
+ * was reached again through a hard link, so its streams have already been
+ * walked.
+ */
+bool read_stream_dir_icb(udf_volume *vol, struct FE_or_EFE *xFE, struct long_ad icbExtent)
+{
+  uint16_t ptn      = U_endian16(icbExtent.Location_PartNo);
+  uint32_t Location = U_endian32(icbExtent.Location_LBN);
+  int32_t  ICB_offs;
+
+  if (find_icb(vol, ptn, Location) >= 0) {
+    return false;
+  }
+
+  read_icb(vol, xFE, icbExtent, NULL, NULL);
+  ICB_offs = find_icb(vol, ptn, Location);
+  if (ICB_offs >= 0) {
+    vol->ICBlist.Link[ICB_offs]++;
+  }
+  return true;
+}
+
+/*
+ * Find where the prevailing (Extended) File Entry of the ICB at ptn:Location
+ * is recorded, which is where read_icb() reads it from once the ICB is
+ * tracked. An ICB that isn't tracked is taken to be recorded in place.
+ */
+void icb_entry_location(udf_volume *vol, uint16_t ptn, uint32_t Location, uint16_t *fePtn,
+                        uint32_t *feLBN)
+{
+  int32_t ICB_offs = find_icb(vol, ptn, Location);
+
+  if (ICB_offs >= 0) {
+    *fePtn = vol->ICBlist.FE_Ptn[ICB_offs];
+    *feLBN = vol->ICBlist.FE_LBN[ICB_offs];
+  } else {
+    *fePtn = ptn;
+    *feLBN = Location;
+  }
+}
+
+#define LINKED_UID_SLAB_CHUNKS  (1U << LINKED_UID_SLAB_SHIFT)
+
+static inline sLinkedUIDChunk *linked_uid_chunk(udf_volume *vol, uint32_t handle)
+{
+  return vol->LinkedUIDSlabs[handle >> LINKED_UID_SLAB_SHIFT] + (handle & (LINKED_UID_SLAB_CHUNKS - 1));
+}
+
+/*
+ * Allocate a zeroed chunk for linked unique IDs.
+ * Chunks come from arena slabs, so growth never moves existing chunks.
+ *
+ * @return  Handle of the new chunk, or 0 on allocation failure
+ */
+static uint32_t alloc_linked_uid_chunk(udf_volume *vol)
+{
+  uint32_t slab = vol->LinkedUIDChunks >> LINKED_UID_SLAB_SHIFT;
+
+  if ((vol->LinkedUIDChunks & (LINKED_UID_SLAB_CHUNKS - 1)) == 0) {
+    // Current slab (if any) is full
+    if (slab >= vol->LinkedUIDSlabs_alloc) {
+      uint32_t newAlloc = vol->LinkedUIDSlabs_alloc + 16;
+      sLinkedUIDChunk **newSlabs = realloc(vol->LinkedUIDSlabs, newAlloc * sizeof(*newSlabs));
+      if (!newSlabs) {
+        return 0;
+      }
+      vol->LinkedUIDSlabs = newSlabs;
+      vol->LinkedUIDSlabs_alloc = newAlloc;
+    }
+    vol->LinkedUIDSlabs[slab] = ArenaAlloc(&vol->Arena, LINKED_UID_SLAB_CHUNKS * sizeof(sLinkedUIDChunk));
+    if (!vol->LinkedUIDSlabs[slab]) {
+      return 0;
+    }
+    if (vol->LinkedUIDChunks == 0) {
+      vol->LinkedUIDChunks = 1;    // Handle 0 means "no chunk"
     }
   }
 
-  if (!bSuccess) {
-    // Time to grow the array
-    uint32_t newMaxLinkedUIDs = pICBinfo->MaxLinkedUIDs + LINKED_UIDS_PER_CHUNK;
-    uint32_t *newLinkedUIDs   = realloc(pICBinfo->LinkedUIDs, newMaxLinkedUIDs * sizeof(uint32_t));
-    if (newLinkedUIDs) {
-      pICBinfo->LinkedUIDs    = newLinkedUIDs;
-      pICBinfo->MaxLinkedUIDs = newMaxLinkedUIDs;
-      pICBinfo->LinkedUIDs[i] = uniqueID_L;
-      bSuccess = true;
-      memset(pICBinfo->LinkedUIDs + i + 1, 0, sizeof(uint32_t) * (LINKED_UIDS_PER_CHUNK - 1));
+  memset(linked_uid_chunk(vol, vol->LinkedUIDChunks), 0, sizeof(sLinkedUIDChunk));
+  return vol->LinkedUIDChunks++;
+}
+
+static bool add_linked_uid(udf_volume *vol, uint32_t icb, uint32_t uniqueID_L)
+{
+  uint32_t chunk = vol->ICBlist.LinkedUIDs[icb];
+  uint32_t lastChunk = 0;
+  uint32_t i;
+
+  if (uniqueID_L == 0) {
+    return true;    // 0 marks an unused slot, so there's nothing to record
+  }
+
+  while (chunk) {
+    sLinkedUIDChunk *pChunk = linked_uid_chunk(vol, chunk);
+    for (i = 0; i < LINKED_UIDS_PER_CHUNK; ++i) {
+      if (pChunk->UID[i] == 0) {
+        pChunk->UID[i] = uniqueID_L;
+        return true;
+      }
     }
+    lastChunk = chunk;
+    chunk = pChunk->Next;
   }
 
-  return bSuccess;
+  // All chunks in the chain are full (or there are none yet)
+  chunk = alloc_linked_uid_chunk(vol);
+  if (!chunk) {
+    return false;
+  }
+  if (lastChunk) {
+    linked_uid_chunk(vol, lastChunk)->Next = chunk;
+  } else {
+    vol->ICBlist.LinkedUIDs[icb] = chunk;
+  }
+  linked_uid_chunk(vol, chunk)->UID[0] = uniqueID_L;
+
+  return true;
 }
 
 /**
  * Make the unique ID from an (Extended) File Entry the 'real' ID for its ICB.
  *
- * @param[in,out]  pICBinfo    Tracking entry for the EFE/FE containing the uniqueID
- * @param[in]      uniqueID    Unique ID recorded in the EFE/FE
+ * @param[in]  icb         Index of the tracking entry for the EFE/FE containing the uniqueID
+ * @param[in]  uniqueID    Unique ID recorded in the EFE/FE
  */
-static bool set_true_unique_id(sICB_trk *pICBinfo, uint64_t uniqueID)
+static bool set_true_unique_id(udf_volume *vol, uint32_t icb, uint64_t uniqueID)
 {
   bool bSuccess = false;
 
-  if ((pICBinfo->UniqueID & UINT64_C(0xFFFFFFFF00000000)) == 0) {
-    // pICBinfo->UniqueID might be a 32-bit ID from a struct FileIDDesc
-    if (pICBinfo->UniqueID == (uniqueID & 0xFFFFFFFF)) {
-      pICBinfo->UniqueID = uniqueID;  // Possibly filling in the high word
+  if ((vol->ICBlist.UniqueID[icb] & UINT64_C(0xFFFFFFFF00000000)) == 0) {
+    // ICBlist.UniqueID[icb] might be a 32-bit ID from a struct FileIDDesc
+    if (vol->ICBlist.UniqueID[icb] == (uniqueID & 0xFFFFFFFF)) {
+      vol->ICBlist.UniqueID[icb] = uniqueID;  // Possibly filling in the high word
       bSuccess = true;
     } else {
-      Debug("Found unique ID %" PRIu64 " for hard link %" PRIu64, uniqueID, pICBinfo->UniqueID);
-      bSuccess = add_linked_uid(pICBinfo, (uint32_t) pICBinfo->UniqueID);
-      pICBinfo->UniqueID = uniqueID;
+      Debug(vol, "Found unique ID %" PRIu64 " for hard link %" PRIu64, uniqueID, vol->ICBlist.UniqueID[icb]);
+      bSuccess = add_linked_uid(vol, icb, (uint32_t) vol->ICBlist.UniqueID[icb]);
+      vol->ICBlist.UniqueID[icb] = uniqueID;
     }
   } else {
-    if (pICBinfo->UniqueID == uniqueID) {
+    if (vol->ICBlist.UniqueID[icb] == uniqueID) {
       bSuccess = true;
     } else {
       // @todo report an error - attempt to change unique ID
@@ -495,22 +592,83 @@ static bool set_true_unique_id(sICB_trk *pICBinfo, uint64_t uniqueID)
  * Increment the link count for an ICB, and associate the specified (short) unique ID
  * with that ICB.
  *
- * @param[in,out]  pICBinfo    Tracking entry for an ICB
- * @param[in]      uniqueID_L  Unique ID recorded in a FileIDDesc referencing the ICB
+ * @param[in]  icb         Index of the tracking entry for an ICB
+ * @param[in]  uniqueID_L  Unique ID recorded in a FileIDDesc referencing the ICB
  *
  * @return @b      true        Success
  * @return @b      false       Memory allocation failure
  */
-static bool link_icb(sICB_trk *pICBinfo, uint32_t uniqueID_L)
+static bool link_icb(udf_volume *vol, uint32_t icb, uint32_t uniqueID_L)
 {
   bool bSuccess = true;
   // @todo check for illegal uniqueID_L
 
-  pICBinfo->Link++;
-  if (uniqueID_L != (pICBinfo->UniqueID & 0xFFFFFFFF)) {
-    Debug(" Hard link unique ID %u -> %" PRIu64 "\n", uniqueID_L, pICBinfo->UniqueID);
-    bSuccess = add_linked_uid(pICBinfo, uniqueID_L);
+  vol->ICBlist.Link[icb]++;
+  if (uniqueID_L != (vol->ICBlist.UniqueID[icb] & 0xFFFFFFFF)) {
+    Debug(vol, " Hard link unique ID %u -> %" PRIu64 "\n", uniqueID_L, vol->ICBlist.UniqueID[icb]);
+    bSuccess = add_linked_uid(vol, icb, uniqueID_L);
   }
 
   return bSuccess;
 }
+
+/**
+ * Fetch one of the unique IDs associated with a tracked ICB.
+ *
+ * @param[in]  icb     Index of the tracking entry
+ * @param[in]  n       0 for the ICB's own unique ID, 1.. for IDs of hard links
+ *
+ * @return     The unique ID, or 0 if the ICB has fewer than n linked IDs
+ */
+uint64_t icb_unique_id(udf_volume *vol, uint32_t icb, uint32_t n)
+{
+  uint32_t chunk;
+
+  if (n == 0) {
+    return vol->ICBlist.UniqueID[icb];
+  }
+
+  n--;
+  for (chunk = vol->ICBlist.LinkedUIDs[icb]; chunk; chunk = linked_uid_chunk(vol, chunk)->Next) {
+    if (n < LINKED_UIDS_PER_CHUNK) {
+      return linked_uid_chunk(vol, chunk)->UID[n];
+    }
+    n -= LINKED_UIDS_PER_CHUNK;
+  }
+
+  return 0;
+}
+
+/*
+ * Number of bytes of tracking data held for each ICB.
+ * Linked unique IDs are held separately, in LinkedUIDSlabs.
+ */
+uint32_t icb_bytes_per_entry(udf_volume *vol)
+{
+  return   sizeof(*vol->ICBlist.LBN) + sizeof(*vol->ICBlist.Ptn) + sizeof(*vol->ICBlist.Link)
+         + sizeof(*vol->ICBlist.LinkRec) + sizeof(*vol->ICBlist.Characteristics)
+         + sizeof(*vol->ICBlist.UniqueID) + sizeof(*vol->ICBlist.FE_LBN)
+         + sizeof(*vol->ICBlist.FE_Ptn) + sizeof(*vol->ICBlist.LinkedUIDs);
+}
+
+void free_icb_list(udf_volume *vol)
+{
+  free(vol->ICBlist.LBN);
+  free(vol->ICBlist.Ptn);
+  free(vol->ICBlist.Link);
+  free(vol->ICBlist.LinkRec);
+  free(vol->ICBlist.Characteristics);
+  free(vol->ICBlist.UniqueID);
+  free(vol->ICBlist.FE_LBN);
+  free(vol->ICBlist.FE_Ptn);
+  free(vol->ICBlist.LinkedUIDs);
+  memset(&vol->ICBlist, 0, sizeof(vol->ICBlist));
+  vol->ICBlist_len = 0;
+  vol->ICBlist_alloc = 0;
+
+  // The chunks themselves belong to Arena
+  free(vol->LinkedUIDSlabs);
+  vol->LinkedUIDSlabs = NULL;
+  vol->LinkedUIDSlabs_alloc = 0;
+  vol->LinkedUIDChunks = 0;
+}
@@ -1,19 +1,18 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (c) 1999 Rob Simms. All rights reserved.
 
+#include <string.h>
 #include "nsr.h"
 #include "chkudf.h"
 #include "protos.h"
 #include <stdio.h>
 
-void initialize(void) 
+void initialize(udf_volume *vol) 
 {
-  int i;
-
-  for (i = 0; i < NUM_CACHE; i++) {
-    Cache[i].Buffer = NULL;
-    Cache[i].Address = 0;
-    Cache[i].Count = 0;
-    Cache[i].Allocated = 0;
-  }
+  memset(vol, 0, sizeof(*vol));
+  vol->Out = stdout;
+  vol->s_per_b = 1;
+  vol->scsi_max_xfer = 1;
+  vol->sensebufsize = SCSI_SENSE_LEN;
+  ClearError(vol);
 }
@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (c) 2026 Steve Magnani. All rights reserved.
+
+#define _GNU_SOURCE            // fopencookie()
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "nsr.h"
+#include "chkudf.h"
+#include "protos.h"
+
+/*
+ * Library interface - see libchkudf.h.
+ *
+ * The checker writes its report to vol->Out like it always has. For a
+ * library caller that stream is a cookie stream whose writes are handed to
+ * the Output callback and also assembled into lines. A line that starts a
+ * section ("--") is reported as progress; a line that flags a problem
+ * ("**"), or was written by one of the error helpers in print.c, becomes a
+ * result. The stream is unbuffered so that the severity recorded by those
+ * helpers belongs to the line being assembled when they are called.
+ */
+
+static const char *PhaseNames[CHKUDF_NUM_PHASES] = {
+  "media",
+  "volume recognition sequence",
+  "anchors",
+  "volume descriptor sequences",
+  "partition scan",
+  "directories",
+  "unreferenced ICBs",
+  "link counts",
+  "file space",
+  "unique IDs",
+  "bad sectors",
+};
+
+static void RecordResult(udf_volume *vol, const char *text)
+{
+  chkudf_result result;
+  char *copy;
+
+  result.Phase = vol->Phase;
+  result.Severity = vol->LineSeverity;
+  result.Text = text;
+
+  if (vol->NumResults >= vol->ResultsAlloc) {
+    uint32_t newAlloc = vol->ResultsAlloc ? vol->ResultsAlloc * 2 : RESULT_ALLOC;
+    chkudf_result *larger = realloc(vol->Results, newAlloc * sizeof(chkudf_result));
+    if (larger) {
+      vol->Results = larger;
+      vol->ResultsAlloc = newAlloc;
+    }
+  }
+
+  copy = ArenaAlloc(&vol->Arena, strlen(text) + 1);
+  if (copy && (vol->NumResults < vol->ResultsAlloc)) {
+    strcpy(copy, text);
+    result.Text = copy;
+    vol->Results[vol->NumResults++] = result;
+  }
+
+  if (vol->Callbacks.Error) {
+    vol->Callbacks.Error(vol->Callbacks.Context, &result);
+  }
+}
+
+static void FinishReportLine(udf_volume *vol)
+{
+  const char *text = "";
+
+  if (vol->Line) {
+    vol->Line[vol->LineLen] = '\0';
+    text = vol->Line;
+  }
+
+  if (!strncmp(text, "--", 2)) {
+    if (vol->Callbacks.Progress) {
+      vol->Callbacks.Progress(vol->Callbacks.Context, vol->Phase, text);
+    }
+  } else if (vol->LineSeverity || strstr(text, "**")) {
+    RecordResult(vol, text);
+  }
+
+  vol->LineLen = 0;
+  vol->LineSeverity = 0;
+}
+
+static void AppendReportText(udf_volume *vol, const char *text, size_t size)
+{
+  if (vol->LineLen + size >= vol->LineAlloc) {
+    uint32_t newAlloc = vol->LineAlloc ? vol->LineAlloc : 128;
+    char *larger;
+
+    while (vol->LineLen + size >= newAlloc) {
+      newAlloc *= 2;
+    }
+    larger = realloc(vol->Line, newAlloc);
+    if (larger) {
+      vol->Line = larger;
+      vol->LineAlloc = newAlloc;
+    } else if (vol->LineAlloc) {
+      size = vol->LineAlloc - 1 - vol->LineLen;   // Keep what fits
+    } else {
+      return;
+    }
+  }
+
+  memcpy(vol->Line + vol->LineLen, text, size);
+  vol->LineLen += size;
+}
+
+static ssize_t ReportWrite(void *cookie, const char *buf, size_t size)
+{
+  udf_volume *vol = cookie;
+  const char *start = buf;
+  const char *end = buf + size;
+  const char *newline;
+
+  if (vol->Callbacks.Output) {
+    vol->Callbacks.Output(vol->Callbacks.Context, buf, size);
+  }
+
+  while ((newline = memchr(start, '\n', end - start)) != NULL) {
+    AppendReportText(vol, start, newline - start);
+    if (vol->LineLen || vol->LineSeverity) {
+      FinishReportLine(vol);
+    }
+    start = newline + 1;
+  }
+  AppendReportText(vol, start, end - start);
+
+  return size;
+}
+
+static int ReportClose(void *cookie)
+{
+  udf_volume *vol = cookie;
+
+  if (vol->LineLen || vol->LineSeverity) {
+    FinishReportLine(vol);
+  }
+  return 0;
+}
+
+void chkudf_set_options(const chkudf_options *options)
+{
+  g_bVerbose = (options->Verbose >= 1);
+  g_bDebug = (options->Verbose >= 2);
+  g_bPhysicalScan = (options->PhysicalScan != 0);
+  g_scsiTimeout = options->ScsiTimeout ? options->ScsiTimeout : SCSI_DEFAULT_TIMEOUT;
+  g_readRetries = options->ReadRetries;
+}
+
+/*
+ * Open a device or image for checking. Returns NULL only if memory could
+ * not be allocated; a device that can't be opened is reported like any
+ * other operational error, and no phase will run.
+ */
+chkudf_volume *chkudf_open(const char *devname, const chkudf_callbacks *callbacks)
+{
+  static const cookie_io_functions_t reportIO = {
+    .write = ReportWrite,
+    .close = ReportClose,
+  };
+  udf_volume *vol;
+
+  vol = malloc(sizeof(udf_volume));
+  if (!vol) {
+    return NULL;
+  }
+  initialize(vol);
+  if (callbacks) {
+    vol->Callbacks = *callbacks;
+  }
+
+  vol->Out = fopencookie(vol, "w", reportIO);
+  if (!vol->Out) {
+    free(vol);
+    return NULL;
+  }
+  setvbuf(vol->Out, NULL, _IONBF, 0);
+
+  vol->device = open(devname, O_RDONLY);
+  if (vol->device < 0) {
+    OperationalError(vol, "**Can't open %s (error %d)\n", devname, errno);
+    vol->NextPhase = CHKUDF_NUM_PHASES;
+  }
+
+  return vol;
+}
+
+/*
+ * Run a phase of the check, first running any earlier phases that haven't
+ * been. Returns 1 if the phase ran, or 0 if it had already run, doesn't
+ * apply, or can't run after a fatal error.
+ */
+int chkudf_run_phase(chkudf_volume *vol, chkudf_phase phase)
+{
+  bool ran = false;
+
+  if ((phase < 0) || (phase >= CHKUDF_NUM_PHASES)) {
+    return 0;
+  }
+
+  while (vol->NextPhase <= phase) {
+    vol->Phase = vol->NextPhase++;
+    ran = RunCheckPhase(vol, vol->Phase);
+  }
+
+  return ran;
+}
+
+/*
+ * Run every remaining phase. Returns the status of the volume.
+ */
+uint8_t chkudf_run(chkudf_volume *vol)
+{
+  chkudf_run_phase(vol, CHKUDF_NUM_PHASES - 1);
+  return vol->ExitStatus;
+}
+
+uint8_t chkudf_status(const chkudf_volume *vol)
+{
+  return vol->ExitStatus;
+}
+
+uint32_t chkudf_num_results(const chkudf_volume *vol)
+{
+  return vol->NumResults;
+}
+
+/*
+ * The returned result is valid until another phase is run or the volume
+ * is closed.
+ */
+const chkudf_result *chkudf_get_result(const chkudf_volume *vol, uint32_t index)
+{
+  return (index < vol->NumResults) ? vol->Results + index : NULL;
+}
+
+const char *chkudf_phase_name(chkudf_phase phase)
+{
+  return ((phase >= 0) && (phase < CHKUDF_NUM_PHASES)) ? PhaseNames[phase] : NULL;
+}
+
+void chkudf_close(chkudf_volume *vol)
+{
+  if (!vol) {
+    return;
+  }
+
+  cleanup(vol);
+  if (vol->device >= 0) {
+    close(vol->device);
+  }
+  fclose(vol->Out);           // Delivers any unfinished report line
+  ArenaRelease(&vol->Arena);  // Results recorded since cleanup()
+  free(vol->Results);
+  free(vol->Line);
+  free(vol);
+}
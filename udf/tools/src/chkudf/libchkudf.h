@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (c) 2026 Steve Magnani. All rights reserved.
+
+/*
+ * libchkudf - check UDF volumes from within another program.
+ *
+ * A check is opened on a device or image with chkudf_open(), run one phase
+ * at a time with chkudf_run_phase() (or all at once with chkudf_run()), and
+ * released with chkudf_close(). Any number of volumes may be checked at once
+ * from different threads; each has its own context.
+ *
+ * Everything the checker reports is passed to the Output callback exactly
+ * as the chkudf command would print it. Lines that start a new section are
+ * also passed to the Progress callback, and lines that report a problem are
+ * passed to the Error callback and kept, so they can be examined with
+ * chkudf_get_result() until the volume is closed.
+ */
+
+#ifndef __LIBCHKUDF_H__
+#define __LIBCHKUDF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Status flags - the combination is the chkudf exit status.
+ */
+#define CHKUDF_UNCORRECTED_ERRORS       (1U << 2)  // 4
+#define CHKUDF_OPERATIONAL_ERROR        (1U << 3)  // 8
+#define CHKUDF_USAGE                    (1U << 4)  // 16
+#define CHKUDF_MINOR_UNCORRECTED_ERRORS (1U << 6)  // 64
+
+typedef enum _chkudf_phase {
+    CHKUDF_PHASE_MEDIA = 0,        // Sector size and extent of the media
+    CHKUDF_PHASE_VRS,              // Volume Recognition Sequence
+    CHKUDF_PHASE_AVDP,             // Anchor Volume Descriptor Pointers
+    CHKUDF_PHASE_VDS,              // Volume Descriptor Sequences and partitions
+    CHKUDF_PHASE_SCAN,             // Physical-order partition scan (optional)
+    CHKUDF_PHASE_DIRS,             // Directory hierarchy
+    CHKUDF_PHASE_UNREFERENCED,     // ICBs found by the scan but not the walk
+    CHKUDF_PHASE_LINKCOUNT,        // File link counts
+    CHKUDF_PHASE_FILESPACE,        // Space maps against space in use
+    CHKUDF_PHASE_UNIQUEID,         // Unique IDs
+    CHKUDF_PHASE_BADSECTORS,       // Sectors that could not be read
+    CHKUDF_NUM_PHASES
+} chkudf_phase;
+
+typedef struct _chkudf_result {
+    chkudf_phase Phase;            // Phase that reported the problem
+    uint8_t      Severity;         // Status flags raised by it, 0 if informational
+    const char  *Text;             // The report line, without its newline
+} chkudf_result;
+
+typedef struct _chkudf_callbacks {
+    void (*Output)(void *Context, const char *Text, size_t Length);
+    void (*Progress)(void *Context, chkudf_phase Phase, const char *Text);
+    void (*Error)(void *Context, const chkudf_result *Result);
+    void  *Context;                // Passed to each callback
+} chkudf_callbacks;
+
+/*
+ * Options apply to every volume checked by the process.
+ */
+typedef struct _chkudf_options {
+    int      Verbose;              // 1 for verbose output, 2 for debug output
+    int      PhysicalScan;         // Run CHKUDF_PHASE_SCAN and _UNREFERENCED
+    uint32_t ScsiTimeout;          // Seconds per SCSI command, 0 for the default
+    uint32_t ReadRetries;          // Rereads before a sector is declared bad
+} chkudf_options;
+
+struct _udf_volume;
+typedef struct _udf_volume chkudf_volume;
+
+void chkudf_set_options(const chkudf_options *options);
+
+chkudf_volume *chkudf_open(const char *devname, const chkudf_callbacks *callbacks);
+int chkudf_run_phase(chkudf_volume *vol, chkudf_phase phase);
+uint8_t chkudf_run(chkudf_volume *vol);
+uint8_t chkudf_status(const chkudf_volume *vol);
+uint32_t chkudf_num_results(const chkudf_volume *vol);
+const chkudf_result *chkudf_get_result(const chkudf_volume *vol, uint32_t index);
+const char *chkudf_phase_name(chkudf_phase phase);
+void chkudf_close(chkudf_volume *vol);
+
+#endif
@@ -5,17 +5,17 @@
 #include "chkudf.h"
 #include "protos.h"
 
-int TestLinkCount(void)
+int TestLinkCount(udf_volume *vol)
 {
   uint32_t i;
 
-  printf("\n--Testing link counts.\n");
+  fprintf(vol->Out, "\n--Testing link counts.\n");
 
-  for (i = 0; i < ICBlist_len; i++) {
-    if (ICBlist[i].Link != ICBlist[i].LinkRec) {
-      printf("**ICB at %04x:%08x has a link count of %u, found %u link%s.\n",
-             ICBlist[i].Ptn, ICBlist[i].LBN, ICBlist[i].LinkRec, 
-             ICBlist[i].Link, ICBlist[i].Link == 1 ? "" : "s");
+  for (i = 0; i < vol->ICBlist_len; i++) {
+    if (vol->ICBlist.Link[i] != vol->ICBlist.LinkRec[i]) {
+      fprintf(vol->Out, "**ICB at %04x:%08x has a link count of %u, found %u link%s.\n",
+              vol->ICBlist.Ptn[i], vol->ICBlist.LBN[i], vol->ICBlist.LinkRec[i],
+              vol->ICBlist.Link[i], vol->ICBlist.Link[i] == 1 ? "" : "s");
     }
   }
 
@@ -155,6 +155,22 @@ struct PartMapSP {
     uint32_t SpareLoc[4];
 };
 
+struct PartMapMeta {
+    uint8_t  uPartMapType;
+    uint8_t  uPartMapLen;
+    uint8_t  uReserved[2];
+    struct udfEntityId sMetaIdentifier;
+    uint16_t uVSN;
+    uint16_t uPartNum;
+    uint32_t uMetadataFileLoc;
+    uint32_t uMirrorFileLoc;
+    uint32_t uBitmapFileLoc;
+    uint32_t uAllocUnitSize;
+    uint16_t uAlignUnitSize;
+    uint8_t  uFlags;
+    uint8_t  uReserved2[5];
+};
+
 /* [3/10.6] Logical Volume Descriptor --------------------------*/
 struct LogVolDesc {
     struct tag sTag;       /* uTagID = 6 */
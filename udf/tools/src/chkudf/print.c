@@ -7,90 +7,93 @@
 #include "chkudf.h"
 #include "protos.h"
 
-int Debug(const char* format, ...)
+int Debug(udf_volume *vol, const char* format, ...)
 {
   int charsPrinted = 0;
   if (g_bDebug) {
     va_list args;
     va_start(args, format);
 
-    charsPrinted = vprintf(format, args);
+    charsPrinted = vfprintf(vol->Out, format, args);
     va_end(args);
   }
 
   return charsPrinted;
 }
 
-int Verbose(const char* format, ...)
+int Verbose(udf_volume *vol, const char* format, ...)
 {
   int charsPrinted = 0;
   if (g_bVerbose) {
     va_list args;
     va_start(args, format);
 
-    charsPrinted = vprintf(format, args);
+    charsPrinted = vfprintf(vol->Out, format, args);
     va_end(args);
   }
 
   return charsPrinted;
 }
 
-int Information(const char* format, ...)
+int Information(udf_volume *vol, const char* format, ...)
 {
   int charsPrinted = 0;
 
   va_list args;
   va_start(args, format);
 
-  charsPrinted = vprintf(format, args);
+  charsPrinted = vfprintf(vol->Out, format, args);
   va_end(args);
 
   return charsPrinted;
 }
 
-int OperationalError(const char* format, ...)
+int OperationalError(udf_volume *vol, const char* format, ...)
 {
   int charsPrinted = 0;
-  g_exitStatus |= EXIT_OPERATIONAL_ERROR;
+  vol->ExitStatus |= EXIT_OPERATIONAL_ERROR;
+  vol->LineSeverity |= EXIT_OPERATIONAL_ERROR;
 
   va_list args;
   va_start(args, format);
 
-  charsPrinted = vprintf(format, args);
+  charsPrinted = vfprintf(vol->Out, format, args);
   va_end(args);
 
   return charsPrinted;
 }
 
-int MinorError(const char* format, ...)
+int MinorError(udf_volume *vol, const char* format, ...)
 {
   int charsPrinted = 0;
-  g_exitStatus |= EXIT_MINOR_UNCORRECTED_ERRORS;
+  vol->ExitStatus |= EXIT_MINOR_UNCORRECTED_ERRORS;
+  vol->LineSeverity |= EXIT_MINOR_UNCORRECTED_ERRORS;
 
   va_list args;
   va_start(args, format);
 
-  charsPrinted = vprintf(format, args);
+  charsPrinted = vfprintf(vol->Out, format, args);
   va_end(args);
 
   return charsPrinted;
 }
 
-int UDFError(const char* format, ...)
+int UDFError(udf_volume *vol, const char* format, ...)
 {
   int charsPrinted = 0;
-  g_exitStatus |= EXIT_UNCORRECTED_ERRORS;
+  vol->ExitStatus |= EXIT_UNCORRECTED_ERRORS;
+  vol->LineSeverity |= EXIT_UNCORRECTED_ERRORS;
 
   va_list args;
   va_start(args, format);
 
-  charsPrinted = vprintf(format, args);
+  charsPrinted = vfprintf(vol->Out, format, args);
   va_end(args);
 
   return charsPrinted;
 }
 
-int UDFErrorIf(bool bError, const char* format, ...)
+int UDFErrorIf(udf_volume *vol, bool bError, const char* format, ...)
 {
   int charsPrinted = 0;
 
@@ -98,12 +101,13 @@ int UDFErrorIf(bool bError, const char* format, ...)
   va_start(args, format);
 
   if (bError) {
-    g_exitStatus |= EXIT_UNCORRECTED_ERRORS;
-    charsPrinted = printf("**");
+    vol->ExitStatus |= EXIT_UNCORRECTED_ERRORS;
+    vol->LineSeverity |= EXIT_UNCORRECTED_ERRORS;
+    charsPrinted = fprintf(vol->Out, "**");
   }
 
   if (bError || g_bVerbose) {
-    charsPrinted += vprintf(format, args);
+    charsPrinted += vfprintf(vol->Out, format, args);
   }
   va_end(args);
 
@@ -7,6 +7,60 @@
  * Function prototypes for all files 
  */
 
+/*****************************************************************************
+ * allocdesc.c
+ *
+ * ADIterInit and ADIterInitChain start a walk over the allocation
+ * descriptors of a file or space table; ADIterNext returns each extent in
+ * turn, following the blocks the descriptors are continued in. ADIterFree
+ * releases what the walk kept to catch loops.
+ *
+ * GetADSummary collects the extents of a file in one walk, and keeps them
+ * for files whose descriptors are continued. FreeADSummaries releases them.
+ ****************************************************************************/
+
+void ADIterInit(udf_volume *vol, sADIter *iter, const struct FE_or_EFE *xFE, uint16_t ptn);
+bool ADIterInitChain(udf_volume *vol, sADIter *iter, uint16_t ptn, uint32_t location,
+                     uint32_t length);
+bool ADIterNext(udf_volume *vol, sADIter *iter, sADExtent *extent);
+void ADIterFree(sADIter *iter);
+const sADSummary *GetADSummary(udf_volume *vol, const struct FE_or_EFE *xFE, uint16_t ptn,
+                               uint32_t icbLoc);
+void FreeADSummaries(udf_volume *vol);
+
+
+/*****************************************************************************
+ * arena.c
+ *
+ * ArenaAlloc hands out storage from large slabs.  Allocations are never
+ * freed individually; ArenaRelease frees every slab at once.
+ ****************************************************************************/
+
+void *ArenaAlloc(sArena *arena, uint32_t numBytes);
+void ArenaRelease(sArena *arena);
+
+
+/*****************************************************************************
+ * badsect.c
+ *
+ * These functions maintain the map of sectors that could not be read, so
+ * they are never retried.
+ ****************************************************************************/
+
+uint32_t FirstBadSector(udf_volume *vol, uint32_t address, uint32_t Count);
+void RecordBadSector(udf_volume *vol, uint32_t address);
+void ReportBadSectors(udf_volume *vol);
+void FreeBadSectors(udf_volume *vol);
+
+/*****************************************************************************
+ * batch.c
+ *
+ * CheckBatch checks a list of devices or images with a pool of worker
+ * threads, printing each report when its check completes.
+ ****************************************************************************/
+
+uint8_t CheckBatch(char **devnames, uint32_t Count, uint32_t Jobs);
+
 /*****************************************************************************
  * build_scsi.c
  * 
@@ -15,8 +69,8 @@
  * the scsi_modesense10 function builds a mode sense scsi command in a
  * buffer passed to the routine.  
  *
- * The scsi_read10 command builds a read command in the preallocated
- * buffer.  It returns a pointer to the buffer.
+ * The scsi_read10 and scsi_read12 commands build a read command in the
+ * preallocated buffer.  They return a pointer to the buffer.
  ****************************************************************************/ 
 uint8_t *scsi_modesense10(uint8_t *buffer, int DBD, int PC, int pagecode,
                           int pagelength);
@@ -24,6 +78,9 @@ uint8_t *scsi_modesense10(uint8_t *buffer, int DBD, int PC, int pagecode,
 uint8_t *scsi_read10(uint8_t *buffer, int LBA, int length, int sectorsize,
                      int DPO, int FUA, int RelAdr);
 
+uint8_t *scsi_read12(uint8_t *buffer, int LBA, int length, int sectorsize,
+                     int DPO, int FUA, int RelAdr);
+
 
 
 /*****************************************************************************
@@ -37,15 +94,17 @@ uint8_t *scsi_read10(uint8_t *buffer, int LBA, int length, int sectorsize,
  * likely to be a tag but has a small problem, or is a good tag.
  ****************************************************************************/
 
-int CheckTag(const struct tag *TagPtr, uint32_t uTagLoc, uint16_t TagID,
+int CheckTag(udf_volume *vol, const struct tag *TagPtr, uint32_t uTagLoc, uint16_t TagID,
              int crc_min, int crc_max);
 
 /*****************************************************************************
  * chkudf.c
  *
- * This module contains no exported functions (just main).
+ * CheckDevice runs the complete check of one device or image, writing the
+ * report to out.
  ****************************************************************************/
 
+uint8_t CheckDevice(const char *devname, FILE *out);
 
 /*****************************************************************************
  * cleanup.c
@@ -53,7 +112,7 @@ int CheckTag(const struct tag *TagPtr, uint32_t uTagLoc, uint16_t TagID,
  * The cleanup command frees all memory allocated in the course of execution.
  ****************************************************************************/
 
-void cleanup(void);
+void cleanup(udf_volume *vol);
 
 
 /*****************************************************************************
@@ -63,29 +122,42 @@ void cleanup(void);
  *  structure.
  ****************************************************************************/
 
-int GetRootDir(void);
-int DisplayDirs(void);
-int GetFID(struct FileIDDesc *FID, const struct FE_or_EFE *fe, uint16_t part,
-           uint64_t offset);
+int GetRootDir(udf_volume *vol);
+int DisplayDirs(udf_volume *vol);
+int GetFID(udf_volume *vol, struct FileIDDesc *FID, const struct FE_or_EFE *fe,
+           uint16_t part, uint32_t icbLoc, uint64_t offset);
 
 /*****************************************************************************
  * do_scsi.c
  *
- * This function issues SCSI commands
+ * These functions issue SCSI commands; do_scsi_quiet doesn't report failures.
+ * decode_sense extracts the sense key
+ * and additional sense code/qualifier from fixed or descriptor sense data.
  ****************************************************************************/
 
-bool do_scsi(uint8_t *command, int cmd_len, void *buffer, uint32_t in_len,
+bool do_scsi(udf_volume *vol, uint8_t *command, int cmd_len, void *buffer, uint32_t in_len,
              uint32_t out_len, uint8_t *sense, int sense_len);
+bool do_scsi_quiet(udf_volume *vol, uint8_t *command, int cmd_len, void *buffer,
+                   uint32_t in_len, uint8_t *sense, int sense_len);
+void decode_sense(const uint8_t *sense, int sense_len, uint8_t *key,
+                  uint8_t *asc, uint8_t *ascq);
 
 /*****************************************************************************
  * errors.c
  *
- * This function dumps the coded error from the error structure to the
- * display in a human readable form.
+ * SetError() records an error for the calling thread and CurrentError()
+ * returns it. DumpError() displays the recorded error in a human readable
+ * form and logs it; an error replaced before it was dumped is logged too.
  ****************************************************************************/
 
-void DumpError(void);
-void ClearError(void);
+void SetError(udf_volume *vol, int code, uint32_t sector, long long expected,
+              long long found);
+sError *CurrentError(udf_volume *vol);
+void DumpError(udf_volume *vol);
+void ClearError(udf_volume *vol);
+void FlushError(udf_volume *vol);
+uint32_t CountErrors(udf_volume *vol, chkudf_phase phase, bool reported);
+void FreeErrorLog(udf_volume *vol);
 
 
 /*****************************************************************************
@@ -94,10 +166,22 @@ void ClearError(void);
  * This routine checks file space assignments
  ****************************************************************************/
 
-int track_freespace(uint16_t ptn, uint32_t Location, uint32_t numBlocks);
-int track_filespace(uint16_t ptn, uint32_t Location, uint32_t numBytes);
-int check_filespace(void);
-int check_uniqueid(void);
+int track_freespace(udf_volume *vol, uint16_t ptn, uint32_t Location, uint32_t numBlocks);
+int track_filespace(udf_volume *vol, uint16_t ptn, uint32_t Location, uint32_t numBytes);
+int check_filespace(udf_volume *vol);
+int check_uniqueid(udf_volume *vol);
+
+/*****************************************************************************
+ * geometry.c
+ *
+ * DiscoverGeometry queries the device once for everything needed to
+ * establish the sector size and media extent. GuessSectorSize looks for an
+ * anchor at each candidate sector size.
+ ****************************************************************************/
+
+void DiscoverGeometry(udf_volume *vol);
+uint32_t GuessSectorSize(udf_volume *vol);
+void FreeGeometry(udf_volume *vol);
 
 /*****************************************************************************
  * getMap.c
@@ -105,7 +189,7 @@ int check_uniqueid(void);
  * This routine loads the sparing maps if appropriate.
  ****************************************************************************/
 
-void GetMap(void);
+void GetMap(udf_volume *vol);
 
 
 /*****************************************************************************
@@ -114,92 +198,66 @@ void GetMap(void);
  * This routine loads the VAT if a virtual partition exists.
  ****************************************************************************/
 
-void GetVAT(void);
+void GetVAT(udf_volume *vol);
+
+
+/*****************************************************************************
+ * getMetadata.c
+ *
+ * GetMetadata loads the Metadata File if a metadata partition exists.
+ * MetaBlockLocation finds where a block of it is recorded.
+ ****************************************************************************/
+
+void GetMetadata(udf_volume *vol);
+uint32_t MetaBlockLocation(const sMeta_desc *PM_MD, uint32_t block);
 
 
 /*****************************************************************************
  * globals.c
  *
- * The following are global variables used by chkudf.
+ * The following are global variables used by chkudf. They hold the
+ * options given on the command line; the state of each volume being checked
+ * is in its udf_volume.
  ****************************************************************************/
 
 extern char           g_defaultAnswer;   // == '\0' (interactive), 'y', or 'n'
 extern bool           g_bVerbose;
 extern bool           g_bDebug;
-extern uint8_t        g_exitStatus;
-extern uint32_t       blocksize;
-extern uint_least8_t  bdivshift;
-extern uint32_t       secsize;
-extern uint_least8_t  sdivshift;
-extern uint_least8_t  s_per_b;
-extern uint32_t       packet_size;
-extern bool           scsi;
-extern int            device;
-extern uint32_t       LastSector;
-extern bool           LastSectorAccurate;
-extern uint32_t       lastSessionStartLBA;
-extern bool           isType5;
-extern bool           isCDRW;
-
-extern uint8_t        *scsibuf;
-extern uint32_t       scsibufsize;
-extern uint8_t        cdb[];
-extern uint8_t        sensedata[];
-extern int            sensebufsize;
-
-extern sCacheData     Cache[];
-extern uint_least8_t  bufno;
-extern sError         Error;
+extern bool           g_bPhysicalScan;
+extern uint32_t       g_scsiTimeout;
+extern uint32_t       g_readRetries;
 extern ErrorSeverity  Error_Msgs[];
 
 
-extern uint16_t       UDF_Version;
-extern bool           Version_OK;
-extern uint16_t       Serial_No;
-extern bool           Serial_OK;
-extern bool           Fatal;
-
-extern uint32_t       VDS_Loc, VDS_Len, RVDS_Loc, RVDS_Len;
-extern sPart_Info     Part_Info[];
-extern uint16_t       PTN_no;
-extern dstring        LogVolID[];      // The logical volume ID
-extern uint_least32_t VolSpaceListLen;
-extern struct extent_ad_name VolSpace[];
-extern uint32_t      *VAT;
-extern uint32_t       VATLength;
-
-extern struct long_ad FSD;
-extern struct long_ad RootDirICB;
-extern struct long_ad StreamDirICB;
-extern sICB_trk      *ICBlist;
-extern uint_least32_t ICBlist_len;
-extern uint_least32_t ICBlist_alloc;
-extern uint32_t       ID_Dirs;
-extern uint32_t       ID_Files;
-extern uint64_t       ID_UID;
-extern unsigned int   Num_Dirs;
-extern unsigned int   Num_Files;
-extern unsigned int   Num_Type_Err;
-extern unsigned int   FID_Loc_Wrong;
-
-
 /*****************************************************************************
  * icbspace.c
  *
  * This routine tracks ICBs, link counts, and file space
+ *
+ * icb_unique_id returns the unique ID (n == 0) or nth hard link ID of a
+ * tracked ICB.  icb_bytes_per_entry reports the tracking overhead per ICB.
+ * read_stream_dir_icb tracks a stream directory the first time its owner
+ * is reached.  icb_entry_location finds where the File Entry of a tracked
+ * ICB is recorded.
  ****************************************************************************/
 
-int read_icb(struct FE_or_EFE *FE, struct long_ad icbExtent,
+int read_icb(udf_volume *vol, struct FE_or_EFE *FE, struct long_ad icbExtent,
              struct FileIDDesc *FID, uint16_t* pPrevCharacteristics);
+bool read_stream_dir_icb(udf_volume *vol, struct FE_or_EFE *xFE, struct long_ad icbExtent);
+void icb_entry_location(udf_volume *vol, uint16_t ptn, uint32_t Location, uint16_t *fePtn,
+                        uint32_t *feLBN);
+uint64_t icb_unique_id(udf_volume *vol, uint32_t icb, uint32_t n);
+uint32_t icb_bytes_per_entry(udf_volume *vol);
+void free_icb_list(udf_volume *vol);
 
 
 /*****************************************************************************
  * init.c
  *
- * This routine initializes any global variables that need it.
+ * This routine prepares a volume context for a new check.
  ****************************************************************************/
 
-void initialize(void);
+void initialize(udf_volume *vol);
 
 
 /*****************************************************************************
@@ -208,20 +266,20 @@ void initialize(void);
  * This routine checks the link count of the file entries.
  ****************************************************************************/
 
-int TestLinkCount(void);
+int TestLinkCount(udf_volume *vol);
 
 /*****************************************************************************
  * print.c
  *
  * Output messages and keep track of severity
  ****************************************************************************/
-int Debug(const char* format, ...);
-int Verbose(const char* format, ...);
-int Information(const char* format, ...);
-int MinorError(const char* format, ...);
-int UDFError(const char* format, ...);
-int UDFErrorIf(bool bError, const char* format, ...);
-int OperationalError(const char* format, ...);
+int Debug(udf_volume *vol, const char* format, ...);
+int Verbose(udf_volume *vol, const char* format, ...);
+int Information(udf_volume *vol, const char* format, ...);
+int MinorError(udf_volume *vol, const char* format, ...);
+int UDFError(udf_volume *vol, const char* format, ...);
+int UDFErrorIf(udf_volume *vol, bool bError, const char* format, ...);
+int OperationalError(udf_volume *vol, const char* format, ...);
 
 /*****************************************************************************
  * readSpMap.c
@@ -229,25 +287,46 @@ int OperationalError(const char* format, ...);
  * This routine reads and verifies a space allocation bitmap or table
  ****************************************************************************/
 
-int ReadPartitionUnallocatedSpaceDescs(void);
+int ReadPartitionUnallocatedSpaceDescs(udf_volume *vol);
+void LoadSpaceBitmap(udf_volume *vol, uint16_t ptn, const struct SpaceBitmapHdr *BMD,
+                     uint32_t bmdLoc, uint32_t bmdBytes);
 
 /*****************************************************************************
  * read_udf.c
  *
- * This routine is the start of the logical checks.
+ * RunCheckPhase runs one phase of the check, from establishing the media
+ * parameters through the logical checks.
  ****************************************************************************/
 
-void Check_UDF(void);
+bool RunCheckPhase(udf_volume *vol, chkudf_phase phase);
 
 
+/*****************************************************************************
+ * scanpart.c
+ *
+ * ScanPartitions sweeps each partition in physical order, indexing the
+ * File Entries, Indirect Entries, Allocation Extent Descriptors and FIDs it
+ * finds in allocated space, and keeping up to SCAN_STORE_LIMIT bytes of
+ * them.  LookupScannedBlock returns the retained copy of an indexed block.  MarkScannedICB notes that the directory walk reached an
+ * ICB, NoteSystemICB that the checker read one itself, and
+ * ReportUnreferencedICBs lists File Entries that were reached neither way.
+ ****************************************************************************/
+
+void ScanPartitions(udf_volume *vol);
+const uint8_t *LookupScannedBlock(udf_volume *vol, uint16_t ptn, uint32_t lbn);
+void MarkScannedICB(udf_volume *vol, uint16_t ptn, uint32_t lbn);
+void NoteSystemICB(udf_volume *vol, uint16_t ptn, uint32_t lbn);
+void ReportUnreferencedICBs(udf_volume *vol);
+void FreeScanIndex(udf_volume *vol);
+
 /*****************************************************************************
  * setSectorSize.c
  *
- * This routine attempts to determine the sector size, and sets the secsize
- * and sdivshift globals.
+ * This routine attempts to determine the sector size, and sets the volume's
+ * secsize and sdivshift.
  ****************************************************************************/
 
-void SetSectorSize(void);
+void SetSectorSize(udf_volume *vol);
 
 
 /*****************************************************************************
@@ -257,13 +336,13 @@ void SetSectorSize(void);
  * media.
  ****************************************************************************/
 
-void SetFirstSector(void);
+void SetFirstSector(udf_volume *vol);
 
 /*****************************************************************************
  * setLastSector.c
  *
  * SetLastSector tries a bunch of tricks to find the last sector.  It sets
- * the LastSector and LastSectorAccurate global variables.
+ * the volume's LastSector and LastSectorAccurate.
  *
  * SetLastSectorAccurate adjusts LastSector after probing the media a bit.
  * It looks for AVDP in a variety of locations, and attempts to identify
@@ -271,16 +350,32 @@ void SetFirstSector(void);
  * isCDRW flag based on its guesses.
  ****************************************************************************/
 
-void SetLastSector(void);
+void SetLastSector(udf_volume *vol);
 
-void SetLastSectorAccurate(void);
+void SetLastSectorAccurate(udf_volume *vol);
 
 
+/*****************************************************************************
+ * sg_async.c
+ *
+ * These functions queue SCSI commands on an sg device and collect their
+ * completions, allowing several commands to be outstanding at once.
+ ****************************************************************************/
+
+bool sg_async_available(udf_volume *vol);
+int  sg_async_submit_cdb(udf_volume *vol, const uint8_t *command, int cmd_len, void *buffer,
+                         uint32_t in_len);
+int  sg_async_submit(udf_volume *vol, uint8_t *buffer, uint32_t address, uint32_t Count);
+bool sg_async_wait(udf_volume *vol, int tag);
+void sg_async_free(udf_volume *vol);
+
 /*****************************************************************************
  * utils.c
  *
  * Miscellaneous small routines.
  * endian32 swaps a 32 bit integer from big endian to little or vice versa.
+ * BlockDigest computes a 64-bit digest for quick comparison of blocks.
+ * IsZeroBuffer tests whether a buffer holds only zeros.
  ****************************************************************************/
 
 uint32_t endian32(uint32_t toswap);
@@ -288,34 +383,56 @@ uint16_t endian16(uint16_t toswap);
 uint16_t doCRC(uint8_t *buffer, int n);
 int Is_Charspec(const struct charspec *chars);
 bool IsKnownUDFVersion(uint16_t bcdVersion);
-void printDstring(const uint8_t *start, uint8_t fieldLen);
-void printDchars(const uint8_t *start, uint8_t length);
-void printCharSpec(struct charspec chars);
-void printTimestamp( struct timestamp x);
-void printExtentAD(struct extent_ad extent);
-void printLongAd(struct long_ad *longad);
+void printDstring(udf_volume *vol, const uint8_t *start, uint8_t fieldLen);
+void printDchars(udf_volume *vol, const uint8_t *start, uint8_t length);
+void printCharSpec(udf_volume *vol, struct charspec chars);
+void printTimestamp(udf_volume *vol,  struct timestamp x);
+void printExtentAD(udf_volume *vol, struct extent_ad extent);
+void printLongAd(udf_volume *vol, struct long_ad *longad);
 unsigned int countSetBits(unsigned int value);
+uint64_t BlockDigest(const void *data, size_t length);
+bool IsZeroBuffer(const void *data, size_t length);
 
 /*****************************************************************************
  * utils_read.c
  *
  * The ReadSectors command performs reading from a logical device or
- * file.  It depends on several global variables, including secsize.
+ * file.  It depends on several volume parameters, including secsize.
  *
  * The ReadLBlocks command reads blocks from a partition.  It relies on 
- * ReadSectors and several globals, including blocksize.
+ * ReadSectors and several volume parameters, including blocksize.
  *
  * The ReadFileData command reads data from a file.  It relies on 
  * ReadLBlocks.
+ *
+ * FlushCacheReads waits for read-ahead still queued into the cache.
+ *
+ * ReadBatch reads a set of independent ranges together, in address order.
+ *
+ * CachePBlocks brings partition blocks into the cache and returns a pointer
+ * to them, valid until the next read, using the reader SetPartType chose
+ * for the partition. PrefetchPBlock starts bringing in a
+ * block that will be wanted soon, without waiting for it.
+ *
+ * FindPhysicalPartition returns the reference of the partition that records
+ * a partition number in place, or PTN_no if there is none.
  ****************************************************************************/
 
-int ReadSectors(void *buffer, uint32_t address, uint32_t Count);
+int ReadSectors(udf_volume *vol, void *buffer, uint32_t address, uint32_t Count);
+void FlushCacheReads(udf_volume *vol);
+void ReadBatch(udf_volume *vol, sReadRequest *Requests, uint32_t Count);
 
-int ReadLBlocks(void *buffer, uint32_t address, uint16_t partition, uint32_t Count);
+int ReadLBlocks(udf_volume *vol, void *buffer, uint32_t address, uint16_t partition,
+                uint32_t Count);
+const uint8_t* CachePBlocks(udf_volume *vol, uint32_t p_address, uint16_t p_ref,
+                            uint32_t Count);
+void PrefetchPBlock(udf_volume *vol, uint32_t p_address, uint16_t p_ref);
+void SetPartType(udf_volume *vol, sPart_Info *part, int type);
+uint16_t FindPhysicalPartition(udf_volume *vol, uint16_t partNum);
 
-unsigned int ReadFileData(void *buffer, const struct FE_or_EFE *ICB, uint16_t part,
-                          uint64_t startOffset, unsigned int bytesRequested,
-                          uint32_t *data_start_loc);
+unsigned int ReadFileData(udf_volume *vol, void *buffer, const struct FE_or_EFE *ICB,
+                          uint16_t part, uint32_t icbLoc, uint64_t startOffset,
+                          unsigned int bytesRequested, uint32_t *data_start_loc);
 
 /*****************************************************************************
  * verifyAVDP.c
@@ -323,7 +440,7 @@ unsigned int ReadFileData(void *buffer, const struct FE_or_EFE *ICB, uint16_t pa
  * These routines read and verify the AVDP.
  ****************************************************************************/
 
-void VerifyAVDP(void);
+void VerifyAVDP(udf_volume *vol);
 
 
 /*****************************************************************************
@@ -332,7 +449,7 @@ void VerifyAVDP(void);
  * These routines read and verify file ICBs.
  ****************************************************************************/
 
-int checkICB(struct FE_or_EFE *fe, struct long_ad FE, int dir);
+int checkICB(udf_volume *vol, struct FE_or_EFE *fe, struct long_ad FE, int dir);
 
 
 /*****************************************************************************
@@ -341,7 +458,7 @@ int checkICB(struct FE_or_EFE *fe, struct long_ad FE, int dir);
  * This routine verifies an LVID sequence.
  ****************************************************************************/
 
-int verifyLVID(uint32_t loc, uint32_t len);
+int verifyLVID(udf_volume *vol, uint32_t loc, uint32_t len);
 
 
 /*****************************************************************************
@@ -350,10 +467,10 @@ int verifyLVID(uint32_t loc, uint32_t len);
  * These routines read and verify various registered identifiers.
  ****************************************************************************/
 int CheckRegid(const struct udfEntityId *reg, const char *ID);
-void DisplayImplID(struct implEntityId * ieip);
-void DisplayUdfID(struct udfEntityId * ueip);
-void DisplayRegIDID( struct regid *RegIDp);
-void DisplayAppID(struct regid *pAppID);
+void DisplayImplID(udf_volume *vol, struct implEntityId * ieip);
+void DisplayUdfID(udf_volume *vol, struct udfEntityId * ueip);
+void DisplayRegIDID(udf_volume *vol,  struct regid *RegIDp);
+void DisplayAppID(udf_volume *vol, struct regid *pAppID);
 
 //void printOSInfo( uint8_t osClass, uint8_t osIdentifier );
 
@@ -364,11 +481,11 @@ void DisplayAppID(struct regid *pAppID);
  * These routines verify the various Volume Descriptors.
  ****************************************************************************/
 
-int checkIUVD(struct ImpUseDesc *mIUVD, struct ImpUseDesc *rIUVD);
-int checkLVD(struct LogVolDesc *mLVD, struct LogVolDesc *rLVD);
-int checkPD(struct PartDesc *mPD, struct PartDesc *rPD);
-int checkPVD(struct PrimaryVolDes *mPVD, struct PrimaryVolDes *rPVD);
-int checkUSD(struct UnallocSpDesHead *mUSD, struct UnallocSpDesHead *rUSD);
+int checkIUVD(udf_volume *vol, struct ImpUseDesc *mIUVD, struct ImpUseDesc *rIUVD);
+int checkLVD(udf_volume *vol, struct LogVolDesc *mLVD, struct LogVolDesc *rLVD);
+int checkPD(udf_volume *vol, struct PartDesc *mPD, struct PartDesc *rPD);
+int checkPVD(udf_volume *vol, struct PrimaryVolDes *mPVD, struct PrimaryVolDes *rPVD);
+int checkUSD(udf_volume *vol, struct UnallocSpDesHead *mUSD, struct UnallocSpDesHead *rUSD);
 
 
 /*****************************************************************************
@@ -377,12 +494,14 @@ int checkUSD(struct UnallocSpDesHead *mUSD, struct UnallocSpDesHead *rUSD);
  * This routine checks the VDS and its contents for validity.  It will store
  * usefule file system information along the way, i.e. partition info.
  * 
- * The name in CheckSequence is for printing to the display.
+ * ReadVDS indexes the descriptors of one sequence and picks out the
+ * prevailing ones, which stay in memory until FreeVDSIndex.
  ****************************************************************************/
 
-int ReadVDS(uint8_t *VDS, char *name, uint32_t loc, uint32_t len);
+int ReadVDS(udf_volume *vol, sVDSIndex *index, sVDSReader *reader);
+void FreeVDSIndex(sVDSIndex *index);
 
-int VerifyVDS(void);
+int VerifyVDS(udf_volume *vol);
 
 /*****************************************************************************
  * verifyVRS.c
@@ -390,13 +509,18 @@ int VerifyVDS(void);
  * This routine checks for ISO 9660 and ECMA 167 recognition structures.
  ****************************************************************************/
 
-int VerifyVRS(void);
+int VerifyVRS(udf_volume *vol);
 
 
 /*****************************************************************************
  * volspace.c
  *
- * This routine checks for overlapping volume space assignments
+ * This routine checks for overlapping volume space assignments.
+ * track_volspace_bulk does the same for many equal-length extents at once.
+ * print_volspace lists the assignments in order of location.
  ****************************************************************************/
 
-int track_volspace(uint32_t Location, uint32_t Length, char *Name);
+int track_volspace(udf_volume *vol, uint32_t Location, uint32_t Length, char *Name);
+int track_volspace_bulk(udf_volume *vol, const uint32_t *Locations, uint32_t Count,
+                        uint32_t Length, char *Name);
+void print_volspace(udf_volume *vol);
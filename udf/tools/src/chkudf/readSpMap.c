@@ -10,221 +10,185 @@
 #include "chkudf.h"
 #include "protos.h"
 
-static int ReadSpaceBitmap(uint16_t ptn)
+/*
+ * Check a Space Bitmap Descriptor that has been read into memory, and take
+ * the recorded space map of partition reference ptn from it.
+ *
+ * @param[in]  BMD       The descriptor
+ * @param[in]  bmdLoc    Block where the descriptor was recorded
+ * @param[in]  bmdBytes  Number of bytes of the descriptor that were read
+ */
+void LoadSpaceBitmap(udf_volume *vol, uint16_t ptn, const struct SpaceBitmapHdr *BMD,
+                     uint32_t bmdLoc, uint32_t bmdBytes)
+{
+  CheckTag(vol, (struct tag *)BMD, bmdLoc, TAGID_SPACE_BMAP, 0, bmdBytes);
+  if (CurrentError(vol)->Code == ERR_TAGID) {
+    UDFError(vol, "**Not a space bitmap descriptor.\n");
+  } else {
+    DumpError(vol);
+  }
+  if (!CurrentError(vol)->Code) {
+    unsigned int mapBytesRequired = BITMAP_NUM_BYTES(vol->Part_Info[ptn].Len);
+    unsigned int mapBytesRecorded = U_endian32(BMD->N_Bytes);
+    Verbose(vol, "  Partition is %u blocks long, requiring %u bytes.\n",
+            vol->Part_Info[ptn].Len, mapBytesRequired);
+    if (U_endian32(BMD->N_Bits) != vol->Part_Info[ptn].Len) {
+      UDFError(vol, "**Partition is %u blocks long but is described by %u bits.\n",
+               vol->Part_Info[ptn].Len, U_endian32(BMD->N_Bits));
+    }
+    if (BITMAP_NUM_BYTES(U_endian32(BMD->N_Bits)) != mapBytesRecorded) {
+      UDFError(vol, "**Bitmap descriptor requires %u bytes to hold %u bits.\n",
+               mapBytesRecorded, U_endian32(BMD->N_Bits));
+    }
+    if (vol->Part_Info[ptn].SpMap && (mapBytesRecorded < bmdBytes)) {
+      memcpy(vol->Part_Info[ptn].SpMap,
+             (uint8_t *)BMD + sizeof(struct SpaceBitmapHdr),
+             MIN(mapBytesRecorded, mapBytesRequired));
+
+      // Mask out bits for blocks beyond end of partition
+      vol->Part_Info[ptn].SpMap[mapBytesRequired-1] &= vol->Part_Info[ptn].FinalMapByteMask;
+
+      Verbose(vol, "  Read the space bitmap for partition reference %u.\n", ptn);
+    }
+  } else {
+    DumpError(vol);
+  }
+}
+
+static int ReadSpaceBitmap(udf_volume *vol, uint16_t ptn)
 {
   struct SpaceBitmapHdr *BMD;
 
-  if (Part_Info[ptn].Space != -1) {
-    Information("\n--Reading the Space Bitmap Descriptor for partition reference %u.\n", ptn);
-    Verbose("  Descriptor is %u sectors at %u:%u.\n",
-            Part_Info[ptn].SpLen >> bdivshift, ptn, Part_Info[ptn].Space);
-    BMD = (struct SpaceBitmapHdr *)malloc(Part_Info[ptn].SpLen);
+  if (vol->Part_Info[ptn].Space != -1) {
+    Information(vol, "\n--Reading the Space Bitmap Descriptor for partition reference %u.\n", ptn);
+    Verbose(vol, "  Descriptor is %u sectors at %u:%u.\n",
+            vol->Part_Info[ptn].SpLen >> vol->bdivshift, ptn, vol->Part_Info[ptn].Space);
+    BMD = (struct SpaceBitmapHdr *)malloc(vol->Part_Info[ptn].SpLen);
     if (BMD) {
-      ReadLBlocks(BMD, Part_Info[ptn].Space, ptn, Part_Info[ptn].SpLen >> bdivshift);
-      track_filespace(ptn, Part_Info[ptn].Space, Part_Info[ptn].SpLen);
-
-      CheckTag((struct tag *)BMD, Part_Info[ptn].Space, TAGID_SPACE_BMAP,
-               0, Part_Info[ptn].SpLen);
-      if (Error.Code == ERR_TAGID) {
-        UDFError("**Not a space bitmap descriptor.\n");
-      } else {
-        DumpError();
-      }
-      if (!Error.Code) {
-        unsigned int mapBytesRequired = BITMAP_NUM_BYTES(Part_Info[ptn].Len);
-        unsigned int mapBytesRecorded = U_endian32(BMD->N_Bytes);
-        Verbose("  Partition is %u blocks long, requiring %u bytes.\n",
-                Part_Info[ptn].Len, mapBytesRequired);
-        if (U_endian32(BMD->N_Bits) != Part_Info[ptn].Len) {
-          UDFError("**Partition is %u blocks long but is described by %u bits.\n",
-                   Part_Info[ptn].Len, U_endian32(BMD->N_Bits));
-        }
-        if (BITMAP_NUM_BYTES(U_endian32(BMD->N_Bits)) != mapBytesRecorded) {
-          UDFError("**Bitmap descriptor requires %u bytes to hold %u bits.\n",
-                   mapBytesRecorded, U_endian32(BMD->N_Bits));
-        }
-        if (Part_Info[ptn].SpMap && (mapBytesRecorded < Part_Info[ptn].SpLen)) {
-          memcpy(Part_Info[ptn].SpMap,
-                 (uint8_t *)BMD + sizeof(struct SpaceBitmapHdr),
-                 MIN(mapBytesRecorded, mapBytesRequired));
-
-          // Mask out bits for blocks beyond end of partition
-          Part_Info[ptn].SpMap[mapBytesRequired-1] &= Part_Info[ptn].FinalMapByteMask;
-
-          Verbose("  Read the space bitmap for partition reference %u.\n", ptn);
-        }
-      } else {
-        DumpError();
-      }
+      ReadLBlocks(vol, BMD, vol->Part_Info[ptn].Space, ptn, vol->Part_Info[ptn].SpLen >> vol->bdivshift);
+      track_filespace(vol, ptn, vol->Part_Info[ptn].Space, vol->Part_Info[ptn].SpLen);
+      LoadSpaceBitmap(vol, ptn, BMD, vol->Part_Info[ptn].Space, vol->Part_Info[ptn].SpLen);
       free(BMD);
     } else {
-      OperationalError("**Couldn't allocate memory for space bitmap.\n");  // if (BMD)
+      OperationalError(vol, "**Couldn't allocate memory for space bitmap.\n");  // if (BMD)
     }
   }
 
   return 0;
 }
 
-static void ReadSpaceTable(uint16_t ptn)
+static void ReadSpaceTable(udf_volume *vol, uint16_t ptn)
 {
-  struct UnallocSpEntry *USE = malloc(blocksize);
-
-  if (USE) {
-    uint32_t nextUSELocation = Part_Info[ptn].Space;
-    uint32_t nextUSESize     = Part_Info[ptn].SpLen;
-    uint32_t minNextUnallocStart = 0;
-    bool     bWarnedUnsorted = false;
-    const uint32_t maxExtentLength = 0x3FFFFFFF & ~(blocksize - 1);
-
-    Information("\n--Reading Unallocated Space Entries for partition reference %u.\n", ptn);
-    while (nextUSELocation != -1) {
-      struct short_ad *sad;
-      uint32_t L_AD;
-      uint32_t ad_offset = 0;
-
-      uint32_t curUSESize     = nextUSESize;
-      uint32_t curUSELocation = nextUSELocation;
-      nextUSELocation = -1;
-
-      Debug("  [loc=%u, size=%u]\n", curUSELocation, curUSESize);
-      ReadLBlocks(USE, curUSELocation, ptn, 1);
-      // @todo Handle nextSpaceSize > blocksize gracefully
-      track_filespace(ptn, curUSELocation, blocksize);
-
-      CheckTag((struct tag *)USE, curUSELocation, TAGID_UNALLOC_SP_ENTRY,
-               0, curUSESize);
-      if (Error.Code == ERR_TAGID) {
-        UDFError("    **Not a space entry descriptor.\n");
-        break;
-      }
-
-      DumpError();
+  sADIter   iter;
+  sADExtent extent;
+  uint32_t  minNextUnallocStart = 0;
+  bool      bWarnedUnsorted = false;
+  bool      more;
+  const uint32_t maxExtentLength = 0x3FFFFFFF & ~(vol->blocksize - 1);
+
+  Information(vol, "\n--Reading Unallocated Space Entries for partition reference %u.\n", ptn);
+  Debug(vol, "  [loc=%u, size=%u]\n", vol->Part_Info[ptn].Space, vol->Part_Info[ptn].SpLen);
+  // @todo Handle nextSpaceSize > blocksize gracefully
+  track_filespace(vol, ptn, vol->Part_Info[ptn].Space, vol->blocksize);
+  if (!ADIterInitChain(vol, &iter, ptn, vol->Part_Info[ptn].Space, vol->Part_Info[ptn].SpLen)) {
+    return;
+  }
 
-// @todo bail if  Error.Code??
+  for (;;) {
+    more = ADIterNext(vol, &iter, &extent);
+    if (!more && !iter.ZeroLength) {
+      break;
+    }
 
-      // UDF: "Only Short Allocation Descriptors shall be used."
-      if ((U_endian16(USE->sICBTag.Flags) & ADTYPEMASK) != ADSHORT) {
-        Error.Code     = ERR_PROHIBITED_AD_TYPE;
-        Error.Sector   = curUSELocation;
-        Error.Expected = ADSHORT;
-        Error.Found    = U_endian16(USE->sICBTag.Flags) & ADTYPEMASK;
+    if (more) {
+      switch (extent.Type) {
+        case E_RECORDED:
+        case E_UNALLOCATED:
+          SetError(vol, ERR_PROHIBITED_EXTENT_TYPE, iter.DescLoc, E_ALLOCATED, extent.Type);
+          break;
 
-        DumpError();
-        break;    // Can't proceed further with the table
-      }
+        case E_ALLOCATED:
+          // UDF requires extents to be sorted by ascending location,
+          // and for adjacent extents to be discontiguous except when
+          // the preceding one is the maximum allowable length
+          if (extent.Length & (vol->blocksize - 1)) {
+            SetError(vol, ERR_BAD_AD, iter.DescLoc,
+                     (extent.Length & ~(vol->blocksize - 1)) + vol->blocksize, extent.Length);
+          } else if (extent.Location < minNextUnallocStart) {
+            if (extent.Location == (minNextUnallocStart - 1)) {
+              // Adjacent, but shouldn't be
+              SetError(vol, ERR_SEQ_ALLOC, iter.DescLoc, minNextUnallocStart, extent.Location);
+            } else {
+              SetError(vol, ERR_UNSORTED_EXTENTS, iter.DescLoc, minNextUnallocStart,
+                       extent.Location);
+            }
+          } else {
+            minNextUnallocStart = extent.Location + (extent.Length >> vol->bdivshift);
+            if (extent.Length < maxExtentLength)
+              ++minNextUnallocStart;
+          }
+          break;
 
-      L_AD = U_endian32(USE->L_AD);
-      sad = (struct short_ad *) (USE + 1);
-
-      while ((ad_offset < L_AD) && (nextUSELocation == -1)) {
-        uint32_t extentLocation = U_endian32(sad->Location);
-        uint32_t extentLength   = EXTENT_LENGTH(sad->ExtentLengthAndType);
-        uint32_t extentType     = EXTENT_TYPE(sad->ExtentLengthAndType);
-        if (extentLength) {
-          switch (extentType) {
-            case E_RECORDED:
-            case E_UNALLOCATED:
-              Error.Code     = ERR_PROHIBITED_EXTENT_TYPE;
-              Error.Expected = E_ALLOCATED;
-              Error.Found    = extentType;
-              break;
-
-            case E_ALLOCATED:
-              // UDF requires extents to be sorted by ascending location,
-              // and for adjacent extents to be discontiguous except when
-              // the preceding one is the maximum allowable length
-              if (extentLength & (blocksize - 1)) {
-                Error.Code     = ERR_BAD_AD;
-                Error.Expected = (extentLength & ~(blocksize - 1)) + blocksize;
-                Error.Found    = extentLength;
-              } else if (extentLocation < minNextUnallocStart) {
-                Error.Expected = minNextUnallocStart;
-                Error.Found    = extentLocation;
-                if (extentLocation == (minNextUnallocStart - 1)) {
-                  Error.Code = ERR_SEQ_ALLOC;  // Adjacent, but shouldn't be
-                } else {
-                  Error.Code = ERR_UNSORTED_EXTENTS;
-                }
-              } else {
-                minNextUnallocStart = extentLocation + (extentLength >> bdivshift);
-                if (extentLength < maxExtentLength)
-                  ++minNextUnallocStart;
-              }
-              break;
-
-            case E_ALLOCEXTENT:
-              // Chain
-              if ((extentLength > blocksize) || (extentLength < sizeof(*USE))) {
-                Error.Code     = ERR_BAD_AD;
-                Error.Expected = blocksize;
-                Error.Found    = extentLength;
-              }
-
-              nextUSESize     = extentLength;
-              nextUSELocation = extentLocation;
-              break;
-
-            // No other cases, this is just to avoid a "missing default" warning
-            default:
-              break;
-          }  // switch (extentType)
-        }    // if (extentLength)
-
-        Debug("%s  [ad_offset=%u, atype=%u, loc=%u, len=%u]\n",
-              Error.Code ? "**" : "  ",
-              ad_offset, extentType, extentLocation, extentLength);
-
-        if (Error.Code == ERR_UNSORTED_EXTENTS) {
-          if (bWarnedUnsorted) {
-            ClearError();
+        case E_ALLOCEXTENT:
+          // Chain
+          if ((extent.Length > vol->blocksize) || (extent.Length < sizeof(struct UnallocSpEntry))) {
+            SetError(vol, ERR_BAD_AD, iter.DescLoc, vol->blocksize, extent.Length);
           }
-          bWarnedUnsorted = true;
-        }
-
-        if (!Error.Code && (extentLength == 0)) {
-            Error.Code     = ERR_UNEXPECTED_ZERO_LEN;
-            Error.Expected = L_AD;
-            Error.Found    = ad_offset;
-        }
-
-        if (Error.Code) {
-          Error.Sector = curUSELocation;
-          DumpError();
-        }
-
-        if (extentLength == 0) {
-          // ECMA-167r3 sec. 4.12: zero extent length terminates allocation descriptors
-          nextUSELocation = -1;
           break;
-        }
 
-        // Do this after the above print to provide context in the event of
-        // a tracking error
-        if (extentType == E_ALLOCATED) {
-          track_freespace(ptn, extentLocation, extentLength);
-        }
-        ++sad;
-        ad_offset += sizeof(*sad);
-      }  // walk short_ads
+        // No other cases, this is just to avoid a "missing default" warning
+        default:
+          break;
+      }  // switch (extent.Type)
+    }
+
+    Debug(vol, "%s  [ad_offset=%u, atype=%u, loc=%u, len=%u]\n",
+          CurrentError(vol)->Code ? "**" : "  ",
+          extent.DescOffset, extent.Type, extent.Location, extent.Length);
 
-    }  // walk USE block chain
+    if (CurrentError(vol)->Code == ERR_UNSORTED_EXTENTS) {
+      if (bWarnedUnsorted) {
+        ClearError(vol);
+      }
+      bWarnedUnsorted = true;
+    }
+
+    if (!CurrentError(vol)->Code && !more) {
+      SetError(vol, ERR_UNEXPECTED_ZERO_LEN, iter.DescLoc, iter.L_AD, extent.DescOffset);
+    }
 
-    free(USE);
+    if (CurrentError(vol)->Code) {
+      DumpError(vol);
+    }
+
+    // Do this after the above print to provide context in the event of
+    // a tracking error
+    if (!more) {
+      // ECMA-167r3 sec. 4.12: zero extent length terminates allocation descriptors
+      break;
+    } else if (extent.Type == E_ALLOCATED) {
+      track_freespace(vol, ptn, extent.Location, extent.Length);
+    } else if (extent.Type == E_ALLOCEXTENT) {
+      Debug(vol, "  [loc=%u, size=%u]\n", extent.Location, extent.Length);
+      track_filespace(vol, ptn, extent.Location, vol->blocksize);
+    }
   }
+  ADIterFree(&iter);
 }
+
 /*
  *  Read description of unallocated space (bitmap or table) for each partition.
  */
 
-int ReadPartitionUnallocatedSpaceDescs(void)
+int ReadPartitionUnallocatedSpaceDescs(udf_volume *vol)
 {
   uint16_t i;
 
-  for (i = 0; i < PTN_no; i++) {
-    if (Part_Info[i].SpaceTag == TAGID_SPACE_BMAP) {
-      ReadSpaceBitmap(i);
-    } else if (Part_Info[i].SpaceTag == TAGID_UNALLOC_SP_ENTRY) {
-      ReadSpaceTable(i);
+  for (i = 0; i < vol->PTN_no; i++) {
+    if (vol->Part_Info[i].SpaceTag == TAGID_SPACE_BMAP) {
+      ReadSpaceBitmap(vol, i);
+    } else if (vol->Part_Info[i].SpaceTag == TAGID_UNALLOC_SP_ENTRY) {
+      ReadSpaceTable(vol, i);
     }
   }
 
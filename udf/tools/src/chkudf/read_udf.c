@@ -9,29 +9,99 @@
 #include "chkudf.h"
 #include "protos.h"
 
-void Check_UDF(void)
+/*
+ * Find the sector size and the extent of the media.
+ */
+static void CheckMedia(udf_volume *vol)
 {
-  VerifyVRS(); /* Verify NSR and other descriptors; extract version */
+  Information(vol, "--Determining device/media parameters.\n");
+  SetSectorSize(vol);
+  SetLastSector(vol);
+  if (vol->LastSector == -1) {
+    vol->LastSector = (vol->Geometry.FileBytes >> vol->sdivshift) - 1;
+  }
+  Information(vol, "  Last Sector = %u (0x%x) and is%s accurate\n", vol->LastSector,
+              vol->LastSector, vol->LastSectorAccurate ? "" : " not");
+  if (!vol->LastSectorAccurate) {
+    SetLastSectorAccurate(vol);
+  }
+  if (vol->isType5) {
+    SetFirstSector(vol);
+  }
+}
 
-  VerifyAVDP();
+/*
+ * Run one phase of the check. Returns false if the phase was skipped
+ * because it doesn't apply or a fatal error was found earlier.
+ */
+bool RunCheckPhase(udf_volume *vol, chkudf_phase phase)
+{
+  uint32_t superseded;
 
-  if (!Fatal) {
-    VerifyVDS();
+  // Recognition and anchors are reported even if the media phase failed
+  if (vol->Fatal && (phase > CHKUDF_PHASE_AVDP) && (phase != CHKUDF_PHASE_BADSECTORS)) {
+    return false;
   }
-
-  if (!Fatal) {
-    DisplayDirs();
+  if (!g_bPhysicalScan &&
+      ((phase == CHKUDF_PHASE_SCAN) || (phase == CHKUDF_PHASE_UNREFERENCED))) {
+    return false;
   }
 
-  if (!Fatal) {
-    TestLinkCount();
-  } 
+  switch (phase) {
+    case CHKUDF_PHASE_MEDIA:
+      CheckMedia(vol);
+      break;
+
+    case CHKUDF_PHASE_VRS:
+      VerifyVRS(vol); /* Verify NSR and other descriptors; extract version */
+      break;
+
+    case CHKUDF_PHASE_AVDP:
+      VerifyAVDP(vol);
+      break;
+
+    case CHKUDF_PHASE_VDS:
+      VerifyVDS(vol);
+      break;
+
+    case CHKUDF_PHASE_SCAN:
+      ScanPartitions(vol);
+      break;
+
+    case CHKUDF_PHASE_DIRS:
+      DisplayDirs(vol);
+      break;
+
+    case CHKUDF_PHASE_UNREFERENCED:
+      ReportUnreferencedICBs(vol);
+      break;
+
+    case CHKUDF_PHASE_LINKCOUNT:
+      TestLinkCount(vol);
+      break;
+
+    case CHKUDF_PHASE_FILESPACE:
+      check_filespace(vol);
+      break;
+
+    case CHKUDF_PHASE_UNIQUEID:
+      check_uniqueid(vol);
+      break;
+
+    case CHKUDF_PHASE_BADSECTORS:
+      ReportBadSectors(vol);
+      break;
 
-  if (!Fatal) {
-    check_filespace();
+    case CHKUDF_NUM_PHASES:
+    default:
+      return false;
   }
 
-  if (!Fatal) {
-    check_uniqueid();
+  FlushError(vol);
+  superseded = CountErrors(vol, phase, false);
+  if (superseded) {
+    Debug(vol, "  %u error%s recorded but not reported.\n", superseded,
+          (superseded == 1) ? "" : "s");
   }
+  return true;
 }
@@ -0,0 +1,396 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (c) 2026 Steve Magnani. All rights reserved.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "nsr.h"
+#include "chkudf.h"
+#include "protos.h"
+
+/*
+ * Physical-order partition scan.
+ *
+ * The directory walk in DisplayDirs() follows the logical tree, which on
+ * optical or tape-like media means a seek for nearly every ICB and directory
+ * block. When requested (-p) each partition is first swept from start to end
+ * in large reads. Every allocated block is classified by its tag, and the
+ * ICB-related descriptors are indexed and, up to SCAN_STORE_LIMIT bytes,
+ * kept. The walk still follows the logical tree and does the space
+ * accounting as before; it is served from memory for the descriptors that
+ * were kept and reads the rest from the medium. The index also lets File
+ * Entries that the walk never reached be reported.
+ */
+
+typedef struct _sScanCounts {
+    uint32_t Blocks;
+    uint32_t Unreadable;
+    uint32_t FE;
+    uint32_t EFE;
+    uint32_t IE;
+    uint32_t AED;
+    uint32_t FID;
+} sScanCounts;
+
+/*
+ * Validate a candidate descriptor tag without touching Error, Version_OK or
+ * Serial_OK. Free space and stale data are expected to contain garbage, so
+ * nothing found here is reported.
+ */
+static bool IsValidTag(udf_volume *vol, const struct tag *TagPtr, uint32_t uTagLoc)
+{
+  uint8_t checksum = 0;
+  uint16_t crcLen;
+  int i;
+
+  for (i = 0; i < 4; i++) checksum += *((uint8_t *)TagPtr + i);
+  for (i = 5; i < 16; i++) checksum += *((uint8_t *)TagPtr + i);
+  if (TagPtr->uTagChecksum != checksum) {
+    return false;
+  }
+
+  if (U_endian32(TagPtr->uTagLoc) != uTagLoc) {
+    return false;
+  }
+
+  crcLen = U_endian16(TagPtr->uCRCLen);
+  if (crcLen > vol->blocksize - sizeof(struct tag)) {
+    return false;
+  }
+
+  return doCRC((uint8_t *)TagPtr + sizeof(struct tag), crcLen) ==
+         U_endian16(TagPtr->uDescriptorCRC);
+}
+
+static void ScanBlock(udf_volume *vol, const uint8_t *block, uint16_t ptn, uint32_t lbn,
+                      sScanCounts *counts)
+{
+  const struct tag *TagPtr = (const struct tag *)block;
+  uint16_t tagID = U_endian16(TagPtr->uTagID);
+  sScanEntry *entry;
+
+  counts->Blocks++;
+
+  // Blocks the volume says are free may hold stale descriptors; ignore them
+  if (vol->Part_Info[ptn].SpMap && (vol->Part_Info[ptn].SpMap[lbn >> 3] & (1 << (lbn & 7)))) {
+    return;
+  }
+
+  switch (tagID) {
+    case TAGID_FILE_ENTRY:
+    case TAGID_EXT_FILE_ENTRY:
+    case TAGID_INDIRECT:
+    case TAGID_ALLOC_EXTENT:
+    case TAGID_FILE_ID:
+      break;
+
+    default:
+      return;
+  }
+
+  if (!IsValidTag(vol, TagPtr, lbn)) {
+    return;
+  }
+
+  switch (tagID) {
+    case TAGID_FILE_ENTRY:     counts->FE++;  break;
+    case TAGID_EXT_FILE_ENTRY: counts->EFE++; break;
+    case TAGID_INDIRECT:       counts->IE++;  break;
+    case TAGID_ALLOC_EXTENT:   counts->AED++; break;
+    case TAGID_FILE_ID:        counts->FID++; break;
+    default:                                  break;
+  }
+
+  if (vol->ScanIndexLen >= vol->ScanIndexAlloc) {
+    sScanEntry *largerIndex = realloc(vol->ScanIndex, (vol->ScanIndexAlloc + SCAN_INDEX_ALLOC) *
+                                                 sizeof(sScanEntry));
+    if (!largerIndex) {
+      return;
+    }
+    vol->ScanIndex = largerIndex;
+    vol->ScanIndexAlloc += SCAN_INDEX_ALLOC;
+  }
+
+  // The sweep runs in (partition, block) order, so appending keeps the index sorted
+  entry = vol->ScanIndex + vol->ScanIndexLen++;
+  entry->LBN = lbn;
+  entry->Ptn = ptn;
+  entry->TagID = tagID;
+  entry->Referenced = false;
+  entry->Data = NULL;
+  if (vol->ScanStoreBytes + vol->blocksize <= SCAN_STORE_LIMIT) {
+    entry->Data = ArenaAlloc(&vol->Arena, vol->blocksize);
+    if (entry->Data) {
+      memcpy(entry->Data, block, vol->blocksize);
+      vol->ScanStoreBytes += vol->blocksize;
+    }
+  }
+}
+
+static sScanEntry *FindScanEntry(udf_volume *vol, uint16_t ptn, uint32_t lbn)
+{
+  uint32_t lo = 0;
+  uint32_t hi = vol->ScanIndexLen;
+
+  while (lo < hi) {
+    uint32_t mid = lo + ((hi - lo) >> 1);
+    sScanEntry *entry = vol->ScanIndex + mid;
+    if ((entry->Ptn < ptn) || ((entry->Ptn == ptn) && (entry->LBN < lbn))) {
+      lo = mid + 1;
+    } else if ((entry->Ptn == ptn) && (entry->LBN == lbn)) {
+      return entry;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return NULL;
+}
+
+void ScanPartitions(udf_volume *vol)
+{
+  sScanEntry *entry;
+  uint32_t i, notKept;
+  uint16_t ptn;
+  uint32_t chunkBlocks = MAX(SCAN_CHUNK_SIZE >> vol->bdivshift, 1);
+  uint8_t *chunk;
+
+  Information(vol, "\n--Scanning partitions in physical order.\n");
+
+  chunk = malloc(chunkBlocks << vol->bdivshift);
+  if (!chunk) {
+    OperationalError(vol, "**Couldn't allocate memory for partition scan.\n");
+    return;
+  }
+
+  for (ptn = 0; ptn < vol->PTN_no; ptn++) {
+    sScanCounts counts;
+    uint32_t lbn, numBlocks;
+
+    if ((vol->Part_Info[ptn].type != PTN_TYP_REAL) && (vol->Part_Info[ptn].type != PTN_TYP_SPARE)) {
+      Verbose(vol, "  Partition reference %u is not recorded in place, not scanned.\n", ptn);
+      continue;
+    }
+
+    memset(&counts, 0, sizeof(counts));
+    for (lbn = 0; lbn < vol->Part_Info[ptn].Len; lbn += numBlocks) {
+      numBlocks = MIN(chunkBlocks, vol->Part_Info[ptn].Len - lbn);
+      if (!ReadLBlocks(vol, chunk, lbn, ptn, numBlocks)) {
+        for (i = 0; i < numBlocks; i++) {
+          ScanBlock(vol, chunk + (i << vol->bdivshift), ptn, lbn + i, &counts);
+        }
+      } else {
+        // Isolate the unreadable block(s) so the rest of the chunk is indexed
+        for (i = 0; i < numBlocks; i++) {
+          if (!ReadLBlocks(vol, chunk, lbn + i, ptn, 1)) {
+            ScanBlock(vol, chunk, ptn, lbn + i, &counts);
+          } else {
+            counts.Unreadable++;
+          }
+        }
+      }
+    }
+
+    Information(vol, "  Partition reference %u: %u blocks scanned", ptn, counts.Blocks);
+    if (counts.Unreadable) {
+      Information(vol, ", **%u unreadable", counts.Unreadable);
+    }
+    Information(vol, ".\n");
+    Verbose(vol, "    %u File Entries, %u Extended File Entries, %u Indirect Entries,\n",
+            counts.FE, counts.EFE, counts.IE);
+    Verbose(vol, "    %u Allocation Extent Descriptors, %u blocks beginning with a FID.\n",
+            counts.AED, counts.FID);
+  }
+
+  Information(vol, "  Indexed %u descriptors, %u KiB retained for the directory walk.\n",
+              vol->ScanIndexLen, vol->ScanStoreBytes >> 10);
+  for (i = 0, notKept = 0; i < vol->ScanIndexLen; i++) {
+    notKept += !vol->ScanIndex[i].Data;
+  }
+  if (notKept) {
+    Information(vol, "  %u descriptors beyond the %u MiB limit will be read again by the walk.\n",
+                notKept, SCAN_STORE_LIMIT >> 20);
+  }
+
+  // ICBs read while checking the volume descriptors were read before there was an index
+  for (i = 0; i < vol->SystemICBsLen; i++) {
+    entry = FindScanEntry(vol, vol->SystemICBs[i].Ptn, vol->SystemICBs[i].LBN);
+    if (entry) {
+      entry->Referenced = true;
+    }
+  }
+
+  free(chunk);
+}
+
+/*
+ * Return the scanned copy of a partition block, or NULL if the block was not
+ * indexed or its data was not retained.
+ */
+const uint8_t *LookupScannedBlock(udf_volume *vol, uint16_t ptn, uint32_t lbn)
+{
+  sScanEntry *entry;
+
+  if (!vol->ScanIndexLen) {
+    return NULL;
+  }
+
+  entry = FindScanEntry(vol, ptn, lbn);
+  return entry ? entry->Data : NULL;
+}
+
+/*
+ * Translate the address of an ICB into the partition that was scanned for
+ * it. A sparable partition is scanned through its sparing table, so its
+ * addresses stand as they are; virtual and metadata partitions are mapped
+ * onto the partition they are recorded in. Returns false if the block is
+ * not recorded anywhere.
+ */
+static bool ScannedAddress(udf_volume *vol, uint16_t *ptn, uint32_t *lbn)
+{
+  const sPart_Info *part;
+  const sMeta_desc *PM_MD;
+
+  if (*ptn >= vol->PTN_no) {
+    return false;
+  }
+  part = vol->Part_Info + *ptn;
+
+  switch (part->type) {
+    case PTN_TYP_REAL:
+    case PTN_TYP_SPARE:
+      return true;
+
+    case PTN_TYP_VIRTUAL:
+      if (!part->Extra || (*lbn >= part->Len) || (part->Extra[*lbn] == (uint32_t) -1)) {
+        return false;
+      }
+      *lbn = part->Extra[*lbn];
+      *ptn = FindPhysicalPartition(vol, part->Num);
+      return *ptn < vol->PTN_no;
+
+    case PTN_TYP_METADATA:
+      PM_MD = (const sMeta_desc *)part->Extra;
+      if (!PM_MD) {
+        return false;
+      }
+      *lbn = MetaBlockLocation(PM_MD, *lbn);
+      *ptn = PM_MD->PhysRef;
+      return *lbn != (uint32_t) -1;
+
+    default:
+      return false;
+  }
+}
+
+void MarkScannedICB(udf_volume *vol, uint16_t ptn, uint32_t lbn)
+{
+  sScanEntry *entry;
+
+  if (!vol->ScanIndexLen || !ScannedAddress(vol, &ptn, &lbn)) {
+    return;
+  }
+
+  entry = FindScanEntry(vol, ptn, lbn);
+  if (entry) {
+    entry->Referenced = true;
+  }
+}
+
+/*
+ * Record an ICB the checker read outside the directory walk, addressed in
+ * a partition that is recorded in place. It is never reported as
+ * unreferenced, whether it is read before or after the scan.
+ */
+void NoteSystemICB(udf_volume *vol, uint16_t ptn, uint32_t lbn)
+{
+  sScanEntry *entry;
+
+  if (ptn >= vol->PTN_no) {
+    return;
+  }
+
+  if (vol->SystemICBsLen >= vol->SystemICBsAlloc) {
+    uint32_t newAlloc = vol->SystemICBsAlloc ? vol->SystemICBsAlloc * 2 : 8;
+    sSystemICB *larger = realloc(vol->SystemICBs, newAlloc * sizeof(sSystemICB));
+    if (!larger) {
+      return;
+    }
+    vol->SystemICBs = larger;
+    vol->SystemICBsAlloc = newAlloc;
+  }
+  vol->SystemICBs[vol->SystemICBsLen].LBN = lbn;
+  vol->SystemICBs[vol->SystemICBsLen].Ptn = ptn;
+  vol->SystemICBsLen++;
+
+  entry = vol->ScanIndexLen ? FindScanEntry(vol, ptn, lbn) : NULL;
+  if (entry) {
+    entry->Referenced = true;
+  }
+}
+
+/*
+ * Write-once media keep every superseded ICB - including the VAT ICB of
+ * each earlier session - in the partition a virtual partition is built on,
+ * so File Entries found there are expected to be unreferenced.
+ */
+static bool BacksVirtualPartition(udf_volume *vol, uint16_t ptn)
+{
+  uint16_t i;
+
+  for (i = 0; i < vol->PTN_no; i++) {
+    if (   (vol->Part_Info[i].type == PTN_TYP_VIRTUAL)
+        && (FindPhysicalPartition(vol, vol->Part_Info[i].Num) == ptn)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Any (Extended) File Entry found in allocated space that the directory walk
+ * never reached is lost: its space is in use but no FID identifies it.
+ */
+void ReportUnreferencedICBs(udf_volume *vol)
+{
+  uint32_t i, numUnreferenced = 0, numSuperseded = 0;
+
+  Information(vol, "\n--Checking for File Entries not reached from the directory hierarchy.\n");
+
+  for (i = 0; i < vol->ScanIndexLen; i++) {
+    const sScanEntry *entry = vol->ScanIndex + i;
+
+    if (   entry->Referenced
+        || ((entry->TagID != TAGID_FILE_ENTRY) && (entry->TagID != TAGID_EXT_FILE_ENTRY))) {
+      continue;
+    }
+    if (BacksVirtualPartition(vol, entry->Ptn)) {
+      numSuperseded++;
+    } else {
+      MinorError(vol, "**Unreferenced %sFile Entry at %04x:%08x\n",
+                 (entry->TagID == TAGID_EXT_FILE_ENTRY) ? "Extended " : "", entry->Ptn, entry->LBN);
+      numUnreferenced++;
+    }
+  }
+
+  if (numSuperseded) {
+    Verbose(vol, "  %u File Entr%s under a virtual partition taken to be superseded.\n",
+            numSuperseded, (numSuperseded == 1) ? "y" : "ies");
+  }
+  Information(vol, "%s%u unreferenced File Entr%s.\n", numUnreferenced ? "**" : "  ",
+              numUnreferenced, (numUnreferenced == 1) ? "y" : "ies");
+}
+
+void FreeScanIndex(udf_volume *vol)
+{
+  // Block data belongs to Arena
+  free(vol->ScanIndex);
+  free(vol->SystemICBs);
+  vol->ScanIndex = NULL;
+  vol->SystemICBs = NULL;
+  vol->SystemICBsLen = 0;
+  vol->SystemICBsAlloc = 0;
+  vol->ScanIndexLen = 0;
+  vol->ScanIndexAlloc = 0;
+  vol->ScanStoreBytes = 0;
+}
@@ -5,12 +5,8 @@
 #include "nsr.h"
 #include <stdlib.h>
 #include <stdio.h>
-#include <sys/errno.h>
-#include <sys/ioctl.h>
 #include <string.h>
 #include <ctype.h>
-#include <linux/cdrom.h>
-#include <sys/mount.h>
 #include "chkudf.h"
 #include "protos.h"
 
@@ -24,32 +20,19 @@
  * can be at N or N - 256.
  */
 
-int AVDP_Places[] = {-2, -258, 0, -256, -152, -150, -408, -406};
-int End_Places[]  = {-2,   -2, 0,    0, -152, -150, -152, -150};
-int Num_Places = 8;
+#define NUM_AVDP_PLACES 8
 
-bool Get_Last_BGS()
-{
-  unsigned long num512ByteBlocks;
-  int      result;
-  bool     success = false;
+int AVDP_Places[NUM_AVDP_PLACES] = {-2, -258, 0, -256, -152, -150, -408, -406};
+int End_Places[NUM_AVDP_PLACES]  = {-2,   -2, 0,    0, -152, -150, -152, -150};
+int Num_Places = NUM_AVDP_PLACES;
 
-  result = ioctl(device, BLKGETSIZE, &num512ByteBlocks);
-  if (!result) {
-    // Note, 9 == log2(512)
-    LastSector = (uint32_t) (num512ByteBlocks >> (sdivshift - 9)) - 1;
-    LastSectorAccurate = true;
-    success = true;
-  } else if (errno == EFBIG) {
-    uint64_t numBytes;
-    result = ioctl(device, BLKGETSIZE64, &numBytes);
-    if (!result) {
-      LastSector = (uint32_t) (numBytes >> sdivshift) - 1;
-      LastSectorAccurate = true;
-      success = true;
-    }
+bool Get_Last_BGS(udf_volume *vol)
+{
+  if (vol->Geometry.BlockBytesOK) {
+    vol->LastSector = (uint32_t) (vol->Geometry.BlockBytes >> vol->sdivshift) - 1;
+    vol->LastSectorAccurate = true;
   }
-  return success;
+  return vol->Geometry.BlockBytesOK;
 }
 
 /*
@@ -58,52 +41,39 @@ bool Get_Last_BGS()
  * where the first track is numbered other than 1.
  */
 
-bool Get_Last_PRTI()
+bool Get_Last_PRTI(udf_volume *vol)
 {
-  char     *buffer;
-  int      result = 0;
-  int      *ip;
-  int      track_no;
-  bool     success = false;
+  const uint8_t *buffer = vol->Geometry.HPLastTrack;
   uint32_t trackstart, tracklength, freeblocks;
 
-  buffer = malloc(128);
-  ip = (int *)buffer;
-  if (buffer) {
-    memset(cdb, 0, 12);     /* Clear the request buffer */
-    cdb[0] = 0xe5;          /* 4020/6020 Read Track Info */
-    cdb[5] = 1;             /* Really should be from Read TOC, but who ever uses != 1? */
-    cdb[8] = 20;            /* Allocation length in CDB */
-    result = do_scsi(cdb, 10, buffer, 20, 0, sensedata, sensebufsize);
-    if (!result) {
-      track_no = buffer[1];     /* This is really number of tracks, not last TNO! */
-      printf("  Proprietary Read Track Info worked; last track is %d.\n", track_no);
-      cdb[5] = track_no;
-      result = do_scsi(cdb, 10, buffer, 20, 0, sensedata, sensebufsize);
-      if (!result) {
-        trackstart  = S_endian32(*(uint32_t *)(buffer + 2));
-        tracklength = S_endian32(*(uint32_t *)(buffer + 6));
-        freeblocks = S_endian32(ip[3]);
-        /*
-         * Track length includes two run-outs and link 
-         */
-        LastSector = trackstart + tracklength - 3;
-        if (freeblocks) {
-          /*
-           * If the whole track isn't written, subtract the free blocks
-           * and the run-in and run-out sectors that go between the written
-           * and free blocks
-           */
-          LastSector = LastSector - freeblocks - 6;
-        }
-        LastSectorAccurate = true;
-        printf("  Proprietary RTI (e5) worked.\n");
-        success = true;
-      }
-    }
-    free(buffer);
+  if (!vol->Geometry.HPTrack1OK) {
+    return false;
+  }
+
+  /* Byte 1 is really number of tracks, not last TNO! */
+  fprintf(vol->Out, "  Proprietary Read Track Info worked; last track is %d.\n", vol->Geometry.HPTrack1[1]);
+  if (!vol->Geometry.HPLastTrackOK) {
+    return false;
+  }
+
+  trackstart  = S_endian32(*(uint32_t *)(buffer + 2));
+  tracklength = S_endian32(*(uint32_t *)(buffer + 6));
+  freeblocks  = S_endian32(*(uint32_t *)(buffer + 12));
+  /*
+   * Track length includes two run-outs and link 
+   */
+  vol->LastSector = trackstart + tracklength - 3;
+  if (freeblocks) {
+    /*
+     * If the whole track isn't written, subtract the free blocks
+     * and the run-in and run-out sectors that go between the written
+     * and free blocks
+     */
+    vol->LastSector = vol->LastSector - freeblocks - 6;
   }
-  return success;
+  vol->LastSectorAccurate = true;
+  fprintf(vol->Out, "  Proprietary RTI (e5) worked.\n");
+  return true;
 }
 
 /*
@@ -111,192 +81,152 @@ bool Get_Last_PRTI()
  * MMC READ DISC INFORMATION and READ TRACK INFORMATION Commands.  This 
  * works on most newer CD-R/RW drives.
  */
-bool Get_Last_RTI()
+bool Get_Last_RTI(udf_volume *vol)
 {
-  char     *buffer;
-  int      result = 0;
-  int      *ip;
-  int      track_no;
-  bool     success = false;
+  const uint8_t *buffer = vol->Geometry.LastTrack;
+  const uint32_t *ip = (const uint32_t *)buffer;
   uint32_t trackstart, tracklength, freeblocks;
 
-  buffer = malloc(128);
-  ip = (int *)buffer;
-  if (buffer) {
-    memset(cdb, 0, 12);         /* Clear the request buffer */
-    cdb[0] = 0x51;              /* Generic Read Disk Info */
-    cdb[8] = 32;                /* Allocation length in CDB */
-    result = do_scsi(cdb, 10, buffer, 32, 0, sensedata, sensebufsize);
-    if (!result) {
-      track_no = buffer[6];
-      printf("  Generic Read Disc Info worked; last track is %d.\n", track_no);
-      memset(buffer, 0, 128);
-      cdb[0] = 0x52;       /* Read Track Information      */
-      cdb[1] = 1;          /* For a track (not session)   */
-      cdb[5] = track_no;   /* The last track              */
-      cdb[8] = 36;         /* Allocation Length           */
-      result = do_scsi(cdb, 10, buffer, 36, 0, sensedata, sensebufsize);
-      if (!result) {
-        if (buffer[6] & 0x40) {
-          /*
-           * Track is blank; we want the previous one
-           */
-          cdb[5] = track_no - 1;  /* The right last track        */
-          result = do_scsi(cdb, 10, buffer, 36, 0, sensedata, sensebufsize);
-        }
-        if (!result) {
-          trackstart = S_endian32(ip[2]);
-          tracklength = S_endian32(ip[6]);
-          freeblocks = S_endian32(ip[4]);
-          printf("  start %u, length %u, freeblocks %u.\n", trackstart, tracklength, freeblocks);
-          if (buffer[6] & 0x10) {
-            printf("  Packet size %u.\n", S_endian32(ip[5]));
-            LastSector = trackstart + tracklength - 1;
-          } else {
-            printf("  Variable packet written track.\n");
-            LastSector = trackstart + tracklength - 1;
-            if (freeblocks) {
-              LastSector = LastSector - freeblocks - 7;
-            }
-          }
-          LastSectorAccurate = true;
-          printf("  Generic RDI/RTI worked.\n");
-          success = true;
-        }
-      }
-    }
-    free(buffer);
+  if (!vol->Geometry.DiscInfoOK) {
+    return false;
   }
-  return success;
-}
 
-bool Get_Last_ReadCap()
-{
-  char     *buffer;
-  int      result;
-  bool     success = false;
+  fprintf(vol->Out, "  Generic Read Disc Info worked; last track is %d.\n", vol->Geometry.DiscInfo[6]);
+  if (!vol->Geometry.LastTrackOK) {
+    return false;
+  }
 
-  buffer = malloc(128);
-  if (buffer) {
-    memset(cdb, 0, 12);
-    cdb[0] = 0x25;
-    result = do_scsi(cdb, 10, buffer, 8, 0, sensedata, sensebufsize);
-    if (!result) {
-      LastSector = S_endian32(*(uint32_t *)buffer);
-      LastSectorAccurate = true;
-      success = true;
+  trackstart = S_endian32(ip[2]);
+  tracklength = S_endian32(ip[6]);
+  freeblocks = S_endian32(ip[4]);
+  fprintf(vol->Out, "  start %u, length %u, freeblocks %u.\n", trackstart, tracklength, freeblocks);
+  if (buffer[6] & 0x10) {
+    fprintf(vol->Out, "  Packet size %u.\n", S_endian32(ip[5]));
+    vol->LastSector = trackstart + tracklength - 1;
+  } else {
+    fprintf(vol->Out, "  Variable packet written track.\n");
+    vol->LastSector = trackstart + tracklength - 1;
+    if (freeblocks) {
+      vol->LastSector = vol->LastSector - freeblocks - 7;
     }
-    free(buffer);
   }
-  return success;
+  vol->LastSectorAccurate = true;
+  fprintf(vol->Out, "  Generic RDI/RTI worked.\n");
+  return true;
 }
 
-bool Get_Last_ReadTOC()
+bool Get_Last_ReadCap(udf_volume *vol)
 {
-  char     *buffer;
-  int      result;
-  bool     success = false;
-  struct cdrom_tocentry *toc;
+  if (vol->Geometry.ReadCapOK) {
+    vol->LastSector = S_endian32(*(uint32_t *)vol->Geometry.ReadCap);
+    vol->LastSectorAccurate = true;
+  }
+  return vol->Geometry.ReadCapOK;
+}
 
-  buffer = malloc(128);
-  if (buffer) {
-    memset(buffer, 0, 128);
-    toc = (struct cdrom_tocentry *)buffer;
-    toc->cdte_format = CDROM_LBA;
-    toc->cdte_track = 0xaa;
-    result = ioctl(device, CDROMREADTOCENTRY, buffer);
-    if (!result) {
-      LastSector = toc->cdte_addr.lba - 1;
-      success = true;
-    }
-    free(buffer);
+bool Get_Last_ReadTOC(udf_volume *vol)
+{
+  if (vol->Geometry.TocOK) {
+    vol->LastSector = vol->Geometry.TocLeadOut - 1;
   }
-  return success;
+  return vol->Geometry.TocOK;
 }
 
 
-void SetLastSector(void)
+void SetLastSector(udf_volume *vol)
 {
-  LastSector = -1;
-  LastSectorAccurate = false;
-
-  if (scsi) {
-    if (isType5) {             /* Check for CD device */
-      if (!Get_Last_BGS()) {            /* Block Get Size      */
-        if (!Get_Last_PRTI()) {         /* Proprietary RTI     */
-          if (!Get_Last_RTI()) {        /* Generic RTI         */
-            if (!Get_Last_ReadCap()) {  /* Read Capacity       */
-              if (!Get_Last_ReadTOC()) {/* Read TOC            */
-                printf("  Couldn't determine location of last sector.\n");
+  DiscoverGeometry(vol);
+
+  vol->LastSector = -1;
+  vol->LastSectorAccurate = false;
+
+  if (vol->scsi) {
+    if (vol->isType5) {             /* Check for CD device */
+      if (!Get_Last_BGS(vol)) {            /* Block Get Size      */
+        if (!Get_Last_PRTI(vol)) {         /* Proprietary RTI     */
+          if (!Get_Last_RTI(vol)) {        /* Generic RTI         */
+            if (!Get_Last_ReadCap(vol)) {  /* Read Capacity       */
+              if (!Get_Last_ReadTOC(vol)) {/* Read TOC            */
+                fprintf(vol->Out, "  Couldn't determine location of last sector.\n");
               }
             }
           }
         }
       }
     } else {
-      if (!Get_Last_BGS()) {      /* Block Get Size      */
-        if (!Get_Last_ReadCap()) {/* Read Capacity       */
-          printf("  Couldn't read capacity.\n");
+      if (!Get_Last_BGS(vol)) {      /* Block Get Size      */
+        if (!Get_Last_ReadCap(vol)) {/* Read Capacity       */
+          fprintf(vol->Out, "  Couldn't read capacity.\n");
         }
       }
     }
   } else {
-    if (!Get_Last_BGS()) {      /* Block Get Size      */
-      if (!Get_Last_ReadTOC()) {/* Read TOC            */
-        printf("  Couldn't determine location of last sector.\n");
+    if (!Get_Last_BGS(vol)) {      /* Block Get Size      */
+      if (!Get_Last_ReadTOC(vol)) {/* Read TOC            */
+        fprintf(vol->Out, "  Couldn't determine location of last sector.\n");
       }
     }
   }
 }
 
-void SetLastSectorAccurate(void)
+/*
+ * The CD-RW candidates (the last sector of the last full packet of 32,
+ * and 256 before it) and every AVDP_Places[] candidate are read in one
+ * batch, then checked in order of preference.
+ */
+void SetLastSectorAccurate(udf_volume *vol)
 {
+  sReadRequest candidates[2 + NUM_AVDP_PLACES];
   uint32_t TrialAddress;
-  int      i, error;
+  int      i;
   int      found = false;
-  struct tag *avdptag;
+  uint8_t *buffer;
+
+  buffer = malloc((2 + Num_Places) * vol->secsize);
+  if (buffer) {
+    TrialAddress = 32 * ((vol->LastSector + 38) / 39) - 1;
+    for (i = 0; i < 2 + Num_Places; i++) {
+      uint32_t location;
+      if (i < 2) {
+        location = TrialAddress - 256 * i;
+      } else {
+        location = vol->LastSector + AVDP_Places[i - 2];
+      }
+      candidates[i].Offset = (uint64_t) location << vol->sdivshift;
+      candidates[i].Length = vol->secsize;
+      candidates[i].Buffer = buffer + i * vol->secsize;
+    }
+    ReadBatch(vol, candidates, 2 + Num_Places);
 
-  avdptag = (struct tag *)malloc(secsize);
-  if (avdptag) {
     /* Maybe it's CD-RW media - check first. */
-    isCDRW = false;
-    TrialAddress = 32 * ((LastSector + 38) / 39) - 1;
-    error = ReadSectors(avdptag, TrialAddress, 1);
-    if (!error) {
-      found = !CheckTag(avdptag, TrialAddress, 2, 0, secsize);
-      ClearError();
+    vol->isCDRW = false;
+    for (i = 0; (i < 2) && !found; i++) {
+      if (candidates[i].OK) {
+        found = !CheckTag(vol, (struct tag *)candidates[i].Buffer, TrialAddress - 256 * i,
+                          2, 0, vol->secsize);
+        ClearError(vol);
+      }
     }
     if (found) {
-      LastSector = TrialAddress;
-      isCDRW = true;
-    } else {
-      TrialAddress -= 256;
-      error = ReadSectors(avdptag, TrialAddress, 1);
-      if (!error) {
-        found = !CheckTag(avdptag, TrialAddress, 2, 0, secsize);
-        ClearError();
-      }
-      if (found) {
-        LastSector = TrialAddress + 256;
-        isCDRW = true;
-      }
+      vol->LastSector = TrialAddress;
+      vol->isCDRW = true;
     }
 
     for (i = 0; (i < Num_Places) && (!found); i++) {
-      TrialAddress = LastSector + AVDP_Places[i];
-      error = ReadSectors(avdptag, TrialAddress, 1);
-      if (!error) {
-        found = !CheckTag(avdptag, TrialAddress, 2, 0, secsize);
-        ClearError();
+      if (candidates[2 + i].OK) {
+        found = !CheckTag(vol, (struct tag *)candidates[2 + i].Buffer,
+                          vol->LastSector + AVDP_Places[i], 2, 0, vol->secsize);
+        ClearError(vol);
       }
       if (found) {
-        LastSector += End_Places[i];
+        vol->LastSector += End_Places[i];
       }
     }
+    free(buffer);
   } else {
-    printf("**Couldn't allocate memory for setting last block accurately.\n");
+    fprintf(vol->Out, "**Couldn't allocate memory for setting last block accurately.\n");
   }
   if (found) {
-    printf("  Adjusted last sector to %u.\n", LastSector);
+    fprintf(vol->Out, "  Adjusted last sector to %u.\n", vol->LastSector);
   }
 }
@@ -2,8 +2,9 @@
 // Copyright (c) 1999 Rob Simms. All rights reserved.
 
 #include <sys/types.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
-#include <blkid/blkid.h>     // libblkid
+#include <linux/fs.h>        // BLKSECTGET
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,116 +15,82 @@
 #include "chkudf.h"
 #include "protos.h"
 
-void SetSectorSize(void)
+void SetSectorSize(udf_volume *vol)
 {
-  char   *buffer;
-  char   *avdpbuf;
-  int    result, found;
-  struct stat fileinfo;
-  bool bFullDiskBlockDevice = false;
+  uint8_t *buffer;
 
-  secsize = 0;
+  vol->secsize = 0;
 
-  if ((fstat(device, &fileinfo) == 0) && S_ISBLK(fileinfo.st_mode)) {
-    char diskname[32];
-    dev_t fullDiskDev = 0;
-    result = blkid_devno_to_wholedisk(fileinfo.st_rdev, diskname,
-                                      sizeof(diskname), &fullDiskDev);
-    if (result == 0) {
-      bFullDiskBlockDevice = (fileinfo.st_rdev == fullDiskDev);
-    }
-  }
-  if (bFullDiskBlockDevice) {
+  DiscoverGeometry(vol);
+
+  if (vol->Geometry.InquiryOK) {
     /*
-     * The device is a block device, let's try some SCSI stuff...
+     * INQUIRY worked
      */
-    buffer = malloc(128);
-    if (buffer) {
-      memset(cdb, 0, 12);
-      cdb[0] = 0x12;
-      cdb[4] = 44;
-      result = do_scsi(cdb, 6, buffer, 44, 0, sensedata, sensebufsize);
-      if (!result) {
+    vol->scsi = 1;       // SCSI commands work on this device
+    vol->sg_async = vol->Geometry.SgDevice && !vol->SgStalled;
+    buffer = vol->Geometry.Inquiry;
+    fprintf(vol->Out, "  Device is: '%.28s' (type %d)\n", buffer + 8, buffer[0] & 0x1f);
+    if ((buffer[0] & 0x1f) == 5) {  // Test for CD/DVD
+      vol->isType5 = true;
+      vol->secsize = 2048;
+      fprintf(vol->Out, "  Setting sector size to %u for CD/DVD device.\n", vol->secsize);
+    } else {
+      if (vol->Geometry.ReadCapOK) {
+        vol->secsize = S_endian32(*(uint32_t *)(vol->Geometry.ReadCap + 4));
+        fprintf(vol->Out, "  READ CAPACITY reports a sector size of %u (0x%x).\n", vol->secsize, vol->secsize);
+      }
+      if (!vol->secsize && vol->Geometry.ModeSenseOK) {
         /*
-         * INQUIRY worked
+         * MODE SENSE worked
          */
-        scsi = 1;       // SCSI commands work on this device
-        buffer[36] = 0;
-        printf("  Device is: '%s' (type %d)\n", buffer + 8, buffer[0] & 0x1f);
-        if ((buffer[0] & 0x1f) == 5) {  // Test for CD/DVD
-          isType5 = true;
-          secsize = 2048;
-          printf("  Setting sector size to %u for CD/DVD device.\n", secsize);
-        } else {
-          memset(cdb, 0, 12);
-          cdb[0] = 0x25;
-          result = do_scsi(cdb, 10, buffer, 8, 0, sensedata, sensebufsize);
-          if (!result) {
-            secsize = S_endian32(*(uint32_t *)(buffer + 4));
-            printf("  READ CAPACITY reports a sector size of %u (0x%x).\n", secsize, secsize);
-          }
-          if (!secsize) {
-            scsi_modesense10(cdb, 0, 0, 0, 0);      // Get block descriptor
-            result = do_scsi(cdb, 10, buffer, 16, 0, sensedata, sensebufsize);
-            if (!result) {
-              /*
-               * MODE SENSE worked
-               */
-              if (S_endian16(*(uint16_t *)(buffer + 6)) == 8) {
-                /*
-                 * MODE SENSE returned a block descriptor
-                 */
-                secsize = *(int *)(buffer + 12);
-                secsize = S_endian32(secsize) & 0x00ffffff;
-                printf("  Mode Sense shows %u (0x%x) byte sectors.\n", secsize, secsize);
-              }  //if (block descriptor)
-            }  //if (mode sense worked)
-          }
-        }  //if (not a CD)
-      }  //if (scsi device)
-      free(buffer);
+        buffer = vol->Geometry.ModeSense;
+        if (S_endian16(*(uint16_t *)(buffer + 6)) == 8) {
+          /*
+           * MODE SENSE returned a block descriptor
+           */
+          vol->secsize = S_endian32(*(uint32_t *)(buffer + 12)) & 0x00ffffff;
+          fprintf(vol->Out, "  Mode Sense shows %u (0x%x) byte sectors.\n", vol->secsize, vol->secsize);
+        }  //if (block descriptor)
+      }
+    }  //if (not a CD)
+  }  //if (scsi device)
+
+  if (vol->secsize == 0) {                 /* Block size still not set */
+    vol->secsize = GuessSectorSize(vol);
+    if (vol->secsize) {
+      fprintf(vol->Out, "  Guessing revealed %u byte sector size.\n", vol->secsize);
+    } else {
+      vol->secsize = 0x800;
+      fprintf(vol->Out, "**Guessing failed - assuming %u byte sector size.\n", vol->secsize);
     }
   }
-  if (secsize == 0) {                 /* Block size still not set */
-    secsize = 0x200;
-    found = false;
-    avdpbuf = malloc(MAX_SECTOR_SIZE);
-    if (avdpbuf) {
-      secsize >>= 1;    // Precompensate for initial 'secsize <<= 1'
-      while ((secsize < MAX_SECTOR_SIZE) && !found) {
-        secsize <<= 1;
-        lseek(device, 256 * secsize, SEEK_SET);
-      
-        result = read(device, avdpbuf, secsize);
-        if (result == -1) {
-          printf("\n**Read error #%d\n", errno);
-        } else {
-          found = !CheckTag((struct tag *)avdpbuf, 256, 2, 0, MAX_SECTOR_SIZE);
-          ClearError();
-          if (!found) {
-            found = !CheckTag((struct tag *)avdpbuf, 512, 2, 0, MAX_SECTOR_SIZE);
-            ClearError();
-            if (found) {
-              secsize >>= 1;
-            }
-          }
-        }
-      }
-      if (found) {
-        printf("  Guessing revealed %u byte sector size.\n", secsize);
-      } else {
-        secsize = 0;
+
+  if (vol->secsize == 0) vol->secsize = 1;
+  while (!((1 << vol->sdivshift) & vol->secsize)) {
+    vol->sdivshift++;
+  }
+
+  if (vol->scsi) {
+    /*
+     * Size multi-sector READs to what the host adapter will take in one
+     * request.  BLKSECTGET reports this in 512-byte units.
+     */
+    unsigned short maxSectors512 = 0;
+    int maxBytes = 0;
+    uint32_t maxXferBytes = SCSI_DEFAULT_XFER;
+    if (vol->sg_async) {
+      // The sg driver reports the limit in bytes
+      if ((ioctl(vol->device, BLKSECTGET, &maxBytes) == 0) && (maxBytes > 0)) {
+        maxXferBytes = (uint32_t) maxBytes;
       }
-      free(avdpbuf);
+    } else if ((ioctl(vol->device, BLKSECTGET, &maxSectors512) == 0) && maxSectors512) {
+      maxXferBytes = (uint32_t) maxSectors512 << 9;
     }
-    if (secsize == 0) {
-      secsize = 0x800;
-      printf("**Guessing failed - assuming %u byte sector size.\n", secsize);
+    vol->scsi_max_xfer = MAX(maxXferBytes >> vol->sdivshift, 1);
+    Verbose(vol, "  SCSI reads limited to %u sectors per command.\n", vol->scsi_max_xfer);
+    if (vol->sg_async) {
+      Verbose(vol, "  Up to %u SCSI reads will be queued at once.\n", SG_ASYNC_DEPTH);
     }
   }
-
-  if (secsize == 0) secsize = 1;
-  while (!((1 << sdivshift) & secsize)) {
-    sdivshift++;
-  }
 }
@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (c) 2026 Steve Magnani. All rights reserved.
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <scsi/sg.h>
+#include "nsr.h"
+#include "chkudf.h"
+#include "protos.h"
+
+/*
+ * Asynchronous SCSI commands through the sg driver.
+ *
+ * SG_IO blocks until the command completes, so the drive never sees more
+ * than one command from us at a time. On a /dev/sg* node the same sg_io_hdr
+ * can instead be written to the file descriptor, which queues the command
+ * and returns immediately; the completion is collected later by reading a
+ * header back. This keeps up to SG_ASYNC_DEPTH commands outstanding so that
+ * drives with command queueing can work on the next transfer while the
+ * previous one is being processed, and lets independent queries such as
+ * those made during geometry discovery be issued together.
+ *
+ * Commands are identified by a tag (slot index + 1) carried in pack_id.
+ * A slot stays reserved from sg_async_submit() until its owner collects the
+ * result with sg_async_wait(), even if the completion was read earlier while
+ * waiting for some other command.
+ *
+ * The device transfers into a buffer owned by the slot, and the data is
+ * copied to the caller's buffer when the command is collected. If a command
+ * never completes, its slot and buffer are left to it for good, so a late
+ * completion cannot land in memory the caller has since reused. Queueing is
+ * then disabled and every later read is made synchronously.
+ */
+
+/*
+ * Returns true if 'device' is an sg node that accepts queued commands.
+ */
+bool sg_async_available(udf_volume *vol)
+{
+  int version = 0;
+  int queueing = 1;
+
+  if ((ioctl(vol->device, SG_GET_VERSION_NUM, &version) < 0) || (version < 30000)) {
+    return false;
+  }
+
+  // Older sg drivers only queue more than one command per fd on request
+  ioctl(vol->device, SG_SET_COMMAND_Q, &queueing);
+  return true;
+}
+
+/*
+ * Queue a command that transfers in_len bytes from the device into buffer,
+ * which must stay valid until sg_async_wait() is called for the returned tag.
+ * The buffer is only written by sg_async_wait(), never by the device.
+ *
+ * Returns the command's tag, or 0 if no slot is free or the command could
+ * not be queued.
+ */
+int sg_async_submit_cdb(udf_volume *vol, const uint8_t *command, int cmd_len, void *buffer,
+                        uint32_t in_len)
+{
+  sSgSlot *slot;
+  int i;
+
+  if (vol->SgStalled) {
+    return 0;
+  }
+
+  for (i = 0; (i < SG_ASYNC_DEPTH) && vol->SgSlots[i].InUse; i++) ;
+  if ((i == SG_ASYNC_DEPTH) || (cmd_len > sizeof(slot->cdb))) {
+    return 0;
+  }
+  slot = vol->SgSlots + i;
+  if (in_len > slot->Allocated) {
+    void *newBuffer = NULL;
+    free(slot->Buffer);
+    if (posix_memalign(&newBuffer, IO_BUFFER_ALIGN, in_len)) {
+      newBuffer = NULL;
+    }
+    slot->Buffer = newBuffer;
+    slot->Allocated = newBuffer ? in_len : 0;
+    if (!newBuffer) {
+      return 0;
+    }
+  }
+  memcpy(slot->cdb, command, cmd_len);
+
+  memset(&slot->io, 0, sizeof(slot->io));
+  slot->io.interface_id = 'S';
+  slot->io.cmdp = slot->cdb;
+  slot->io.cmd_len = cmd_len;
+  slot->io.sbp = slot->sense;
+  slot->io.mx_sb_len = sizeof(slot->sense);
+  slot->io.timeout = g_scsiTimeout * 1000;
+  slot->io.flags = SG_FLAG_DIRECT_IO;
+  slot->io.dxfer_direction = in_len ? SG_DXFER_FROM_DEV : SG_DXFER_NONE;
+  slot->io.dxferp = slot->Buffer;
+  slot->io.dxfer_len = in_len;
+  slot->io.pack_id = i + 1;
+
+  if (write(vol->device, &slot->io, sizeof(slot->io)) != sizeof(slot->io)) {
+    Debug(vol, "  sg write error %d queueing command %02x.\n", errno, command[0]);
+    return 0;
+  }
+
+  slot->Dest = buffer;
+  slot->InUse = true;
+  slot->Done = false;
+  slot->OK = false;
+  return i + 1;
+}
+
+/*
+ * Queue a READ of Count sectors at address into buffer.
+ */
+int sg_async_submit(udf_volume *vol, uint8_t *buffer, uint32_t address, uint32_t Count)
+{
+  uint8_t readCdb[12];
+
+  if (!vol->sg_async) {
+    return 0;
+  }
+
+  if (Count > 0xFFFF) {
+    scsi_read12(readCdb, address, Count, vol->secsize, 0, 0, 0);
+    return sg_async_submit_cdb(vol, readCdb, 12, buffer, Count * vol->secsize);
+  }
+
+  scsi_read10(readCdb, address, Count, vol->secsize, 0, 0, 0);
+  return sg_async_submit_cdb(vol, readCdb, 10, buffer, Count * vol->secsize);
+}
+
+/*
+ * Give up on queued commands after one failed to complete. Commands still
+ * outstanding keep their slots, and with them the buffers they transfer
+ * into; nothing more is queued.
+ */
+static void sg_async_stall(udf_volume *vol)
+{
+  vol->SgStalled = true;
+  vol->sg_async = false;
+  OperationalError(vol, "**Queued SCSI commands disabled; reading synchronously from here on.\n");
+}
+
+/*
+ * Read back one completed command, whichever finishes first.
+ */
+static bool sg_async_reap(udf_volume *vol)
+{
+  struct sg_io_hdr io;
+  struct pollfd pfd;
+  sSgSlot *slot;
+
+  pfd.fd = vol->device;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  // Allow the driver's own timeout to expire first
+  if (poll(&pfd, 1, (g_scsiTimeout + 5) * 1000) <= 0) {
+    fprintf(vol->Out, "**Timed out waiting for a queued SCSI command.\n");
+    sg_async_stall(vol);
+    return false;
+  }
+
+  memset(&io, 0, sizeof(io));
+  io.interface_id = 'S';
+  io.pack_id = -1;
+  if (read(vol->device, &io, sizeof(io)) != sizeof(io)) {
+    fprintf(vol->Out, "**sg read error %d collecting a queued SCSI command.\n", errno);
+    sg_async_stall(vol);
+    return false;
+  }
+
+  if ((io.pack_id < 1) || (io.pack_id > SG_ASYNC_DEPTH) || !vol->SgSlots[io.pack_id - 1].InUse) {
+    return true;    // Not one of ours - nothing to record
+  }
+
+  slot = vol->SgSlots + io.pack_id - 1;
+  slot->Done = true;
+  slot->OK = ((io.info & SG_INFO_OK_MASK) == SG_INFO_OK);
+  if (!slot->OK && (io.sb_len_wr > 0)) {
+    uint8_t key, asc, ascq;
+    decode_sense(slot->sense, io.sb_len_wr, &key, &asc, &ascq);
+    Debug(vol, "  Queued command failed with sense %x/%02x/%02x.\n", key, asc, ascq);
+  }
+  return true;
+}
+
+/*
+ * Wait for the command identified by tag and release its slot.
+ * Returns true if the command completed successfully. No error is printed;
+ * callers decide whether to retry synchronously.
+ */
+bool sg_async_wait(udf_volume *vol, int tag)
+{
+  sSgSlot *slot;
+  bool ok;
+
+  if ((tag < 1) || (tag > SG_ASYNC_DEPTH) || !vol->SgSlots[tag - 1].InUse) {
+    return false;
+  }
+
+  slot = vol->SgSlots + tag - 1;
+  while (!slot->Done) {
+    if (vol->SgStalled || !sg_async_reap(vol)) {
+      // The command may still own the slot's buffer; keep the slot out of use
+      return false;
+    }
+  }
+
+  ok = slot->OK;
+  if (ok && slot->io.dxfer_len) {
+    memcpy(slot->Dest, slot->Buffer, slot->io.dxfer_len);
+  }
+  slot->InUse = false;
+  return ok;
+}
+
+/*
+ * Free the slots' buffers. The buffer of a command that never completed is
+ * left allocated, since the device may still write to it.
+ */
+void sg_async_free(udf_volume *vol)
+{
+  int i;
+
+  for (i = 0; i < SG_ASYNC_DEPTH; i++) {
+    if (!vol->SgSlots[i].InUse) {
+      free(vol->SgSlots[i].Buffer);
+      vol->SgSlots[i].Buffer = NULL;
+      vol->SgSlots[i].Allocated = 0;
+    }
+  }
+}
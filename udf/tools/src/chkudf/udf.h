@@ -34,6 +34,7 @@
 #define E_REGID_VAT      "*UDF Virtual Alloc Tbl"
 #define E_REGID_SPARE    "*UDF Sparing Table"
 #define E_REGID_CD_SP    "*UDF Sparable Partition"
+#define E_REGID_META     "*UDF Metadata Partition"
 
 #define OSCLASS_UNDEF    0
 #define OSCLASS_DOS      1
@@ -59,6 +60,11 @@
 /* UDF 2.2.10 Virtual Allocation Table -------------------------*/
 #define FILE_TYPE_VAT             248  /* UDF 2.00 and later */
 
+/* UDF 2.2.13 Metadata Partition ------------------------------*/
+#define FILE_TYPE_METADATA        250  /* UDF 2.50 and later */
+#define FILE_TYPE_METADATA_MIRROR 251
+#define FILE_TYPE_METADATA_BITMAP 252
+
 /* UDF 2.2.11 Sparing Table for CD-RW --------------------------*/
 struct SparingTable {
     struct tag sTag;       /* uTagID = 0 */
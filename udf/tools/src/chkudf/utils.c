@@ -77,14 +77,14 @@ uint16_t doCRC(uint8_t *buffer, int n)
 /* Supports OSTA Compressed Unicode, but if no Compression algorithm */
 /* supplied, will print out ASCII string.                            */
 /*********************************************************************/
-void printDstring(const uint8_t *start, uint8_t fieldLen)
+void printDstring(udf_volume *vol, const uint8_t *start, uint8_t fieldLen)
 {
     /* First, grab the length of the string */
     uint8_t dstringLen = start[fieldLen - 1];
 
     /* Then, hand it all off to Dchars */
-    printDchars(start, dstringLen);
-    printf("\n");
+    printDchars(vol, start, dstringLen);
+    fprintf(vol->Out, "\n");
     return;
 }
 
@@ -94,7 +94,7 @@ void printDstring(const uint8_t *start, uint8_t fieldLen)
 /* Supports OSTA Compressed Unicode, but if no Compression algorithm */
 /* supplied, will print out ASCII string.                            */
 /*********************************************************************/
-void printDchars(const uint8_t *start, uint8_t length)
+void printDchars(udf_volume *vol, const uint8_t *start, uint8_t length)
 {
   /* Some (one) local variable(s) */
   uint16_t i;                       /* Index  */
@@ -127,47 +127,47 @@ void printDchars(const uint8_t *start, uint8_t length)
 
   /* Print out the characters. */
   if ( alg == 16 ) {
-    printf("\"");
+    fprintf(vol->Out, "\"");
     for (i=0;i<dispLen;i++,i++) {
       unichar = *(start + i) << 8;
       unichar |= *(start + i + 1);
       if ((unichar > 31) && (unichar < 127)) {
-        printf("%c", (uint8_t)unichar);
+        fprintf(vol->Out, "%c", (uint8_t)unichar);
       } else {
-        printf("[%4x]", unichar);
+        fprintf(vol->Out, "[%4x]", unichar);
       }
     }
-    printf("\"");
+    fprintf(vol->Out, "\"");
   } else {
     /* Now make a copy of all the bytes, to make sure we have a null
        termination */
     strncpy( tbuff, (const char*) start, dispLen); /* copy over just enough characters */
     tbuff[dispLen]=0;           /* null terminate the string */
-    printf("'%s'", tbuff);    /* print it out */
+    fprintf(vol->Out, "'%s'", tbuff);    /* print it out */
   }
   return;
 }
 
-void printExtentAD(struct extent_ad extent)
+void printExtentAD(udf_volume *vol, struct extent_ad extent)
 {
-  printf("%u [0x%08x] @ %u [0x%08x]\n",
-         U_endian32(extent.Length), U_endian32(extent.Length),
-         U_endian32(extent.Location), U_endian32(extent.Location));
+  fprintf(vol->Out, "%u [0x%08x] @ %u [0x%08x]\n",
+          U_endian32(extent.Length), U_endian32(extent.Length),
+          U_endian32(extent.Location), U_endian32(extent.Location));
 }
 
-void printCharSpec(struct charspec chars)
+void printCharSpec(udf_volume *vol, struct charspec chars)
 {
   int i;
 
-  printf("[%u] ", (int)chars.uCharSetType);
+  fprintf(vol->Out, "[%u] ", (int)chars.uCharSetType);
   for (i = 0; i < 63; i++) {
     if (chars.aCharSetInfo[i]) {
-      printf("%c", chars.aCharSetInfo[i]);
+      fprintf(vol->Out, "%c", chars.aCharSetInfo[i]);
     } else {
       i = 64;
     }
   }
-  printf("\n");
+  fprintf(vol->Out, "\n");
 }
 
 int Is_Charspec(const struct charspec *chars)
@@ -195,36 +195,36 @@ int Is_Charspec(const struct charspec *chars)
 /********************************************************************/
 /* Display an ISO/IEC 13346 timestamp structure                     */
 /********************************************************************/
-void printTimestamp( struct timestamp Time)
+void printTimestamp(udf_volume *vol,  struct timestamp Time)
 {
   /* assumes character is positioned, ends with newline */
 
   int tp = GetTSTP(U_endian16(Time.uTypeAndTimeZone));
   int tz = GetTSTZ(U_endian16(Time.uTypeAndTimeZone));
 
-  printf("%4.4u/%2.2u/%2.2u ",
-         U_endian16(Time.iYear), Time.uMonth, Time.uDay);
-  printf("%2.2u:%2.2u:%2.2u.",
-         Time.uHour, Time.uMinute, Time.uSecond);
-  printf("%2.2u%2.2u%2.2u",
-         Time.uCentiseconds,Time.uHundredMicroseconds,Time.uMicroseconds);
-  printf(" (%s)",
-         (tp == 0 ? "UTC" :
-          (tp == 1 ? "Local" :
-           "Non-ISO")));
-  printf(", %d %s\n",
-         tz,(tz == -2047 ? "(No timezone specified)" :
-             (tz <= 1440 && tz >= -1440 ? "min. from UTC" :
-              "(***INVALID timezone value***)")));
+  fprintf(vol->Out, "%4.4u/%2.2u/%2.2u ",
+          U_endian16(Time.iYear), Time.uMonth, Time.uDay);
+  fprintf(vol->Out, "%2.2u:%2.2u:%2.2u.",
+          Time.uHour, Time.uMinute, Time.uSecond);
+  fprintf(vol->Out, "%2.2u%2.2u%2.2u",
+          Time.uCentiseconds,Time.uHundredMicroseconds,Time.uMicroseconds);
+  fprintf(vol->Out, " (%s)",
+          (tp == 0 ? "UTC" :
+           (tp == 1 ? "Local" :
+            "Non-ISO")));
+  fprintf(vol->Out, ", %d %s\n",
+          tz,(tz == -2047 ? "(No timezone specified)" :
+              (tz <= 1440 && tz >= -1440 ? "min. from UTC" :
+               "(***INVALID timezone value***)")));
 }
 
 /********************************************************************/
 /* Display a long_ad structure                                      */
 /********************************************************************/
-void printLongAd(struct long_ad *longad)
+void printLongAd(udf_volume *vol, struct long_ad *longad)
 {
-  printf("%u bytes @ %u:%u\n", EXTENT_LENGTH(longad->ExtentLengthAndType),
-         U_endian16(longad->Location_PartNo), U_endian32(longad->Location_LBN));
+  fprintf(vol->Out, "%u bytes @ %u:%u\n", EXTENT_LENGTH(longad->ExtentLengthAndType),
+          U_endian16(longad->Location_PartNo), U_endian32(longad->Location_LBN));
 }
 
 unsigned int countSetBits(unsigned int value)
@@ -242,6 +242,79 @@ unsigned int countSetBits(unsigned int value)
   return numSetBits;
 }
 
+#define DIGEST_PRIME1  UINT64_C(0x9E3779B185EBCA87)
+#define DIGEST_PRIME2  UINT64_C(0xC2B2AE3D27D4EB4F)
+#define DIGEST_PRIME3  UINT64_C(0x165667B19E3779F9)
+#define DIGEST_PRIME4  UINT64_C(0x85EBCA77C2B2AE63)
+#define DIGEST_PRIME5  UINT64_C(0x27D4EB2F165667C5)
+#define ROTL64(x, r)   (((x) << (r)) | ((x) >> (64 - (r))))
+
+/*
+ * 64-bit digest of a buffer, computed the way xxHash64 does it. The four
+ * lanes are independent, so the compiler can keep them in vector
+ * registers. Digests are only ever compared within one run of the
+ * checker, so words are taken in host byte order.
+ */
+uint64_t BlockDigest(const void *data, size_t length)
+{
+  const uint8_t *bytes = data;
+  uint64_t lane[4] = { DIGEST_PRIME1 + DIGEST_PRIME2, DIGEST_PRIME2, 0, -DIGEST_PRIME1 };
+  uint64_t digest, word;
+  size_t i = 0;
+  int j;
+
+  for (; i + 32 <= length; i += 32) {
+    for (j = 0; j < 4; j++) {
+      memcpy(&word, bytes + i + 8 * j, sizeof(word));
+      lane[j] += word * DIGEST_PRIME2;
+      lane[j] = ROTL64(lane[j], 31) * DIGEST_PRIME1;
+    }
+  }
+
+  digest = ROTL64(lane[0], 1) + ROTL64(lane[1], 7) + ROTL64(lane[2], 12) + ROTL64(lane[3], 18);
+  for (j = 0; j < 4; j++) {
+    digest ^= ROTL64(lane[j] * DIGEST_PRIME2, 31) * DIGEST_PRIME1;
+    digest = digest * DIGEST_PRIME1 + DIGEST_PRIME4;
+  }
+  digest += length;
+
+  // Block sizes are multiples of 32, but allow for anything
+  for (; i < length; i++) {
+    digest ^= bytes[i] * DIGEST_PRIME5;
+    digest = ROTL64(digest, 11) * DIGEST_PRIME1;
+  }
+
+  digest ^= digest >> 33;
+  digest *= DIGEST_PRIME2;
+  digest ^= digest >> 29;
+  digest *= DIGEST_PRIME3;
+  digest ^= digest >> 32;
+  return digest;
+}
+
+/*
+ * Test whether a buffer holds only zeros, a word at a time.
+ */
+bool IsZeroBuffer(const void *data, size_t length)
+{
+  const uint8_t *bytes = data;
+  uint64_t word;
+  size_t i = 0;
+
+  for (; i + sizeof(word) <= length; i += sizeof(word)) {
+    memcpy(&word, bytes + i, sizeof(word));
+    if (word) {
+      return false;
+    }
+  }
+  for (; i < length; i++) {
+    if (bytes[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
 // As of 2019-02-27
 bool IsKnownUDFVersion(uint16_t bcdVersion)
 {
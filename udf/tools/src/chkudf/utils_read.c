@@ -2,104 +2,390 @@
 // Copyright (c) 1999 Rob Simms. All rights reserved.
 // Copyright (c) 2019 Digital Design Corporation. All rights reserved.
 
-#define _LARGEFILE64_SOURCE    // lseek64()
+#define _LARGEFILE64_SOURCE    // pread64()
+#include <aio.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>           // posix_fadvise()
 #include "nsr.h"
 #include "chkudf.h"
 #include "protos.h"
 
+/*
+ * Outcome of a single read command.
+ */
+typedef enum {
+  READ_OK,            // Data transferred (possibly short, at end of file)
+  READ_FAILED,        // The medium could not deliver the data
+  READ_REJECTED       // The device refused the request, e.g. beyond its end
+} eReadResult;
+
+/*
+ * Issue a single SCSI READ for Count sectors.
+ */
+static bool ScsiReadCommand(udf_volume *vol, uint8_t *buffer, uint32_t address,
+                            uint32_t Count)
+{
+  if (Count > 0xFFFF) {
+    scsi_read12(vol->cdb, address, Count, vol->secsize, 0, 0, 0);
+    return !do_scsi(vol, vol->cdb, 12, buffer, Count * vol->secsize, 0, vol->sensedata, vol->sensebufsize);
+  }
+
+  scsi_read10(vol->cdb, address, Count, vol->secsize, 0, 0, 0);
+  return !do_scsi(vol, vol->cdb, 10, buffer, Count * vol->secsize, 0, vol->sensedata, vol->sensebufsize);
+}
+
+/*
+ * Read Count sectors with one command. *numRead is the number of sectors
+ * transferred, which is less than Count only when a file ends early.
+ */
+static eReadResult ReadCommand(udf_volume *vol, uint8_t *buffer, uint32_t address,
+                               uint32_t Count, uint32_t *numRead)
+{
+  *numRead = 0;
+
+  if (vol->scsi) {
+    uint8_t key, asc, ascq;
+
+    memset(vol->sensedata, 0, vol->sensebufsize);
+    if (ScsiReadCommand(vol, buffer, address, Count)) {
+      *numRead = Count;
+      return READ_OK;
+    }
+    decode_sense(vol->sensedata, vol->sensebufsize, &key, &asc, &ascq);
+    return (key == 0x05) ? READ_REJECTED : READ_FAILED;   // ILLEGAL REQUEST
+  } else {
+    ssize_t result = pread64(vol->device, buffer, (size_t) Count * vol->secsize,
+                             address * (off64_t) vol->secsize);
+    if (result < 0) {
+      return (errno == EINVAL) ? READ_REJECTED : READ_FAILED;
+    }
+    *numRead = (uint32_t) (result >> vol->sdivshift);
+    return READ_OK;
+  }
+}
+
+static bool RecoverRange(udf_volume *vol, uint8_t *buffer, uint32_t address, uint32_t Count,
+                         eReadResult result);
+
+/*
+ * Read a range of sectors. Sectors already in the bad sector map are not
+ * read again; they, and any sectors that turn out to be bad, are returned
+ * as zeros so the rest of the range is still usable.
+ *
+ * Returns true only if every sector in the range was read.
+ */
+static bool ReadRange(udf_volume *vol, uint8_t *buffer, uint32_t address, uint32_t Count)
+{
+  uint32_t bad, numRead;
+  eReadResult result;
+
+  bad = FirstBadSector(vol, address, Count);
+  if (bad < Count) {
+    if (bad > 0) {
+      ReadRange(vol, buffer, address, bad);
+    }
+    memset(buffer + bad * vol->secsize, 0, vol->secsize);
+    if (bad + 1 < Count) {
+      ReadRange(vol, buffer + (bad + 1) * vol->secsize, address + bad + 1, Count - bad - 1);
+    }
+    return false;
+  }
+
+  result = ReadCommand(vol, buffer, address, Count, &numRead);
+  if (result == READ_OK) {
+    if (numRead == Count) {
+      return true;
+    }
+    // End of file - there is nothing more to find
+    memset(buffer + numRead * vol->secsize, 0, (Count - numRead) * vol->secsize);
+    return false;
+  }
+
+  return RecoverRange(vol, buffer, address, Count, result);
+}
+
+/*
+ * Handle a failed read of a range by splitting it in half, so only the
+ * sectors around a bad one end up being read individually. A single sector
+ * is retried g_readRetries times before it is entered in the bad sector map.
+ * If a transfer fails but both of its halves succeed, the device is assumed
+ * to be unable to handle transfers that large and scsi_max_xfer is reduced.
+ */
+static bool RecoverRange(udf_volume *vol, uint8_t *buffer, uint32_t address, uint32_t Count,
+                         eReadResult result)
+{
+  uint32_t half, attempt, numRead;
+  bool firstOK, secondOK;
+
+  if (Count == 1) {
+    if (result == READ_FAILED) {
+      for (attempt = 0; attempt < g_readRetries; attempt++) {
+        if ((ReadCommand(vol, buffer, address, 1, &numRead) == READ_OK) && numRead) {
+          return true;
+        }
+      }
+      fprintf(vol->Out, "**Unreadable sector %u.\n", address);
+      RecordBadSector(vol, address);
+    }
+    memset(buffer, 0, vol->secsize);
+    return false;
+  }
+
+  half = Count >> 1;
+  firstOK  = ReadRange(vol, buffer, address, half);
+  secondOK = ReadRange(vol, buffer + half * vol->secsize, address + half, Count - half);
+  if (firstOK && secondOK && vol->scsi && (vol->scsi_max_xfer >= Count)) {
+    vol->scsi_max_xfer = MAX(half, 1);
+    Verbose(vol, "  Reducing SCSI reads to %u sectors per command.\n", vol->scsi_max_xfer);
+  }
+
+  return firstOK && secondOK;
+}
+
+/*
+ * Read Count sectors as a pipeline of queued READs, keeping up to
+ * SG_ASYNC_DEPTH of them outstanding. Chunks are collected in the order
+ * they were issued; a chunk that fails, or that holds a sector already
+ * known to be bad, is read synchronously so bad sectors are isolated
+ * the same way as without queueing.
+ */
+static bool ScsiReadSectorsQueued(udf_volume *vol, uint8_t *buffer, uint32_t address,
+                                  uint32_t Count)
+{
+  struct {
+    int      Tag;
+    uint32_t Offset;
+    uint32_t Count;
+  } queue[SG_ASYNC_DEPTH];
+  uint32_t submitted = 0;
+  int head = 0, numQueued = 0;
+  bool readOK = true;
+
+  while ((submitted < Count) || numQueued) {
+    while ((submitted < Count) && (numQueued < SG_ASYNC_DEPTH)) {
+      uint32_t numSectors = MIN(Count - submitted, vol->scsi_max_xfer);
+      int tag = 0;
+      if (FirstBadSector(vol, address + submitted, numSectors) == numSectors) {
+        tag = sg_async_submit(vol, buffer + submitted * vol->secsize, address + submitted, numSectors);
+      }
+      if (!tag) {
+        break;
+      }
+      queue[(head + numQueued) % SG_ASYNC_DEPTH].Tag = tag;
+      queue[(head + numQueued) % SG_ASYNC_DEPTH].Offset = submitted;
+      queue[(head + numQueued) % SG_ASYNC_DEPTH].Count = numSectors;
+      numQueued++;
+      submitted += numSectors;
+    }
+
+    if (numQueued) {
+      if (!sg_async_wait(vol, queue[head].Tag)) {
+        readOK &= RecoverRange(vol, buffer + queue[head].Offset * vol->secsize,
+                               address + queue[head].Offset, queue[head].Count,
+                               READ_FAILED);
+      }
+      head = (head + 1) % SG_ASYNC_DEPTH;
+      numQueued--;
+    } else {
+      // Nothing could be queued - read this chunk synchronously
+      uint32_t numSectors = MIN(Count - submitted, vol->scsi_max_xfer);
+      readOK &= ReadRange(vol, buffer + submitted * vol->secsize, address + submitted, numSectors);
+      submitted += numSectors;
+    }
+  }
+
+  return readOK;
+}
+
+/*
+ * Read Count sectors using as few SCSI READ commands as the device allows.
+ * Every chunk is read even if an earlier one fails, so that the good
+ * sectors of the request can be cached and the bad ones mapped.
+ */
+static bool ScsiReadSectors(udf_volume *vol, uint8_t *buffer, uint32_t address,
+                            uint32_t Count)
+{
+  bool readOK = true;
+
+  if (vol->sg_async && (Count > vol->scsi_max_xfer)) {
+    return ScsiReadSectorsQueued(vol, buffer, address, Count);
+  }
+
+  while (Count > 0) {
+    uint32_t numSectors = MIN(Count, vol->scsi_max_xfer);
+    readOK &= ReadRange(vol, buffer, address, numSectors);
+    buffer  += numSectors * vol->secsize;
+    address += numSectors;
+    Count   -= numSectors;
+  }
+
+  return readOK;
+}
+
+/*
+ * Make sure a cache segment's buffer can hold Count sectors.
+ */
+static bool SizeCacheBuffer(udf_volume *vol, sCacheData *seg, uint32_t Count)
+{
+  if (Count > seg->Allocated) {
+    void *newBuffer = NULL;
+    if (seg->Buffer) {
+      free(seg->Buffer);
+    }
+    // Page-aligned so SCSI reads can DMA straight into the cache
+    if (posix_memalign(&newBuffer, IO_BUFFER_ALIGN, vol->secsize * Count)) {
+      newBuffer = NULL;
+    }
+    seg->Buffer = newBuffer;
+    seg->Allocated = newBuffer ? Count : 0;
+  }
+  return seg->Buffer != NULL;
+}
+
+/*
+ * Collect a queued read-ahead into a cache segment. If it failed, the
+ * segment is left empty and the data will be read again on demand.
+ */
+static void FinishCacheRead(udf_volume *vol, sCacheData *seg)
+{
+  if (seg->Pending) {
+    if (!sg_async_wait(vol, seg->Pending)) {
+      seg->Count = 0;
+    }
+    seg->Pending = 0;
+  }
+}
+
+/*
+ * Queue a read of the sectors following a small request into the next cache
+ * segment, without waiting for it. The directory walk tends to move forward
+ * through ICBs and directory blocks, so the drive can be fetching them
+ * while the current block is being checked.
+ */
+static void StartReadahead(udf_volume *vol, uint32_t address)
+{
+  uint32_t Count = MIN(SG_READAHEAD_SIZE >> vol->sdivshift, vol->scsi_max_xfer);
+  uint_least8_t seg = (vol->bufno + 1) % NUM_CACHE;
+
+  if (vol->LastSector) {
+    if (address > vol->LastSector) {
+      return;
+    }
+    Count = MIN(Count, vol->LastSector - address + 1);
+  }
+  // Stop short of sectors known to be bad
+  Count = FirstBadSector(vol, address, Count);
+  if (!Count) {
+    return;
+  }
+
+  FinishCacheRead(vol, &vol->Cache[seg]);
+  vol->Cache[seg].Count = 0;
+  if (SizeCacheBuffer(vol, &vol->Cache[seg], Count)) {
+    vol->Cache[seg].Pending = sg_async_submit(vol, vol->Cache[seg].Buffer, address, Count);
+    if (vol->Cache[seg].Pending) {
+      vol->Cache[seg].Address = address;
+      vol->Cache[seg].Count = Count;
+      // Keep the read-ahead from being the next segment replaced
+      vol->bufno = seg;
+    }
+  }
+}
+
+/*
+ * Wait for any queued reads still targeting the cache. Must be done before
+ * the cache buffers are freed.
+ */
+void FlushCacheReads(udf_volume *vol)
+{
+  int i;
+
+  for (i = 0; i < NUM_CACHE; i++) {
+    FinishCacheRead(vol, &vol->Cache[i]);
+  }
+}
+
 /* Cache everything in units of packet_size.  packet_size will be filled
  * in for all media, packet or not.
  * Subtle point: the caching obviates any need for 'buffer' to have any special alignment
  *
+ * A request that includes a known bad sector fails without touching the
+ * medium. When a read turns up new bad sectors the request fails, but the
+ * rest of what was read stays cached so neighbouring requests still hit.
+ *
  * WARNING: pointer returned by CacheSectors() is only guaranteed valid until next
  *          call to CacheSectors
  */
-static const void* CacheSectors(uint32_t address, uint32_t Count)
+static const void* CacheSectors(udf_volume *vol, uint32_t address, uint32_t Count)
 {
-  int readOK, result, numsecs, i;
+  int readOK, i;
+  uint32_t numRead;
   void *curbuffer;
 
   //printf("  Reading sector %u.\n", address);
   readOK = false;
 
+  if (FirstBadSector(vol, address, Count) < Count) {
+    return NULL;
+  }
+
   /* Search cache for existing bits */
   for (i = 0; i < NUM_CACHE; i++) {
-    if ((Cache[i].Count > 0) && (address >= Cache[i].Address) && 
-        ((address + Count) <= (Cache[i].Address + Cache[i].Count)) &&
+    if ((vol->Cache[i].Count > 0) && (address >= vol->Cache[i].Address) && 
+        ((address + Count) <= (vol->Cache[i].Address + vol->Cache[i].Count)) &&
          (address + Count > address)) {
+      FinishCacheRead(vol, &vol->Cache[i]);
+      if (!vol->Cache[i].Count) {
+        continue;     // Read-ahead failed
+      }
       readOK = 1;
-      curbuffer = Cache[i].Buffer + (address - Cache[i].Address) * secsize;
-      bufno = i;
+      curbuffer = vol->Cache[i].Buffer + (address - vol->Cache[i].Address) * vol->secsize;
+      vol->bufno = i;
       i = NUM_CACHE;
     }
   }
 
   if (!readOK) {
-    bufno++;
-    bufno %= NUM_CACHE;
-    if (Count > Cache[bufno].Allocated) {
-      if (Cache[bufno].Buffer) {
-        free(Cache[bufno].Buffer);
-      }
-      Cache[bufno].Buffer = malloc(secsize * Count);
-      Cache[bufno].Allocated = Count;
-    }
-    if (Cache[bufno].Buffer) {
-      if (scsi) {
-        readOK = true;
-        for (i = 0; i < Count; i++) {
-          scsi_read10(cdb, address + i, 1, secsize, 0, 0, 0);
-          result = do_scsi(cdb, 10, Cache[bufno].Buffer + i * secsize,
-                           secsize, 0, sensedata, sensebufsize);
-          if (result) {
-            readOK = false;
-          }
-        }
-        if (readOK) {
-          Cache[bufno].Address = address;
-          Cache[bufno].Count = Count;
-        } else {
-          Cache[bufno].Count = 0;
-        }
+    vol->bufno++;
+    vol->bufno %= NUM_CACHE;
+    FinishCacheRead(vol, &vol->Cache[vol->bufno]);
+    vol->Cache[vol->bufno].Count = 0;
+    if (SizeCacheBuffer(vol, &vol->Cache[vol->bufno], Count)) {
+      if (vol->scsi) {
+        readOK = ScsiReadSectors(vol, vol->Cache[vol->bufno].Buffer, address, Count);
+        numRead = Count;
       } else {
-        off64_t byte_address = address * (off64_t) secsize;
-        result = lseek64(device, byte_address, SEEK_SET);
-        if (result != -1) {
-          result = read(device, Cache[bufno].Buffer, secsize * Count);
-          if (result == -1) {
-            printf("**Read error #%d in %u\n", errno, address);
-            readOK = 0;
-            Cache[bufno].Count = 0;
-          } else {
-            if (result < secsize * Count) {
-              numsecs = result / secsize;
-              Cache[bufno].Address = address;
-              Cache[bufno].Count = numsecs;
-              readOK = numsecs > 0;
-              if (readOK) {
-                printf("**Only read %d sector%s.\n", numsecs, numsecs == 1 ? "" : "s");
-              }
-            } else {
-              readOK = 1;
-              Cache[bufno].Address = address;
-              Cache[bufno].Count = Count;
-            }   /* partial read  */
-          }     /* non-scsi read */
+        eReadResult result = ReadCommand(vol, vol->Cache[vol->bufno].Buffer, address, Count, &numRead);
+        if (result != READ_OK) {
+          readOK = RecoverRange(vol, vol->Cache[vol->bufno].Buffer, address, Count, result);
+          numRead = Count;
+        } else if (numRead < Count) {
+          readOK = numRead > 0;
+          if (readOK) {
+            fprintf(vol->Out, "**Only read %u sector%s.\n", numRead, numRead == 1 ? "" : "s");
+          }
         } else {
-          readOK = 0; /* Seek failure */
+          readOK = 1;
         }
-      }       /* scsi */
+      }
+      // Keep a failed read only if it was due to mapped bad sectors
+      if (readOK || (FirstBadSector(vol, address, numRead) < numRead)) {
+        vol->Cache[vol->bufno].Address = address;
+        vol->Cache[vol->bufno].Count = numRead;
+      }
     } else {
-      printf("**Couldn't malloc space for %u %u byte sectors.\n", Count, secsize);
+      fprintf(vol->Out, "**Couldn't malloc space for %u %u byte sectors.\n", Count, vol->secsize);
     }
     if (readOK) {
-      curbuffer = Cache[bufno].Buffer;
+      curbuffer = vol->Cache[vol->bufno].Buffer;
+      if (vol->sg_async && ((Count << vol->sdivshift) < SG_READAHEAD_SIZE)) {
+        StartReadahead(vol, address + Count);
+      }
     } else {
       curbuffer = NULL;
     }
@@ -107,17 +393,158 @@ static const void* CacheSectors(uint32_t address, uint32_t Count)
 
   return curbuffer;
 }
-
-int ReadSectors(void *buffer, uint32_t address, uint32_t Count)
+int ReadSectors(udf_volume *vol, void *buffer, uint32_t address, uint32_t Count)
 {
-    const void *cachedBuf = CacheSectors(address, Count);
+    const void *cachedBuf = CacheSectors(vol, address, Count);
     if (cachedBuf) {
-      memcpy(buffer, cachedBuf, Count << sdivshift);
+      memcpy(buffer, cachedBuf, Count << vol->sdivshift);
     }
 
     return (cachedBuf == NULL);
 }
 
+static int compare_request_offset(const void *a, const void *b)
+{
+  const sReadRequest *ra = *(const sReadRequest * const *)a;
+  const sReadRequest *rb = *(const sReadRequest * const *)b;
+
+  return (ra->Offset > rb->Offset) - (ra->Offset < rb->Offset);
+}
+
+/*
+ * A request can be retried through ReadRange() (and so consult and update
+ * the bad sector map) only if it covers whole sectors.
+ */
+static bool RequestIsSectorAligned(udf_volume *vol, const sReadRequest *req)
+{
+  return vol->secsize && !(req->Offset & (vol->secsize - 1)) && req->Length &&
+         !(req->Length & (vol->secsize - 1));
+}
+
+static bool ReadRequestRange(udf_volume *vol, sReadRequest *req)
+{
+  return ReadRange(vol, req->Buffer, (uint32_t) (req->Offset >> vol->sdivshift),
+                   req->Length >> vol->sdivshift);
+}
+
+/*
+ * Read with lio_listio(), BATCH_LIO_MAX requests at a time.
+ */
+static void ReadBatchLio(udf_volume *vol, sReadRequest **sorted, uint32_t Count)
+{
+  struct aiocb  cbs[BATCH_LIO_MAX];
+  struct aiocb *list[BATCH_LIO_MAX];
+  uint32_t base, i, n;
+
+  for (base = 0; base < Count; base += n) {
+    n = MIN(Count - base, BATCH_LIO_MAX);
+    for (i = 0; i < n; i++) {
+      memset(&cbs[i], 0, sizeof(cbs[i]));
+      cbs[i].aio_fildes = vol->device;
+      cbs[i].aio_offset = sorted[base + i]->Offset;
+      cbs[i].aio_buf = sorted[base + i]->Buffer;
+      cbs[i].aio_nbytes = sorted[base + i]->Length;
+      cbs[i].aio_lio_opcode = LIO_READ;
+      list[i] = &cbs[i];
+    }
+
+    // Individual failures are picked up below
+    lio_listio(LIO_WAIT, list, n, NULL);
+
+    for (i = 0; i < n; i++) {
+      sReadRequest *req = sorted[base + i];
+      ssize_t result = (aio_error(&cbs[i]) == 0) ? aio_return(&cbs[i]) : -1;
+      if (result == req->Length) {
+        req->OK = true;
+      } else if ((result < 0) && RequestIsSectorAligned(vol, req)) {
+        // Not simply beyond the end - isolate any bad sectors
+        req->OK = ReadRequestRange(vol, req);
+      }
+    }
+  }
+}
+
+/*
+ * Read with queued commands on an sg device, in ascending address order.
+ */
+static void ReadBatchQueued(udf_volume *vol, sReadRequest **sorted, uint32_t Count)
+{
+  int tags[SG_ASYNC_DEPTH];
+  uint32_t submitted = 0, completed = 0;
+
+  while (completed < Count) {
+    while ((submitted < Count) && (submitted - completed < SG_ASYNC_DEPTH)) {
+      sReadRequest *req = sorted[submitted];
+      tags[submitted % SG_ASYNC_DEPTH] = sg_async_submit(vol, req->Buffer,
+                                                         (uint32_t) (req->Offset >> vol->sdivshift),
+                                                         req->Length >> vol->sdivshift);
+      if (!tags[submitted % SG_ASYNC_DEPTH] && (submitted > completed)) {
+        break;    // Collect a completion to free a slot
+      }
+      submitted++;
+    }
+
+    if (tags[completed % SG_ASYNC_DEPTH] && sg_async_wait(vol, tags[completed % SG_ASYNC_DEPTH])) {
+      sorted[completed]->OK = true;
+    } else {
+      sorted[completed]->OK = ReadRequestRange(vol, sorted[completed]);
+    }
+    completed++;
+  }
+}
+
+/*
+ * Read a set of independent ranges, such as candidate anchor locations.
+ * Requests are issued in ascending offset order and, where the device
+ * allows, all at once: as queued commands on an sg device, or as a single
+ * lio_listio() batch on a file or block device. Other SCSI devices are read
+ * one request at a time, still in ascending order.
+ *
+ * Each request's OK flag reports whether all of its bytes were read. Ranges
+ * holding a known bad sector are not read. Nothing is added to the cache.
+ */
+void ReadBatch(udf_volume *vol, sReadRequest *Requests, uint32_t Count)
+{
+  sReadRequest **sorted;
+  uint32_t i, numToRead = 0;
+
+  sorted = malloc(Count * sizeof(sReadRequest *));
+  if (!sorted) {
+    OperationalError(vol, "**Couldn't allocate memory for batched reads.\n");
+    for (i = 0; i < Count; i++) {
+      Requests[i].OK = false;
+    }
+    return;
+  }
+
+  for (i = 0; i < Count; i++) {
+    sReadRequest *req = Requests + i;
+    req->OK = false;
+    if (   RequestIsSectorAligned(vol, req)
+        && (FirstBadSector(vol, (uint32_t) (req->Offset >> vol->sdivshift), req->Length >> vol->sdivshift)
+            < (req->Length >> vol->sdivshift))) {
+      continue;
+    }
+    if (vol->scsi && !RequestIsSectorAligned(vol, req)) {
+      continue;   // Commands can only transfer whole sectors
+    }
+    sorted[numToRead++] = req;
+  }
+  qsort(sorted, numToRead, sizeof(sReadRequest *), compare_request_offset);
+
+  if (!vol->scsi) {
+    ReadBatchLio(vol, sorted, numToRead);
+  } else if (vol->sg_async) {
+    ReadBatchQueued(vol, sorted, numToRead);
+  } else {
+    for (i = 0; i < numToRead; i++) {
+      sorted[i]->OK = ReadRequestRange(vol, sorted[i]);
+    }
+  }
+
+  free(sorted);
+}
+
 /**
  * Pull data from a range of partition logical blocks into a contiguous cache buffer.
  *
@@ -125,128 +552,324 @@ int ReadSectors(void *buffer, uint32_t address, uint32_t Count)
  * @param[in]  p_ref       Index of the partition where blocks reside
  * @param[in]  Count       Number of logical blocks to fetch.
  *                         Must not be larger than 1 if the partition has a Virtual
- *                         or Sparable Partition Map because sequential partition blocks
- *                         may reside in discontiguous media sectors.
+ *                         Partition Map, nor span a spared packet boundary if it has
+ *                         a Sparable Partition Map, because sequential partition
+ *                         blocks may reside in discontiguous media sectors.
  *
  * @return     NULL        Read error, or request could not be satisfied
  *                         (see constraints spelled out under "Count")
  * @return     non-NULL    Pointer to cached block data
  */
-static const uint8_t* CachePBlocks(uint32_t p_address, uint16_t p_ref, uint32_t Count)
+const uint8_t* CachePBlocks(udf_volume *vol, uint32_t p_address, uint16_t p_ref,
+                            uint32_t Count)
+{
+  if ((Count == 1) && vol->ScanIndexLen) {
+    const uint8_t *scannedBlock = LookupScannedBlock(vol, p_ref, p_address);
+    if (scannedBlock) {
+      return scannedBlock;
+    }
+  }
+
+  if (p_ref >= vol->PTN_no) {
+    return NULL;
+  }
+  return vol->Part_Info[p_ref].CacheBlocks(vol, p_address, p_ref, Count);
+}
+
+/*
+ * Block readers for each partition type, called by CachePBlocks() with a
+ * partition reference that is known to be valid.
+ */
+static const uint8_t* CacheNoBlocks(udf_volume *vol, uint32_t p_address, uint16_t p_ref,
+                                    uint32_t Count)
+{
+  return NULL;
+}
+
+static const uint8_t* CacheRealBlocks(udf_volume *vol, uint32_t p_address, uint16_t p_ref,
+                                      uint32_t Count)
+{
+  const sPart_Info *part = &vol->Part_Info[p_ref];
+
+  if (p_address >= part->Len) {
+    return NULL;
+  }
+  return CacheSectors(vol, (p_address * vol->s_per_b) + part->Offs, Count * vol->s_per_b);
+}
+
+/*
+ * Real partition readers for common sector and block sizes, with the
+ * address arithmetic and cache search done in constant shifts. Anything
+ * not already whole in a cache segment is left to CacheSectors().
+ */
+#define DEFINE_REAL_BLOCK_READER(name, SECSHIFT, BLKSHIFT)                                \
+static const uint8_t* name(udf_volume *vol, uint32_t p_address, uint16_t p_ref,             \
+                           uint32_t Count)                                                 \
+{                                                                                          \
+  const sPart_Info *part = &vol->Part_Info[p_ref];                                         \
+  uint32_t address = (p_address << ((BLKSHIFT) - (SECSHIFT))) + part->Offs;               \
+  uint32_t numSectors = Count << ((BLKSHIFT) - (SECSHIFT));                                \
+  const sCacheData *seg;                                                                   \
+  int i;                                                                                   \
+                                                                                           \
+  if (p_address >= part->Len) {                                                            \
+    return NULL;                                                                           \
+  }                                                                                        \
+  if (!vol->BadSectorsLen) {                                                               \
+    for (i = 0; i < NUM_CACHE; i++) {                                                      \
+      seg = &vol->Cache[i];                                                                \
+      if (   !seg->Pending && (seg->Count > 0) && (address >= seg->Address)                \
+          && ((address + numSectors) <= (seg->Address + seg->Count))                       \
+          && (address + numSectors > address)) {                                           \
+        vol->bufno = i;                                                                    \
+        return seg->Buffer + ((size_t) (address - seg->Address) << (SECSHIFT));            \
+      }                                                                                    \
+    }                                                                                      \
+  }                                                                                        \
+  return CacheSectors(vol, address, numSectors);                                           \
+}
+
+DEFINE_REAL_BLOCK_READER(CacheRealBlocks2048_2048, 11, 11)    // Optical media
+DEFINE_REAL_BLOCK_READER(CacheRealBlocks512_4096,   9, 12)    // Disks
+DEFINE_REAL_BLOCK_READER(CacheRealBlocks4096_4096, 12, 12)    // 4Kn disks
+
+static const uint8_t* CacheVirtualBlocks(udf_volume *vol, uint32_t p_address, uint16_t p_ref,
+                                         uint32_t Count)
+{
+  const sPart_Info *part = &vol->Part_Info[p_ref];
+
+  if ((p_address >= part->Len) || (Count != 1)) {
+    return NULL;
+  }
+  return CacheSectors(vol, (part->Extra[p_address] * vol->s_per_b) + part->Offs, vol->s_per_b);
+}
+
+/*
+ * Find where block p_address of a sparable partition is recorded, and
+ * reduce *Count to the number of blocks from there that are contiguous on
+ * the medium: the rest of a spared packet, or the blocks up to the next one.
+ */
+static uint32_t SparableSector(udf_volume *vol, const sPart_Info *part, uint32_t p_address,
+                               uint32_t *Count)
 {
-  const void *cachedBuf = NULL;
-  sST_desc *PM_ST;
+  const sST_desc *PM_ST = (const sST_desc *)part->Extra;
+  uint32_t secaddr = (p_address * vol->s_per_b) + part->Offs;
   uint32_t i;
-  uint32_t numSectors = Count * s_per_b;
-  uint32_t secaddr = (p_address * s_per_b) + Part_Info[p_ref].Offs;
-
-  if (p_ref < PTN_no) {
-    switch(Part_Info[p_ref].type) {
-      case PTN_TYP_REAL:
-        if (p_address < Part_Info[p_ref].Len) {
-          cachedBuf = CacheSectors(secaddr, numSectors);
-        }
-        break;
 
-      case PTN_TYP_VIRTUAL:
-        if ((p_address < Part_Info[p_ref].Len) && (Count == 1)) {
-          secaddr =   (Part_Info[p_ref].Extra[p_address] * s_per_b)
-                    + Part_Info[p_ref].Offs;
-          cachedBuf = CacheSectors(secaddr, s_per_b);
-        }
-        break;
+  if (!PM_ST || !PM_ST->Map) {
+    return secaddr;     // No sparing table available
+  }
 
-      case PTN_TYP_SPARE:
-        PM_ST = (struct _sST_desc *)Part_Info[p_ref].Extra;
-        if (PM_ST) {
-          if (Count == 1) {
-            bool spared = false;
-            for (i = 0; (i < PM_ST->Size) && !spared; i++) {
-              if ((p_address >= PM_ST->Map[i].Original)  &&
-                  (p_address < (PM_ST->Map[i].Original + PM_ST->Extent))) {
-                printf("!!Getting sector from spare area!!\n");
-                spared = true;
-                secaddr = Part_Info[p_ref].Extra[2*i+1];
-                cachedBuf = CacheSectors(secaddr, s_per_b);
-                break;
-              }
-            }
-            if (!spared) {
-              cachedBuf = CacheSectors(secaddr, s_per_b);
-            }
-          } // else unsupported case, since spared blocks can be discontiguous on the medium
-        } else {
-          // No sparing table available
-          cachedBuf = CacheSectors(secaddr, numSectors);
-        }
-        break;
+  for (i = 0; i < PM_ST->Size; i++) {
+    uint32_t original = U_endian32(PM_ST->Map[i].Original);
+    if ((p_address >= original) && (p_address - original < PM_ST->Extent)) {
+      *Count = MIN(*Count, original + PM_ST->Extent - p_address);
+      return U_endian32(PM_ST->Map[i].Mapped) + (p_address - original) * vol->s_per_b;
+    }
+    if ((original > p_address) && (original - p_address < *Count)) {
+      *Count = original - p_address;
+    }
+  }
+  return secaddr;
+}
+
+static const uint8_t* CacheSparableBlocks(udf_volume *vol, uint32_t p_address, uint16_t p_ref,
+                                          uint32_t Count)
+{
+  const sPart_Info *part = &vol->Part_Info[p_ref];
+  uint32_t numBlocks = Count;
+  uint32_t secaddr = SparableSector(vol, part, p_address, &numBlocks);
+
+  if (numBlocks < Count) {
+    return NULL;    // Unsupported, since spared blocks are discontiguous on the medium
+  }
+  if (secaddr != (p_address * vol->s_per_b) + part->Offs) {
+    fprintf(vol->Out, "!!Getting sector from spare area!!\n");
+  }
+  return CacheSectors(vol, secaddr, Count * vol->s_per_b);
+}
+
+static const uint8_t* CacheMetadataBlocks(udf_volume *vol, uint32_t p_address, uint16_t p_ref,
+                                          uint32_t Count)
+{
+  // The whole Metadata File was read by GetMetadata()
+  const sMeta_desc *PM_MD = (const sMeta_desc *)vol->Part_Info[p_ref].Extra;
+
+  if (   PM_MD && PM_MD->Blocks && (p_address < PM_MD->NumBlocks)
+      && (Count <= PM_MD->NumBlocks - p_address)) {
+    return PM_MD->Blocks + ((size_t) p_address << vol->bdivshift);
+  }
+  return NULL;
+}
+
+/*
+ * Set the type of a partition, and with it how its blocks are read. The
+ * block size must already be known.
+ */
+void SetPartType(udf_volume *vol, sPart_Info *part, int type)
+{
+  static const PartBlockReader readers[] = {
+    [PTN_TYP_NONE]     = CacheNoBlocks,
+    [PTN_TYP_REAL]     = CacheRealBlocks,
+    [PTN_TYP_VIRTUAL]  = CacheVirtualBlocks,
+    [PTN_TYP_SPARE]    = CacheSparableBlocks,
+    [PTN_TYP_METADATA] = CacheMetadataBlocks,
+  };
+  static const struct {
+    uint32_t        SecSize;
+    uint32_t        BlockSize;
+    PartBlockReader Reader;
+  } realReaders[] = {
+    { 2048, 2048, CacheRealBlocks2048_2048 },
+    {  512, 4096, CacheRealBlocks512_4096  },
+    { 4096, 4096, CacheRealBlocks4096_4096 },
+  };
+  unsigned int i;
 
-      default:
+  part->type = type;
+  part->CacheBlocks = readers[type];
+  // Virtual and spared blocks need not be contiguous on the medium
+  part->Contiguous = (type == PTN_TYP_REAL) || (type == PTN_TYP_METADATA);
+
+  if (type == PTN_TYP_REAL) {
+    for (i = 0; i < sizeof(realReaders) / sizeof(realReaders[0]); i++) {
+      if (   (vol->secsize == realReaders[i].SecSize)
+          && (vol->blocksize == realReaders[i].BlockSize)) {
+        part->CacheBlocks = realReaders[i].Reader;
         break;
+      }
     }
   }
+}
+
+/*
+ * Find the partition that records partition number partNum in place, for
+ * a virtual or metadata partition built on it.
+ */
+uint16_t FindPhysicalPartition(udf_volume *vol, uint16_t partNum)
+{
+  uint16_t ref;
 
-  return cachedBuf;
+  for (ref = 0; ref < vol->PTN_no; ref++) {
+    if (   ((vol->Part_Info[ref].type == PTN_TYP_REAL)
+            || (vol->Part_Info[ref].type == PTN_TYP_SPARE))
+        && (vol->Part_Info[ref].Num == partNum)) {
+      break;
+    }
+  }
+  return ref;
 }
 
-/* Bug: If count crosses sparing boundary... */
-int ReadLBlocks(void *buffer, uint32_t p_address, uint16_t p_ref, uint32_t Count)
+/*
+ * Start bringing a block of a real partition into the cache without
+ * waiting for it. On an sg device the read is queued into a cache segment;
+ * otherwise the device is advised that the block will be wanted. Blocks
+ * that are already at hand, or that need translating, are left alone.
+ */
+void PrefetchPBlock(udf_volume *vol, uint32_t p_address, uint16_t p_ref)
+{
+  uint32_t secaddr;
+  int i;
+
+  if (   (p_ref >= vol->PTN_no) || (vol->Part_Info[p_ref].type != PTN_TYP_REAL)
+      || (p_address >= vol->Part_Info[p_ref].Len)) {
+    return;
+  }
+  if (vol->ScanIndexLen && LookupScannedBlock(vol, p_ref, p_address)) {
+    return;
+  }
+
+  secaddr = (p_address * vol->s_per_b) + vol->Part_Info[p_ref].Offs;
+  for (i = 0; i < NUM_CACHE; i++) {
+    if (   (vol->Cache[i].Count > 0) && (secaddr >= vol->Cache[i].Address)
+        && ((secaddr + vol->s_per_b) <= (vol->Cache[i].Address + vol->Cache[i].Count))) {
+      return;
+    }
+  }
+
+  if (vol->sg_async) {
+    StartReadahead(vol, secaddr);
+  } else if (!vol->scsi) {
+    posix_fadvise(vol->device, (off_t) secaddr << vol->sdivshift, vol->blocksize,
+                  POSIX_FADV_WILLNEED);
+  }
+}
+
+/*
+ * Read logical blocks of a partition. A sparable partition is read in runs
+ * between its spared packets; blocks of any other partition that isn't
+ * Contiguous are read one at a time, since they can be scattered on the
+ * medium.
+ */
+int ReadLBlocks(udf_volume *vol, void *buffer, uint32_t p_address, uint16_t p_ref,
+                uint32_t Count)
 {
     const void *cachedBuf = NULL;
-    sST_desc *PM_ST;
     uint32_t i;
     int error = 1;
     uint8_t *destBuffer = (uint8_t*) buffer;
 
-    if (p_ref < PTN_no) {
-      switch(Part_Info[p_ref].type) {
-        case PTN_TYP_SPARE:
-          PM_ST = (struct _sST_desc *)Part_Info[p_ref].Extra;
-          if (PM_ST) {
-            error = 0;
-            // Sparable blocks may not be contiguous,
-            // do each one independently
-            for (i = 0; !error && (i < Count); i++) {
-              cachedBuf = CachePBlocks(p_address + i, p_ref, 1);
-              if (cachedBuf) {
-                memcpy(destBuffer + (i << bdivshift), cachedBuf, blocksize);
-              } else {
-                error = 1;
-              }
-            }
-            break;
-          } // else no sparing table available
-          // fallthrough
-        case PTN_TYP_REAL:
-          cachedBuf = CachePBlocks(p_address, p_ref, Count);
-          if (cachedBuf) {
-            memcpy(destBuffer, cachedBuf, Count << bdivshift);
-            error = 0;
-          }
-          break;
-
-        case PTN_TYP_VIRTUAL:
-          // Virtual blocks may not be contiguous,
-          // do each one independently
-          error = 0;
-          for (i = 0; !error && (i < Count); i++) {
-            cachedBuf = CachePBlocks(p_address + i, p_ref, 1);
-            if (cachedBuf) {
-              memcpy(destBuffer + (i << bdivshift), cachedBuf, blocksize);
-            } else {
-              error = 1;
-            }
-          }
-          break;
+    if (p_ref >= vol->PTN_no) {
+      return error;
+    }
 
-        default:
-          break;
+    if (vol->Part_Info[p_ref].Contiguous) {
+      cachedBuf = CachePBlocks(vol, p_address, p_ref, Count);
+      if (cachedBuf) {
+        memcpy(destBuffer, cachedBuf, Count << vol->bdivshift);
+        error = 0;
+      }
+    } else if (vol->Part_Info[p_ref].type == PTN_TYP_SPARE) {
+      // Read in runs that are contiguous on the medium, between spared packets
+      error = 0;
+      while (!error && Count) {
+        uint32_t numBlocks = Count;
+        SparableSector(vol, &vol->Part_Info[p_ref], p_address, &numBlocks);
+        cachedBuf = CachePBlocks(vol, p_address, p_ref, numBlocks);
+        if (cachedBuf) {
+          memcpy(destBuffer, cachedBuf, numBlocks << vol->bdivshift);
+          destBuffer += numBlocks << vol->bdivshift;
+          p_address  += numBlocks;
+          Count      -= numBlocks;
+        } else {
+          error = 1;
+        }
+      }
+    } else {
+      error = 0;
+      for (i = 0; !error && (i < Count); i++) {
+        cachedBuf = CachePBlocks(vol, p_address + i, p_ref, 1);
+        if (cachedBuf) {
+          memcpy(destBuffer + (i << vol->bdivshift), cachedBuf, vol->blocksize);
+        } else {
+          error = 1;
+        }
       }
     }
 
     return error;
 }
 
+/*
+ * Find the extent of a file holding the byte at offset: the last to begin
+ * at or before it, since one holding any of the file ends where the next
+ * begins.
+ */
+static uint32_t FindSummaryExtent(const sADSummary *summary, uint64_t offset)
+{
+  uint32_t low = 0, high = summary->NumExtents;
+
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (summary->Start[mid] <= offset) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low ? low - 1 : 0;
+}
+
 /*
  * @param[out]   buffer           Data read from the file.
  *                                This buffer should have a minimum length of
@@ -255,6 +878,7 @@ int ReadLBlocks(void *buffer, uint32_t p_address, uint16_t p_ref, uint32_t Count
  *
  * @param[in]    xfe              ICB describing the file
  * @param[in]    part             Which partition the file is part of
+ * @param[in]    icbLoc           Block of that partition in which xfe is recorded
  * @param[in]    startOffset      # of bytes into the file at which to begin reading
  * @param[in]    bytesRequested   Desired number of file data bytes
  * @param[out]   data_start_loc   Sector in which the startOffset byte of the file resides,
@@ -262,21 +886,18 @@ int ReadLBlocks(void *buffer, uint32_t p_address, uint16_t p_ref, uint32_t Count
  *
  * @return       Number of bytes read
  */
-unsigned int ReadFileData(void *buffer, const struct FE_or_EFE *xfe, uint16_t part,
-                          uint64_t startOffset, unsigned int bytesRequested,
-                          uint32_t *data_start_loc)
+unsigned int ReadFileData(udf_volume *vol, void *buffer, const struct FE_or_EFE *xfe,
+                          uint16_t part, uint32_t icbLoc, uint64_t startOffset,
+                          unsigned int bytesRequested, uint32_t *data_start_loc)
 {
-  const char *exts_ptr, *exts_end;
-  struct AllocationExtentDesc *AED = NULL;
+  const sADSummary  *summary;
+  const sADExtent   *extent;    // Extent holding curFileOffset
+  uint64_t           extentStart;  // File offset at which it begins
+  uint32_t           extentIndex;
   uint32_t           sector;    // @todo Rename - confusing b/c this is not used with ReadSectors()
-  uint16_t           curPartitionIndex = part;  // Default matches short_ad case
-  uint32_t           curExtentLocation;
-  uint32_t           curExtentLength;
-  uint32_t           curExtentType;
   uint32_t           blockBytesAvailable;
   uint64_t           infoLength;
   uint64_t           curFileOffset;
-  uint64_t           offset;
   unsigned int       bytesRemaining;
   int                error;
   bool               firstpass;
@@ -305,18 +926,13 @@ unsigned int ReadFileData(void *buffer, const struct FE_or_EFE *xfe, uint16_t pa
     }
 
     // @todo switch to using Error so we can report meaningful information
-    if (   (L_EA > (blocksize - xfeHeaderSize))
-        || (L_AD > (blocksize - xfeHeaderSize))) {
-      error = 1;
-      break;
-    }
-
-    if ((xfeHeaderSize + L_EA + L_AD) > blocksize) {
+    if (   (L_EA > (vol->blocksize - xfeHeaderSize))
+        || (L_AD > (vol->blocksize - xfeHeaderSize))) {
       error = 1;
       break;
     }
 
-    if (adtype == ADEXTENDED) {
+    if ((xfeHeaderSize + L_EA + L_AD) > vol->blocksize) {
       error = 1;
       break;
     }
@@ -327,11 +943,11 @@ unsigned int ReadFileData(void *buffer, const struct FE_or_EFE *xfe, uint16_t pa
       *data_start_loc = U_endian32(xfe->sTag.uTagLoc);
       // @todo Why qualify with !startOffset?
       if ((L_AD != infoLength) && !startOffset) {
-        printf("**Embedded data error: L_AD = %u, Information Length = %" PRIu64 "\n",
-               L_AD, infoLength);
+        fprintf(vol->Out, "**Embedded data error: L_AD = %u, Information Length = %" PRIu64 "\n",
+                L_AD, infoLength);
       }
 
-      blockBytesAvailable = blocksize - xfeHeaderSize - L_EA;
+      blockBytesAvailable = vol->blocksize - xfeHeaderSize - L_EA;
       if (L_AD < blockBytesAvailable) {
           blockBytesAvailable = L_AD;
       }
@@ -358,108 +974,75 @@ unsigned int ReadFileData(void *buffer, const struct FE_or_EFE *xfe, uint16_t pa
       break;
     }  // adtype == ADNONE
 
-    // At this point adtype == ADSHORT || adtype == ADLONG
+    if ((adtype != ADSHORT) && (adtype != ADLONG) && (adtype != ADEXTENDED)) {
+      error = 1;
+      break;
+    }
     // @todo check that L_EA and L_AD are proper multiples of adsize
 
-    while ((bytesRemaining > 0) && !error) {
-      offset = curFileOffset;
+    summary = GetADSummary(vol, xfe, part, icbLoc);
+    extentIndex = FindSummaryExtent(summary, curFileOffset);
 
-      if (offset >= infoLength) {
+    while ((bytesRemaining > 0) && !error) {
+      if (curFileOffset >= infoLength) {
         // Attempted read beyond EOF
         error = 1;
         break;
       }
 
-      // FIXME: efficiency: don't restart from the beginning if !firstpass
-      exts_ptr = ((const char*) xfe) + xfeHeaderSize + L_EA;
-      exts_end = exts_ptr + L_AD;
-
-      // The following while loop "eats" all unneeded extents.
-      while (exts_ptr < exts_end) {
-        if (adtype == ADSHORT) {
-          const struct short_ad *cur_ext = (const struct short_ad *)exts_ptr;
-          curExtentLength   = EXTENT_LENGTH(cur_ext->ExtentLengthAndType);
-          curExtentType     = EXTENT_TYPE(cur_ext->ExtentLengthAndType);
-          curExtentLocation = U_endian32(cur_ext->Location);
-        } else if (adtype == ADLONG) {
-          const struct long_ad *cur_ext = (const struct long_ad *)exts_ptr;
-          curExtentLength   = EXTENT_LENGTH(cur_ext->ExtentLengthAndType);
-          curExtentType     = EXTENT_TYPE(cur_ext->ExtentLengthAndType);
-          curExtentLocation = U_endian32(cur_ext->Location_LBN);
-          curPartitionIndex = U_endian16(cur_ext->Location_PartNo);
-        }
-
-        if (curExtentLength == 0) {
-          // ECMA-167r3 sec. 4.12: zero extent length terminates allocation descriptors
-          // @todo error if exts_ptr < exts_end "- 1"?
-          // Error will get set below the 'while' loop but it might be more informative
-          // to log that we found an unexpected zero-length extent
-          exts_ptr = exts_end;
-          break;
-        }
-        if (curExtentType == E_ALLOCEXTENT) {
-          // Chain to (next) Allocation Extent Descriptor
-          if (!AED) {
-            AED = (struct AllocationExtentDesc *)malloc(blocksize);
-          }
-          if (AED) {
-            error = ReadLBlocks(AED, curExtentLocation, curPartitionIndex, 1);
-            if (!error) {
-              error = CheckTag((struct tag *)AED, curExtentLocation,
-                               TAGID_ALLOC_EXTENT, 8, blocksize - 16);
-            }
-          } else {
-            error = 1;
-          }
-          if (!error) {
-            exts_ptr = (const char*)(AED + 1);
-            exts_end = exts_ptr + U_endian32(AED->L_AD);
-            // FIXME: AED->L_AD assumed sane.  At least prevent buffer overread.
-          } else {
-            exts_ptr = exts_end;
-          }
-        } else if (offset < curExtentLength) {
-          // curFileOffset is at "offset" bytes into the current extent
-          break;
-        } else {
-          // Haven't reached the extent containing curFileOffset yet
-          // FIXME: Terminate if curExtentLength == 0
-          offset -= curExtentLength;
-          exts_ptr += (adtype == ADSHORT) ? sizeof(struct short_ad)
-                                          : sizeof(struct long_ad);
-        }
+      // Reads move forward through the file, and so through its extents
+      while (   (extentIndex < summary->NumExtents)
+             && (   (summary->Extents[extentIndex].Type == E_ALLOCEXTENT)
+                 || (curFileOffset >= (  summary->Start[extentIndex]
+                                       + summary->Extents[extentIndex].InfoLength)))) {
+        extentIndex++;
+      }
+      if (extentIndex >= summary->NumExtents) {
+        error = 1;
+        break;
       }
+      extent = summary->Extents + extentIndex;
+      extentStart = summary->Start[extentIndex];
+
       // Now to read from the right extent
-      // FIXME: efficiency: process until bytesRemaining == 0, error, exts_end, or chain
-      // FIXME: Terminate if curExtentLength == 0
-      // FIXME: need to return all zero for blocks in extents not marked E_RECORDED
-      if ((exts_ptr < exts_end) && (offset < curExtentLength)) {
-        const uint32_t offset32 = (uint32_t) offset;   // Same value - to avoid repeated casting
-        uint32_t blockStartOffset = offset32 & (blocksize - 1);
-        blockBytesAvailable = blocksize - blockStartOffset;  // FIXME: assumes sane curExtentLength
+      {
+        // curFileOffset is at "offset32" bytes into the current extent
+        const uint32_t offset32 = (uint32_t) (curFileOffset - extentStart);
+        // Never read past the allocated extent, even if Recorded Length says to
+        const uint32_t recordedLength = MIN(MIN(extent->RecordedLength, extent->InfoLength),
+                                            extent->Length);
+        uint32_t blockStartOffset = offset32 & (vol->blocksize - 1);
+        blockBytesAvailable = vol->blocksize - blockStartOffset;
 
-        if (blockBytesAvailable > (curExtentLength - offset32))
-          blockBytesAvailable = curExtentLength - offset32;
+        if (blockBytesAvailable > (extent->InfoLength - offset32))
+          blockBytesAvailable = extent->InfoLength - offset32;
 
         if (blockBytesAvailable > bytesRemaining)
           blockBytesAvailable = bytesRemaining;
 
+        // Don't run from the recorded part into an unrecorded tail
+        if ((offset32 < recordedLength) && (blockBytesAvailable > (recordedLength - offset32)))
+          blockBytesAvailable = recordedLength - offset32;
+
         // Speculative - don't use resulting value if E_UNALLOCATED
-        sector = curExtentLocation + (offset32 >> bdivshift);
+        sector = extent->Location + (offset32 >> vol->bdivshift);
 
-        if (curExtentType == E_RECORDED) {
+        if (offset32 < recordedLength) {
           const uint8_t *cacheBuf;
 
           // Note, block-at-a-time in case of sparing or virtual mapping
-          cacheBuf = CachePBlocks(sector, curPartitionIndex, 1);
-          memcpy(fileData, cacheBuf + blockStartOffset, blockBytesAvailable);
-
+          cacheBuf = CachePBlocks(vol, sector, extent->Ptn, 1);
+          if (cacheBuf) {
+            memcpy(fileData, cacheBuf + blockStartOffset, blockBytesAvailable);
+          } else {
+            error = 1;
+          }
         } else {
           // Maybe allocated, but definitely unrecorded
           memset(fileData, 0, blockBytesAvailable);
         }
 
-        if (firstpass && (curExtentType != E_UNALLOCATED)) {
+        if (firstpass && (extent->Type != E_UNALLOCATED)) {
           *data_start_loc = sector;
         }
 
@@ -468,16 +1051,11 @@ unsigned int ReadFileData(void *buffer, const struct FE_or_EFE *xfe, uint16_t pa
           bytesRemaining -= blockBytesAvailable;
           fileData       += blockBytesAvailable;
         }
-      } else {
-        error = 1;
       }
 
       firstpass = false;
     }
 
-    if (AED)
-      free(AED);
-
   } while (0);
 
   return (bytesRequested - bytesRemaining);
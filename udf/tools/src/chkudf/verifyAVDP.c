@@ -9,90 +9,96 @@
 #include "chkudf.h"
 #include "protos.h"
 
-void VerifyAVDP(void)
+#define NUM_FRONT_AVDP  2
+#define NUM_BACK_AVDP   4
+
+/*
+ * Validate one anchor candidate that has been read into AVDPtr.
+ */
+static void CheckAVDP(udf_volume *vol, const struct AnchorVolDesPtr *AVDPtr,
+                      uint32_t location, bool front, int *avdp_count)
+{
+  int result;
+
+  result = CheckTag(vol, (struct tag *)AVDPtr, location, TAGID_ANCHOR, 16, 496);
+  if (result < CHECKTAG_OK_LIMIT) {
+    Verbose(vol, "AVDP present.\n");
+    DumpError(vol);
+    track_volspace(vol, location, 1, front ? "Front AVDP" : "Back AVDP");
+    if (!*avdp_count) {
+      vol->VDS_Loc = U_endian32(AVDPtr->sMainVDSAdr.Location);
+      vol->VDS_Len = U_endian32(AVDPtr->sMainVDSAdr.Length);
+      vol->RVDS_Loc = U_endian32(AVDPtr->sReserveVDSAdr.Location);
+      vol->RVDS_Len = U_endian32(AVDPtr->sReserveVDSAdr.Length);
+      track_volspace(vol, vol->VDS_Loc, vol->VDS_Len >> vol->sdivshift,
+                     front ? "Main VDS (Front AVDP)" : "Main VDS (Back AVDP)");
+      track_volspace(vol, vol->RVDS_Loc, vol->RVDS_Len >> vol->sdivshift,
+                     front ? "Reserve VDS (Front AVDP)" : "Reserve VDS (Back AVDP)");
+    } else {
+      if (vol->VDS_Loc != U_endian32(AVDPtr->sMainVDSAdr.Location) ||
+          vol->VDS_Len != U_endian32(AVDPtr->sMainVDSAdr.Length) ||
+          vol->RVDS_Loc != U_endian32(AVDPtr->sReserveVDSAdr.Location) ||
+          vol->RVDS_Len != U_endian32(AVDPtr->sReserveVDSAdr.Length)) {
+        SetError(vol, ERR_VDS_NOT_EQUIVALENT, location, 0, 0);
+        DumpError(vol);
+      }
+    } /* If first AVDP */
+    (*avdp_count)++;
+  } else {
+    Verbose(vol, "No AVDP.\n");
+    ClearError(vol);
+  } /* If is AVDP */
+}
+
+/*
+ * All anchor candidates are read in one batch, so that on optical media
+ * the drive can visit them in a single sweep, and then validated in the
+ * order UDF gives them precedence.
+ */
+void VerifyAVDP(udf_volume *vol)
 {
   int avdp_count = 0;
-  int front_avdp[] = {256, 512, -1};
-  int back_avdp[] = {0, 150, 256, 406, -1};
-  int i, result;
-  struct AnchorVolDesPtr *AVDPtr;
+  int front_avdp[NUM_FRONT_AVDP] = {256, 512};
+  int back_avdp[NUM_BACK_AVDP] = {0, 150, 256, 406};
+  sReadRequest candidates[NUM_FRONT_AVDP + NUM_BACK_AVDP];
+  uint32_t location;
+  int i;
+  uint8_t *buffer;
+
+  buffer = malloc((NUM_FRONT_AVDP + NUM_BACK_AVDP) * vol->secsize);
+  if (buffer) {
+    Information(vol, "\n--Verifying the Anchor Volume Descriptor Pointers.\n");
+
+    for (i = 0; i < NUM_FRONT_AVDP + NUM_BACK_AVDP; i++) {
+      if (i < NUM_FRONT_AVDP) {
+        location = vol->lastSessionStartLBA + front_avdp[i];
+      } else {
+        location = vol->LastSector - back_avdp[i - NUM_FRONT_AVDP];
+      }
+      candidates[i].Offset = (uint64_t) location << vol->sdivshift;
+      candidates[i].Length = vol->secsize;
+      candidates[i].Buffer = buffer + i * vol->secsize;
+    }
+    ReadBatch(vol, candidates, NUM_FRONT_AVDP + NUM_BACK_AVDP);
 
-  AVDPtr = (struct AnchorVolDesPtr *)malloc(secsize);
-  if (AVDPtr) {
-    Information("\n--Verifying the Anchor Volume Descriptor Pointers.\n");
-    
-    for (i = 0; front_avdp[i] != -1; i++) {
-      Verbose("  Checking %u: ", lastSessionStartLBA + front_avdp[i]);
-      result = ReadSectors(AVDPtr, lastSessionStartLBA + front_avdp[i], 1);
-      if (!result) {
-        result = CheckTag((struct tag *)AVDPtr, lastSessionStartLBA + front_avdp[i], TAGID_ANCHOR, 
-                          16, 496);
-        if (result < CHECKTAG_OK_LIMIT) {
-          Verbose("AVDP present.\n");
-          DumpError();
-          track_volspace(lastSessionStartLBA + front_avdp[i], 1, "Front AVDP");
-          if (!avdp_count) {
-            VDS_Loc = U_endian32(AVDPtr->sMainVDSAdr.Location);
-            VDS_Len = U_endian32(AVDPtr->sMainVDSAdr.Length);
-            RVDS_Loc = U_endian32(AVDPtr->sReserveVDSAdr.Location);
-            RVDS_Len = U_endian32(AVDPtr->sReserveVDSAdr.Length);
-            track_volspace(VDS_Loc, VDS_Len >> sdivshift, "Main VDS (Front AVDP)");
-            track_volspace(RVDS_Loc, RVDS_Len >> sdivshift, "Reserve VDS (Front AVDP)");
-          } else {
-            if (VDS_Loc != U_endian32(AVDPtr->sMainVDSAdr.Location) ||
-                VDS_Len != U_endian32(AVDPtr->sMainVDSAdr.Length) ||
-                RVDS_Loc != U_endian32(AVDPtr->sReserveVDSAdr.Location) ||
-                RVDS_Len != U_endian32(AVDPtr->sReserveVDSAdr.Length)) {
-              Error.Code = ERR_VDS_NOT_EQUIVALENT;
-              Error.Sector = lastSessionStartLBA + front_avdp[i];
-              DumpError();
-            }
-          } /* If first AVDP */
-          avdp_count++;
-        } else {
-          Verbose("No AVDP.\n");
-          ClearError();
-        } /* If is AVDP */
+    for (i = 0; i < NUM_FRONT_AVDP; i++) {
+      Verbose(vol, "  Checking %u: ", vol->lastSessionStartLBA + front_avdp[i]);
+      if (candidates[i].OK) {
+        CheckAVDP(vol, (struct AnchorVolDesPtr *)candidates[i].Buffer,
+                  vol->lastSessionStartLBA + front_avdp[i], true, &avdp_count);
       } else {
-        OperationalError("read error.\n");
+        OperationalError(vol, "read error.\n");
       }
     }
 
     /* Check the end referenced AVDPs */
-    for (i = 0; back_avdp[i] != -1; i++) {
-      Verbose("  Checking %u (n - %d): ", LastSector - back_avdp[i], back_avdp[i]);
-      result = ReadSectors(AVDPtr, LastSector - back_avdp[i], 1);
-      if (!result) {
-        result = CheckTag((struct tag *)AVDPtr, LastSector - back_avdp[i], 
-                          TAGID_ANCHOR, 16, 496);
-        if (result < CHECKTAG_OK_LIMIT) {
-          Verbose("AVDP present.\n");
-          DumpError();
-          track_volspace(LastSector - back_avdp[i], 1, "Back AVDP");
-          if (!avdp_count) {
-            VDS_Loc = U_endian32(AVDPtr->sMainVDSAdr.Location);
-            VDS_Len = U_endian32(AVDPtr->sMainVDSAdr.Length);
-            RVDS_Loc = U_endian32(AVDPtr->sReserveVDSAdr.Location);
-            RVDS_Len = U_endian32(AVDPtr->sReserveVDSAdr.Length);
-            track_volspace(VDS_Loc, VDS_Len >> sdivshift, "Main VDS (Back AVDP)");
-            track_volspace(RVDS_Loc, RVDS_Len >> sdivshift, "Reserve VDS (Back AVDP)");
-          } else {
-            if (VDS_Loc != U_endian32(AVDPtr->sMainVDSAdr.Location) ||
-                VDS_Len != U_endian32(AVDPtr->sMainVDSAdr.Length) ||
-                RVDS_Loc != U_endian32(AVDPtr->sReserveVDSAdr.Location) ||
-                RVDS_Len != U_endian32(AVDPtr->sReserveVDSAdr.Length)) {
-              Error.Code = ERR_VDS_NOT_EQUIVALENT;
-              Error.Sector = LastSector - back_avdp[i];
-              DumpError();
-            }
-          } /* If first AVDP */
-          avdp_count++;
-        } else {
-          Verbose("No AVDP.\n");
-          ClearError();
-        } /* If is AVDP */
+    for (i = 0; i < NUM_BACK_AVDP; i++) {
+      Verbose(vol, "  Checking %u (n - %d): ", vol->LastSector - back_avdp[i], back_avdp[i]);
+      if (candidates[NUM_FRONT_AVDP + i].OK) {
+        CheckAVDP(vol, (struct AnchorVolDesPtr *)candidates[NUM_FRONT_AVDP + i].Buffer,
+                  vol->LastSector - back_avdp[i], false, &avdp_count);
       } else {
-        OperationalError("read error.\n");
+        OperationalError(vol, "read error.\n");
       }
     }
 
@@ -128,29 +134,28 @@ void VerifyAVDP(void)
 //    }
     if (avdp_count) {
       // @todo We could be a little more tolerant here
-      UDFErrorIf(avdp_count == 1,
+      UDFErrorIf(vol, avdp_count == 1,
                  "Found %d Anchor Volume Descriptor Pointer%s.\n",
                  avdp_count,
                  avdp_count == 1 ? "" : "s");
-      UDFErrorIf(VDS_Len < (16 << bdivshift),
+      UDFErrorIf(vol, vol->VDS_Len < (16 << vol->bdivshift),
                  "Main Volume Descriptor Sequence is at %u, %u bytes long.\n",
-                 VDS_Loc, VDS_Len);
-      UDFErrorIf(RVDS_Len < (16 << bdivshift),
+                 vol->VDS_Loc, vol->VDS_Len);
+      UDFErrorIf(vol, vol->RVDS_Len < (16 << vol->bdivshift),
                  "Reserve Volume Descriptor Sequence is at %u, %u bytes long.\n",
-                 RVDS_Loc, RVDS_Len);
-      if (!VDS_Len && !RVDS_Len) {
-        UDFError("**Both Volume Descriptor Sequences have zero length.\n");
-        Fatal = true;
+                 vol->RVDS_Loc, vol->RVDS_Len);
+      if (!vol->VDS_Len && !vol->RVDS_Len) {
+        UDFError(vol, "**Both Volume Descriptor Sequences have zero length.\n");
+        vol->Fatal = true;
       }
     } else {
-      UDFError("**No Anchor Volume Descriptor Pointers found.\n");
-      Error.Code = ERR_NOAVDP;
-      Error.Sector = LastSector;
-      Fatal = true;
+      UDFError(vol, "**No Anchor Volume Descriptor Pointers found.\n");
+      SetError(vol, ERR_NOAVDP, vol->LastSector, 0, 0);
+      vol->Fatal = true;
     }
-    free(AVDPtr);
+    free(buffer);
   } else {
-    OperationalError("**Couldn't allocate memory for reading AVDP.\n");
-    Fatal = true;
+    OperationalError(vol, "**Couldn't allocate memory for reading AVDP.\n");
+    vol->Fatal = true;
   }
 }
@@ -15,35 +15,34 @@
  *  Read a File Entry and extract the basics.
  */
 
-int checkICB(struct FE_or_EFE *xfe, struct long_ad FE, int dir)
+int checkICB(udf_volume *vol, struct FE_or_EFE *xfe, struct long_ad FE, int dir)
 {
   if (xfe) {
     uint64_t infoLength = U_endian64(xfe->InfoLength);
-    if (!CheckTag((struct tag *)xfe, U_endian32(FE.Location_LBN), TAGID_FILE_ENTRY, 16, blocksize)) {
-      printf("(%" PRIu64 ") ", infoLength);
+    if (!CheckTag(vol, (struct tag *)xfe, U_endian32(FE.Location_LBN), TAGID_FILE_ENTRY, 16, vol->blocksize)) {
+      fprintf(vol->Out, "(%" PRIu64 ") ", infoLength);
     } else {
-      ClearError();
-      if (!CheckTag((struct tag *)xfe, U_endian32(FE.Location_LBN), TAGID_EXT_FILE_ENTRY, 16, blocksize)) {
-        printf("(%" PRIu64 ") ", infoLength);
+      ClearError(vol);
+      if (!CheckTag(vol, (struct tag *)xfe, U_endian32(FE.Location_LBN), TAGID_EXT_FILE_ENTRY, 16, vol->blocksize)) {
+        fprintf(vol->Out, "(%" PRIu64 ") ", infoLength);
       }
     }
 
     if (dir && xfe->sICBTag.FileType != FILE_TYPE_DIRECTORY) {
-      printf("[Type: %u] ", xfe->sICBTag.FileType);
+      fprintf(vol->Out, "[Type: %u] ", xfe->sICBTag.FileType);
     }
 
     if (!dir && xfe->sICBTag.FileType != FILE_TYPE_RAW) {
-      printf("[Type: %u] ", xfe->sICBTag.FileType);
+      fprintf(vol->Out, "[Type: %u] ", xfe->sICBTag.FileType);
     }
   } else {
-    Error.Code = ERR_READ;
-    Error.Sector = U_endian32(FE.Location_LBN);
+    SetError(vol, ERR_READ, U_endian32(FE.Location_LBN), 0, 0);
   }
 
 /* Verify that the information length is consistent with the descriptors.
    Verify the recorded sectors field. */
 
-  DumpError();
+  DumpError(vol);
   return 0;
 }
 
@@ -14,7 +14,7 @@
  * The following routine verifies the Logical Volume Integrity Descriptor
  * sequence.
  */
-int verifyLVID(uint32_t loc, uint32_t len)
+int verifyLVID(udf_volume *vol, uint32_t loc, uint32_t len)
 {
   uint32_t                           i, j;
   uint32_t                          *Table;
@@ -22,84 +22,84 @@ int verifyLVID(uint32_t loc, uint32_t len)
   struct LogicalVolumeIntegrityDesc *LVID;
   struct LVIDImplUse                *LVIDIU;
 
-  Information("  Verifying the Logical Volume Integrity Descriptor Sequence.\n");
-  buffer = malloc(secsize);
+  Information(vol, "  Verifying the Logical Volume Integrity Descriptor Sequence.\n");
+  buffer = malloc(vol->secsize);
   if (buffer) {
     LVID = (struct LogicalVolumeIntegrityDesc *)buffer;
-    for (i = 0; i < (len >> sdivshift); i++) {
+    for (i = 0; i < (len >> vol->sdivshift); i++) {
       /*
        * Get a sector and test it.
        */
-      ReadSectors(buffer, loc + i, 1);
-      CheckTag((struct tag *)buffer, loc + i, TAGID_LVID, 0, secsize - 16);
-      if (!Error.Code) {
-        printf("  LVID at %08x: recorded at ", loc + i);
-        printTimestamp(LVID->sRecordingTime);
+      ReadSectors(vol, buffer, loc + i, 1);
+      CheckTag(vol, (struct tag *)buffer, loc + i, TAGID_LVID, 0, vol->secsize - 16);
+      if (!CurrentError(vol)->Code) {
+        fprintf(vol->Out, "  LVID at %08x: recorded at ", loc + i);
+        printTimestamp(vol, LVID->sRecordingTime);
         switch (U_endian32(LVID->integrityType)) {
           case 0:
-            printf(" [Open]\n");
+            fprintf(vol->Out, " [Open]\n");
             break;
           case 1:
-            printf(" [Close]\n");
+            fprintf(vol->Out, " [Close]\n");
             break;
           default:
-            UDFError("** Illegal! (%u)\n", U_endian32(LVID->integrityType));
+            UDFError(vol, "** Illegal! (%u)\n", U_endian32(LVID->integrityType));
             break;
         }
-        ID_UID = U_endian64(LVID->UniqueId);
+        vol->ID_UID = U_endian64(LVID->UniqueId);
         LVIDIU = (struct LVIDImplUse *)(buffer + 80 + U_endian32(LVID->N_P) * 8);
 
         bool bProcessIU = true;
         if (U_endian32(LVID->L_IU) != 46) {
           if (   IsKnownUDFVersion(U_endian16(LVIDIU->MaxUDFWrite))
               && IsKnownUDFVersion(U_endian16(LVIDIU->MinUDFRead))) {
-            MinorError("**Length of Implementation use is %u (expected 46).\n",
+            MinorError(vol, "**Length of Implementation use is %u (expected 46).\n",
                        U_endian32(LVID->L_IU));
-            Information("  Continuing since data appears valid.\n");
+            Information(vol, "  Continuing since data appears valid.\n");
           } else {
-            UDFError("**Length of Implementation use is %u (expected 46).\n",
+            UDFError(vol, "**Length of Implementation use is %u (expected 46).\n",
                      U_endian32(LVID->L_IU));
             bProcessIU = false;
           }
         }
         if (bProcessIU) {
-          ID_Files = U_endian32(LVIDIU->numFiles);
-          ID_Dirs = U_endian32(LVIDIU->numDirectories);
-          printf("  %u directories, %u files, next UniqueID is %" PRIu64 ".\n",
-                 ID_Dirs, ID_Files, ID_UID);
-          printf("  Min read ver. %x, min write ver. %x, max write ver %x.\n",
-                 U_endian16(LVIDIU->MinUDFRead), U_endian16(LVIDIU->MinUDFWrite),
-                 U_endian16(LVIDIU->MaxUDFWrite));
-          if (U_endian16(LVIDIU->MinUDFRead) > 0x201) {
-            OperationalError("**Cannot reliably analyze media that has min read ver > 201\n");
+          vol->ID_Files = U_endian32(LVIDIU->numFiles);
+          vol->ID_Dirs = U_endian32(LVIDIU->numDirectories);
+          fprintf(vol->Out, "  %u directories, %u files, next UniqueID is %" PRIu64 ".\n",
+                  vol->ID_Dirs, vol->ID_Files, vol->ID_UID);
+          fprintf(vol->Out, "  Min read ver. %x, min write ver. %x, max write ver %x.\n",
+                  U_endian16(LVIDIU->MinUDFRead), U_endian16(LVIDIU->MinUDFWrite),
+                  U_endian16(LVIDIU->MaxUDFWrite));
+          if (U_endian16(LVIDIU->MinUDFRead) > 0x260) {
+            OperationalError(vol, "**Cannot reliably analyze media that has min read ver > 260\n");
           }
-          printf("  Recorded by: ");
-          DisplayImplID(&(LVIDIU->implementationID));
+          fprintf(vol->Out, "  Recorded by: ");
+          DisplayImplID(vol, &(LVIDIU->implementationID));
         } else {
-          Verbose("  Next unique ID is %" PRIu64 "\n", ID_UID);
+          Verbose(vol, "  Next unique ID is %" PRIu64 "\n", vol->ID_UID);
         }
         Table = (uint32_t *)(buffer + 80);
         for (j = 0; j < U_endian32(LVID->N_P); j++) {
-          printf("  Partition reference %u has %u of %u blocks available.\n",
-                 j, U_endian32(Table[j]), U_endian32(Table[j + U_endian32(LVID->N_P)]));
+          fprintf(vol->Out, "  Partition reference %u has %u of %u blocks available.\n",
+                  j, U_endian32(Table[j]), U_endian32(Table[j + U_endian32(LVID->N_P)]));
         }
         if (U_endian32(LVID->nextIntegrityExtent.Length)) {
           len = U_endian32(LVID->nextIntegrityExtent.Length);
           loc = U_endian32(LVID->nextIntegrityExtent.Location);
           i = -1;
-          printf("  Next extent is %u bytes at %u.\n", len, loc);
-          track_volspace(loc, len >> sdivshift, "Integrity Sequence Extension");
+          fprintf(vol->Out, "  Next extent is %u bytes at %u.\n", len, loc);
+          track_volspace(vol, loc, len >> vol->sdivshift, "Integrity Sequence Extension");
         }
       } else {
         i = len;
-        printf("  End of LVID sequence.\n");
-        ClearError();
+        fprintf(vol->Out, "  End of LVID sequence.\n");
+        ClearError(vol);
       }
     }  //run through extent  
     free(buffer);
   } else {
-    Error.Code = ERR_NO_VD_MEM;
+    SetError(vol, ERR_NO_VD_MEM, 0, 0, 0);
   }
-  return Error.Code;
+  return CurrentError(vol)->Code;
 }
    
@@ -22,7 +22,7 @@ int CheckRegid(const struct udfEntityId *reg, const char *ID)
   if (reg->uOSClass > OSCLASS_WINCE) {
     error = 1;
   }
-  if ((U_endian16(reg->uUDFRevision) < 0x100) || (U_endian16(reg->uUDFRevision) > 0x201)) {
+  if ((U_endian16(reg->uUDFRevision) < 0x100) || (U_endian16(reg->uUDFRevision) > 0x260)) {
     error = 1;
   }
   return error;
@@ -31,7 +31,7 @@ int CheckRegid(const struct udfEntityId *reg, const char *ID)
 /********************************************************************/
 /* Display only the first part of a regid                           */
 /********************************************************************/
-void DisplayRegIDID( struct regid *RegIDp)
+void DisplayRegIDID(udf_volume *vol,  struct regid *RegIDp)
 {
   /* assumes character is positioned */
   /* Make a null-terminated version of the Identifier field. */
@@ -40,104 +40,104 @@ void DisplayRegIDID( struct regid *RegIDp)
   id[23] = '\000';
 
   if ( RegIDp->uFlags & DIRTYREGID )
-    printf("(Dirty **NON-UDF**)     ");
+    fprintf(vol->Out, "(Dirty **NON-UDF**)     ");
   if ( RegIDp->uFlags & PROTECTREGID )
-    printf("(Protected **NON-UDF**) ");
+    fprintf(vol->Out, "(Protected **NON-UDF**) ");
 
-  printf("'%.23s'",id);
+  fprintf(vol->Out, "'%.23s'",id);
 }
 
-void printOSInfo( uint8_t osClass, uint8_t osIdentifier )
+void printOSInfo(udf_volume *vol,  uint8_t osClass, uint8_t osIdentifier )
 {
-  printf(" OS: %u,%u",
-         osClass,osIdentifier);
+  fprintf(vol->Out, " OS: %u,%u",
+          osClass,osIdentifier);
   switch (osClass) {
-    case OSCLASS_UNDEF: printf(" (Undefined)");  break;
-    case OSCLASS_DOS:   printf(" (DOS)");        break;
-    case OSCLASS_OS2:   printf(" (OS/2)");       break;
-    case OSCLASS_MAC:   printf(" (Macintosh)");  break;
-    case OSCLASS_UNIX:  printf(" (UNIX)");       break;
-    case OSCLASS_WIN9x: printf(" (Windows 9x)"); break;
-    case OSCLASS_WINNT: printf(" (Windows NT)"); break;
-    case OSCLASS_OS400: printf(" (Windows NT)"); break;
-    case OSCLASS_BEOS:  printf(" (BeOS)");       break;
-    case OSCLASS_WINCE: printf(" (Windows CE)"); break;
-    default:            printf(" (Illegal) ** NON-UDF **");
+    case OSCLASS_UNDEF: fprintf(vol->Out, " (Undefined)");  break;
+    case OSCLASS_DOS:   fprintf(vol->Out, " (DOS)");        break;
+    case OSCLASS_OS2:   fprintf(vol->Out, " (OS/2)");       break;
+    case OSCLASS_MAC:   fprintf(vol->Out, " (Macintosh)");  break;
+    case OSCLASS_UNIX:  fprintf(vol->Out, " (UNIX)");       break;
+    case OSCLASS_WIN9x: fprintf(vol->Out, " (Windows 9x)"); break;
+    case OSCLASS_WINNT: fprintf(vol->Out, " (Windows NT)"); break;
+    case OSCLASS_OS400: fprintf(vol->Out, " (Windows NT)"); break;
+    case OSCLASS_BEOS:  fprintf(vol->Out, " (BeOS)");       break;
+    case OSCLASS_WINCE: fprintf(vol->Out, " (Windows CE)"); break;
+    default:            fprintf(vol->Out, " (Illegal) ** NON-UDF **");
   }
 
   if (osClass == OSCLASS_UNIX) {
     switch (osIdentifier) {
-      case OSID_GENERIC:     printf(" (Undefined)"); break;
-      case OSID_IBM_AIX:     printf(" AIX");         break;
-      case OSID_SUN_SOLARIS: printf(" Solaris");     break;
-      case OSID_HPUX:        printf(" HPUX");        break;
-      case OSID_SGI_IRIX:    printf(" SGI_Irix");    break;
-      case OSID_LINUX:       printf(" Linux");       break;
-      case OSID_MKLINUX:     printf(" MkLinux");     break;
-      case OSID_FREEBSD:     printf(" FreeBSD");     break;
-      case OSID_NETBSD:      printf(" NetBSD");      break;
-      default:               printf(" (Unknown) ** NON-UDF **");
+      case OSID_GENERIC:     fprintf(vol->Out, " (Undefined)"); break;
+      case OSID_IBM_AIX:     fprintf(vol->Out, " AIX");         break;
+      case OSID_SUN_SOLARIS: fprintf(vol->Out, " Solaris");     break;
+      case OSID_HPUX:        fprintf(vol->Out, " HPUX");        break;
+      case OSID_SGI_IRIX:    fprintf(vol->Out, " SGI_Irix");    break;
+      case OSID_LINUX:       fprintf(vol->Out, " Linux");       break;
+      case OSID_MKLINUX:     fprintf(vol->Out, " MkLinux");     break;
+      case OSID_FREEBSD:     fprintf(vol->Out, " FreeBSD");     break;
+      case OSID_NETBSD:      fprintf(vol->Out, " NetBSD");      break;
+      default:               fprintf(vol->Out, " (Unknown) ** NON-UDF **");
     }
   } else if (osClass == OSCLASS_MAC) {
     switch (osIdentifier) {
-      case 0:                printf(" (pre-OS X)");    break;
-      case 1:                printf(" (OS X)");        break;
-      default:               printf(" (Unknown) ** NON-UDF **");
+      case 0:                fprintf(vol->Out, " (pre-OS X)");    break;
+      case 1:                fprintf(vol->Out, " (OS X)");        break;
+      default:               fprintf(vol->Out, " (Unknown) ** NON-UDF **");
     }
   } else {
     if (osIdentifier != 0)
-      printf("\n  ** NON-UDF **");
+      fprintf(vol->Out, "\n  ** NON-UDF **");
   }
 }
 
 /**************************/
 /* Display a UDF EntityID */
 /**************************/
-void DisplayUdfID(struct udfEntityId * ueip)
+void DisplayUdfID(udf_volume *vol, struct udfEntityId * ueip)
 {
   int i;
   /* Display the Identifier and flags field first */
-  DisplayRegIDID((struct regid *)ueip);
+  DisplayRegIDID(vol, (struct regid *)ueip);
 
   /* Then display the suffix */
-  printf(", UDF Ver.: %02x.%02x",
-         (U_endian16(ueip->uUDFRevision) & 0xff00) >> 8, U_endian16(ueip->uUDFRevision) & 0xff);
-  printOSInfo(ueip->uOSClass,ueip->uOSIdentifier);
+  fprintf(vol->Out, ", UDF Ver.: %02x.%02x",
+          (U_endian16(ueip->uUDFRevision) & 0xff00) >> 8, U_endian16(ueip->uUDFRevision) & 0xff);
+  printOSInfo(vol, ueip->uOSClass,ueip->uOSIdentifier);
   if (*(ueip->aReserved) != 0) {
-    printf(", Reserved: ");
+    fprintf(vol->Out, ", Reserved: ");
     for (i = 0; i < 4; i++) {
-      printf("%02x ", ueip->aReserved[i]);
+      fprintf(vol->Out, "%02x ", ueip->aReserved[i]);
     }
   }
-  printf("\n");
+  fprintf(vol->Out, "\n");
 }
 
 /********************************/
 /* Display an Application ID    */
 /********************************/
-void DisplayAppID(struct regid *pAppID)
+void DisplayAppID(udf_volume *vol, struct regid *pAppID)
 {
-  DisplayRegIDID(pAppID);
-  printf("\n");
+  DisplayRegIDID(vol, pAppID);
+  fprintf(vol->Out, "\n");
 }
 
 /********************************/
 /* Display an implementation ID */
 /********************************/
 
-void DisplayImplID(struct implEntityId * ieip)
+void DisplayImplID(udf_volume *vol, struct implEntityId * ieip)
 {
   int i;
   /* Display the Identifier and flags field first */
-  DisplayRegIDID((struct regid *)ieip);
+  DisplayRegIDID(vol, (struct regid *)ieip);
 
   /* Then display the suffix */
-  printOSInfo(ieip->uOSClass,ieip->uOSIdentifier);
+  printOSInfo(vol, ieip->uOSClass,ieip->uOSIdentifier);
   if (*(ieip->uImplUse) != 0) {
-    printf(", Impl. use: ");
+    fprintf(vol->Out, ", Impl. use: ");
     for (i = 0; i < 6; i++) {
-      printf("%02x ", ieip->uImplUse[i]);
+      fprintf(vol->Out, "%02x ", ieip->uImplUse[i]);
     }
   }
-  printf("\n");
+  fprintf(vol->Out, "\n");
 }
@@ -12,8 +12,8 @@
 
 /*
  * This set of functions is used to verify individual volume structures.
- * In addition, appropriate information is pulled off and stored in global
- * variables.  The fields that are not checked or displayed should be, I
+ * In addition, appropriate information is pulled off and stored in the
+ * volume context.  The fields that are not checked or displayed should be, I
  * just haven't implemented it.  The code is pretty simple but tedious.
  * Each interesting (to me) field of the Main descriptor is displayed, 
  * and if a difference is found between the Main and Reserve sequences, 
@@ -23,6 +23,18 @@
  * because it is flagged earlier and would make a messy display.
  */
 
+/*
+ * Main and Reserve descriptors normally differ only in their tags, so one
+ * comparison of everything after the tag usually settles all the fields
+ * that would otherwise be compared one at a time.
+ */
+static bool ReserveDiffers(udf_volume *vol, const void *mainVD, const void *reserveVD)
+{
+  return vol->RVDS_Len && memcmp((const uint8_t *)mainVD + sizeof(struct tag),
+                                 (const uint8_t *)reserveVD + sizeof(struct tag),
+                                 vol->secsize - sizeof(struct tag));
+}
+
 /* 
  * The following routine checks the PVD.  It looks for legal values in most
  * fields and verifies that the main and reserve PVD are equivalent.  A few
@@ -32,109 +44,111 @@
  *   uint16_t uFlags;
  *   uint8_t  aReserved[22];
  */
-int checkPVD(struct PrimaryVolDes *mPVD, struct PrimaryVolDes *rPVD)
+int checkPVD(udf_volume *vol, struct PrimaryVolDes *mPVD, struct PrimaryVolDes *rPVD)
 {
+  bool reserveDiffers;
   int error;
 
-  error = CheckTag((struct tag *)mPVD, U_endian32(mPVD->sTag.uTagLoc), TAGID_PVD, 496, 496);
-  DumpError();
+  reserveDiffers = ReserveDiffers(vol, mPVD, rPVD);
+  error = CheckTag(vol, (struct tag *)mPVD, U_endian32(mPVD->sTag.uTagLoc), TAGID_PVD, 496, 496);
+  DumpError(vol);
   if (error < CHECKTAG_OK_LIMIT) {
-    printf("  (M) Volume Identifier: ");
-    printDstring( mPVD->aVolID, 32);
-    if (RVDS_Len && memcmp(mPVD->aVolID, rPVD->aVolID, 32)) {
-      printf("**(R) Volume Identifier: ");
-      printDstring(rPVD->aVolID, 32);
-    }
-    printf("  (M) Volume Set ID:     ");
-    printDstring( mPVD->aVolSetID, 128);
-    if (RVDS_Len && memcmp(mPVD->aVolSetID, rPVD->aVolSetID, 128)) {
-      printf("**(R) Volume Set ID:     ");
-      printDstring( rPVD->aVolSetID, 128);
-    }
-    printf("  (M) Recording Time: ");
-    printTimestamp( mPVD->sRecordingTime);
-    if (RVDS_Len && memcmp(&mPVD->sRecordingTime, &rPVD->sRecordingTime, sizeof(struct timestamp))) {
-      printf("  (R) Recording Time: ");
-      printTimestamp( rPVD->sRecordingTime);
-    }
-    printf("  (M) Primary Volume Descriptor number is %u.\n", U_endian32(mPVD->uPrimVolDesNum));
-    if (RVDS_Len && (U_endian32(mPVD->uPrimVolDesNum) != U_endian32(rPVD->uPrimVolDesNum))) {
-      printf("  (R) Primary Volume Descriptor number is %u.\n", U_endian32(rPVD->uPrimVolDesNum));
+    fprintf(vol->Out, "  (M) Volume Identifier: ");
+    printDstring(vol,  mPVD->aVolID, 32);
+    if (reserveDiffers && memcmp(mPVD->aVolID, rPVD->aVolID, 32)) {
+      fprintf(vol->Out, "**(R) Volume Identifier: ");
+      printDstring(vol, rPVD->aVolID, 32);
+    }
+    fprintf(vol->Out, "  (M) Volume Set ID:     ");
+    printDstring(vol,  mPVD->aVolSetID, 128);
+    if (reserveDiffers && memcmp(mPVD->aVolSetID, rPVD->aVolSetID, 128)) {
+      fprintf(vol->Out, "**(R) Volume Set ID:     ");
+      printDstring(vol,  rPVD->aVolSetID, 128);
+    }
+    fprintf(vol->Out, "  (M) Recording Time: ");
+    printTimestamp(vol,  mPVD->sRecordingTime);
+    if (reserveDiffers && memcmp(&mPVD->sRecordingTime, &rPVD->sRecordingTime, sizeof(struct timestamp))) {
+      fprintf(vol->Out, "  (R) Recording Time: ");
+      printTimestamp(vol,  rPVD->sRecordingTime);
+    }
+    fprintf(vol->Out, "  (M) Primary Volume Descriptor number is %u.\n", U_endian32(mPVD->uPrimVolDesNum));
+    if (reserveDiffers && (U_endian32(mPVD->uPrimVolDesNum) != U_endian32(rPVD->uPrimVolDesNum))) {
+      fprintf(vol->Out, "  (R) Primary Volume Descriptor number is %u.\n", U_endian32(rPVD->uPrimVolDesNum));
     }
     if ((U_endian16(mPVD->uVSN) != 1) || (U_endian16(mPVD->uMaxVSN) != 1) || 
-        (RVDS_Len && ((U_endian16(rPVD->uVSN) != 1) || (U_endian16(rPVD->uMaxVSN) != 1)))) {
-      printf("%s(M) Volume %u of %u.\n", U_endian16(mPVD->uVSN) > U_endian16(mPVD->uMaxVSN) ? "**" : "  ",
-            U_endian16(mPVD->uVSN), U_endian16(mPVD->uMaxVSN));
+        (vol->RVDS_Len && ((U_endian16(rPVD->uVSN) != 1) || (U_endian16(rPVD->uMaxVSN) != 1)))) {
+      fprintf(vol->Out, "%s(M) Volume %u of %u.\n", U_endian16(mPVD->uVSN) > U_endian16(mPVD->uMaxVSN) ? "**" : "  ",
+             U_endian16(mPVD->uVSN), U_endian16(mPVD->uMaxVSN));
       if ((U_endian16(mPVD->uVSN) != U_endian16(rPVD->uVSN)) || U_endian16((mPVD->uMaxVSN) != U_endian16(rPVD->uMaxVSN))) {
-        printf("**(R) Volume %u of %u.\n", U_endian16(rPVD->uVSN), U_endian16(rPVD->uMaxVSN));
+        fprintf(vol->Out, "**(R) Volume %u of %u.\n", U_endian16(rPVD->uVSN), U_endian16(rPVD->uMaxVSN));
       }
     }
-    if ((U_endian16(mPVD->uInterchangeLev) != 2) || (RVDS_Len && (U_endian16(rPVD->uInterchangeLev) != 2))) {
-      printf("  (M) Interchange level is %u.\n", U_endian16(mPVD->uInterchangeLev));
-      if (RVDS_Len && (U_endian16(mPVD->uInterchangeLev) != U_endian16(rPVD->uInterchangeLev))) {
-        printf("**(R) Interchange level is %u.\n", U_endian16(rPVD->uInterchangeLev));
+    if ((U_endian16(mPVD->uInterchangeLev) != 2) || (vol->RVDS_Len && (U_endian16(rPVD->uInterchangeLev) != 2))) {
+      fprintf(vol->Out, "  (M) Interchange level is %u.\n", U_endian16(mPVD->uInterchangeLev));
+      if (reserveDiffers && (U_endian16(mPVD->uInterchangeLev) != U_endian16(rPVD->uInterchangeLev))) {
+        fprintf(vol->Out, "**(R) Interchange level is %u.\n", U_endian16(rPVD->uInterchangeLev));
       }
     }
-    if ((U_endian16(mPVD->uMaxInterchangeLev) != 3) || (RVDS_Len && (U_endian16(rPVD->uMaxInterchangeLev) != 3))) {
-      printf("**(M) Max. Interchange level is %u.\n", U_endian16(mPVD->uMaxInterchangeLev));
-      if (RVDS_Len && (U_endian16(mPVD->uMaxInterchangeLev) != U_endian16(rPVD->uMaxInterchangeLev))) {
-        printf("**(R) Max. Interchange level is %u.\n", U_endian16(rPVD->uMaxInterchangeLev));
+    if ((U_endian16(mPVD->uMaxInterchangeLev) != 3) || (vol->RVDS_Len && (U_endian16(rPVD->uMaxInterchangeLev) != 3))) {
+      fprintf(vol->Out, "**(M) Max. Interchange level is %u.\n", U_endian16(mPVD->uMaxInterchangeLev));
+      if (reserveDiffers && (U_endian16(mPVD->uMaxInterchangeLev) != U_endian16(rPVD->uMaxInterchangeLev))) {
+        fprintf(vol->Out, "**(R) Max. Interchange level is %u.\n", U_endian16(rPVD->uMaxInterchangeLev));
       }
     }
-    if ((U_endian32(mPVD->uCharSetList) != 1) || (RVDS_Len && (U_endian32(rPVD->uCharSetList) != 1))) {
-      printf("**(M) Character set list is 0x%08x.\n", U_endian32(mPVD->uCharSetList));
-      if (RVDS_Len && (U_endian32(mPVD->uCharSetList) != U_endian32(rPVD->uCharSetList))) {
-        printf("**(R) Character set list is 0x%08x.\n", U_endian32(rPVD->uCharSetList));
+    if ((U_endian32(mPVD->uCharSetList) != 1) || (vol->RVDS_Len && (U_endian32(rPVD->uCharSetList) != 1))) {
+      fprintf(vol->Out, "**(M) Character set list is 0x%08x.\n", U_endian32(mPVD->uCharSetList));
+      if (reserveDiffers && (U_endian32(mPVD->uCharSetList) != U_endian32(rPVD->uCharSetList))) {
+        fprintf(vol->Out, "**(R) Character set list is 0x%08x.\n", U_endian32(rPVD->uCharSetList));
       }
     }
-    if ((U_endian32(mPVD->uMaxCharSetList) != 1) || (RVDS_Len && (U_endian32(rPVD->uMaxCharSetList) != 1))) {
-      printf("**(M) Max. Character set list is 0x%08x.\n", U_endian32(mPVD->uMaxCharSetList));
-      if (RVDS_Len && (U_endian32(mPVD->uMaxCharSetList) != U_endian32(rPVD->uMaxCharSetList))) {
-        printf("**(R) Max. Character set list is 0x%08x.\n", U_endian32(rPVD->uMaxCharSetList));
+    if ((U_endian32(mPVD->uMaxCharSetList) != 1) || (vol->RVDS_Len && (U_endian32(rPVD->uMaxCharSetList) != 1))) {
+      fprintf(vol->Out, "**(M) Max. Character set list is 0x%08x.\n", U_endian32(mPVD->uMaxCharSetList));
+      if (reserveDiffers && (U_endian32(mPVD->uMaxCharSetList) != U_endian32(rPVD->uMaxCharSetList))) {
+        fprintf(vol->Out, "**(R) Max. Character set list is 0x%08x.\n", U_endian32(rPVD->uMaxCharSetList));
       }
     }
     if (!Is_Charspec(&mPVD->sDesCharSet)) {
-      printf("**(M) Description Character Set is: ");
-      printCharSpec(mPVD->sDesCharSet);
+      fprintf(vol->Out, "**(M) Description Character Set is: ");
+      printCharSpec(vol, mPVD->sDesCharSet);
     }
-    if (RVDS_Len && !Is_Charspec(&rPVD->sDesCharSet)) {
-      printf("**(R) Description Character Set is: ");
-      printCharSpec(rPVD->sDesCharSet);
+    if (vol->RVDS_Len && !Is_Charspec(&rPVD->sDesCharSet)) {
+      fprintf(vol->Out, "**(R) Description Character Set is: ");
+      printCharSpec(vol, rPVD->sDesCharSet);
     }
     if (!Is_Charspec(&mPVD->sExplanatoryCharSet)) {
-      printf("**(M) Description Character Set is: ");
-      printCharSpec(mPVD->sExplanatoryCharSet);
-    }
-    if (RVDS_Len && !Is_Charspec(&rPVD->sExplanatoryCharSet)) {
-      printf("**(R) Description Character Set is: ");
-      printCharSpec(rPVD->sExplanatoryCharSet);
-    }
-    if (RVDS_Len && memcmp(&mPVD->sVolAbstract, &rPVD->sVolAbstract, sizeof(struct extent_ad))) {
-      printf("**(M) Volume Abstract location: ");
-      printExtentAD(mPVD->sVolAbstract);
-      printf("**(R) Volume Abstract location: ");
-      printExtentAD(rPVD->sVolAbstract);
-    }
-    if (RVDS_Len && memcmp(&mPVD->sVolCopyrightNotice, &rPVD->sVolCopyrightNotice, sizeof(struct extent_ad))) {
-      printf("**(M) Volume Abstract location: ");
-      printExtentAD(mPVD->sVolCopyrightNotice);
-      printf("**(R) Volume Abstract location: ");
-      printExtentAD(rPVD->sVolCopyrightNotice);
-    }
-    printf("  (M) App. ID:  ");
-    DisplayAppID(&mPVD->sApplicationID);
-    if (RVDS_Len && memcmp(&mPVD->sApplicationID, &rPVD->sApplicationID, sizeof(struct udfEntityId))) {
-      printf("**(R) App. ID:  ");
-      DisplayAppID(&rPVD->sApplicationID);
-    }
-    printf("  (M) Impl. ID: ");
-    DisplayImplID(&mPVD->sImplementationID);
-    if (RVDS_Len && memcmp(&mPVD->sImplementationID, &rPVD->sImplementationID, sizeof(struct udfEntityId))) {
-      printf("**(R) Impl. ID: ");
-      DisplayImplID(&rPVD->sImplementationID);
+      fprintf(vol->Out, "**(M) Description Character Set is: ");
+      printCharSpec(vol, mPVD->sExplanatoryCharSet);
+    }
+    if (vol->RVDS_Len && !Is_Charspec(&rPVD->sExplanatoryCharSet)) {
+      fprintf(vol->Out, "**(R) Description Character Set is: ");
+      printCharSpec(vol, rPVD->sExplanatoryCharSet);
+    }
+    if (reserveDiffers && memcmp(&mPVD->sVolAbstract, &rPVD->sVolAbstract, sizeof(struct extent_ad))) {
+      fprintf(vol->Out, "**(M) Volume Abstract location: ");
+      printExtentAD(vol, mPVD->sVolAbstract);
+      fprintf(vol->Out, "**(R) Volume Abstract location: ");
+      printExtentAD(vol, rPVD->sVolAbstract);
+    }
+    if (reserveDiffers && memcmp(&mPVD->sVolCopyrightNotice, &rPVD->sVolCopyrightNotice, sizeof(struct extent_ad))) {
+      fprintf(vol->Out, "**(M) Volume Abstract location: ");
+      printExtentAD(vol, mPVD->sVolCopyrightNotice);
+      fprintf(vol->Out, "**(R) Volume Abstract location: ");
+      printExtentAD(vol, rPVD->sVolCopyrightNotice);
+    }
+    fprintf(vol->Out, "  (M) App. ID:  ");
+    DisplayAppID(vol, &mPVD->sApplicationID);
+    if (reserveDiffers && memcmp(&mPVD->sApplicationID, &rPVD->sApplicationID, sizeof(struct udfEntityId))) {
+      fprintf(vol->Out, "**(R) App. ID:  ");
+      DisplayAppID(vol, &rPVD->sApplicationID);
+    }
+    fprintf(vol->Out, "  (M) Impl. ID: ");
+    DisplayImplID(vol, &mPVD->sImplementationID);
+    if (reserveDiffers && memcmp(&mPVD->sImplementationID, &rPVD->sImplementationID, sizeof(struct udfEntityId))) {
+      fprintf(vol->Out, "**(R) Impl. ID: ");
+      DisplayImplID(vol, &rPVD->sImplementationID);
     }
   }
-  return Error.Code;
+  return CurrentError(vol)->Code;
 }
 
 
@@ -144,70 +158,72 @@ int checkPVD(struct PrimaryVolDes *mPVD, struct PrimaryVolDes *rPVD)
  * fields are not checked or displayed:
  *   uint8_t aImplementationUse[128];
  */
-int checkIUVD(struct ImpUseDesc *mIUVD, struct ImpUseDesc *rIUVD)
+int checkIUVD(udf_volume *vol, struct ImpUseDesc *mIUVD, struct ImpUseDesc *rIUVD)
 {
+  bool reserveDiffers;
   int error;
   struct LVInformation *mLVI, *rLVI;
 
-  error = CheckTag((struct tag *)mIUVD, U_endian32(mIUVD->sTag.uTagLoc), TAGID_IUD, 0, secsize);
-  DumpError();
+  reserveDiffers = ReserveDiffers(vol, mIUVD, rIUVD);
+  error = CheckTag(vol, (struct tag *)mIUVD, U_endian32(mIUVD->sTag.uTagLoc), TAGID_IUD, 0, vol->secsize);
+  DumpError(vol);
   if (error < CHECKTAG_OK_LIMIT) {
-    printf("%s(M) Impl. ID: ",
-           CheckRegid(&mIUVD->sImplementationIdentifier, E_REGID_IUVD) ? "**" : "  ");
-    DisplayUdfID(&mIUVD->sImplementationIdentifier);
-    if (RVDS_Len && CheckRegid(&rIUVD->sImplementationIdentifier, E_REGID_IUVD)) {
-      printf("**(R) Impl. ID: ");
-      DisplayUdfID(&rIUVD->sImplementationIdentifier);
+    fprintf(vol->Out, "%s(M) Impl. ID: ",
+            CheckRegid(&mIUVD->sImplementationIdentifier, E_REGID_IUVD) ? "**" : "  ");
+    DisplayUdfID(vol, &mIUVD->sImplementationIdentifier);
+    if (vol->RVDS_Len && CheckRegid(&rIUVD->sImplementationIdentifier, E_REGID_IUVD)) {
+      fprintf(vol->Out, "**(R) Impl. ID: ");
+      DisplayUdfID(vol, &rIUVD->sImplementationIdentifier);
     }                                                                            
 
     mLVI = (struct LVInformation *)&(mIUVD->aReserved[0]);
     rLVI = (struct LVInformation *)&(rIUVD->aReserved[0]);
 
     if (!Is_Charspec(&mLVI->sLVICharset)) {
-      printf("**(M) Description Character Set is: ");
-      printCharSpec(mLVI->sLVICharset);
+      fprintf(vol->Out, "**(M) Description Character Set is: ");
+      printCharSpec(vol, mLVI->sLVICharset);
     }
-    if (RVDS_Len && !Is_Charspec(&rLVI->sLVICharset)) {
-      printf("**(R) Description Character Set is: ");
-      printCharSpec(rLVI->sLVICharset);
+    if (vol->RVDS_Len && !Is_Charspec(&rLVI->sLVICharset)) {
+      fprintf(vol->Out, "**(R) Description Character Set is: ");
+      printCharSpec(vol, rLVI->sLVICharset);
     }                                                                            
  
-    if (memcmp(LogVolID, mLVI->aLogicalVolumeIdentifier, 128)) {
-      printf("**(M) Logical Volume Identifier doesn't match LVD\n");
+    if (memcmp(vol->LogVolID, mLVI->aLogicalVolumeIdentifier, 128)) {
+      fprintf(vol->Out, "**(M) Logical Volume Identifier doesn't match LVD\n");
     }
-    printf("  (M) Logical Volume Identifier: ");
-    printDstring(mLVI->aLogicalVolumeIdentifier, 128);
-    if (RVDS_Len && memcmp(mLVI->aLogicalVolumeIdentifier, rLVI->aLogicalVolumeIdentifier, 128)) {
-      printf("**(R) Logical Volume Identifier: ");
-      printDstring(rLVI->aLogicalVolumeIdentifier, 128);
+    fprintf(vol->Out, "  (M) Logical Volume Identifier: ");
+    printDstring(vol, mLVI->aLogicalVolumeIdentifier, 128);
+    if (reserveDiffers && memcmp(mLVI->aLogicalVolumeIdentifier, rLVI->aLogicalVolumeIdentifier, 128)) {
+      fprintf(vol->Out, "**(R) Logical Volume Identifier: ");
+      printDstring(vol, rLVI->aLogicalVolumeIdentifier, 128);
     }
 
-    printf("  (M) Logical Volume Info 1: ");
-    printDstring(mLVI->aLVInfo1, 36);
-    if (RVDS_Len && memcmp(mLVI->aLVInfo1, rLVI->aLVInfo1, 36)) {
-      printf("**(R) Logical Volume Info 1: ");
-      printDstring(rLVI->aLVInfo1, 36);
+    fprintf(vol->Out, "  (M) Logical Volume Info 1: ");
+    printDstring(vol, mLVI->aLVInfo1, 36);
+    if (reserveDiffers && memcmp(mLVI->aLVInfo1, rLVI->aLVInfo1, 36)) {
+      fprintf(vol->Out, "**(R) Logical Volume Info 1: ");
+      printDstring(vol, rLVI->aLVInfo1, 36);
     }
 
-    printf("  (M) Logical Volume Info 2: ");
-    printDstring(mLVI->aLVInfo2, 36);
-    if (RVDS_Len && memcmp(mLVI->aLVInfo2, rLVI->aLVInfo2, 36)) {
-      printf("**(R) Logical Volume Info 2: ");
-      printDstring(rLVI->aLVInfo2, 36);
+    fprintf(vol->Out, "  (M) Logical Volume Info 2: ");
+    printDstring(vol, mLVI->aLVInfo2, 36);
+    if (reserveDiffers && memcmp(mLVI->aLVInfo2, rLVI->aLVInfo2, 36)) {
+      fprintf(vol->Out, "**(R) Logical Volume Info 2: ");
+      printDstring(vol, rLVI->aLVInfo2, 36);
     }
 
-    printf("  (M) Logical Volume Info 3: ");
-    printDstring(mLVI->aLVInfo3, 36);
-    if (RVDS_Len && memcmp(mLVI->aLVInfo3, rLVI->aLVInfo3, 36)) {
-      printf("**(R) Logical Volume Info 3: ");
-      printDstring(rLVI->aLVInfo3, 36);
+    fprintf(vol->Out, "  (M) Logical Volume Info 3: ");
+    printDstring(vol, mLVI->aLVInfo3, 36);
+    if (reserveDiffers && memcmp(mLVI->aLVInfo3, rLVI->aLVInfo3, 36)) {
+      fprintf(vol->Out, "**(R) Logical Volume Info 3: ");
+      printDstring(vol, rLVI->aLVInfo3, 36);
     }
 
-    printf("  (M) Impl. ID: ");
-    DisplayImplID(&mLVI->sImplementationID);
-    if (RVDS_Len && memcmp(&mLVI->sImplementationID, &rLVI->sImplementationID, sizeof(struct udfEntityId))) {
-      printf("**(R) Impl. ID: ");
-      DisplayImplID(&rLVI->sImplementationID);
+    fprintf(vol->Out, "  (M) Impl. ID: ");
+    DisplayImplID(vol, &mLVI->sImplementationID);
+    if (reserveDiffers && memcmp(&mLVI->sImplementationID, &rLVI->sImplementationID, sizeof(struct udfEntityId))) {
+      fprintf(vol->Out, "**(R) Impl. ID: ");
+      DisplayImplID(vol, &rLVI->sImplementationID);
     }
   }
   return 0;
@@ -222,94 +238,100 @@ int checkIUVD(struct ImpUseDesc *mIUVD, struct ImpUseDesc *rIUVD)
  *   uint8_t  aImplementationUse[128];
  *   uint8_t  aReserved[156];
  */
-int checkPD(struct PartDesc *mPD, struct PartDesc *rPD)
+int checkPD(udf_volume *vol, struct PartDesc *mPD, struct PartDesc *rPD)
 {
+  bool reserveDiffers;
   int hit, i, error;
   struct PartHeaderDesc *PHD;
 
-  error = CheckTag((struct tag *)mPD, U_endian32(mPD->sTag.uTagLoc), TAGID_PD, 496, 496);
-  DumpError();
+  reserveDiffers = ReserveDiffers(vol, mPD, rPD);
+  error = CheckTag(vol, (struct tag *)mPD, U_endian32(mPD->sTag.uTagLoc), TAGID_PD, 496, 496);
+  DumpError(vol);
   if (error < CHECKTAG_OK_LIMIT) {
-    printf("  (M) Partition number %u.\n", U_endian16(mPD->uPartNumber));
-    if (RVDS_Len && (U_endian16(mPD->uPartNumber) != U_endian16(rPD->uPartNumber))) {
-      printf("**(R) Partition number %u.\n", U_endian16(rPD->uPartNumber));
+    fprintf(vol->Out, "  (M) Partition number %u.\n", U_endian16(mPD->uPartNumber));
+    if (reserveDiffers && (U_endian16(mPD->uPartNumber) != U_endian16(rPD->uPartNumber))) {
+      fprintf(vol->Out, "**(R) Partition number %u.\n", U_endian16(rPD->uPartNumber));
     }
 
-    printf("  (M) Partition flags: %04x (Space %sAllocated)\n", U_endian16(mPD->uPartFlags),
-            U_endian16(mPD->uPartFlags) & PARTITION_ALLOCATED ? "" : "NOT ");
-    if (RVDS_Len && (U_endian16(mPD->uPartFlags) != U_endian16(rPD->uPartFlags))) {
-      printf("  (R) Partition flags: %04x (Space %sAllocated)\n", U_endian16(rPD->uPartFlags),
-              U_endian16(rPD->uPartFlags) & PARTITION_ALLOCATED ? "" : "NOT ");
+    fprintf(vol->Out, "  (M) Partition flags: %04x (Space %sAllocated)\n", U_endian16(mPD->uPartFlags),
+             U_endian16(mPD->uPartFlags) & PARTITION_ALLOCATED ? "" : "NOT ");
+    if (reserveDiffers && (U_endian16(mPD->uPartFlags) != U_endian16(rPD->uPartFlags))) {
+      fprintf(vol->Out, "  (R) Partition flags: %04x (Space %sAllocated)\n", U_endian16(rPD->uPartFlags),
+               U_endian16(rPD->uPartFlags) & PARTITION_ALLOCATED ? "" : "NOT ");
     }
 
     if (memcmp((uint8_t *)&mPD->sPartContents +1, E_REGID_NSR, 5)) {
-      printf("**(M) Illegal partition contents identifier\n      ");
-      DisplayRegIDID(&mPD->sPartContents);
-      printf("\n");
+      fprintf(vol->Out, "**(M) Illegal partition contents identifier\n      ");
+      DisplayRegIDID(vol, &mPD->sPartContents);
+      fprintf(vol->Out, "\n");
     }
-    if (*((uint8_t *)(&mPD->sPartContents) + 6) - '0' != UDF_Version) {
-      printf("**(M) NSR version is %u, partition claims %u.  Changing.\n", UDF_Version,
-             *((uint8_t *)(&mPD->sPartContents) + 6) - '0');
-      UDF_Version = *((uint8_t *)(&mPD->sPartContents) + 6) - '0';
-      Version_OK = true;
+    if (*((uint8_t *)(&mPD->sPartContents) + 6) - '0' != vol->UDF_Version) {
+      fprintf(vol->Out, "**(M) NSR version is %u, partition claims %u.  Changing.\n", vol->UDF_Version,
+              *((uint8_t *)(&mPD->sPartContents) + 6) - '0');
+      vol->UDF_Version = *((uint8_t *)(&mPD->sPartContents) + 6) - '0';
+      vol->Version_OK = true;
     }
-    if (RVDS_Len && memcmp((uint8_t *)&mPD->sPartContents, (uint8_t *)&rPD->sPartContents, sizeof(struct regid))) {
-      printf("**(R) Reserve sequence partition contents identifier\n      ");
-      DisplayRegIDID(&rPD->sPartContents);
-      printf("\n");
+    if (reserveDiffers && memcmp((uint8_t *)&mPD->sPartContents, (uint8_t *)&rPD->sPartContents, sizeof(struct regid))) {
+      fprintf(vol->Out, "**(R) Reserve sequence partition contents identifier\n      ");
+      DisplayRegIDID(vol, &rPD->sPartContents);
+      fprintf(vol->Out, "\n");
     }
 
-    printf("  (M) Impl. ID: ");
-    DisplayImplID(&mPD->sImplementationID);
-    if (RVDS_Len && memcmp(&mPD->sImplementationID, &rPD->sImplementationID, sizeof(struct udfEntityId))) {
-      printf("**(R) Impl. ID: ");
-      DisplayImplID(&rPD->sImplementationID);
+    fprintf(vol->Out, "  (M) Impl. ID: ");
+    DisplayImplID(vol, &mPD->sImplementationID);
+    if (reserveDiffers && memcmp(&mPD->sImplementationID, &rPD->sImplementationID, sizeof(struct udfEntityId))) {
+      fprintf(vol->Out, "**(R) Impl. ID: ");
+      DisplayImplID(vol, &rPD->sImplementationID);
     }
 
 
     switch (U_endian32(mPD->uAccessType)) {
-      case ACCESS_UNSPECIFIED:  printf("  (M) Access Type Unspecified.\n");  break;
-      case ACCESS_READ_ONLY:    printf("  (M) Access Type Read Only.\n");    break;
-      case ACCESS_WORM:         printf("  (M) Access Type Write Once.\n");   break;
-      case ACCESS_REWRITABLE:   printf("  (M) Access Type Rewritable.\n");   break;
-      case ACCESS_OVERWRITABLE: printf("  (M) Access Type Overwritable.\n"); break;
-      default:                  printf("**(M) Access Type Non-Standard.\n"); break;
-    }
-    if (RVDS_Len && (U_endian32(mPD->uAccessType) != U_endian32(rPD->uAccessType))) {
+      case ACCESS_UNSPECIFIED:  fprintf(vol->Out, "  (M) Access Type Unspecified.\n");  break;
+      case ACCESS_READ_ONLY:    fprintf(vol->Out, "  (M) Access Type Read Only.\n");    break;
+      case ACCESS_WORM:         fprintf(vol->Out, "  (M) Access Type Write Once.\n");   break;
+      case ACCESS_REWRITABLE:   fprintf(vol->Out, "  (M) Access Type Rewritable.\n");   break;
+      case ACCESS_OVERWRITABLE: fprintf(vol->Out, "  (M) Access Type Overwritable.\n"); break;
+      default:                  fprintf(vol->Out, "**(M) Access Type Non-Standard.\n"); break;
+    }
+    if (reserveDiffers && (U_endian32(mPD->uAccessType) != U_endian32(rPD->uAccessType))) {
       switch (U_endian32(rPD->uAccessType)) {
-        case ACCESS_UNSPECIFIED:  printf("**(R) Access Type Unspecified.\n");  break;
-        case ACCESS_READ_ONLY:    printf("**(R) Access Type Read Only.\n");    break;
-        case ACCESS_WORM:         printf("**(R) Access Type Write Once.\n");   break;
-        case ACCESS_REWRITABLE:   printf("**(R) Access Type Rewritable.\n");   break;
-        case ACCESS_OVERWRITABLE: printf("**(R) Access Type Overwritable.\n"); break;
-        default:                  printf("**(R) Access Type Non-Standard.\n"); break;
+        case ACCESS_UNSPECIFIED:  fprintf(vol->Out, "**(R) Access Type Unspecified.\n");  break;
+        case ACCESS_READ_ONLY:    fprintf(vol->Out, "**(R) Access Type Read Only.\n");    break;
+        case ACCESS_WORM:         fprintf(vol->Out, "**(R) Access Type Write Once.\n");   break;
+        case ACCESS_REWRITABLE:   fprintf(vol->Out, "**(R) Access Type Rewritable.\n");   break;
+        case ACCESS_OVERWRITABLE: fprintf(vol->Out, "**(R) Access Type Overwritable.\n"); break;
+        default:                  fprintf(vol->Out, "**(R) Access Type Non-Standard.\n"); break;
       }
     }
 
-    printf("  (M) Partition starts at sector %u.\n", U_endian32(mPD->uPartStartingLoc));
-    if (RVDS_Len && (U_endian32(mPD->uPartStartingLoc) != U_endian32(rPD->uPartStartingLoc))) {
-      printf("**(R) Partition starts at sector %u.\n", U_endian32(rPD->uPartStartingLoc));
+    fprintf(vol->Out, "  (M) Partition starts at sector %u.\n", U_endian32(mPD->uPartStartingLoc));
+    if (reserveDiffers && (U_endian32(mPD->uPartStartingLoc) != U_endian32(rPD->uPartStartingLoc))) {
+      fprintf(vol->Out, "**(R) Partition starts at sector %u.\n", U_endian32(rPD->uPartStartingLoc));
     }
 
-    printf("  (M) Partition length is %u sectors.\n", U_endian32(mPD->uPartLength));
-    if (RVDS_Len && (U_endian32(mPD->uPartLength) != U_endian32(rPD->uPartLength))) {
-      printf("**(R) Partition Length is %u sectors.\n", U_endian32(rPD->uPartLength));
+    fprintf(vol->Out, "  (M) Partition length is %u sectors.\n", U_endian32(mPD->uPartLength));
+    if (reserveDiffers && (U_endian32(mPD->uPartLength) != U_endian32(rPD->uPartLength))) {
+      fprintf(vol->Out, "**(R) Partition Length is %u sectors.\n", U_endian32(rPD->uPartLength));
     }
 
-    track_volspace(U_endian32(mPD->uPartStartingLoc), U_endian32(mPD->uPartLength), "A partition");
+    track_volspace(vol, U_endian32(mPD->uPartStartingLoc), U_endian32(mPD->uPartLength), "A partition");
 
     hit = 0;
-    for (i = 0; i < PTN_no; i++) {
-      if (Part_Info[i].Num == U_endian16(mPD->uPartNumber)) {
+    for (i = 0; i < vol->PTN_no; i++) {
+      if (   (vol->Part_Info[i].type == PTN_TYP_METADATA)
+          && (vol->Part_Info[i].Num == U_endian16(mPD->uPartNumber))) {
+        // Blocks are located through the Metadata File (see GetMetadata)
+        vol->Part_Info[i].Offs = U_endian32(mPD->uPartStartingLoc);
+      } else if (vol->Part_Info[i].Num == U_endian16(mPD->uPartNumber)) {
         uint32_t expectedBitmapNumBytes;    // Expected/maximum
-        Part_Info[i].Offs = U_endian32(mPD->uPartStartingLoc);
-        Part_Info[i].Len = U_endian32(mPD->uPartLength);
-        expectedBitmapNumBytes = BITMAP_NUM_BYTES(Part_Info[i].Len);    // Expected/maximum
+        vol->Part_Info[i].Offs = U_endian32(mPD->uPartStartingLoc);
+        vol->Part_Info[i].Len = U_endian32(mPD->uPartLength);
+        expectedBitmapNumBytes = BITMAP_NUM_BYTES(vol->Part_Info[i].Len);    // Expected/maximum
 
         // Calculate the mask for the last byte of the space map
         // (screen out bits representing blocks beyond end of partition)
-        if (Part_Info[i].Len & 7) {
-          unsigned int finalByteNumInvalid = 8 - (Part_Info[i].Len & 7);
+        if (vol->Part_Info[i].Len & 7) {
+          unsigned int finalByteNumInvalid = 8 - (vol->Part_Info[i].Len & 7);
 
           /**
            * Note, bitmap accounting is such that lowest bit == lowest location,
@@ -327,32 +349,32 @@ int checkPD(struct PartDesc *mPD, struct PartDesc *rPD)
            * So, any blocks beyond the end of the partition would be at the
            * most significant bits of the last byte.
            */
-          Part_Info[i].FinalMapByteMask = 0xFF >> finalByteNumInvalid;
+          vol->Part_Info[i].FinalMapByteMask = 0xFF >> finalByteNumInvalid;
         }
 
         hit++;
         PHD = (struct PartHeaderDesc *)(mPD->aPartContentsUse);
         if (U_endian32(PHD->USB.ExtentLengthAndType)) {
           /* Unallocated Space Bitmap */
-          Part_Info[i].SpaceTag = TAGID_SPACE_BMAP;
-          Part_Info[i].Space = U_endian32(PHD->USB.Location);
-          Part_Info[i].SpLen = EXTENT_LENGTH(PHD->USB.ExtentLengthAndType);
-          Part_Info[i].SpMap = malloc(expectedBitmapNumBytes);
-          Part_Info[i].MyMap = malloc(expectedBitmapNumBytes);
-          if (Part_Info[i].SpMap) {
+          vol->Part_Info[i].SpaceTag = TAGID_SPACE_BMAP;
+          vol->Part_Info[i].Space = U_endian32(PHD->USB.Location);
+          vol->Part_Info[i].SpLen = EXTENT_LENGTH(PHD->USB.ExtentLengthAndType);
+          vol->Part_Info[i].SpMap = malloc(expectedBitmapNumBytes);
+          vol->Part_Info[i].MyMap = malloc(expectedBitmapNumBytes);
+          if (vol->Part_Info[i].SpMap) {
             // Fill in case of underread later
-            memset(Part_Info[i].SpMap, 0xff, expectedBitmapNumBytes-1);
-            Part_Info[i].SpMap[expectedBitmapNumBytes-1] = Part_Info[i].FinalMapByteMask;
+            memset(vol->Part_Info[i].SpMap, 0xff, expectedBitmapNumBytes-1);
+            vol->Part_Info[i].SpMap[expectedBitmapNumBytes-1] = vol->Part_Info[i].FinalMapByteMask;
           }
-          if (Part_Info[i].MyMap) {
-            memset(Part_Info[i].MyMap, 0xff, expectedBitmapNumBytes-1);
-            Part_Info[i].MyMap[expectedBitmapNumBytes-1] = Part_Info[i].FinalMapByteMask;
+          if (vol->Part_Info[i].MyMap) {
+            memset(vol->Part_Info[i].MyMap, 0xff, expectedBitmapNumBytes-1);
+            vol->Part_Info[i].MyMap[expectedBitmapNumBytes-1] = vol->Part_Info[i].FinalMapByteMask;
           }
         } else if (U_endian32(PHD->UST.ExtentLengthAndType)) {
           /* Unallocated Space Table */
-          Part_Info[i].SpaceTag = TAGID_UNALLOC_SP_ENTRY;
-          Part_Info[i].Space = U_endian32(PHD->UST.Location);
-          Part_Info[i].SpLen = EXTENT_LENGTH(PHD->UST.ExtentLengthAndType);
+          vol->Part_Info[i].SpaceTag = TAGID_UNALLOC_SP_ENTRY;
+          vol->Part_Info[i].Space = U_endian32(PHD->UST.Location);
+          vol->Part_Info[i].SpLen = EXTENT_LENGTH(PHD->UST.ExtentLengthAndType);
 
           // Ambiguity in the UDF and ECMA standards:
           // it's not clear whether PD references to space tables whose blocks
@@ -366,31 +388,31 @@ int checkPD(struct PartDesc *mPD, struct PartDesc *rPD)
           // indicate a 1-block extent.
           // Nevertheless, mkudffs in udftools 1.3 indicates an extent length that
           // encompasses the entire table of contiguous blocks.
-          if (Part_Info[i].SpLen > blocksize)
-            Part_Info[i].SpLen = blocksize;
+          if (vol->Part_Info[i].SpLen > vol->blocksize)
+            vol->Part_Info[i].SpLen = vol->blocksize;
 
-          Part_Info[i].SpMap = malloc(expectedBitmapNumBytes);
-          Part_Info[i].MyMap = malloc(expectedBitmapNumBytes);
-          if (Part_Info[i].SpMap) {
+          vol->Part_Info[i].SpMap = malloc(expectedBitmapNumBytes);
+          vol->Part_Info[i].MyMap = malloc(expectedBitmapNumBytes);
+          if (vol->Part_Info[i].SpMap) {
             // In-use until marked free
-            memset(Part_Info[i].SpMap, 0, expectedBitmapNumBytes);
+            memset(vol->Part_Info[i].SpMap, 0, expectedBitmapNumBytes);
           }
-          if (Part_Info[i].MyMap) {
+          if (vol->Part_Info[i].MyMap) {
             // Free until marked in-use
-            memset(Part_Info[i].MyMap, 0xff, expectedBitmapNumBytes-1);
-            Part_Info[i].MyMap[expectedBitmapNumBytes-1] = Part_Info[i].FinalMapByteMask;
+            memset(vol->Part_Info[i].MyMap, 0xff, expectedBitmapNumBytes-1);
+            vol->Part_Info[i].MyMap[expectedBitmapNumBytes-1] = vol->Part_Info[i].FinalMapByteMask;
           }
         }
       }
     }
     if (hit != 1) {
-      printf("  (M) partition %u was referenced by %d maps.\n", U_endian16(mPD->uPartNumber),
-             hit);
+      fprintf(vol->Out, "  (M) partition %u was referenced by %d maps.\n", U_endian16(mPD->uPartNumber),
+              hit);
     }
   } else {
-    Fatal = true;
+    vol->Fatal = true;
   }
-  DumpError();
+  DumpError(vol);
   return 0;
 }
 
@@ -401,185 +423,220 @@ int checkPD(struct PartDesc *mPD, struct PartDesc *rPD)
  * fields are not checked or displayed:
  *   uint8_t aImplementationUse[128];
  */
-int checkLVD(struct LogVolDesc *mLVD, struct LogVolDesc *rLVD)
+int checkLVD(udf_volume *vol, struct LogVolDesc *mLVD, struct LogVolDesc *rLVD)
 {
+  bool reserveDiffers;
   int i, offset, error;
+  uint32_t maxMaps;
   struct PartMap1   *sPartMap1;
   struct PartMapVAT *sPartMapVAT;
   struct PartMapSP  *sPartMapSP;
+  struct PartMapMeta *sPartMapMeta;
 
-  error = CheckTag((struct tag *)mLVD, U_endian32(mLVD->sTag.uTagLoc), TAGID_LVD, 424, secsize);
-  DumpError();
+  reserveDiffers = ReserveDiffers(vol, mLVD, rLVD);
+  error = CheckTag(vol, (struct tag *)mLVD, U_endian32(mLVD->sTag.uTagLoc), TAGID_LVD, 424, vol->secsize);
+  DumpError(vol);
   if (error < CHECKTAG_OK_LIMIT) {
     if (!Is_Charspec(&mLVD->sDesCharSet)) {
-      printf("**(M) Description Character Set is: ");
-      printCharSpec(mLVD->sDesCharSet);
+      fprintf(vol->Out, "**(M) Description Character Set is: ");
+      printCharSpec(vol, mLVD->sDesCharSet);
     }
-    if (RVDS_Len && !Is_Charspec(&rLVD->sDesCharSet)) {
-      printf("**(R) Description Character Set is: ");
-      printCharSpec(rLVD->sDesCharSet);
+    if (vol->RVDS_Len && !Is_Charspec(&rLVD->sDesCharSet)) {
+      fprintf(vol->Out, "**(R) Description Character Set is: ");
+      printCharSpec(vol, rLVD->sDesCharSet);
     }
 
-    memcpy(LogVolID, mLVD->uLogVolID, 128);
+    memcpy(vol->LogVolID, mLVD->uLogVolID, 128);
 
-    printf("  (M) Logical Volume ID:     ");
-    printDstring( mLVD->uLogVolID, 128);
-    if (RVDS_Len && memcmp(mLVD->uLogVolID, rLVD->uLogVolID, 128)) {
-      printf("**(R) Logical Volume ID:     ");
-      printDstring( rLVD->uLogVolID, 128);
+    fprintf(vol->Out, "  (M) Logical Volume ID:     ");
+    printDstring(vol,  mLVD->uLogVolID, 128);
+    if (reserveDiffers && memcmp(mLVD->uLogVolID, rLVD->uLogVolID, 128)) {
+      fprintf(vol->Out, "**(R) Logical Volume ID:     ");
+      printDstring(vol,  rLVD->uLogVolID, 128);
     }
 
-    blocksize = U_endian32(mLVD->uLogBlkSize);
-    if (blocksize < secsize) {
-      printf("**(M) Block size of %u is less than sector size of %u!.\n",
-             blocksize, secsize);
-      Fatal = true;
+    vol->blocksize = U_endian32(mLVD->uLogBlkSize);
+    if (vol->blocksize < vol->secsize) {
+      fprintf(vol->Out, "**(M) Block size of %u is less than sector size of %u!.\n",
+              vol->blocksize, vol->secsize);
+      vol->Fatal = true;
     } else {
-      while (!((1 << bdivshift) & blocksize)) {
-        bdivshift++;
+      while (!((1 << vol->bdivshift) & vol->blocksize)) {
+        vol->bdivshift++;
       }
-      s_per_b = blocksize / secsize;
+      vol->s_per_b = vol->blocksize / vol->secsize;
     }
-    if (blocksize != secsize) {
-      printf("**(M) Block size is %u, sector size is %u.\n", blocksize, secsize);
+    if (vol->blocksize != vol->secsize) {
+      fprintf(vol->Out, "**(M) Block size is %u, sector size is %u.\n", vol->blocksize, vol->secsize);
     }
-    if (RVDS_Len && (U_endian32(rLVD->uLogBlkSize) != blocksize)) {
-      printf("**(R) Block size is %u.\n", rLVD->uLogBlkSize);
+    if (reserveDiffers && (U_endian32(rLVD->uLogBlkSize) != vol->blocksize)) {
+      fprintf(vol->Out, "**(R) Block size is %u.\n", rLVD->uLogBlkSize);
     }
 
     if (CheckRegid((struct udfEntityId *)&mLVD->sDomainID, UDF_DOMAIN_ID)) {
-      printf("**(M) Domain Identifier: ");
-      DisplayUdfID((struct udfEntityId *)&mLVD->sDomainID);
+      fprintf(vol->Out, "**(M) Domain Identifier: ");
+      DisplayUdfID(vol, (struct udfEntityId *)&mLVD->sDomainID);
     }
 
-    if (RVDS_Len && CheckRegid((struct udfEntityId *)&rLVD->sDomainID, UDF_DOMAIN_ID)) {
-      printf("**(R) Domain Identifier: ");
-      DisplayUdfID((struct udfEntityId *)&rLVD->sDomainID);
+    if (vol->RVDS_Len && CheckRegid((struct udfEntityId *)&rLVD->sDomainID, UDF_DOMAIN_ID)) {
+      fprintf(vol->Out, "**(R) Domain Identifier: ");
+      DisplayUdfID(vol, (struct udfEntityId *)&rLVD->sDomainID);
     }
 
-    printf("  (M) Impl. ID: ");
-    DisplayImplID(&mLVD->sImplementationID);
-    if (RVDS_Len && memcmp(&mLVD->sImplementationID, &rLVD->sImplementationID, sizeof(struct udfEntityId))) {
-      printf("**(R) Impl. ID: ");
-      DisplayImplID(&rLVD->sImplementationID);
+    fprintf(vol->Out, "  (M) Impl. ID: ");
+    DisplayImplID(vol, &mLVD->sImplementationID);
+    if (reserveDiffers && memcmp(&mLVD->sImplementationID, &rLVD->sImplementationID, sizeof(struct udfEntityId))) {
+      fprintf(vol->Out, "**(R) Impl. ID: ");
+      DisplayImplID(vol, &rLVD->sImplementationID);
     }
 
-    memcpy(&FSD, &mLVD->uLogVolUse, 16);
+    memcpy(&vol->FSD, &mLVD->uLogVolUse, 16);
 
-    if (EXTENT_LENGTH(FSD.ExtentLengthAndType) == 0) {
-      Fatal = true;
-      printf("**");
+    if (EXTENT_LENGTH(vol->FSD.ExtentLengthAndType) == 0) {
+      vol->Fatal = true;
+      fprintf(vol->Out, "**");
     } else {
-      printf("  ");
-    }
-    printf("(M) File Set Descriptor location is ");
-    printLongAd(&FSD);
-
-    if (RVDS_Len && memcmp(&FSD, &rLVD->uLogVolUse, 16)) {
-      printf("**(R) File Set Descriptor Location is ");
-      printLongAd((struct long_ad *)&rLVD->uLogVolUse);
-    }
-
-    for (i = 0; i < NUM_PARTS; i++) {
-      Part_Info[i].type = PTN_TYP_NONE;
-      Part_Info[i].Num = 0;
-      Part_Info[i].Offs = 0;
-      Part_Info[i].Len = 0;
-      Part_Info[i].Space = -1;
-      Part_Info[i].Extra = NULL;
-      Part_Info[i].SpMap = NULL;
-      Part_Info[i].MyMap = NULL;
-    }
-
-    printf("  (M) There %s %u partition map entr%s.\n", U_endian32(mLVD->uNumPartMaps) == 1 ? "is" : "are",
-            U_endian32(mLVD->uNumPartMaps), U_endian32(mLVD->uNumPartMaps) == 1 ? "y" : "ies");
-    if (RVDS_Len && (U_endian32(mLVD->uNumPartMaps) != U_endian32(rLVD->uNumPartMaps))) {
-      printf("**(R) There %s %u partition map entr%s.\n", U_endian32(rLVD->uNumPartMaps) == 1 ? "is" : "are",
-              U_endian32(rLVD->uNumPartMaps), U_endian32(rLVD->uNumPartMaps) == 1 ? "y" : "ies");
-    }
-    if (U_endian32(mLVD->uNumPartMaps) > NUM_PARTS) {
-      Error.Code = ERR_TOO_MANY_PARTS;
-      DumpError();
-      Fatal = true;
+      fprintf(vol->Out, "  ");
+    }
+    fprintf(vol->Out, "(M) File Set Descriptor location is ");
+    printLongAd(vol, &vol->FSD);
+
+    if (reserveDiffers && memcmp(&vol->FSD, &rLVD->uLogVolUse, 16)) {
+      fprintf(vol->Out, "**(R) File Set Descriptor Location is ");
+      printLongAd(vol, (struct long_ad *)&rLVD->uLogVolUse);
+    }
+
+    fprintf(vol->Out, "  (M) There %s %u partition map entr%s.\n", U_endian32(mLVD->uNumPartMaps) == 1 ? "is" : "are",
+             U_endian32(mLVD->uNumPartMaps), U_endian32(mLVD->uNumPartMaps) == 1 ? "y" : "ies");
+    if (reserveDiffers && (U_endian32(mLVD->uNumPartMaps) != U_endian32(rLVD->uNumPartMaps))) {
+      fprintf(vol->Out, "**(R) There %s %u partition map entr%s.\n", U_endian32(rLVD->uNumPartMaps) == 1 ? "is" : "are",
+               U_endian32(rLVD->uNumPartMaps), U_endian32(rLVD->uNumPartMaps) == 1 ? "y" : "ies");
+    }
+    // Every map must fit in the descriptor, and the smallest is a type 1 map
+    maxMaps = (vol->secsize - sizeof(struct LogVolDesc)) / sizeof(struct PartMap1);
+    offset = sizeof(struct LogVolDesc);
+    if (U_endian32(mLVD->uNumPartMaps) > maxMaps) {
+      SetError(vol, ERR_TOO_MANY_PARTS, 0, maxMaps, U_endian32(mLVD->uNumPartMaps));
+      DumpError(vol);
+      vol->Fatal = true;
+    } else if (U_endian32(mLVD->uNumPartMaps) == 0) {
+      fprintf(vol->Out, "**No Partition Map Entries.\n");
+      vol->Fatal = true;
+    } else if (!(vol->Part_Info = calloc(U_endian32(mLVD->uNumPartMaps), sizeof(sPart_Info)))) {
+      SetError(vol, ERR_NO_VD_MEM, 0, 0, 0);
+      DumpError(vol);
+      vol->Fatal = true;
     } else {
-      PTN_no = U_endian32(mLVD->uNumPartMaps);
-      if (PTN_no == 0) {
-        printf("**No Partition Map Entries.\n");
-        Fatal = true;
+      vol->PTN_no = U_endian32(mLVD->uNumPartMaps);
+      for (i = 0; i < vol->PTN_no; i++) {
+        SetPartType(vol, &vol->Part_Info[i], PTN_TYP_NONE);
+        vol->Part_Info[i].Space = -1;
       }
-      offset = sizeof(struct LogVolDesc);
-      for (i = 0; i < PTN_no; i++) {
-        printf("  (M) Partition map entry %d is ", i);
+      for (i = 0; i < vol->PTN_no; i++) {
         sPartMap1 = (struct PartMap1 *)((uint8_t *)mLVD + offset);
+        if (   (offset + sizeof(struct PartMap1) > vol->secsize)
+            || (offset + sPartMap1->uPartMapLen > vol->secsize)
+            || ((sPartMap1->uPartMapType == 2) && (offset + sizeof(struct PartMap2) > vol->secsize))) {
+          fprintf(vol->Out, "**(M) Partition map entry %d runs past the end of the descriptor.\n", i);
+          vol->Fatal = true;
+          break;
+        }
+        fprintf(vol->Out, "  (M) Partition map entry %d is ", i);
         sPartMapVAT = (struct PartMapVAT *)sPartMap1;
         sPartMapSP = (struct PartMapSP *)sPartMap1;
+        sPartMapMeta = (struct PartMapMeta *)sPartMap1;
 
         switch(sPartMap1->uPartMapType) {
           case 1:
-            Part_Info[i].type = PTN_TYP_REAL;
-            Part_Info[i].Num  = U_endian16(sPartMap1->uPartNum);
-            printf("type 1 (real) and references partition %u.\n", Part_Info[i].Num);
+            SetPartType(vol, &vol->Part_Info[i], PTN_TYP_REAL);
+            vol->Part_Info[i].Num  = U_endian16(sPartMap1->uPartNum);
+            fprintf(vol->Out, "type 1 (real) and references partition %u.\n", vol->Part_Info[i].Num);
             break;
 
           case 2:
             if (!strncmp(E_REGID_CD_VP, (const char*)sPartMapVAT->sVATIdentifier.aID, strlen(E_REGID_CD_VP))) {
-              Part_Info[i].type = PTN_TYP_VIRTUAL;
-              Part_Info[i].Num  = U_endian16(sPartMapVAT->uPartNum);
-              printf("type 2 (virtual) and references partition %u.\n", Part_Info[i].Num);
+              SetPartType(vol, &vol->Part_Info[i], PTN_TYP_VIRTUAL);
+              vol->Part_Info[i].Num  = U_endian16(sPartMapVAT->uPartNum);
+              fprintf(vol->Out, "type 2 (virtual) and references partition %u.\n", vol->Part_Info[i].Num);
             } else if (!strncmp(E_REGID_CD_SP, (const char*)sPartMapVAT->sVATIdentifier.aID, strlen(E_REGID_CD_SP))) {
-              Part_Info[i].type = PTN_TYP_SPARE;
-              Part_Info[i].Num  = U_endian16(sPartMapSP->uPartNum);
-              printf("type 2 (sparable) and references partition %u.\n", Part_Info[i].Num);
-              Part_Info[i].Extra = malloc(sizeof(struct _sST_desc));
-              if ((struct _sST_desc *)Part_Info[i].Extra) {
-                printf("  (M) %u sparing map(s), %u bytes long, mapping %u sectors each.\n",
-                        sPartMapSP->N_ST, U_endian32(sPartMapSP->SpareSize), U_endian16(sPartMapSP->uPacketLength));
-                ((struct _sST_desc *)Part_Info[i].Extra)->Size = U_endian32(sPartMapSP->SpareSize);
-                ((struct _sST_desc *)Part_Info[i].Extra)->Count = sPartMapSP->N_ST;
-                ((struct _sST_desc *)Part_Info[i].Extra)->Extent = U_endian16(sPartMapSP->uPacketLength);
-                ((struct _sST_desc *)Part_Info[i].Extra)->Location[0] = U_endian32(sPartMapSP->SpareLoc[0]);
-                ((struct _sST_desc *)Part_Info[i].Extra)->Location[1] = U_endian32(sPartMapSP->SpareLoc[1]);
-                ((struct _sST_desc *)Part_Info[i].Extra)->Location[2] = U_endian32(sPartMapSP->SpareLoc[2]);
-                ((struct _sST_desc *)Part_Info[i].Extra)->Location[3] = U_endian32(sPartMapSP->SpareLoc[3]);
+              SetPartType(vol, &vol->Part_Info[i], PTN_TYP_SPARE);
+              vol->Part_Info[i].Num  = U_endian16(sPartMapSP->uPartNum);
+              fprintf(vol->Out, "type 2 (sparable) and references partition %u.\n", vol->Part_Info[i].Num);
+              vol->Part_Info[i].Extra = malloc(sizeof(struct _sST_desc));
+              if ((struct _sST_desc *)vol->Part_Info[i].Extra) {
+                fprintf(vol->Out, "  (M) %u sparing map(s), %u bytes long, mapping %u sectors each.\n",
+                         sPartMapSP->N_ST, U_endian32(sPartMapSP->SpareSize), U_endian16(sPartMapSP->uPacketLength));
+                ((struct _sST_desc *)vol->Part_Info[i].Extra)->Size = U_endian32(sPartMapSP->SpareSize);
+                ((struct _sST_desc *)vol->Part_Info[i].Extra)->Count = sPartMapSP->N_ST;
+                ((struct _sST_desc *)vol->Part_Info[i].Extra)->Extent = U_endian16(sPartMapSP->uPacketLength);
+                ((struct _sST_desc *)vol->Part_Info[i].Extra)->Location[0] = U_endian32(sPartMapSP->SpareLoc[0]);
+                ((struct _sST_desc *)vol->Part_Info[i].Extra)->Location[1] = U_endian32(sPartMapSP->SpareLoc[1]);
+                ((struct _sST_desc *)vol->Part_Info[i].Extra)->Location[2] = U_endian32(sPartMapSP->SpareLoc[2]);
+                ((struct _sST_desc *)vol->Part_Info[i].Extra)->Location[3] = U_endian32(sPartMapSP->SpareLoc[3]);
+              }
+            } else if (!strncmp(E_REGID_META, (const char*)sPartMapMeta->sMetaIdentifier.aID, strlen(E_REGID_META))) {
+              sMeta_desc *PM_MD;
+              SetPartType(vol, &vol->Part_Info[i], PTN_TYP_METADATA);
+              vol->Part_Info[i].Num  = U_endian16(sPartMapMeta->uPartNum);
+              fprintf(vol->Out, "type 2 (metadata) and references partition %u.\n", vol->Part_Info[i].Num);
+              PM_MD = (sMeta_desc *)calloc(1, sizeof(sMeta_desc));
+              vol->Part_Info[i].Extra = (uint32_t *)PM_MD;
+              if (PM_MD) {
+                PM_MD->FileLoc   = U_endian32(sPartMapMeta->uMetadataFileLoc);
+                PM_MD->MirrorLoc = U_endian32(sPartMapMeta->uMirrorFileLoc);
+                PM_MD->BitmapLoc = U_endian32(sPartMapMeta->uBitmapFileLoc);
+                PM_MD->AllocUnit = U_endian32(sPartMapMeta->uAllocUnitSize);
+                PM_MD->AlignUnit = U_endian16(sPartMapMeta->uAlignUnitSize);
+                PM_MD->Flags     = sPartMapMeta->uFlags;
+                fprintf(vol->Out, "  (M) Metadata File at %u, Mirror File at %u, Bitmap File at ",
+                        PM_MD->FileLoc, PM_MD->MirrorLoc);
+                if (PM_MD->BitmapLoc == (uint32_t) -1) {
+                  fprintf(vol->Out, "(none).\n");
+                } else {
+                  fprintf(vol->Out, "%u.\n", PM_MD->BitmapLoc);
+                }
+                fprintf(vol->Out, "  (M) Allocation unit %u blocks, alignment unit %u blocks, %sduplicated.\n",
+                        PM_MD->AllocUnit, PM_MD->AlignUnit,
+                        (PM_MD->Flags & META_FLAG_DUPLICATE) ? "" : "not ");
               }
             } else {
-              Part_Info[i].type = PTN_TYP_NONE;
-              printf("type 2 (unknown).\n");
+              SetPartType(vol, &vol->Part_Info[i], PTN_TYP_NONE);
+              fprintf(vol->Out, "type 2 (unknown).\n");
             }
             break;
 
           default:
-            Part_Info[i].type = PTN_TYP_NONE;
-            printf("**illegal type (%u).\n", sPartMap1->uPartMapType);
+            SetPartType(vol, &vol->Part_Info[i], PTN_TYP_NONE);
+            fprintf(vol->Out, "**illegal type (%u).\n", sPartMap1->uPartMapType);
         }
         offset += sPartMap1->uPartMapLen;
       }
     }
     offset -= sizeof(struct LogVolDesc);
     if (offset != U_endian32(mLVD->uMapTabLen)) {
-      printf("**(M) Found %d bytes of map entries, LVD claims %u.\n", offset,
-             U_endian32(mLVD->uMapTabLen));
+      fprintf(vol->Out, "**(M) Found %d bytes of map entries, LVD claims %u.\n", offset,
+              U_endian32(mLVD->uMapTabLen));
     }
-    if (RVDS_Len && (offset != U_endian32(rLVD->uMapTabLen))) {
-      printf("**(R) Found %d bytes of map entries, LVD claims %u.\n", offset,
-             U_endian32(rLVD->uMapTabLen));
+    if (vol->RVDS_Len && (offset != U_endian32(rLVD->uMapTabLen))) {
+      fprintf(vol->Out, "**(R) Found %d bytes of map entries, LVD claims %u.\n", offset,
+              U_endian32(rLVD->uMapTabLen));
     }
 
-    printf("  (M) Integrity Sequence is %u bytes at %u.\n",
-           U_endian32(mLVD->integritySeqExtent.Length), U_endian32(mLVD->integritySeqExtent.Location));
-    if (RVDS_Len && memcmp(&mLVD->integritySeqExtent, &rLVD->integritySeqExtent, sizeof(struct extent_ad))) {
-      printf("**(R) Integrity Sequence is %u bytes at %u.\n",
-             U_endian32(rLVD->integritySeqExtent.Length), U_endian32(rLVD->integritySeqExtent.Location));
+    fprintf(vol->Out, "  (M) Integrity Sequence is %u bytes at %u.\n",
+            U_endian32(mLVD->integritySeqExtent.Length), U_endian32(mLVD->integritySeqExtent.Location));
+    if (reserveDiffers && memcmp(&mLVD->integritySeqExtent, &rLVD->integritySeqExtent, sizeof(struct extent_ad))) {
+      fprintf(vol->Out, "**(R) Integrity Sequence is %u bytes at %u.\n",
+              U_endian32(rLVD->integritySeqExtent.Length), U_endian32(rLVD->integritySeqExtent.Location));
     }
-    track_volspace(U_endian32(mLVD->integritySeqExtent.Location), U_endian32(mLVD->integritySeqExtent.Length) >> sdivshift, 
+    track_volspace(vol, U_endian32(mLVD->integritySeqExtent.Location), U_endian32(mLVD->integritySeqExtent.Length) >> vol->sdivshift, 
                    "Integrity Sequence");
 
-    verifyLVID(U_endian32(mLVD->integritySeqExtent.Location), U_endian32(mLVD->integritySeqExtent.Length));
+    verifyLVID(vol, U_endian32(mLVD->integritySeqExtent.Location), U_endian32(mLVD->integritySeqExtent.Length));
   } else {
-    Fatal = true;
+    vol->Fatal = true;
   }
-  DumpError();
-  return Error.Code;
+  DumpError(vol);
+  return CurrentError(vol)->Code;
 }
 
 
@@ -587,42 +644,44 @@ int checkLVD(struct LogVolDesc *mLVD, struct LogVolDesc *rLVD)
  * The following routine checks the USD.  It looks for legal values in most
  * fields and verifies that the main and reserve USD are equivalent.  
  */
-int checkUSD(struct UnallocSpDesHead *mUSD, struct UnallocSpDesHead *rUSD)
+int checkUSD(udf_volume *vol, struct UnallocSpDesHead *mUSD, struct UnallocSpDesHead *rUSD)
 {
+  bool reserveDiffers;
   int i, error;
 
-  error = CheckTag((struct tag *)mUSD, U_endian32(mUSD->sTag.uTagLoc), TAGID_USD, 8, secsize);
-  DumpError();
+  reserveDiffers = ReserveDiffers(vol, mUSD, rUSD);
+  error = CheckTag(vol, (struct tag *)mUSD, U_endian32(mUSD->sTag.uTagLoc), TAGID_USD, 8, vol->secsize);
+  DumpError(vol);
   if (error < CHECKTAG_OK_LIMIT) {
-    printf("  (M) Number of Allocation Descriptors: %u\n", U_endian32(mUSD->uNumAllocationDes));
-    if (RVDS_Len && (U_endian32(mUSD->uNumAllocationDes) != U_endian32(rUSD->uNumAllocationDes))) {
-      printf("**(R) Number of Allocation Descriptors: %u\n", U_endian32(rUSD->uNumAllocationDes));
+    fprintf(vol->Out, "  (M) Number of Allocation Descriptors: %u\n", U_endian32(mUSD->uNumAllocationDes));
+    if (reserveDiffers && (U_endian32(mUSD->uNumAllocationDes) != U_endian32(rUSD->uNumAllocationDes))) {
+      fprintf(vol->Out, "**(R) Number of Allocation Descriptors: %u\n", U_endian32(rUSD->uNumAllocationDes));
     }
 
     if (U_endian32(mUSD->uNumAllocationDes) > 0) {
-      printf("  (M) Space allocation descriptors:\n");
+      fprintf(vol->Out, "  (M) Space allocation descriptors:\n");
     }
     for (i = 0; i < U_endian32(mUSD->uNumAllocationDes); i++) {
-      printf("    %u bytes (%u blocks) @ %u\n",
-             U_endian32(*((uint32_t *) ((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)))),
-             U_endian32(*((uint32_t *) ((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)))) >> sdivshift,
-             U_endian32(*((uint32_t *) ((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)) + 1)));
-      track_volspace(U_endian32(*((uint32_t *)((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)) + 1)),
-                     U_endian32(*((uint32_t *)((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)))) >> sdivshift,
+      fprintf(vol->Out, "    %u bytes (%u blocks) @ %u\n",
+              U_endian32(*((uint32_t *) ((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)))),
+              U_endian32(*((uint32_t *) ((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)))) >> vol->sdivshift,
+              U_endian32(*((uint32_t *) ((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)) + 1)));
+      track_volspace(vol, U_endian32(*((uint32_t *)((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)) + 1)),
+                     U_endian32(*((uint32_t *)((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)))) >> vol->sdivshift,
                      "Unallocated Space");
     }
-    if (RVDS_Len && (memcmp((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead), 
+    if (reserveDiffers && (memcmp((uint8_t *)mUSD + sizeof(struct UnallocSpDesHead), 
                (uint8_t *)rUSD + sizeof(struct UnallocSpDesHead), 
                U_endian32(mUSD->uNumAllocationDes) * sizeof(struct extent_ad)) || 
                (U_endian32(mUSD->uNumAllocationDes) != U_endian32(rUSD->uNumAllocationDes)))) {
-      printf("**(R) Space allocation descriptors:\n");
+      fprintf(vol->Out, "**(R) Space allocation descriptors:\n");
       for (i = 0; i < U_endian32(rUSD->uNumAllocationDes); i++) {
-        printf("    %u bytes (%u blocks) @ %u\n",
-               U_endian32(*((uint32_t *) ((uint8_t *)rUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)))),
-               U_endian32(*((uint32_t *) ((uint8_t *)rUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)))) >> sdivshift,
-               U_endian32(*((uint32_t *) ((uint8_t *)rUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)) + 1)));
-      track_volspace(*((uint32_t *)((uint8_t *)rUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)) + 1),
-                     *((uint32_t *)((uint8_t *)rUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad))) >> sdivshift,
+        fprintf(vol->Out, "    %u bytes (%u blocks) @ %u\n",
+                U_endian32(*((uint32_t *) ((uint8_t *)rUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)))),
+                U_endian32(*((uint32_t *) ((uint8_t *)rUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)))) >> vol->sdivshift,
+                U_endian32(*((uint32_t *) ((uint8_t *)rUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)) + 1)));
+      track_volspace(vol, *((uint32_t *)((uint8_t *)rUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad)) + 1),
+                     *((uint32_t *)((uint8_t *)rUSD + sizeof(struct UnallocSpDesHead) + i * sizeof(struct extent_ad))) >> vol->sdivshift,
                      "Unallocated Space from Reserve USD");
       }
     }
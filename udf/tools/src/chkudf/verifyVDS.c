@@ -9,328 +9,454 @@
 #include "chkudf.h"
 #include "protos.h"
 
-/* 
- * The following routine loads a VDS into memory.  Only the prevailing
- * descriptors are retained, with oddities noted on the way.  Since UDF
- * allows only one of each descriptor, only one is kept.  All discarded
- * descriptors are noted.
+/*
+ * Start reading a Volume Descriptor Sequence extent.
  */
-int ReadVDS(uint8_t *buf, char *name, uint32_t loc, uint32_t len)
+static bool InitVDSReader(udf_volume *vol, sVDSReader *reader, const char *name, uint32_t loc,
+                          uint32_t len)
 {
-  /*
-   * All volume descriptors are one block in length.  This routine 
-   * scans the Volume Descriptor Sequence, picking out the interesting
-   * stuff.  The interesting stuff includes one PVD, one LVD, the UDF
-   * IUVD, one USD, and one PD.  The buffer must be able to handle five
-   * sectors.  Upon return, the buffer will contain the listed descriptors
-   * in the order above.
-   */
-  uint32_t                  i, j;
-  uint8_t*                  buffer;
-  struct tag               *vdtag;
-  uint8_t                   zerotest;
-  struct PrimaryVolDes     *PVD, *PVDt;
-  struct LogVolDesc        *LVD, *LVDt;
-  struct ImpUseDesc        *IUVD, *IUVDt;
-  struct UnallocSpDesHead  *USD, *USDt;
-  struct PartDesc          *PD, *PDt;
-
-  printf("\n--Reading the %s Volume Descriptor Sequence.\n", name);
-  ClearError();
-  buffer = malloc(secsize);
-  if (buffer) {
-    memset(buf, 0, secsize * 5);
+  reader->Name = name;
+  reader->Loc = loc;
+  reader->NumSectors = len >> vol->sdivshift;
+  reader->First = 0;
+  reader->Count = 0;
+  reader->OK = false;
+  reader->Buffer = malloc((size_t) MAX(VDS_READ_SIZE >> vol->sdivshift, 1) << vol->sdivshift);
+  return reader->Buffer != NULL;
+}
 
-    /*
-     * The following pointers are for convenience sake.
-     */
-    PVD  = (struct PrimaryVolDes *)(buf);
-    LVD  = (struct LogVolDesc *)(buf + secsize);
-    IUVD = (struct ImpUseDesc *)(buf + 2 * secsize);
-    USD  = (struct UnallocSpDesHead *)(buf + 3 * secsize);
-    PD   = (struct PartDesc *)(buf + 4 * secsize);
-
-    vdtag = (struct tag *)buffer;
-    PVDt  = (struct PrimaryVolDes *)buffer;
-    LVDt  = (struct LogVolDesc *)buffer;
-    IUVDt = (struct ImpUseDesc *)buffer;
-    USDt  = (struct UnallocSpDesHead *)buffer;
-    PDt   = (struct PartDesc *)buffer;
-    
-    for (i = 0; i < (len >> sdivshift); i++) {
-      /*
-       * Get a sector and test it.
-       */
-      ClearError();
-      ReadSectors(buffer, loc + i, 1);
-      CheckTag(vdtag, loc + i, -1, 0, 496);
-      zerotest = 0;
-      for (j = 0; j < secsize; j++) {
-        zerotest |= buffer[j];
+/*
+ * Describe the read of the piece of the current extent that starts with
+ * sector first. Nothing is read yet.
+ */
+static void VDSReadRequest(udf_volume *vol, sVDSReader *reader, uint32_t first,
+                           sReadRequest *req)
+{
+  reader->First = first;
+  reader->Count = MIN(reader->NumSectors - first, MAX(VDS_READ_SIZE >> vol->sdivshift, 1));
+  reader->OK = false;
+  req->Offset = (uint64_t) (reader->Loc + first) << vol->sdivshift;
+  req->Length = reader->Count << vol->sdivshift;
+  req->Buffer = reader->Buffer;
+}
+
+/*
+ * Get sector i of the current extent, reading the next piece of the extent
+ * if it isn't at hand. If the piece couldn't be read as a whole, its sectors
+ * are read one at a time and those that fail are reported as ERR_READ.
+ */
+static uint8_t *VDSSector(udf_volume *vol, sVDSReader *reader, uint32_t i)
+{
+  sReadRequest request;
+  uint8_t *sector;
+
+  if ((i < reader->First) || (i - reader->First >= reader->Count)) {
+    VDSReadRequest(vol, reader, i, &request);
+    ReadBatch(vol, &request, 1);
+    reader->OK = request.OK;
+  }
+
+  sector = reader->Buffer + ((size_t) (i - reader->First) << vol->sdivshift);
+  if (!reader->OK && ReadSectors(vol, sector, reader->Loc + i, 1)) {
+    SetError(vol, ERR_READ, reader->Loc + i, 0, 0);
+  }
+  return sector;
+}
+
+/*
+ * Keep a copy of a descriptor. Returns its entry number, or -1 if there is
+ * no memory for it.
+ */
+static int32_t AddVDEntry(udf_volume *vol, sVDSIndex *index, const uint8_t *sector,
+                          uint32_t location)
+{
+  sVDEntry *entry;
+
+  if (index->NumEntries >= index->EntriesAlloc) {
+    uint32_t newAlloc = index->EntriesAlloc ? index->EntriesAlloc * 2 : 8;
+    sVDEntry *larger = realloc(index->Entries, newAlloc * sizeof(sVDEntry));
+    if (!larger) {
+      return -1;
+    }
+    index->Entries = larger;
+    index->EntriesAlloc = newAlloc;
+  }
+
+  entry = &index->Entries[index->NumEntries];
+  entry->Data = malloc(vol->secsize);
+  if (!entry->Data) {
+    return -1;
+  }
+  memcpy(entry->Data, sector, vol->secsize);
+  entry->TagID = U_endian16(((const struct tag *)sector)->uTagID);
+  // Every descriptor kept has its sequence number right after the tag
+  entry->VDSN = U_endian32(*(const uint32_t *)(sector + sizeof(struct tag)));
+  entry->PartNum = 0;
+  if (entry->TagID == TAGID_PD) {
+    entry->PartNum = U_endian16(((const struct PartDesc *)sector)->uPartNumber);
+  }
+  entry->Location = location;
+  return index->NumEntries++;
+}
+
+/*
+ * Find the prevailing PD entry for a partition, or NULL if there is none.
+ */
+static int32_t *FindPD(sVDSIndex *index, uint16_t partNum)
+{
+  uint32_t i;
+
+  for (i = 0; i < index->NumPDs; i++) {
+    if (index->Entries[index->PDs[i]].PartNum == partNum) {
+      return &index->PDs[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Decide whether a descriptor prevails over the one found before it with
+ * the same identification: the higher sequence number wins [3/8.4.3].
+ */
+static void ResolveDescriptor(udf_volume *vol, sVDSIndex *index, int32_t *prevailing,
+                              int32_t entry, const char *name)
+{
+  const sVDEntry *found = &index->Entries[entry];
+  const sVDEntry *current;
+
+  if (*prevailing < 0) {
+    fprintf(vol->Out, "Found first %s.\n", name);
+    *prevailing = entry;
+    return;
+  }
+
+  current = &index->Entries[*prevailing];
+  if (found->VDSN > current->VDSN) {
+    fprintf(vol->Out, "Replaced %s seq. %u with %u.\n", name, current->VDSN, found->VDSN);
+    *prevailing = entry;
+  } else {
+    fprintf(vol->Out, "Not replacing %s seq. %u with %u.\n", name, current->VDSN, found->VDSN);
+    if (   (found->VDSN == current->VDSN)
+        && memcmp(found->Data + sizeof(struct tag), current->Data + sizeof(struct tag),
+                  vol->secsize - sizeof(struct tag))) {
+      UDFError(vol, "**%ss with the same sequence number differ.\n", name);
+    }
+  }
+}
+
+/*
+ * Index a descriptor that may prevail.
+ */
+static void IndexDescriptor(udf_volume *vol, sVDSIndex *index, const uint8_t *sector,
+                            uint32_t location)
+{
+  const struct PrimaryVolDes *PVD, *PVDt = (const struct PrimaryVolDes *)sector;
+  const struct LogVolDesc    *LVD, *LVDt = (const struct LogVolDesc *)sector;
+  const struct ImpUseDesc    *IUVDt = (const struct ImpUseDesc *)sector;
+  const struct PartDesc      *PDt = (const struct PartDesc *)sector;
+  int32_t *prevailing;
+  int32_t entry, *larger;
+
+  if (   (U_endian16(PVDt->sTag.uTagID) == TAGID_IUD)
+      && CheckRegid(&IUVDt->sImplementationIdentifier, E_REGID_IUVD)) {
+    fprintf(vol->Out, "A non-UDF IUVD was found.  Skipping.\n");
+    return;
+  }
+
+  entry = AddVDEntry(vol, index, sector, location);
+  if (entry < 0) {
+    SetError(vol, ERR_NO_VD_MEM, location, 0, 0);
+    return;
+  }
+
+  switch (index->Entries[entry].TagID) {
+    case TAGID_PVD:
+      if (index->PVD >= 0) {
+        PVD = (const struct PrimaryVolDes *)index->Entries[index->PVD].Data;
+        if (memcmp(PVD->aVolID, PVDt->aVolID, 32) ||
+            memcmp(PVD->aVolSetID, PVDt->aVolSetID, 128) ||
+            memcmp(&PVD->sDesCharSet, &PVDt->sDesCharSet, sizeof(struct charspec))) {
+          fprintf(vol->Out, "\n**A PVD that doesn't match the previous one was found.\n");
+          return;
+        }
       }
-      if (!zerotest) {
-        ClearError();
+      ResolveDescriptor(vol, index, &index->PVD, entry, "PVD");
+      break;
+
+    case TAGID_LVD:
+      if (index->LVD >= 0) {
+        LVD = (const struct LogVolDesc *)index->Entries[index->LVD].Data;
+        if (memcmp(LVD->uLogVolID, LVDt->uLogVolID, 128) ||
+            memcmp(&LVD->sDesCharSet, &LVDt->sDesCharSet, sizeof(struct charspec))) {
+          fprintf(vol->Out, "\n**A LVD that doesn't match the previous one was found.\n");
+          return;
+        }
       }
-      if (!Error.Code) {
-        printf("  %s VDS (%08x): ", name, loc + i);
-        switch (U_endian16(vdtag->uTagID)) {
-          case 0:
-            printf("terminated by blank or zeroed sector.\n");
-            i = len;
-            break;
+      ResolveDescriptor(vol, index, &index->LVD, entry, "LVD");
+      break;
 
-          case TAGID_PVD:
-            if (U_endian16(PVD->sTag.uTagID)) {
-              /*
-               * A PVD already exists.  Replace if OK
-               */
-              if (memcmp(PVD->aVolID, PVDt->aVolID, 32) ||
-                  memcmp(PVD->aVolSetID, PVDt->aVolSetID, 128) ||
-                  memcmp(&PVD->sDesCharSet, &PVDt->sDesCharSet, sizeof(struct charspec))) {
-                printf("\n**A PVD that doesn't match the previous one was found.\n");
-              } else {
-                if (U_endian32(PVDt->uVolDescSeqNum) > PVD->uVolDescSeqNum) {
-                  printf("Replaced PVD seq. %u with %u.\n",
-                         U_endian32(PVD->uVolDescSeqNum),
-                         U_endian32(PVDt->uVolDescSeqNum));
-                  memcpy(PVD, PVDt, secsize);
-                } else {
-                  printf("Not replacing PVD seq. %u with %u.\n", PVD->uVolDescSeqNum,
-                         PVDt->uVolDescSeqNum);
-                }
-              }
-            } else {
-              memcpy(PVD, PVDt, secsize);
-              printf("Found first PVD.\n");
-            }
-            break;
+    case TAGID_IUD:
+      ResolveDescriptor(vol, index, &index->IUVD, entry, "IUVD");
+      break;
 
-          case TAGID_POINTER:
-            loc = U_endian32(((struct VolDescPtr *)buffer)->sNextVDS.Location);
-            len = U_endian32(((struct VolDescPtr *)buffer)->sNextVDS.Length);
-            track_volspace(loc, len >> sdivshift, "Next VDS sequence");
-            i = -1;
-            printf("Redirecting to 0x%08x (%x bytes).\n", loc, len);
-            break;
+    case TAGID_USD:
+      ResolveDescriptor(vol, index, &index->USD, entry, "USD");
+      break;
 
-          case TAGID_IUD:
-            if (CheckRegid(&IUVDt->sImplementationIdentifier, E_REGID_IUVD)) {
-              printf("A non-UDF IUVD was found.  Skipping.\n");
-            } else {
-              if (U_endian16(IUVD->sTag.uTagID)) {
-                /*
-                 * A IUVD already exists.  Replace if OK
-                 */
-                if (U_endian32(IUVDt->uVolDescSeqNum) > U_endian32(IUVD->uVolDescSeqNum)) {
-                  printf("Replaced IUVD seq. %u with %u.\n", U_endian32(IUVD->uVolDescSeqNum),
-                         U_endian32(IUVDt->uVolDescSeqNum));
-                  memcpy(IUVD, IUVDt, secsize);
-                } else {
-                  printf("Not replacing IUVD seq. %u with %u.\n",
-                         U_endian32(IUVD->uVolDescSeqNum),
-                         U_endian32(IUVDt->uVolDescSeqNum));
-                }
-              } else {
-                printf("Found first IUVD.\n");
-                memcpy(IUVD, IUVDt, secsize);
-              }
-            }
-            break;
-                    
-          case TAGID_PD:
-            if (U_endian16(PD->sTag.uTagID)) {
-              /*
-               * A PD already exists.  Replace if OK
-               */
-              if (U_endian16(PD->uPartNumber) != U_endian16(PDt->uPartNumber)) {
-                UDFError("\n**A PD that doesn't match the previous one was found.\n"
-                         "Only one partition allowed per volume.\n");
-              } else {
-                if (U_endian32(PDt->uVolDescSeqNum) > U_endian32(PD->uVolDescSeqNum)) {
-                  printf("Replaced PD seq. %u with %u.\n",
-                         U_endian32(PD->uVolDescSeqNum),
-                         U_endian32(PDt->uVolDescSeqNum));
-                  memcpy(PD, PDt, secsize);
-                } else {
-                  printf("Not replacing PD seq. %u with %u.\n",
-                         U_endian32(PD->uVolDescSeqNum),
-                         U_endian32(PDt->uVolDescSeqNum));
-                }
-              }
-            } else {
-              memcpy(PD, PDt, secsize);
-              printf("Found first PD.\n");
-            }
-            break;
+    case TAGID_PD:
+    default:
+      prevailing = FindPD(index, U_endian16(PDt->uPartNumber));
+      if (!prevailing) {
+        larger = realloc(index->PDs, (index->NumPDs + 1) * sizeof(int32_t));
+        if (!larger) {
+          SetError(vol, ERR_NO_VD_MEM, location, 0, 0);
+          return;
+        }
+        index->PDs = larger;
+        if (index->NumPDs) {
+          fprintf(vol->Out, "Found first PD for partition %u.\n", U_endian16(PDt->uPartNumber));
+          index->PDs[index->NumPDs++] = entry;
+          return;
+        }
+        prevailing = &index->PDs[index->NumPDs++];
+        *prevailing = -1;
+      }
+      ResolveDescriptor(vol, index, prevailing, entry, "PD");
+      break;
+  }
+}
 
-          case TAGID_LVD:
-            if (U_endian16(LVD->sTag.uTagID)) {
-              /*
-               * A LVD already exists.  Replace if OK
-               */
-              if (memcmp(LVD->uLogVolID, LVDt->uLogVolID, 128) ||
-                  memcmp(&LVD->sDesCharSet, &LVDt->sDesCharSet, sizeof(struct charspec))) {
-                printf("\n**A LVD that doesn't match the previous one was found.\n");
-              } else {
-                if (U_endian32(LVDt->uVolDescSeqNum) > U_endian32(LVD->uVolDescSeqNum)) {
-                  printf("Replaced LVD seq. %u with %u.\n",
-                         U_endian32(LVD->uVolDescSeqNum),
-                         U_endian32(LVDt->uVolDescSeqNum));
-                  memcpy(LVD, LVDt, secsize);
-                } else {
-                  printf("Not replacing LVD seq. %u with %u.\n",
-                         U_endian32(LVD->uVolDescSeqNum),
-                         U_endian32(LVDt->uVolDescSeqNum));
-                }
-              }
-            } else {
-              memcpy(LVD, LVDt, secsize);
-              printf("Found first LVD.\n");
-            }
-            break;
+/*
+ * Index the descriptors of a VDS in one pass, following Volume Descriptor
+ * Pointers, and pick out the prevailing ones. Oddities are noted on the
+ * way, as is every descriptor that doesn't prevail.
+ */
+int ReadVDS(udf_volume *vol, sVDSIndex *index, sVDSReader *reader)
+{
+  uint32_t      i, loc, len;
+  uint32_t      numPointers = 0;
+  uint8_t      *sector;
+  struct tag   *vdtag;
+  const char   *name = reader->Name;
 
-          case TAGID_USD:
-            if (U_endian16(USD->sTag.uTagID)) {
-              /*
-               * A USD already exists.  Replace if OK
-               */
-              if (U_endian32(PVDt->uVolDescSeqNum) > U_endian32(PVD->uVolDescSeqNum)) {
-                printf("Replaced PVD seq. %u with %u.\n",
-                         U_endian32(PVD->uVolDescSeqNum),
-                         U_endian32(PVDt->uVolDescSeqNum));
-                memcpy(PVD, PVDt, secsize);
-              } else {
-                printf("Not replacing PVD seq. %u with %u.\n",
-                         U_endian32(PVD->uVolDescSeqNum),
-                         U_endian32(PVDt->uVolDescSeqNum));
-              }
-            } else {
-              memcpy(USD, USDt, secsize);
-              printf("Found first USD.\n");
-            }
-            break;
+  fprintf(vol->Out, "\n--Reading the %s Volume Descriptor Sequence.\n", name);
+  ClearError(vol);
+  memset(index, 0, sizeof(*index));
+  index->PVD = index->LVD = index->IUVD = index->USD = -1;
 
-          case TAGID_TERM_DESC:
-            printf("terminated by a Terminating Descriptor.\n");
-            i = len;
+  for (i = 0; i < reader->NumSectors; i++) {
+    /*
+     * Get a sector and test it.
+     */
+    ClearError(vol);
+    sector = VDSSector(vol, reader, i);
+    vdtag = (struct tag *)sector;
+    if (!CurrentError(vol)->Code) {
+      CheckTag(vol, vdtag, reader->Loc + i, -1, 0, 496);
+      if (IsZeroBuffer(sector, vol->secsize)) {
+        ClearError(vol);
+      }
+    }
+    if (!CurrentError(vol)->Code) {
+      fprintf(vol->Out, "  %s VDS (%08x): ", name, reader->Loc + i);
+      switch (U_endian16(vdtag->uTagID)) {
+        case 0:
+          fprintf(vol->Out, "terminated by blank or zeroed sector.\n");
+          i = reader->NumSectors;
+          break;
+
+        case TAGID_POINTER:
+          loc = U_endian32(((struct VolDescPtr *)sector)->sNextVDS.Location);
+          len = U_endian32(((struct VolDescPtr *)sector)->sNextVDS.Length);
+          if (++numPointers > VDS_POINTER_MAX) {
+            UDFError(vol, "\n**More than %u Volume Descriptor Pointers, not following this one.\n",
+                     VDS_POINTER_MAX);
+            i = reader->NumSectors;
             break;
+          }
+          track_volspace(vol, loc, len >> vol->sdivshift, "Next VDS sequence");
+          reader->Loc = loc;
+          reader->NumSectors = len >> vol->sdivshift;
+          reader->Count = 0;
+          i = -1;
+          fprintf(vol->Out, "Redirecting to 0x%08x (%x bytes).\n", loc, len);
+          break;
 
-          default:
-            UDFError("\n**Unknown Tag (%u) found in VDS!\n",
-                     U_endian16(vdtag->uTagID));
-        }
-      } else {
-        DumpError();
+        case TAGID_PVD:
+        case TAGID_IUD:
+        case TAGID_PD:
+        case TAGID_LVD:
+        case TAGID_USD:
+          IndexDescriptor(vol, index, sector, reader->Loc + i);
+          break;
+
+        case TAGID_TERM_DESC:
+          fprintf(vol->Out, "terminated by a Terminating Descriptor.\n");
+          i = reader->NumSectors;
+          break;
+
+        default:
+          UDFError(vol, "\n**Unknown Tag (%u) found in VDS!\n",
+                   U_endian16(vdtag->uTagID));
       }
-    }  //run through extent  
-  } else {
-    Error.Code = ERR_NO_VD_MEM;
+    }
+    if (CurrentError(vol)->Code) {
+      DumpError(vol);
+    }
+  }  //run through extent  
+  return CurrentError(vol)->Code;
+}
+
+void FreeVDSIndex(sVDSIndex *index)
+{
+  uint32_t i;
+
+  for (i = 0; i < index->NumEntries; i++) {
+    free(index->Entries[i].Data);
   }
-  return Error.Code;
+  free(index->Entries);
+  free(index->PDs);
+  memset(index, 0, sizeof(*index));
 }
-   
-int VerifyVDS()
+
+/*
+ * The prevailing descriptor of an entry number, or a blank sector if there
+ * is none so that the verifiers report it missing.
+ */
+static uint8_t *PrevailingVD(const sVDSIndex *index, int32_t entry, uint8_t *blank)
+{
+  return (entry >= 0) ? index->Entries[entry].Data : blank;
+}
+
+int VerifyVDS(udf_volume *vol)
 {
-  int i;
   struct PrimaryVolDes    *mainPVD,  *reservePVD;
   struct ImpUseDesc       *mainIUVD, *reserveIUVD;
   struct UnallocSpDesHead *mainUSD,  *reserveUSD;
   struct LogVolDesc       *mainLVD,  *reserveLVD;
   struct PartDesc         *mainPD,   *reservePD;
-  uint8_t *buffer_main, *buffer_reserve;
+  sVDSIndex mainVDS = { 0 }, reserveVDS = { 0 };
+  sVDSReader mainReader = { 0 }, reserveReader = { 0 };
+  sReadRequest requests[2];
+  int32_t *reservePDEntry;
+  uint8_t *blank;
+  uint32_t i;
   
-  Information("\n--Verifying Volume Descriptor Sequences.\n");
+  Information(vol, "\n--Verifying Volume Descriptor Sequences.\n");
+
+  blank = calloc(1, vol->secsize);
 
-  buffer_main = malloc(secsize * 5);
-  buffer_reserve = malloc(secsize * 5);
+  if (   blank
+      && InitVDSReader(vol, &mainReader, "Main", vol->VDS_Loc, vol->VDS_Len)
+      && InitVDSReader(vol, &reserveReader, "Reserve", vol->RVDS_Loc, vol->RVDS_Len)) {
+    // Both sequences are usually read in a single request each, issued together
+    VDSReadRequest(vol, &mainReader, 0, &requests[0]);
+    VDSReadRequest(vol, &reserveReader, 0, &requests[1]);
+    ReadBatch(vol, requests, 2);
+    mainReader.OK = requests[0].OK;
+    reserveReader.OK = requests[1].OK;
 
-  if (buffer_main && buffer_reserve) {
-    ReadVDS(buffer_main, "Main", VDS_Loc, VDS_Len);
-    DumpError();
-    ReadVDS(buffer_reserve, "Reserve", RVDS_Loc, RVDS_Len);
-    DumpError();
+    ReadVDS(vol, &mainVDS, &mainReader);
+    DumpError(vol);
+    ReadVDS(vol, &reserveVDS, &reserveReader);
+    DumpError(vol);
 
     /* 
-     * The important Volume Descriptors are in memory.  Let's run!
-     * The following definitions are for easy access to each VD.
+     * The prevailing Volume Descriptors are in memory.  Let's run!
+     * Missing ones are blank, and reported as such by the verifiers.
      */
 
-    mainPVD  = (struct PrimaryVolDes *)(buffer_main);
-    mainLVD  = (struct LogVolDesc *)(buffer_main + secsize);
-    mainIUVD = (struct ImpUseDesc *)(buffer_main + 2 * secsize);
-    mainUSD  = (struct UnallocSpDesHead *)(buffer_main + 3 * secsize);
-    mainPD   = (struct PartDesc *)(buffer_main + 4 * secsize);
-
-    reservePVD  = (struct PrimaryVolDes *)(buffer_reserve);
-    reserveLVD  = (struct LogVolDesc *)(buffer_reserve + secsize);
-    reserveIUVD = (struct ImpUseDesc *)(buffer_reserve + 2 * secsize);
-    reserveUSD  = (struct UnallocSpDesHead *)(buffer_reserve + 3 * secsize);
-    reservePD   = (struct PartDesc *)(buffer_reserve + 4 * secsize);
-
-    if (!Fatal) {
-      printf("\n--Primary Volume Descriptor Information:\n");
-      checkPVD(mainPVD, reservePVD);
+    mainPVD  = (struct PrimaryVolDes *)PrevailingVD(&mainVDS, mainVDS.PVD, blank);
+    mainLVD  = (struct LogVolDesc *)PrevailingVD(&mainVDS, mainVDS.LVD, blank);
+    mainIUVD = (struct ImpUseDesc *)PrevailingVD(&mainVDS, mainVDS.IUVD, blank);
+    mainUSD  = (struct UnallocSpDesHead *)PrevailingVD(&mainVDS, mainVDS.USD, blank);
+
+    reservePVD  = (struct PrimaryVolDes *)PrevailingVD(&reserveVDS, reserveVDS.PVD, blank);
+    reserveLVD  = (struct LogVolDesc *)PrevailingVD(&reserveVDS, reserveVDS.LVD, blank);
+    reserveIUVD = (struct ImpUseDesc *)PrevailingVD(&reserveVDS, reserveVDS.IUVD, blank);
+    reserveUSD  = (struct UnallocSpDesHead *)PrevailingVD(&reserveVDS, reserveVDS.USD, blank);
+
+    if (!vol->Fatal) {
+      fprintf(vol->Out, "\n--Primary Volume Descriptor Information:\n");
+      checkPVD(vol, mainPVD, reservePVD);
     }
   
 
     /* Verify the existence of the USD.  Print its contents. */
-    if (!Fatal) {
-      printf("\n--Unallocated Volume Space Descriptor Information:\n");
-      checkUSD(mainUSD, reserveUSD);
+    if (!vol->Fatal) {
+      fprintf(vol->Out, "\n--Unallocated Volume Space Descriptor Information:\n");
+      checkUSD(vol, mainUSD, reserveUSD);
     }
   
 
   /* Verify the existence of the LVD.  Print its contents and extract useful
      information. */
 
-    if (!Fatal) {
-      printf("\n--Logical Volume Descriptor Information:\n");
-      checkLVD(mainLVD, reserveLVD);
+    if (!vol->Fatal) {
+      fprintf(vol->Out, "\n--Logical Volume Descriptor Information:\n");
+      checkLVD(vol, mainLVD, reserveLVD);
     }
 
 
     /* Verify the existence of the PD(s).  Print contents and extract useful
        information. */
-    if (!Fatal) {
-      printf("\n--Partition Descriptor Information:\n");
-      checkPD(mainPD, reservePD);
+    if (!vol->Fatal) {
+      fprintf(vol->Out, "\n--Partition Descriptor Information:\n");
+    }
+    for (i = 0; (i < MAX(mainVDS.NumPDs, 1)) && !vol->Fatal; i++) {
+      // Each PD is compared with the Reserve PD for the same partition
+      mainPD = (struct PartDesc *)PrevailingVD(&mainVDS, mainVDS.NumPDs ? mainVDS.PDs[i] : -1,
+                                               blank);
+      reservePDEntry = FindPD(&reserveVDS, U_endian16(mainPD->uPartNumber));
+      reservePD = (struct PartDesc *)PrevailingVD(&reserveVDS, reservePDEntry ? *reservePDEntry : -1,
+                                                  blank);
+      checkPD(vol, mainPD, reservePD);
     }
 
-    GetVAT();
+    GetVAT(vol);
 
-    if (Error.Code) {
-      DumpError();
+    if (CurrentError(vol)->Code) {
+      DumpError(vol);
     }
 
-    GetMap();
+    GetMap(vol);
 
-    if (Error.Code) {
-      DumpError();
+    if (CurrentError(vol)->Code) {
+      DumpError(vol);
     }
 
-    ReadPartitionUnallocatedSpaceDescs();
+    GetMetadata(vol);
 
-    if (Error.Code) {
-      DumpError();
+    if (CurrentError(vol)->Code) {
+      DumpError(vol);
+    }
+
+    ReadPartitionUnallocatedSpaceDescs(vol);
+
+    if (CurrentError(vol)->Code) {
+      DumpError(vol);
     }
 
     /* Verify the existence of the IUVD.  Print its contents. */
-    if (!Fatal) {
-      printf("\n--Implementation Use Volume Descriptor information:\n");
-      checkIUVD(mainIUVD, reserveIUVD);
+    if (!vol->Fatal) {
+      fprintf(vol->Out, "\n--Implementation Use Volume Descriptor information:\n");
+      checkIUVD(vol, mainIUVD, reserveIUVD);
     }
   
   
-    if (!Fatal) {
-      printf("\n--Volume space report:\n");
-      for (i = 0; i < VolSpaceListLen; i++) {
-        printf("  %8u : %8u - %s\n", VolSpace[i].Location,
-               VolSpace[i].Location + VolSpace[i].Length - 1, VolSpace[i].Name);
-      }
+    if (!vol->Fatal) {
+      fprintf(vol->Out, "\n--Volume space report:\n");
+      print_volspace(vol);
     } 
-    free(buffer_main);
-    free(buffer_reserve);
+  } else {
+    SetError(vol, ERR_NO_VD_MEM, 0, 0, 0);
+    DumpError(vol);
   }
-  return Error.Code;
+  FreeVDSIndex(&mainVDS);
+  FreeVDSIndex(&reserveVDS);
+  free(mainReader.Buffer);
+  free(reserveReader.Buffer);
+  free(blank);
+  return CurrentError(vol)->Code;
 }
 
@@ -2,53 +2,266 @@
 // Copyright (c) 1999 Rob Simms. All rights reserved.
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "chkudf.h"
 #include "protos.h"
 
-int track_volspace(uint32_t Location, uint32_t Length, char *Name)
+/*
+ * Volume space assignments are kept in an AVL tree ordered by starting
+ * sector. Each node also records the largest end sector in its subtree,
+ * which lets an overlapping extent be found in O(log n).
+ */
+
+static int vs_height(const sVolSpaceNode *node)
+{
+  return node ? node->Height : 0;
+}
+
+static uint64_t vs_maxend(const sVolSpaceNode *node)
+{
+  return node ? node->MaxEnd : 0;
+}
+
+static void vs_update(sVolSpaceNode *node)
+{
+  uint64_t end = (uint64_t)node->Location + node->Length;
+
+  node->Height = 1 + MAX(vs_height(node->Left), vs_height(node->Right));
+  end = MAX(end, vs_maxend(node->Left));
+  node->MaxEnd = MAX(end, vs_maxend(node->Right));
+}
+
+static sVolSpaceNode *vs_rotate_right(sVolSpaceNode *node)
+{
+  sVolSpaceNode *pivot = node->Left;
+
+  node->Left = pivot->Right;
+  pivot->Right = node;
+  vs_update(node);
+  vs_update(pivot);
+  return pivot;
+}
+
+static sVolSpaceNode *vs_rotate_left(sVolSpaceNode *node)
+{
+  sVolSpaceNode *pivot = node->Right;
+
+  node->Right = pivot->Left;
+  pivot->Left = node;
+  vs_update(node);
+  vs_update(pivot);
+  return pivot;
+}
+
+static sVolSpaceNode *vs_insert(sVolSpaceNode *node, sVolSpaceNode *newNode)
+{
+  int balance;
+
+  if (!node) {
+    return newNode;
+  }
+
+  // Equal starting locations go left, so the newest is listed first
+  if (newNode->Location <= node->Location) {
+    node->Left = vs_insert(node->Left, newNode);
+  } else {
+    node->Right = vs_insert(node->Right, newNode);
+  }
+  vs_update(node);
+
+  balance = vs_height(node->Left) - vs_height(node->Right);
+  if (balance > 1) {
+    if (vs_height(node->Left->Left) < vs_height(node->Left->Right)) {
+      node->Left = vs_rotate_left(node->Left);
+    }
+    node = vs_rotate_right(node);
+  } else if (balance < -1) {
+    if (vs_height(node->Right->Right) < vs_height(node->Right->Left)) {
+      node->Right = vs_rotate_right(node->Right);
+    }
+    node = vs_rotate_left(node);
+  }
+
+  return node;
+}
+
+/*
+ * Find any tracked extent that shares a sector with [Location, End).
+ */
+static const sVolSpaceNode *vs_find_overlap(udf_volume *vol, uint32_t Location,
+                                            uint64_t End)
+{
+  const sVolSpaceNode *node = vol->VolSpaceRoot;
+
+  while (node) {
+    if ((node->Location < End) && (Location < (uint64_t)node->Location + node->Length)) {
+      return node;
+    }
+    if (node->Left && (node->Left->MaxEnd > Location)) {
+      node = node->Left;
+    } else {
+      node = node->Right;
+    }
+  }
+
+  return NULL;
+}
+
+static int compare_uint32(const void *a, const void *b)
+{
+  uint32_t ua = *(const uint32_t *)a;
+  uint32_t ub = *(const uint32_t *)b;
+
+  return (ua > ub) - (ua < ub);
+}
+
+static sVolSpaceNode *vs_new_node(udf_volume *vol, uint32_t Location, uint32_t Length,
+                                  char *Name)
+{
+  sVolSpaceNode *newNode = ArenaAlloc(&vol->Arena, sizeof(sVolSpaceNode));
+
+  if (newNode) {
+    newNode->Left = NULL;
+    newNode->Right = NULL;
+    newNode->Location = Location;
+    newNode->Length = Length;
+    newNode->Name = Name;
+    vs_update(newNode);
+  }
+  return newNode;
+}
+
+int track_volspace(udf_volume *vol, uint32_t Location, uint32_t Length, char *Name)
 {
-  int i, j;
   bool error;
 
   error = false;
 
-  if (Length > 0) {  
-    //point to the location where the new extent is >= the list member
-    for (i = 0; (i < VolSpaceListLen) && (Location > VolSpace[i].Location); i++);
-    if (i > 0) {
-      if (((Location + Length - 1) >= VolSpace[i-1].Location) && 
-          (Location < (VolSpace[i-1].Location + VolSpace[i-1].Length))) {
-        Error.Code = ERR_VOL_SPACE_OVERLAP;
-        Error.Sector = Location;
-        error = true;
-      }
+  if (Length > 0) {
+    sVolSpaceNode *newNode;
+
+    if (vs_find_overlap(vol, Location, (uint64_t)Location + Length)) {
+      SetError(vol, ERR_VOL_SPACE_OVERLAP, Location, 0, 0);
+      error = true;
     }
-    if (i < VolSpaceListLen) {
-      if (((Location + Length - 1) >= VolSpace[i].Location) && 
-          (Location < (VolSpace[i].Location + VolSpace[i].Length))) {
-        Error.Code = ERR_VOL_SPACE_OVERLAP;
-        Error.Sector = Location;
+
+    newNode = vs_new_node(vol, Location, Length, Name);
+    if (newNode) {
+      vol->VolSpaceRoot = vs_insert(vol->VolSpaceRoot, newNode);
+    } else {
+      OperationalError(vol, "**Couldn't allocate memory for volume space tracking.\n");
+    }
+    if (error) {
+      DumpError(vol);
+    }
+  }
+  return error;
+}
+
+/*
+ * Track a set of equal-length extents (e.g. sparing packets) at once.
+ *
+ * The locations are sorted and abutting extents merged into runs. The runs
+ * are then checked for overlap against the existing assignments in a single
+ * in-order pass over the tree before being inserted.
+ *
+ * Returns true if any overlap was found.
+ */
+int track_volspace_bulk(udf_volume *vol, const uint32_t *Locations, uint32_t Count,
+                        uint32_t Length, char *Name)
+{
+  const sVolSpaceNode *stack[2 * sizeof(uint32_t) * 8];   // > max AVL height
+  const sVolSpaceNode *node;
+  uint32_t *sorted;
+  uint32_t numRuns, i;
+  uint64_t *runEnd;
+  uint64_t maxEnd = 0;
+  int depth = 0;
+  bool error = false;
+
+  if ((Count == 0) || (Length == 0)) {
+    return false;
+  }
+
+  sorted = malloc(Count * sizeof(uint32_t));
+  runEnd = malloc(Count * sizeof(uint64_t));
+  if (!sorted || !runEnd) {
+    free(sorted);
+    free(runEnd);
+    OperationalError(vol, "**Couldn't allocate memory for volume space tracking.\n");
+    return false;
+  }
+  memcpy(sorted, Locations, Count * sizeof(uint32_t));
+  qsort(sorted, Count, sizeof(uint32_t), compare_uint32);
+
+  // Merge abutting extents into runs: sorted[i] .. runEnd[i] (exclusive)
+  numRuns = 0;
+  for (i = 0; i < Count; i++) {
+    uint64_t end = (uint64_t)sorted[i] + Length;
+    if (numRuns && (sorted[i] <= runEnd[numRuns - 1])) {
+      if (sorted[i] < runEnd[numRuns - 1]) {
+        // Two of the new extents overlap each other
+        SetError(vol, ERR_VOL_SPACE_OVERLAP, sorted[i], 0, 0);
+        DumpError(vol);
         error = true;
       }
+      runEnd[numRuns - 1] = MAX(runEnd[numRuns - 1], end);
+    } else {
+      sorted[numRuns] = sorted[i];
+      runEnd[numRuns] = end;
+      numRuns++;
     }
-    if (VolSpaceListLen < MAX_VOL_EXTS - 1) {
-      for (j = VolSpaceListLen; j > i; j--) {
-        VolSpace[j] = VolSpace[j - 1];
+  }
+
+  // Merge pass against the existing assignments, in location order
+  node = vol->VolSpaceRoot;
+  for (i = 0; i < numRuns; i++) {
+    for (;;) {
+      while (node) {
+        stack[depth++] = node;
+        node = node->Left;
       }
-      VolSpace[i].Location = Location;
-      VolSpace[i].Length = Length;
-      VolSpace[i].Name = Name;
-      VolSpaceListLen++;
-    } else {
-      printf("**Too many volume extents.");
+      if (!depth || (stack[depth - 1]->Location >= runEnd[i])) {
+        break;
+      }
+      node = stack[--depth];
+      maxEnd = MAX(maxEnd, (uint64_t)node->Location + node->Length);
+      node = node->Right;
     }
-  //  printf("\nVolume Allocation list:\n");
-  //  for (i = 0; i < VolSpaceListLen; i++) {
-  //    printf("  %8u %u\n", VolSpace[i].Location, VolSpace[i].Length);
-  //  }
-    if (error) {
-      DumpError();
+    // Every assignment starting before the end of the run has been seen
+    if (maxEnd > sorted[i]) {
+      SetError(vol, ERR_VOL_SPACE_OVERLAP, sorted[i], 0, 0);
+      DumpError(vol);
+      error = true;
     }
   }
+
+  for (i = 0; i < numRuns; i++) {
+    sVolSpaceNode *newNode = vs_new_node(vol, sorted[i], (uint32_t)(runEnd[i] - sorted[i]), Name);
+    if (!newNode) {
+      OperationalError(vol, "**Couldn't allocate memory for volume space tracking.\n");
+      break;
+    }
+    vol->VolSpaceRoot = vs_insert(vol->VolSpaceRoot, newNode);
+  }
+
+  free(sorted);
+  free(runEnd);
   return error;
 }
+
+static void vs_print(udf_volume *vol, const sVolSpaceNode *node)
+{
+  while (node) {
+    vs_print(vol, node->Left);
+    fprintf(vol->Out, "  %8u : %8u - %s\n", node->Location,
+            node->Location + node->Length - 1, node->Name);
+    node = node->Right;
+  }
+}
+
+void print_volspace(udf_volume *vol)
+{
+  vs_print(vol, vol->VolSpaceRoot);
+}